@@ -1,9 +1,48 @@
 // COPYRIGHT :)
 
+#if defined(DrawRootConstants) || defined(DrawDataBuffer)
+// perDrawData: rows of 3x4 affine world matrix, tessellation factors are in w of vertex unpacking parameters
+struct DrawData
+{
+    row_major float3x4 worldMatrix;
+    float4   positionScale;         // w - edges tessellation factor
+    float4   positionOffset;        // w - inside tessellation factor
+    uint     material;
+};
+#endif
+
+#if defined(DrawRootConstants)
+cbuffer DrawParams : register(b0)
+{
+    DrawData drawData;
+};
+
+DrawData getDrawData()
+{
+    return drawData;
+}
+#elif defined(DrawDataBuffer)
+cbuffer DrawParams : register(b0)
+{
+    uint drawId;
+};
+
+StructuredBuffer<DrawData> drawDataBuffer : register(t1);
+
+DrawData getDrawData()
+{
+    return drawDataBuffer[drawId];
+}
+#else
 cbuffer ModelParams : register(b0)
 {
     float4x4 worldMatrix;
+    float4   positionScale;
+    float4   positionOffset;
+    float2   tessellationFactor;    // x - edges, y - inside, selected per object on CPU
+    uint     material;
 };
+#endif
 
 cbuffer FrameParams : register(b1)
 {
@@ -11,8 +50,60 @@ cbuffer FrameParams : register(b1)
     float4   eyePos;
 };
 
+// per-draw data access which doesn't depend on its source
+#if defined(DrawRootConstants) || defined(DrawDataBuffer)
+float3 transformPosition(float3 position)
+{
+    return mul(getDrawData().worldMatrix, float4(position, 1.0f));
+}
+
+float3 transformDirection(float3 direction)
+{
+    return mul((float3x3)getDrawData().worldMatrix, direction);
+}
+
+float3 unpackPosition(float3 position)
+{
+    DrawData data = getDrawData();
+    return position * data.positionScale.xyz + data.positionOffset.xyz;
+}
+
+float2 getTessellationFactor()
+{
+    DrawData data = getDrawData();
+    return float2(data.positionScale.w, data.positionOffset.w);
+}
+#else
+float3 transformPosition(float3 position)
+{
+    return mul(float4(position, 1.0f), worldMatrix).xyz;
+}
+
+float3 transformDirection(float3 direction)
+{
+    return mul(direction, (float3x3)worldMatrix);
+}
+
+float3 unpackPosition(float3 position)
+{
+    return position * positionScale.xyz + positionOffset.xyz;
+}
+
+float2 getTessellationFactor()
+{
+    return tessellationFactor.xy;
+}
+#endif
+
 struct VS_IN
 {
+#ifdef PackedVertices
+    float4 position     : POSITION;
+#ifdef UseTessellation
+    float4 tangentFrame : TANGENTFRAME;
+    float2 uv           : TEXCOORD;
+#endif
+#else
     float3 position : POSITION;
 #ifdef UseTessellation
     float3 normal   : NORMAL;
@@ -20,6 +111,7 @@ struct VS_IN
     float3 tangent  : TANGENT;
     float2 uv       : TEXCOORD;
 #endif
+#endif
 };
 
 struct VS_OUT
@@ -33,16 +125,31 @@ struct VS_OUT
 #endif
 };
 
+#ifdef PackedVertices
+#include "TangentFrame.hlsl"
+#endif
+
 VS_OUT vs_main(VS_IN input)
 {
+#ifdef PackedVertices
+    float3 position = unpackPosition(input.position.xyz);
+#else
+    float3 position = input.position;
+#endif
+
     VS_OUT output;
 #ifdef UseTessellation
-    output.position = input.position;
-    output.normal = mul(input.normal, (float3x3)worldMatrix);
+#ifdef PackedVertices
+    float3 normal, binormal, tangent;
+    decodeTangentFrame(input.tangentFrame, normal, binormal, tangent);
+#else
+    float3 normal = input.normal;
+#endif
+    output.position = position;
+    output.normal = transformDirection(normal);
     output.uv = input.uv;
 #else
-    output.position = mul(float4(input.position, 1.0f), worldMatrix);
-    output.position = mul(output.position, viewProjectionMatrix);
+    output.position = mul(float4(transformPosition(position), 1.0f), viewProjectionMatrix);
 #endif
     return output;
 }
@@ -69,15 +176,12 @@ struct HS_CONSTANT_DATA_OUTPUT
 HS_CONSTANT_DATA_OUTPUT HSConstant(InputPatch<VS_OUT, MAX_POINTS> ip,
                                    uint PatchID : SV_PrimitiveID)
 {
-    float4 projectedPosition = mul(mul(float4(ip[0].position, 1.0f), worldMatrix), viewProjectionMatrix);
-    float d = (1.0f - projectedPosition.z / projectedPosition.w) * 250.0f;
-    d = clamp(d, 1.0, 15.0);
-
     HS_CONSTANT_DATA_OUTPUT output;
-    output.edges[0] = d;
-    output.edges[1] = d;
-    output.edges[2] = d;
-    output.inside = d / 1.5;
+    float2 factor = getTessellationFactor();
+    output.edges[0] = factor.x;
+    output.edges[1] = factor.x;
+    output.edges[2] = factor.x;
+    output.inside = factor.y;
     return output;
 }
 
@@ -104,6 +208,7 @@ struct DS_OUT
     float4 position : SV_POSITION;
 };
 
+// Tessellator::SurfaceHeight() repeats this formula for the CPU tessellation, keep them in sync
 float surfaceHeight(float2 uv)
 {
     return (pow((sin((uv.x + 0.8) * 6.28) + 1.0) / 2.0, 4.0) *
@@ -133,8 +238,7 @@ DS_OUT ds_main(HS_CONSTANT_DATA_OUTPUT input,
     normalValue = normalize(normalValue);
 
     vertexPosition += normalValue * surfaceHeight(uvPosition);
-    output.position = mul(float4(vertexPosition, 1.0f), worldMatrix);
-    output.position = mul(output.position, viewProjectionMatrix);
+    output.position = mul(float4(transformPosition(vertexPosition), 1.0f), viewProjectionMatrix);
 
     return output;
 }
@@ -0,0 +1,68 @@
+// COPYRIGHT :)
+
+// Histogram exposure pass 2: texels below the low and above the high percentile are clipped, the average is
+// taken over log luminance of the rest, and the high percentile is the white point. The histogram is
+// cleared for the next frame. utils/LuminanceHistogram.cpp repeats the same steps.
+
+struct OutLuminanceBufferType
+{
+    float AverageLuminance;
+    float MaxLuminance;
+};
+
+RWStructuredBuffer<uint> Histogram                          : register(u0);
+RWStructuredBuffer<OutLuminanceBufferType> IntensityOut     : register(u1);
+
+#define HISTOGRAM_BINS 128
+#define MIN_LOG_LUMINANCE -10.0
+#define LOG_LUMINANCE_RANGE 12.0
+#define LOW_PERCENTILE 0.5
+#define HIGH_PERCENTILE 0.95
+
+groupshared uint GroupHistogram[HISTOGRAM_BINS];
+
+float GetBinLogLuminance(uint bin)
+{
+    if (bin == 0)
+        return MIN_LOG_LUMINANCE;
+
+    return MIN_LOG_LUMINANCE + ((bin - 1) + 0.5) / (HISTOGRAM_BINS - 2) * LOG_LUMINANCE_RANGE;
+}
+
+[numthreads(HISTOGRAM_BINS, 1, 1)]
+void cs_main(uint GroupIndex : SV_GroupIndex)
+{
+    GroupHistogram[GroupIndex] = Histogram[GroupIndex];
+    Histogram[GroupIndex] = 0;
+    GroupMemoryBarrierWithGroupSync();
+
+    // 128 bins are walked in one thread, it's shorter than synchronization of a parallel scan
+    if (GroupIndex == 0)
+    {
+        float TexelsCount = 0.0;
+        for (uint i = 0; i < HISTOGRAM_BINS; ++i)
+            TexelsCount += GroupHistogram[i];
+
+        float LowCount = TexelsCount * LOW_PERCENTILE;
+        float HighCount = TexelsCount * HIGH_PERCENTILE;
+
+        float Accumulated = 0.0;
+        float LogLuminanceSum = 0.0;
+        float Weight = 0.0;
+        float WhiteLogLuminance = MIN_LOG_LUMINANCE;
+        for (uint bin = 0; bin < HISTOGRAM_BINS; ++bin)
+        {
+            float Count = GroupHistogram[bin];
+            float Inside = clamp(Accumulated + Count, LowCount, HighCount) - clamp(Accumulated, LowCount, HighCount);
+            LogLuminanceSum += Inside * GetBinLogLuminance(bin);
+            Weight += Inside;
+            if (Accumulated < HighCount)
+                WhiteLogLuminance = GetBinLogLuminance(bin);
+            Accumulated += Count;
+        }
+
+        IntensityOut[0].AverageLuminance = exp2(LogLuminanceSum / max(Weight, 1.0));
+        // maximum luminance is clamped due to enforcing color burning with Reinhard-operator model
+        IntensityOut[0].MaxLuminance = clamp(exp2(WhiteLogLuminance), 0.4, 1.2);
+    }
+}
@@ -0,0 +1,59 @@
+// COPYRIGHT :)
+
+// Histogram exposure pass 1: log2 luminance histogram of the HDR image downsampled by 2x2 averaging.
+// Every group counts its texels in groupshared bins and adds them to the global histogram.
+// utils/LuminanceHistogram.cpp uses the same bins.
+
+Texture2D<float4> ScreenQuad                : register(t0);
+RWStructuredBuffer<uint> Histogram          : register(u0);
+
+#define GROUP_SIZE 16
+#define HISTOGRAM_BINS 128
+#define MIN_LOG_LUMINANCE -10.0
+#define LOG_LUMINANCE_RANGE 12.0
+
+groupshared uint GroupHistogram[HISTOGRAM_BINS];
+
+// bin 0 is for texels darker than the range, the rest split the range evenly
+uint GetBin(float luminance)
+{
+    if (luminance < exp2(MIN_LOG_LUMINANCE))
+        return 0;
+
+    float position = saturate((log2(luminance) - MIN_LOG_LUMINANCE) / LOG_LUMINANCE_RANGE);
+    return (uint)(position * (HISTOGRAM_BINS - 2) + 1.0);
+}
+
+[numthreads(GROUP_SIZE, GROUP_SIZE, 1)]
+void cs_main(uint3 DispatchThreadID : SV_DispatchThreadID,
+             uint GroupIndex : SV_GroupIndex)
+{
+    if (GroupIndex < HISTOGRAM_BINS)
+        GroupHistogram[GroupIndex] = 0;
+    GroupMemoryBarrierWithGroupSync();
+
+    uint Width = 0;
+    uint Height = 0;
+    uint NumberOfLevels = 0;
+
+    ScreenQuad.GetDimensions(0, // mip-level
+                             Width,
+                             Height,
+                             NumberOfLevels);
+
+    // one texel of the half resolution image
+    if (DispatchThreadID.x < (Width + 1) / 2 && DispatchThreadID.y < (Height + 1) / 2)
+    {
+        uint2 Coords = DispatchThreadID.xy * 2;
+        uint2 LastCoords = uint2(Width - 1, Height - 1);
+        float3 TopRGB = ScreenQuad[Coords].rgb + ScreenQuad[min(Coords + uint2(1, 0), LastCoords)].rgb;
+        float3 BottomRGB = ScreenQuad[min(Coords + uint2(0, 1), LastCoords)].rgb + ScreenQuad[min(Coords + uint2(1, 1), LastCoords)].rgb;
+        float3 TextureRGB = (TopRGB + BottomRGB) * 0.25;
+        float luminance = 0.2126 * TextureRGB.r + 0.7152 * TextureRGB.g + 0.0722 * TextureRGB.b;
+        InterlockedAdd(GroupHistogram[GetBin(luminance)], 1);
+    }
+    GroupMemoryBarrierWithGroupSync();
+
+    if (GroupIndex < HISTOGRAM_BINS && GroupHistogram[GroupIndex] != 0)
+        InterlockedAdd(Histogram[GroupIndex], GroupHistogram[GroupIndex]);
+}
@@ -1,5 +1,8 @@
 // COPYRIGHT :)
 
+// Pass 1 of luminance computing: every 16x16 tile of the screen is reduced to the sum of log luminance
+// and maximum luminance in groupshared memory. utils/LuminanceReduction.cpp repeats the same order of additions.
+
 struct OutLuminanceBufferType
 {
     float AverageLuminance;
@@ -7,14 +10,18 @@ struct OutLuminanceBufferType
 };
 
 Texture2D<float4> ScreenQuad                                    : register(t0);
-RWStructuredBuffer<OutLuminanceBufferType> LineIntensityBuffer  : register(u0);
-RWStructuredBuffer<OutLuminanceBufferType> IntensityOut         : register(u1);
+RWStructuredBuffer<OutLuminanceBufferType> TileIntensityBuffer  : register(u0);
+
+#define TILE_SIZE 16
+#define THREADS_IN_GROUP (TILE_SIZE * TILE_SIZE)
 
-#define MAX_THREADS_IN_GROUP 32
+groupshared float TileLogLuminance[THREADS_IN_GROUP];
+groupshared float TileMaxLuminance[THREADS_IN_GROUP];
 
-[numthreads(MAX_THREADS_IN_GROUP, 1, 1)]
-void cs_main(uint3 ThreadID : SV_GroupThreadID,
-             uint3 GroupID : SV_GroupID)
+[numthreads(TILE_SIZE, TILE_SIZE, 1)]
+void cs_main(uint3 DispatchThreadID : SV_DispatchThreadID,
+             uint3 GroupID : SV_GroupID,
+             uint GroupIndex : SV_GroupIndex)
 {
     uint Width = 0;
     uint Height = 0;
@@ -25,39 +32,36 @@ void cs_main(uint3 ThreadID : SV_GroupThreadID,
                              Height,
                              NumberOfLevels);
 
-    uint yCoord = GroupID.x * MAX_THREADS_IN_GROUP + ThreadID.x;
-
-    if (yCoord < Height)
+    // texels outside of the screen don't change the sum and the maximum
+    float LogLuminance = 0.0f;
+    float MaxLuminance = 0.0f;
+    if (DispatchThreadID.x < Width && DispatchThreadID.y < Height)
     {
-        float LineLuminance = 0.0f;
-        float MaxLineLuminance = 0.0f;
-        for (uint j = 0; j < Width; ++j)
-        {
-            uint2 LoadCoords = uint2(j, yCoord);
-            float3 TextureRGB = ScreenQuad[LoadCoords].rgb;
-            float luminance = 0.2126 * TextureRGB.r + 0.7152 * TextureRGB.g + 0.0722 * TextureRGB.b;
-            MaxLineLuminance = max(luminance, MaxLineLuminance);
-            LineLuminance += log(0.001 + luminance); // delta + Y channel
-        }
-        LineIntensityBuffer[yCoord].AverageLuminance = LineLuminance;
-        LineIntensityBuffer[yCoord].MaxLuminance = MaxLineLuminance;
+        float3 TextureRGB = ScreenQuad[DispatchThreadID.xy].rgb;
+        float luminance = 0.2126 * TextureRGB.r + 0.7152 * TextureRGB.g + 0.0722 * TextureRGB.b;
+        LogLuminance = log(0.001 + luminance); // delta + Y channel
+        MaxLuminance = luminance;
     }
 
-    DeviceMemoryBarrierWithGroupSync();
+    TileLogLuminance[GroupIndex] = LogLuminance;
+    TileMaxLuminance[GroupIndex] = MaxLuminance;
+    GroupMemoryBarrierWithGroupSync();
 
-    // compute overall luminance
-    if (ThreadID.x == 0 && GroupID.x == 0)
+    [unroll]
+    for (uint stride = THREADS_IN_GROUP / 2; stride > 0; stride >>= 1)
     {
-        float OverallLuminance = 0.0f;
-        float MaxImageLuminance = 0.0f;
-        for (uint i = 0; i < Height; ++i)
+        if (GroupIndex < stride)
         {
-            OverallLuminance += LineIntensityBuffer[i].AverageLuminance;
-            MaxImageLuminance = max(LineIntensityBuffer[i].MaxLuminance, MaxImageLuminance);
+            TileLogLuminance[GroupIndex] += TileLogLuminance[GroupIndex + stride];
+            TileMaxLuminance[GroupIndex] = max(TileMaxLuminance[GroupIndex], TileMaxLuminance[GroupIndex + stride]);
         }
+        GroupMemoryBarrierWithGroupSync();
+    }
 
-        IntensityOut[0].AverageLuminance = exp(1.0 / (Width * Height) * OverallLuminance);
-        // maximum luminance is clamped due to enforcing color burning with Reinhard-operator model
-        IntensityOut[0].MaxLuminance = clamp(MaxImageLuminance, 0.4, 1.2);
+    if (GroupIndex == 0)
+    {
+        uint TilesInRow = (Width + TILE_SIZE - 1) / TILE_SIZE;
+        TileIntensityBuffer[GroupID.y * TilesInRow + GroupID.x].AverageLuminance = TileLogLuminance[0];
+        TileIntensityBuffer[GroupID.y * TilesInRow + GroupID.x].MaxLuminance = TileMaxLuminance[0];
     }
 }
@@ -0,0 +1,65 @@
+// COPYRIGHT :)
+
+// Pass 2 of luminance computing: one group reduces all tiles of IntensityPass.hlsl, every thread sums
+// tiles with the group size stride, then sums of threads are reduced in groupshared memory.
+
+struct OutLuminanceBufferType
+{
+    float AverageLuminance;
+    float MaxLuminance;
+};
+
+Texture2D<float4> ScreenQuad                                    : register(t0);
+RWStructuredBuffer<OutLuminanceBufferType> TileIntensityBuffer  : register(u0);
+RWStructuredBuffer<OutLuminanceBufferType> IntensityOut         : register(u1);
+
+#define TILE_SIZE 16
+#define THREADS_IN_GROUP 256
+
+groupshared float LogLuminance[THREADS_IN_GROUP];
+groupshared float MaxLuminance[THREADS_IN_GROUP];
+
+[numthreads(THREADS_IN_GROUP, 1, 1)]
+void cs_main(uint GroupIndex : SV_GroupIndex)
+{
+    uint Width = 0;
+    uint Height = 0;
+    uint NumberOfLevels = 0;
+
+    ScreenQuad.GetDimensions(0, // mip-level
+                             Width,
+                             Height,
+                             NumberOfLevels);
+
+    uint TilesCount = ((Width + TILE_SIZE - 1) / TILE_SIZE) * ((Height + TILE_SIZE - 1) / TILE_SIZE);
+
+    float ThreadLogLuminance = 0.0f;
+    float ThreadMaxLuminance = 0.0f;
+    for (uint i = GroupIndex; i < TilesCount; i += THREADS_IN_GROUP)
+    {
+        ThreadLogLuminance += TileIntensityBuffer[i].AverageLuminance;
+        ThreadMaxLuminance = max(ThreadMaxLuminance, TileIntensityBuffer[i].MaxLuminance);
+    }
+
+    LogLuminance[GroupIndex] = ThreadLogLuminance;
+    MaxLuminance[GroupIndex] = ThreadMaxLuminance;
+    GroupMemoryBarrierWithGroupSync();
+
+    [unroll]
+    for (uint stride = THREADS_IN_GROUP / 2; stride > 0; stride >>= 1)
+    {
+        if (GroupIndex < stride)
+        {
+            LogLuminance[GroupIndex] += LogLuminance[GroupIndex + stride];
+            MaxLuminance[GroupIndex] = max(MaxLuminance[GroupIndex], MaxLuminance[GroupIndex + stride]);
+        }
+        GroupMemoryBarrierWithGroupSync();
+    }
+
+    if (GroupIndex == 0)
+    {
+        IntensityOut[0].AverageLuminance = exp(LogLuminance[0] / (Width * Height));
+        // maximum luminance is clamped due to enforcing color burning with Reinhard-operator model
+        IntensityOut[0].MaxLuminance = clamp(MaxLuminance[0], 0.4, 1.2);
+    }
+}
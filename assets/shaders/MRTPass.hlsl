@@ -1,9 +1,48 @@
 // COPYRIGHT :)
 
+#if defined(DrawRootConstants) || defined(DrawDataBuffer)
+// perDrawData: rows of 3x4 affine world matrix, tessellation factors are in w of vertex unpacking parameters
+struct DrawData
+{
+    row_major float3x4 worldMatrix;
+    float4   positionScale;         // w - edges tessellation factor
+    float4   positionOffset;        // w - inside tessellation factor
+    uint     material;
+};
+#endif
+
+#if defined(DrawRootConstants)
+cbuffer DrawParams : register(b0)
+{
+    DrawData drawData;
+};
+
+DrawData getDrawData()
+{
+    return drawData;
+}
+#elif defined(DrawDataBuffer)
+cbuffer DrawParams : register(b0)
+{
+    uint drawId;
+};
+
+StructuredBuffer<DrawData> drawDataBuffer : register(t1);
+
+DrawData getDrawData()
+{
+    return drawDataBuffer[drawId];
+}
+#else
 cbuffer ModelParams : register(b0)
 {
     float4x4 worldMatrix;
+    float4   positionScale;
+    float4   positionOffset;
+    float2   tessellationFactor;    // x - edges, y - inside, selected per object on CPU
+    uint     material;
 };
+#endif
 
 cbuffer FrameParams : register(b1)
 {
@@ -11,12 +50,78 @@ cbuffer FrameParams : register(b1)
     float4   eyePos;
 };
 
+// per-draw data access which doesn't depend on its source
+#if defined(DrawRootConstants) || defined(DrawDataBuffer)
+float3 transformPosition(float3 position)
+{
+    return mul(getDrawData().worldMatrix, float4(position, 1.0f));
+}
+
+float3 transformDirection(float3 direction)
+{
+    return mul((float3x3)getDrawData().worldMatrix, direction);
+}
+
+float3 unpackPosition(float3 position)
+{
+    DrawData data = getDrawData();
+    return position * data.positionScale.xyz + data.positionOffset.xyz;
+}
+
+float2 getTessellationFactor()
+{
+    DrawData data = getDrawData();
+    return float2(data.positionScale.w, data.positionOffset.w);
+}
+
+uint getMaterial()
+{
+    return getDrawData().material;
+}
+#else
+float3 transformPosition(float3 position)
+{
+    return mul(float4(position, 1.0f), worldMatrix).xyz;
+}
+
+float3 transformDirection(float3 direction)
+{
+    return mul(direction, (float3x3)worldMatrix);
+}
+
+float3 unpackPosition(float3 position)
+{
+    return position * positionScale.xyz + positionOffset.xyz;
+}
+
+float2 getTessellationFactor()
+{
+    return tessellationFactor;
+}
+
+uint getMaterial()
+{
+    return material;
+}
+#endif
+
 #ifdef RootConstants
 float texCoordShift : register(b2);
 #endif
 
 #ifdef UseTextures
+#ifdef BindlessTextures
+// materialData, textures are indices in the whole textures heap
+struct Material
+{
+    uint diffuseTexture;
+};
+
+StructuredBuffer<Material> materials : register(t2);
+Texture2D    g_textures[] : register(t0, space1);
+#else
 Texture2D    g_texture : register(t0);
+#endif
 SamplerState g_sampler : register(s0);
 #endif
 
@@ -24,10 +129,15 @@ SamplerState g_sampler : register(s0);
 
 struct VS_IN
 {
+#ifdef PackedVertices
+    float4 position     : POSITION;
+    float4 tangentFrame : TANGENTFRAME;
+#else
     float3 position : POSITION;
     float3 normal   : NORMAL;
     float3 binormal : BINORMAL;
     float3 tangent  : TANGENT;
+#endif
     float2 uv       : TEXCOORD;
 };
 
@@ -44,17 +154,32 @@ struct VS_OUT
     float2 uv       : TEXCOORD;
 };
 
+#ifdef PackedVertices
+#include "TangentFrame.hlsl"
+#endif
+
 VS_OUT vs_main(VS_IN input)
 {
+#ifdef PackedVertices
+    float3 position = unpackPosition(input.position.xyz);
+    float3 normal, binormal, tangent;
+    decodeTangentFrame(input.tangentFrame, normal, binormal, tangent);
+#else
+    float3 position = input.position;
+    float3 normal = input.normal;
+    float3 binormal = input.binormal;
+    float3 tangent = input.tangent;
+#endif
+
     VS_OUT output;
 #ifdef UseTessellation
-    output.position = input.position;
+    output.position = position;
 #else
-    output.position = mul(mul(float4(input.position, 1.0f), worldMatrix), viewProjectionMatrix);
+    output.position = mul(float4(transformPosition(position), 1.0f), viewProjectionMatrix);
 #endif
-    output.normal = mul(input.normal, (float3x3)worldMatrix);
-    output.binormal = mul(input.binormal, (float3x3)worldMatrix);
-    output.tangent = mul(input.tangent, (float3x3)worldMatrix);
+    output.normal = transformDirection(normal);
+    output.binormal = transformDirection(binormal);
+    output.tangent = transformDirection(tangent);
 #ifdef RootConstants
     output.uv = float2(input.uv.x + texCoordShift, input.uv.y + texCoordShift);
 #else
@@ -89,15 +214,12 @@ struct HS_CONSTANT_DATA_OUTPUT
 HS_CONSTANT_DATA_OUTPUT HSConstant(InputPatch<VS_OUT, MAX_POINTS> ip,
                                    uint PatchID : SV_PrimitiveID)
 {
-    float4 projectedPosition = mul(mul(float4(ip[0].position, 1.0), worldMatrix), viewProjectionMatrix);
-    float d = (1.0 - projectedPosition.z / projectedPosition.w) * 250.0;
-    d = clamp(d, 1.0, 15.0);
-
     HS_CONSTANT_DATA_OUTPUT output;
-    output.edges[0] = d;
-    output.edges[1] = d;
-    output.edges[2] = d;
-    output.inside = d / 1.5;
+    float2 factor = getTessellationFactor();
+    output.edges[0] = factor.x;
+    output.edges[1] = factor.x;
+    output.edges[2] = factor.x;
+    output.inside = factor.y;
     return output;
 }
 
@@ -130,6 +252,7 @@ struct DS_OUT
     float2 uv       : TEXCOORD;
 };
 
+// Tessellator::SurfaceHeight() repeats this formula for the CPU tessellation, keep them in sync
 float surfaceHeight(float2 uv)
 {
     return (pow((sin((uv.x + 0.8) * 6.28) + 1.0) / 2.0, 4.0) * 
@@ -165,8 +288,7 @@ DS_OUT ds_main(HS_CONSTANT_DATA_OUTPUT input,
 
     vertexPosition += patch[0].normal * surfaceHeight(uvPosition);
     // Calculate the position of the new vertex against the world, view, and projection matrices.
-    output.position = mul(float4(vertexPosition, 1.0f), worldMatrix);
-    output.position = mul(output.position, viewProjectionMatrix);
+    output.position = mul(float4(transformPosition(vertexPosition), 1.0f), viewProjectionMatrix);
 
     output.normal = normal;
     output.binormal = binormal;
@@ -195,7 +317,10 @@ PS_OUT ps_main(
 )
 {
     PS_OUT output;
-#ifdef UseTextures
+#if defined(BindlessTextures)
+    // the index is the same for the whole draw, so it doesn't need NonUniformResourceIndex
+    float4 diffuseSample = g_textures[materials[getMaterial()].diffuseTexture].Sample(g_sampler, input.uv);
+#elif defined(UseTextures)
     float4 diffuseSample = g_texture.Sample(g_sampler, input.uv);
 #else
     float4 diffuseSample = float4(0.75f, 0.75f, 0.75f, 1.0f);
@@ -0,0 +1,10 @@
+// Restores (binormal, tangent, normal) rows from quaternion, sign of w keeps the binormal handedness
+void decodeTangentFrame(float4 frame, out float3 normal, out float3 binormal, out float3 tangent)
+{
+    float handedness = frame.w < 0.0f ? -1.0f : 1.0f;
+    float4 q = normalize(float4(frame.xyz, abs(frame.w)));
+
+    binormal = handedness * float3(1.0f - 2.0f * (q.y * q.y + q.z * q.z), 2.0f * (q.x * q.y + q.z * q.w), 2.0f * (q.x * q.z - q.y * q.w));
+    tangent  = float3(2.0f * (q.x * q.y - q.z * q.w), 1.0f - 2.0f * (q.x * q.x + q.z * q.z), 2.0f * (q.y * q.z + q.x * q.w));
+    normal   = float3(2.0f * (q.x * q.z + q.y * q.w), 2.0f * (q.y * q.z - q.x * q.w), 1.0f - 2.0f * (q.x * q.x + q.y * q.y));
+}
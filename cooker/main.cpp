@@ -0,0 +1,265 @@
+#include "stdafx.h"
+
+#include <utils/AssetPack.h>
+#include <utils/ParallelFor.h>
+#include <utils/ShaderCache.h>
+#include <utils/ShaderPermutations.h>
+#include <utils/SubresourceStaging.h>
+#include <3rdparty/DDS.h>
+
+namespace fs = std::filesystem;
+
+using namespace std::chrono;
+
+namespace
+{
+std::vector<uint8_t> ReadFile(const fs::path& path)
+{
+    std::ifstream file {path, std::ios::binary | std::ios::ate};
+    if (!file)
+        throw std::runtime_error("Failed to open " + path.string());
+
+    std::vector<uint8_t> data((size_t)file.tellg());
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(data.data()), data.size());
+    return data;
+}
+
+DXGI_FORMAT GetLegacyFormat(const DirectX::DDS_PIXELFORMAT& format)
+{
+    if (!(format.flags & DDS_FOURCC))
+        return DXGI_FORMAT_UNKNOWN;
+
+    static const std::map<uint32_t, DXGI_FORMAT> formats = {
+        {MAKEFOURCC('D', 'X', 'T', '1'), DXGI_FORMAT_BC1_UNORM},
+        {MAKEFOURCC('D', 'X', 'T', '3'), DXGI_FORMAT_BC2_UNORM},
+        {MAKEFOURCC('D', 'X', 'T', '5'), DXGI_FORMAT_BC3_UNORM},
+        {MAKEFOURCC('B', 'C', '4', 'U'), DXGI_FORMAT_BC4_UNORM},
+        {MAKEFOURCC('B', 'C', '4', 'S'), DXGI_FORMAT_BC4_SNORM},
+        {MAKEFOURCC('A', 'T', 'I', '1'), DXGI_FORMAT_BC4_UNORM},
+        {MAKEFOURCC('B', 'C', '5', 'U'), DXGI_FORMAT_BC5_UNORM},
+        {MAKEFOURCC('B', 'C', '5', 'S'), DXGI_FORMAT_BC5_SNORM},
+        {MAKEFOURCC('A', 'T', 'I', '2'), DXGI_FORMAT_BC5_UNORM},
+    };
+
+    auto iter = formats.find(format.fourCC);
+    return iter == formats.end() ? DXGI_FORMAT_UNKNOWN : iter->second;
+}
+
+// DDS keeps subresources tightly packed in the same order as D3D12 does: all mips of the first slice,
+// then mips of the next one. They are re-laid out by copyable footprints in the pack.
+void CookDDS(AssetPack::Writer& writer, const fs::path& path, const std::string& name)
+{
+    using namespace DirectX;
+
+    const std::vector<uint8_t> data = ReadFile(path);
+    size_t offset = sizeof(uint32_t) + sizeof(DDS_HEADER);
+
+    uint32_t magic = 0;
+    DDS_HEADER header = {};
+    if (data.size() < offset)
+        throw std::runtime_error(path.string() + " is not a DDS file");
+
+    memcpy(&magic, data.data(), sizeof(magic));
+    memcpy(&header, data.data() + sizeof(magic), sizeof(header));
+    if (magic != DDS_MAGIC || header.size != sizeof(DDS_HEADER))
+        throw std::runtime_error(path.string() + " is not a DDS file");
+
+    D3D12_RESOURCE_DESC desc = {};
+    desc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+    desc.Width = header.width;
+    desc.Height = header.height;
+    desc.DepthOrArraySize = 1;
+    desc.MipLevels = (UINT16)std::max(header.mipMapCount, 1u);
+    desc.SampleDesc.Count = 1;
+    bool cube = false;
+
+    if ((header.ddspf.flags & DDS_FOURCC) && header.ddspf.fourCC == MAKEFOURCC('D', 'X', '1', '0'))
+    {
+        DDS_HEADER_DXT10 extension = {};
+        if (data.size() < offset + sizeof(extension))
+            throw std::runtime_error(path.string() + " is truncated");
+
+        memcpy(&extension, data.data() + offset, sizeof(extension));
+        offset += sizeof(extension);
+
+        // DDS dimensions have the same values as D3D12 ones
+        desc.Dimension = (D3D12_RESOURCE_DIMENSION)extension.resourceDimension;
+        desc.Format = (DXGI_FORMAT)extension.dxgiFormat;
+        desc.DepthOrArraySize = (UINT16)extension.arraySize;
+        cube = (extension.miscFlag & DDS_RESOURCE_MISC_TEXTURECUBE) != 0;
+    }
+    else
+    {
+        desc.Format = GetLegacyFormat(header.ddspf);
+        if (header.flags & DDS_HEADER_FLAGS_VOLUME)
+            desc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE3D;
+        if ((header.caps2 & DDS_CUBEMAP_ALLFACES) == DDS_CUBEMAP_ALLFACES)
+            cube = true;
+    }
+
+    if (desc.Dimension == D3D12_RESOURCE_DIMENSION_TEXTURE3D)
+        desc.DepthOrArraySize = (UINT16)header.depth;
+    if (cube)
+        desc.DepthOrArraySize *= 6;
+
+    if (desc.Format == DXGI_FORMAT_UNKNOWN || desc.Dimension == D3D12_RESOURCE_DIMENSION_UNKNOWN)
+        throw std::runtime_error(path.string() + " has unsupported format");
+
+    const UINT arraySize = desc.Dimension == D3D12_RESOURCE_DIMENSION_TEXTURE3D ? 1 : desc.DepthOrArraySize;
+    const CopyableFootprints footprints = ComputeCopyableFootprints(desc, 0, desc.MipLevels * arraySize, 0);
+
+    std::vector<D3D12_SUBRESOURCE_DATA> subresources;
+    for (size_t i = 0; i < footprints.layouts.size(); ++i)
+    {
+        const LONG_PTR rowPitch = (LONG_PTR)footprints.rowSizesInBytes[i];
+        const LONG_PTR slicePitch = rowPitch * footprints.numRows[i];
+        const size_t size = (size_t)slicePitch * footprints.layouts[i].Footprint.Depth;
+        if (offset + size > data.size())
+            throw std::runtime_error(path.string() + " is truncated");
+
+        subresources.push_back({data.data() + offset, rowPitch, slicePitch});
+        offset += size;
+    }
+
+    writer.AddTexture(name, desc, subresources.data(), cube);
+}
+
+// D3DCompile of ShaderCache::Compiler, the error goes to the cooking output instead of a message box
+ComPtr<ID3DBlob> CompileShader(const std::string& source,
+                               const std::string& sourceName,
+                               const std::string& entryPoint,
+                               const std::string& profile,
+                               uint32_t flags,
+                               std::string& errorText)
+{
+    ComPtr<ID3DBlob> bytecode;
+    ComPtr<ID3DBlob> error;
+    if (FAILED(D3DCompile(source.data(), source.size(), sourceName.c_str(), nullptr, nullptr, entryPoint.c_str(), profile.c_str(), flags, 0, &bytecode, &error)))
+    {
+        errorText = error ? (const char*)error->GetBufferPointer() : "compilation failed";
+        return nullptr;
+    }
+    return bytecode;
+}
+
+// All permutations from the registry are compiled in parallel through the shader cache, so variants of
+// unchanged shaders are loaded from it. Any failed one fails cooking, so every variant the sample may ask
+// for is in the pack.
+size_t CookShaderPermutations(AssetPack::Writer& writer, const fs::path& shadersPath, const std::string& cacheDirectory, size_t& cachedCount)
+{
+    using namespace ShaderPermutations;
+
+    const std::vector<Permutation> permutations = Enumerate();
+    std::vector<ComPtr<ID3DBlob>> bytecodes(permutations.size());
+    std::vector<std::string> errors(permutations.size());
+    std::atomic_size_t hits = 0;
+
+    Threading::ParallelFor(permutations.size(), 1, [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            const Permutation& permutation = permutations[i];
+            const fs::path path = shadersPath / fs::path(GetShaderInfo(permutation.shader).fileName).filename();
+            const std::vector<D3D_SHADER_MACRO> macro = GetMacros(permutation.features);
+
+            // statistics of the cache aren't synchronized, so every thread has own one
+            std::string error;
+            ShaderCache cache {cacheDirectory, nullptr, [&error](const std::string& source, const std::string& sourceName,
+                                                                 const std::string& entryPoint, const std::string& profile, uint32_t flags)
+            {
+                return CompileShader(source, sourceName, entryPoint, profile, flags, error);
+            }};
+
+            try
+            {
+                bytecodes[i] = cache.CompileFromFile(path.wstring(), permutation.stage, macro.data());
+                hits += cache.Statistics().hits;
+            }
+            catch (const std::exception& preprocessorError)
+            {
+                error = preprocessorError.what();
+            }
+
+            if (!bytecodes[i])
+                errors[i] = GetEntryName(permutation) + ": " + (error.empty() ? "compilation failed" : error);
+        }
+    });
+
+    for (size_t i = 0; i < permutations.size(); ++i)
+    {
+        if (!errors[i].empty())
+            throw std::runtime_error(errors[i]);
+
+        writer.AddData(GetEntryName(permutations[i]), AssetPack::EntryType::Shader, bytecodes[i]->GetBufferPointer(), bytecodes[i]->GetBufferSize());
+    }
+
+    cachedCount = hits;
+    return permutations.size();
+}
+}
+
+// asset_cooker <assets folder> <output pack> [mesh cache folder] [shader cache folder]
+int main(int argc, char ** argv)
+{
+    if (argc < 3)
+    {
+        std::cout << "Usage: asset_cooker <assets folder> <output pack> [mesh cache folder] [shader cache folder]" << std::endl;
+        return 1;
+    }
+
+    try
+    {
+        const fs::path assetsPath = argv[1];
+        auto start = high_resolution_clock::now();
+
+        AssetPack::Writer writer {argv[2]};
+        size_t textures = 0, shaders = 0, cachedShaders = 0, meshes = 0;
+
+        for (const auto& file : fs::directory_iterator(assetsPath / "textures"))
+        {
+            if (file.path().extension() != ".dds")
+                continue;
+
+            try
+            {
+                CookDDS(writer, file.path(), "textures/" + file.path().filename().string());
+                textures++;
+            }
+            catch (const std::runtime_error& error)
+            {
+                std::cout << "Skipped " << error.what() << std::endl;
+            }
+        }
+
+        const std::string shaderCachePath = argc > 4 ? argv[4] : "shaderCache";
+        shaders = CookShaderPermutations(writer, assetsPath / "shaders", shaderCachePath, cachedShaders);
+
+        if (argc > 3 && fs::exists(argv[3]))
+        {
+            for (const auto& file : fs::directory_iterator(argv[3]))
+            {
+                if (file.path().extension() != ".mesh")
+                    continue;
+
+                const std::vector<uint8_t> data = ReadFile(file.path());
+                writer.AddData("meshes/" + file.path().filename().string(), AssetPack::EntryType::Mesh, data.data(), data.size());
+                meshes++;
+            }
+        }
+
+        writer.Finish();
+
+        duration<float, std::milli> cookingTime = high_resolution_clock::now() - start;
+        std::cout << "Cooked " << textures << " textures, " << shaders << " shader permutations (" << cachedShaders << " from cache), ";
+        std::cout << meshes << " meshes to ";
+        std::cout << argv[2] << " in " << cookingTime.count() << " ms" << std::endl;
+    }
+    catch (const std::exception& error)
+    {
+        std::cout << error.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN             // Exclude rarely-used stuff from Windows headers.
+#endif
+
+#ifndef NOMINMAX
+#define NOMINMAX                        // Don't break std::min and std::max.
+#endif
+
+#include <windows.h>
+#include <wrl.h>
+#include <d3d12.h>
+#include <D3Dcompiler.h>
+
+#include <string>
+#include <chrono>
+#include <vector>
+#include <map>
+#include <memory>
+#include <fstream>
+#include <thread>
+#include <iostream>
+#include <filesystem>
+#include <algorithm>
+#include <atomic>
+
+#include <3rdparty/d3dx12.h>
+#include <utils/DXSampleHelper.h>
+
+using namespace Microsoft::WRL;
@@ -5,9 +5,219 @@
 #include <utils/Math.h>
 #include <utils/Shaders.h>
 #include <utils/FeaturesCollector.h>
+#include <utils/TextureSynthesis.h>
+#include <utils/MipGenerator.h>
+#include <utils/BlockCompression.h>
+#include <utils/SubresourceStaging.h>
+#include <utils/AssetPack.h>
+
+#include <algorithm>
 
 using namespace std::chrono;
 
+namespace
+{
+// Throughput and quality of every block compression format on mip chain of one slice
+std::string BenchmarkBlockCompression(const D3D12_SUBRESOURCE_DATA* mips, size_t mipsCount, size_t width, size_t height)
+{
+    using namespace BlockCompression;
+
+    const std::pair<Format, const char*> formats[] = {
+        {Format::BC1, "BC1"}, {Format::BC4, "BC4"}, {Format::BC5, "BC5"}, {Format::BC6H, "BC6H"}, {Format::BC7, "BC7"}
+    };
+
+    size_t texelsCount = 0;
+    for (size_t mip = 0; mip < mipsCount; ++mip)
+        texelsCount += std::max<size_t>(width >> mip, 1) * std::max<size_t>(height >> mip, 1);
+
+    std::ostringstream report;
+    for (const auto& [format, name] : formats)
+    {
+        for (Preset preset : {Preset::Fast, Preset::Refined})
+        {
+            auto start = high_resolution_clock::now();
+            CompressedTexture texture = Compress(DXGI_FORMAT_R8G8B8A8_UNORM_SRGB, width, height, mipsCount, mips, mipsCount, format, preset);
+            duration<double, std::micro> time = high_resolution_clock::now() - start;
+
+            report << name << (preset == Preset::Fast ? " fast: " : " refined: ");
+            report << texelsCount / time.count() << " MPix/s, PSNR ";
+            report << MeasurePSNR(DXGI_FORMAT_R8G8B8A8_UNORM_SRGB, mips[0], width, height, format, texture.subresources[0]) << " dB" << std::endl;
+        }
+    }
+    return report.str();
+}
+
+// written by asset_cooker (cook_assets target) next to the assets folder
+const char* packFileName = "assets/assets.pack";
+
+// Cold start is approximated by unbuffered reads, which bypass the system file cache, warm start by the second pass
+// over the mapped view. The same textures are read from loose DDS files for comparison.
+std::string BenchmarkAssetPack(const AssetPack::Reader& pack)
+{
+    std::vector<const AssetPack::Entry*> textures;
+    size_t alignedSize = 0;
+    size_t dataSize = 0;
+    for (const AssetPack::Entry& entry : pack.Entries())
+    {
+        if (entry.type != AssetPack::EntryType::Texture)
+            continue;
+
+        textures.push_back(&entry);
+        alignedSize += AssetPack::GetAlignedSize(entry);
+        dataSize += (size_t)entry.size;
+    }
+
+    if (textures.empty())
+        return {};
+
+    std::unique_ptr<uint8_t, decltype(&_aligned_free)> buffer {static_cast<uint8_t*>(_aligned_malloc(alignedSize, AssetPack::dataAlignment)), &_aligned_free};
+    if (!buffer)
+        throw std::bad_alloc();
+
+    auto start = high_resolution_clock::now();
+    {
+        std::vector<AssetPack::ReadRequest> requests(textures.size());
+        for (size_t i = 0, offset = 0; i < textures.size(); offset += AssetPack::GetAlignedSize(*textures[i]), ++i)
+            pack.ReadAsync(*textures[i], buffer.get() + offset, requests[i]);
+        for (AssetPack::ReadRequest& request : requests)
+            pack.Wait(request);
+    }
+    duration<double, std::milli> unbufferedTime = high_resolution_clock::now() - start;
+
+    duration<double, std::milli> mappedTime[2] {};
+    for (auto& time : mappedTime)
+    {
+        start = high_resolution_clock::now();
+        for (size_t i = 0, offset = 0; i < textures.size(); offset += AssetPack::GetAlignedSize(*textures[i]), ++i)
+            memcpy(buffer.get() + offset, pack.Data(*textures[i]), (size_t)textures[i]->size);
+        time = high_resolution_clock::now() - start;
+    }
+
+    std::vector<char> looseData;
+    size_t looseSize = 0;
+    start = high_resolution_clock::now();
+    for (const AssetPack::Entry* entry : textures)
+    {
+        const std::string name = entry->name;
+        if (name.compare(0, 9, "textures/") != 0)
+            continue;
+
+        std::ifstream file {"assets/" + name, std::ios::binary | std::ios::ate};
+        if (!file)
+            continue;
+
+        looseData.resize((size_t)file.tellg());
+        file.seekg(0);
+        file.read(looseData.data(), looseData.size());
+        looseSize += looseData.size();
+    }
+    duration<double, std::milli> looseTime = high_resolution_clock::now() - start;
+
+    auto throughput = [](size_t size, duration<double, std::milli> time) { return size / 1048576.0 / (time.count() / 1000.0); };
+
+    std::ostringstream report;
+    report << "Asset pack benchmark, " << textures.size() << " textures, " << dataSize / 1024 << " KB" << std::endl;
+    report << "    Unbuffered overlapped reads (cold): " << unbufferedTime.count() << " ms, " << throughput(alignedSize, unbufferedTime) << " MB/s" << std::endl;
+    report << "    Mapped view, first pass: " << mappedTime[0].count() << " ms, " << throughput(dataSize, mappedTime[0]) << " MB/s" << std::endl;
+    report << "    Mapped view, second pass (warm): " << mappedTime[1].count() << " ms, " << throughput(dataSize, mappedTime[1]) << " MB/s" << std::endl;
+    if (looseSize)
+        report << "    Loose DDS files: " << looseTime.count() << " ms, " << throughput(looseSize, looseTime) << " MB/s" << std::endl;
+    return report.str();
+}
+
+// d3dx12 UpdateSubresources (footprints from the device every time, serial memcpy of rows) against SubresourceStaging
+// on BC7 textures with full mip chains, both of them copy to a mapped upload buffer
+std::string BenchmarkSubresourceStaging(ComPtr<ID3D12Device> pDevice)
+{
+    std::ostringstream report;
+    D3D12_HEAP_PROPERTIES uploadHeapProp = {D3D12_HEAP_TYPE_UPLOAD};
+
+    for (UINT size = 1024; size <= 16384; size *= 2)
+    {
+        CD3DX12_RESOURCE_DESC desc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_BC7_UNORM, size, size);
+        desc.MipLevels = 0;
+        while (size >> desc.MipLevels)
+            desc.MipLevels++;
+
+        // device footprints, the same as the ones d3dx12 allocates and gets on every call
+        auto footprintsStart = high_resolution_clock::now();
+        std::vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT> layouts(desc.MipLevels);
+        std::vector<UINT> numRows(desc.MipLevels);
+        std::vector<UINT64> rowSizes(desc.MipLevels);
+        UINT64 requiredSize = 0;
+        pDevice->GetCopyableFootprints(&desc, 0, desc.MipLevels, 0, layouts.data(), numRows.data(), rowSizes.data(), &requiredSize);
+        duration<double, std::micro> deviceFootprintsTime = high_resolution_clock::now() - footprintsStart;
+
+        SubresourceStaging staging;
+        const CopyableFootprints& footprints = staging.GetFootprints(desc, 0, desc.MipLevels);
+        footprintsStart = high_resolution_clock::now();
+        staging.GetFootprints(desc, 0, desc.MipLevels);
+        duration<double, std::micro> cachedFootprintsTime = high_resolution_clock::now() - footprintsStart;
+
+        // footprints are checked in detail by SubresourceStaging tests, here they only have to fit the copies below
+        bool footprintsMatch = footprints.totalBytes == requiredSize;
+        for (UINT i = 0; i < desc.MipLevels; ++i)
+        {
+            footprintsMatch &= footprints.layouts[i].Offset == layouts[i].Offset &&
+                               footprints.layouts[i].Footprint.RowPitch == layouts[i].Footprint.RowPitch &&
+                               footprints.layouts[i].Footprint.Width == layouts[i].Footprint.Width &&
+                               footprints.layouts[i].Footprint.Height == layouts[i].Footprint.Height &&
+                               footprints.numRows[i] == numRows[i] &&
+                               footprints.rowSizesInBytes[i] == rowSizes[i];
+        }
+        if (!footprintsMatch)
+            throw std::runtime_error("SubresourceStaging footprints of " + std::to_string(size) + "x" + std::to_string(size) + " BC7 don't match the device");
+
+        // tightly packed source chain
+        size_t pixelsSize = 0;
+        for (UINT i = 0; i < desc.MipLevels; ++i)
+            pixelsSize += (size_t)(rowSizes[i] * numRows[i]);
+
+        std::vector<uint8_t> pixels(pixelsSize, 0x5a);
+        std::vector<D3D12_SUBRESOURCE_DATA> subresources;
+        for (size_t i = 0, offset = 0; i < desc.MipLevels; offset += (size_t)(rowSizes[i] * numRows[i]), ++i)
+            subresources.push_back({pixels.data() + offset, (LONG_PTR)rowSizes[i], (LONG_PTR)(rowSizes[i] * numRows[i])});
+
+        ComPtr<ID3D12Resource> uploadBuffer;
+        CD3DX12_RESOURCE_DESC uploadBufferDesc = CD3DX12_RESOURCE_DESC::Buffer(requiredSize);
+        ThrowIfFailed(pDevice->CreateCommittedResource(&uploadHeapProp,
+                                                       D3D12_HEAP_FLAG_NONE,
+                                                       &uploadBufferDesc,
+                                                       D3D12_RESOURCE_STATE_GENERIC_READ,
+                                                       nullptr,
+                                                       IID_PPV_ARGS(&uploadBuffer)));
+
+        uint8_t * pData = nullptr;
+        ThrowIfFailed(uploadBuffer->Map(0, nullptr, reinterpret_cast<void**>(&pData)));
+
+        // the first pass commits pages of the buffer, so only the second one is measured
+        duration<double, std::milli> serialTime {};
+        for (int pass = 0; pass < 2; ++pass)
+        {
+            auto copyStart = high_resolution_clock::now();
+            for (UINT i = 0; i < desc.MipLevels; ++i)
+            {
+                D3D12_MEMCPY_DEST destination = {pData + layouts[i].Offset, layouts[i].Footprint.RowPitch, layouts[i].Footprint.RowPitch * numRows[i]};
+                MemcpySubresource(&destination, &subresources[i], (SIZE_T)rowSizes[i], numRows[i], layouts[i].Footprint.Depth);
+            }
+            serialTime = high_resolution_clock::now() - copyStart;
+        }
+
+        auto copyStart = high_resolution_clock::now();
+        staging.CopySubresources(footprints, pData, subresources.data());
+        duration<double, std::milli> stagingTime = high_resolution_clock::now() - copyStart;
+
+        uploadBuffer->Unmap(0, nullptr);
+
+        report << size << "x" << size << " BC7, " << requiredSize / 1024 << " KB: footprints ";
+        report << deviceFootprintsTime.count() << " us -> " << cachedFootprintsTime.count() << " us, copy ";
+        report << serialTime.count() << " ms -> " << stagingTime.count() << " ms" << std::endl;
+    }
+
+    return report.str();
+}
+}
+
 DX12Sample::DX12Sample(int windowWidth, int windowHeight, std::set<optTypes>& opts)
     : DXSample(windowWidth, windowHeight, L"HELLO YOPTA")
 {
@@ -15,9 +225,15 @@ DX12Sample::DX12Sample(int windowWidth, int windowHeight, std::set<optTypes>& op
     {
         switch (opt)
         {
+        case disable_bindless_textures:
+            _cmdLineOpts.bindless_textures = false;
+            break;
         case disable_bundles:
             _cmdLineOpts.bundles = false;
             break;
+        case disable_lods:
+            _cmdLineOpts.lods = false;
+            break;
         case disable_concurrency:
             _cmdLineOpts.threads = false;
             break;
@@ -30,14 +246,75 @@ DX12Sample::DX12Sample(int windowWidth, int windowHeight, std::set<optTypes>& op
         case disable_shadow_pass:
             _cmdLineOpts.shadow_pass = false;
             break;
+        case disable_worker_spinning:
+            _cmdLineOpts.worker_spin_count = 0;
+            break;
+        case enable_cluster_culling:
+            _cmdLineOpts.cluster_culling = true;
+            break;
+        case enable_core_reservation:
+            _cmdLineOpts.reserved_cores = 2;
+            break;
+        case enable_cpu_tessellation:
+            _cmdLineOpts.cpu_tessellation = true;
+            break;
+        case enable_draw_data_benchmark:
+            _cmdLineOpts.draw_data_benchmark = true;
+            break;
+        case enable_draw_data_buffer:
+            _cmdLineOpts.draw_data = DrawDataMode::StructuredBuffer;
+            break;
+        case enable_draw_root_constants:
+            _cmdLineOpts.draw_data = DrawDataMode::RootConstants;
+            break;
+        case enable_filtered_mips:
+            _cmdLineOpts.filtered_mips = true;
+            break;
+        case enable_gbuffer_cache:
+            _cmdLineOpts.gbuffer_cache = true;
+            break;
+        case enable_histogram_exposure:
+            _cmdLineOpts.histogram_exposure = true;
+            break;
+        case enable_luminance_validation:
+            _cmdLineOpts.luminance_validation = true;
+            break;
+        case enable_pack_benchmark:
+            _cmdLineOpts.pack_benchmark = true;
+            break;
+        case enable_physical_core_workers:
+            _cmdLineOpts.physical_core_workers = true;
+            break;
+        case enable_shadow_lod_bias:
+            _cmdLineOpts.shadow_lod_bias = 1;
+            break;
+        case enable_staging_benchmark:
+            _cmdLineOpts.staging_benchmark = true;
+            break;
+        case enable_streaming_submission:
+            _cmdLineOpts.streaming_submission = true;
+            break;
         case enable_tessellation:
             _cmdLineOpts.tessellation = true;
             break;
+        case enable_texture_compression:
+            _cmdLineOpts.texture_compression = true;
+            break;
+        case enable_thread_pinning:
+            _cmdLineOpts.thread_pinning = true;
+            break;
+        case enable_vertex_packing:
+            _cmdLineOpts.packed_vertices = true;
+            break;
         case legacy_swapchain:
             _cmdLineOpts.legacy_swapchain = true;
             break;
         }
     }
+
+    // meshes are displaced once on CPU, hull and domain shaders are not needed
+    if (_cmdLineOpts.cpu_tessellation)
+        _cmdLineOpts.tessellation = false;
 }
 
 DX12Sample::~DX12Sample()
@@ -66,6 +343,9 @@ void DX12Sample::OnInit()
     _RTManager.reset(new RenderTargetManager(_device));
     CreateTexturesHeap();
 
+    if (GetFileAttributesA(packFileName) != INVALID_FILE_ATTRIBUTES)
+        _pack = std::make_unique<AssetPack::Reader>(packFileName);
+
     _sceneManager.reset(new SceneManager(_device,
                                          m_width,
                                          m_height,
@@ -74,10 +354,16 @@ void DX12Sample::OnInit()
                                          _cmdQueue,
                                          _swapChain,
                                          _RTManager.get(),
-                                         _objectsInRow));
+                                         _objectsInRow,
+                                         _pack.get()));
 
     CreateTextures();
     CreateObjects();
+
+    _sceneManager->DumpMeshStatistics("meshInfo.log");
+    _sceneManager->DumpShaderStatistics("shaderInfo.log");
+    if (_cmdLineOpts.draw_data_benchmark)
+        _sceneManager->BenchmarkDrawData("drawDataInfo.log");
 }
 
 void DX12Sample::OnUpdate()
@@ -95,8 +381,34 @@ void DX12Sample::OnUpdate()
 
     if (elapsedTime > 1.0)
     {
+        const FrameStatistics& statistics = _sceneManager->GetFrameStatistics();
+
         std::wostringstream ss;
         ss << "FPS: " << elapsedFrames;
+        ss << ", geometry: " << statistics.geometryBytes / 1024 << " KB/frame";
+        ss << " (shadow: " << statistics.shadowGeometryBytes / 1024 << " KB)";
+        ss << ", triangles: " << statistics.triangles << " (shadow: " << statistics.shadowTriangles << ")";
+        if (statistics.meshletsTotal)
+            ss << ", meshlets: " << statistics.meshletsVisible << "/" << statistics.meshletsTotal;
+        if (statistics.averageTessellationFactor > 0.0f)
+            ss << ", tessellation: " << statistics.averageTessellationFactor << " (edge " << _sceneManager->GetTessellationEdgePixels() << " px)";
+        if (_cmdLineOpts.threads)
+            ss << ", workers: " << _sceneManager->GetWorkerThreadsCount();
+        ss << ", draw data: " << statistics.drawDataBytes / 1024 << " KB/frame (" << DrawDataBinder::GetModeName(_cmdLineOpts.draw_data) << ")";
+        if (statistics.gbufferLists)
+        {
+            ss << ", G-buffer cache: " << statistics.gbufferListsReused << "/" << statistics.gbufferLists << " lists reused";
+            ss << " (hit rate " << statistics.gbufferCacheHitRate * 100.0f << "%, recorded " << statistics.gbufferRecordingMilliseconds;
+            ss << " ms, saved " << statistics.gbufferSavedMilliseconds << " ms)";
+        }
+        if (statistics.gbufferSubmissions)
+        {
+            ss << ", G-buffer submissions: " << statistics.gbufferSubmissions << " (batch " << _sceneManager->GetSubmissionBatchSize();
+            ss << " lists, first at " << statistics.gbufferFirstSubmitMilliseconds << " ms, last at " << statistics.gbufferLastSubmitMilliseconds << " ms)";
+        }
+        if (statistics.fallbackFrames)
+            ss << ", unshadowed fallback: " << statistics.fallbackFrames << " frames";
+        ss << ", luminance: " << statistics.luminanceMicroseconds << " us" << (_cmdLineOpts.histogram_exposure ? " (histogram)" : "");
         SetWindowText(m_hwnd, ss.str().c_str());
         elapsedFrames = 0;
         elapsedTime -= 1.0;
@@ -146,6 +458,24 @@ bool DX12Sample::OnEvent(MSG msg)
     case WM_KEYDOWN:
         if (msg.wParam == VK_ESCAPE)
             exit(0);
+
+        // tessellation edge length in pixels: smaller edges are more detailed
+        if (msg.wParam == VK_ADD || msg.wParam == VK_OEM_PLUS)
+            _sceneManager->SetTessellationEdgePixels(_sceneManager->GetTessellationEdgePixels() * 0.5f);
+        if (msg.wParam == VK_SUBTRACT || msg.wParam == VK_OEM_MINUS)
+            _sceneManager->SetTessellationEdgePixels(_sceneManager->GetTessellationEdgePixels() * 2.0f);
+
+        // minimal count of streamed G-buffer lists in one submission
+        if (msg.wParam == VK_PRIOR)
+            _sceneManager->SetSubmissionBatchSize(_sceneManager->GetSubmissionBatchSize() * 2);
+        if (msg.wParam == VK_NEXT)
+            _sceneManager->SetSubmissionBatchSize(_sceneManager->GetSubmissionBatchSize() / 2);
+
+        // render threads count, the pool is started again
+        if (msg.wParam == VK_HOME)
+            _sceneManager->SetWorkerThreadsCount(_sceneManager->GetWorkerThreadsCount() + 1);
+        if (msg.wParam == VK_END)
+            _sceneManager->SetWorkerThreadsCount(_sceneManager->GetWorkerThreadsCount() - 1);
     }
 
     // DXSample does not check return value, so it will be false :)
@@ -156,103 +486,10 @@ void DX12Sample::DumpFeatures()
 {
     FeaturesCollector collector {_device};
     collector.CollectFeatures("deviceInfo.log");
-}
-
-static size_t generatePixels(std::vector<uint8_t>& pixels,
-                             std::vector<D3D12_SUBRESOURCE_DATA>& mips_data,
-                             const size_t width,
-                             const size_t height,
-                             const size_t depth,
-                             const bool is_volumed = false)
-{
-    const int bytepp = 4;
-    const size_t row_size_limit = 256 / bytepp;
-    size_t generated_mips = 0;
-    size_t pixels_generated = 0;
-
-    if (!width || !height || !depth)
-        return 0;
-
-    const size_t align_width = (width > row_size_limit) ? width + (row_size_limit - width % row_size_limit) : row_size_limit;
-
-    std::vector<size_t> mip_offsets;
-
-    pixels.clear();
-    mips_data.clear();
-
-    pixels.resize(align_width * height * bytepp * 10 * depth, 0x0);
-
-    uint32_t* p_pixels = (uint32_t*)pixels.data();
-    uint64_t mip_offset = 0;
-
-    size_t array_size = is_volumed ? 1 : depth;
-    size_t max_depth = is_volumed ? depth : 1;
-
-    for (size_t level = 0; level < array_size; ++level)
-    {
-        size_t mip_width = width;
-        size_t mip_height = height;
-        size_t mip_depth = max_depth;
-        generated_mips = 0;
-
-        // for each mip...
-        while (true)
-        {
-            mip_offsets.push_back((uint64_t)p_pixels - (uint64_t)pixels.data());  // only for debug
-            mips_data.push_back({(void*)p_pixels, (int64_t)(mip_width * bytepp), (int64_t)(mip_width * mip_height * bytepp)});
-
-            for (size_t slice = 0; slice < mip_depth; ++slice)
-            {
-                size_t delimx = (mip_width >= 8) ? 8 : mip_width;
-                size_t delimy = (mip_width >= 8) ? 8 : mip_height;
-
-                for (UINT row = 0; row < mip_height; row++)
-                {
-                    for (UINT col = 0; col < mip_width; col++)
-                    {
-                        size_t xBlock = col * delimx / mip_width;
-                        size_t yBlock = row * delimy / mip_height;
-
-                        if (xBlock % 2 == yBlock % 2)
-                        {
-                            p_pixels[mip_width*row + col] = slice & 1 ? 0xFF'FF'FF'FF : 0xFF'C4'92'00;
-                        }
-                        else
-                        {
-                            p_pixels[mip_width*row + col] = slice & 1 ? 0xFF'C4'92'00 : 0xFF'FF'FF'FF;
-                        }
-                    }
-                }
-                p_pixels += mip_width * mip_height;
-            }
-            ++generated_mips;
-
-            if (level == array_size - 1 && mip_width == 1 && mip_height == 1 && mip_depth == 1)
-                break;
-
-            size_t row_padding = 0;
-            if (mip_width % row_size_limit)
-            {
-                row_padding = row_size_limit - mip_width % row_size_limit;
-                p_pixels += row_padding * mip_height * mip_depth; // add row padding for alignment
-            }
 
-            if (((mip_width + row_padding) * mip_height * mip_depth) & (2 * row_size_limit - 1))
-                p_pixels += row_size_limit;                       // add mip padding for alignment
-
-            if (mip_width == 1 && mip_height == 1 && mip_depth == 1)
-                break;
-
-            mip_width = mip_width > 1 ? mip_width >> 1 : 1;
-            mip_height = mip_height > 1 ? mip_height >> 1 : 1;
-            mip_depth = mip_depth > 1 ? mip_depth >> 1 : 1;
-
-            //if (width > 2*mip_width)
-            //    break;
-        }
-    }
-    pixels.resize((uint8_t*)p_pixels - pixels.data());
-    return generated_mips;
+    // per-draw descriptor tables are kept for devices without unbounded SRV tables
+    if (_cmdLineOpts.bindless_textures)
+        _cmdLineOpts.bindless_textures = _cmdLineOpts.textures && collector.GetResourceBindingTier() >= D3D12_RESOURCE_BINDING_TIER_2;
 }
 
 void DX12Sample::CreateTextures()
@@ -268,14 +505,61 @@ void DX12Sample::CreateTextures()
     std::vector<uint8_t> texturePixels;
     std::vector<D3D12_SUBRESOURCE_DATA> textureMips;
 
-    size_t textureWidth = 255;
-    size_t textureHeight = 255;
+    // size of block compressed textures has to be multiple of 4
+    size_t textureWidth = _cmdLineOpts.texture_compression ? 256 : 255;
+    size_t textureHeight = _cmdLineOpts.texture_compression ? 256 : 255;
     size_t textureSlices = 30;
 
+    // only the top level of every slice is taken from the generator, other levels are filtered from it
+    MipGenerator::MipChain filteredMips;
+    auto filterMips = [&](size_t mipsCount, bool volume)
+    {
+        MipGenerator::TextureDesc desc;
+        desc.dimension = volume ? D3D12_RESOURCE_DIMENSION_TEXTURE3D : D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+        desc.format = DXGI_FORMAT_R8G8B8A8_UNORM_SRGB;
+        desc.width = textureWidth;
+        desc.height = textureHeight;
+        desc.depthOrArraySize = textureSlices;
+
+        std::vector<D3D12_SUBRESOURCE_DATA> topLevel;
+        for (size_t i = 0; i < textureMips.size(); i += mipsCount)
+            topLevel.push_back(textureMips[i]);
+
+        filteredMips = MipGenerator::Generate(desc, topLevel.data(), MipGenerator::Filter::Kaiser, mipsCount);
+        textureMips = filteredMips.subresources;
+    };
+
     // Have to create and fill vertex buffer
-    size_t mipsCount = generatePixels(texturePixels, textureMips, textureWidth, textureHeight, textureSlices);
+    auto generationStart = high_resolution_clock::now();
+    size_t mipsCount = TextureSynthesis::GenerateCheckerboard(texturePixels, textureMips, textureWidth, textureHeight, textureSlices);
+    if (_cmdLineOpts.filtered_mips)
+        filterMips(mipsCount, false);
+    duration<float, std::milli> generationTime = high_resolution_clock::now() - generationStart;
     size_t imagesGenerated = mipsCount * textureSlices;
 
+    // the same chains are uploaded to both 2D textures, so they are compressed once
+    BlockCompression::CompressedTexture compressedTexture;
+    std::ostringstream compressionReport;
+    if (_cmdLineOpts.texture_compression)
+    {
+        compressionReport << BenchmarkBlockCompression(textureMips.data(), mipsCount, textureWidth, textureHeight);
+
+        auto compressionStart = high_resolution_clock::now();
+        compressedTexture = BlockCompression::Compress(DXGI_FORMAT_R8G8B8A8_UNORM_SRGB,
+                                                       textureWidth,
+                                                       textureHeight,
+                                                       mipsCount,
+                                                       textureMips.data(),
+                                                       textureMips.size(),
+                                                       BlockCompression::Format::BC7,
+                                                       BlockCompression::Preset::Fast);
+        duration<float, std::milli> compressionTime = high_resolution_clock::now() - compressionStart;
+
+        compressionReport << "Procedural textures BC7 compression: " << compressionTime.count() << " ms, ";
+        compressionReport << texturePixels.size() / 1024 << " KB -> " << compressedTexture.data.size() / 1024 << " KB" << std::endl;
+        textureMips = compressedTexture.subresources;
+    }
+
     ComPtr<ID3D12Resource> textureUploadBuffer[6] = {};
     D3D12_RESOURCE_DESC textureResourceDesc = {};
     UINT64 uploadBufferSize = 0;
@@ -294,29 +578,101 @@ void DX12Sample::CreateTextures()
     };
     D3D12_SHADER_RESOURCE_VIEW_DESC textureSRVDesc = {};
 
+    // footprints of both 2D textures are the same, so they are computed once
+    SubresourceStaging staging;
+
+    // BC6 textures are read from the cooked pack straight to upload buffers, loose DDS files are loaded without it
+    const AssetPack::Reader* pack = _pack.get();
+    const std::pair<const char*, const wchar_t*> packedTextures[] = {{"textures/tex_bc6u.dds", L"BC6u"}, {"textures/tex_bc6s.dds", L"BC6s"}};
+    auto bc6LoadingStart = high_resolution_clock::now();
+    size_t bc6PackedSize = 0;
+    if (pack && pack->Find(packedTextures[0].first) && pack->Find(packedTextures[1].first))
     {
-        // BC6U texture - 2D
-        ID3D12Resource * pTex_bc6 = nullptr;
-        ID3D12Resource * pTex_bc6_upload = nullptr;
-        ThrowIfFailed(CreateDDSTextureFromFile(_device.Get(), L"Assets/Textures/tex_bc6u.dds", 1024, true, &pTex_bc6, pCmdList, &pTex_bc6_upload, texturesHeapHandle));
-        assert(pTex_bc6 && pTex_bc6_upload);
-        _texture[4].Attach(pTex_bc6);
-        _texture[4]->SetName(L"BC6u");
-        textureUploadBuffer[4].Attach(pTex_bc6_upload);
-        texturesHeapHandle.ptr += CbvSrvUavHeapIncSize;
-    }
+        // both reads are in flight at the same time, copies are recorded when they are completed
+        AssetPack::ReadRequest requests[2];
+        for (size_t i = 0; i < 2; ++i)
+        {
+            const AssetPack::Entry& entry = *pack->Find(packedTextures[i].first);
+            D3D12_RESOURCE_DESC desc = AssetPack::GetTextureDesc(entry);
+            ThrowIfFailed(_device->CreateCommittedResource(&defaultHeapProp,
+                                                           D3D12_HEAP_FLAG_NONE,
+                                                           &desc,
+                                                           D3D12_RESOURCE_STATE_COPY_DEST,
+                                                           nullptr,
+                                                           IID_PPV_ARGS(&_texture[4 + i])));
+            _texture[4 + i]->SetName(packedTextures[i].second);
+
+            CD3DX12_RESOURCE_DESC packedBufferDesc = CD3DX12_RESOURCE_DESC::Buffer(AssetPack::GetAlignedSize(entry));
+            ThrowIfFailed(_device->CreateCommittedResource(&uploadHeapProp,
+                                                           D3D12_HEAP_FLAG_NONE,
+                                                           &packedBufferDesc,
+                                                           D3D12_RESOURCE_STATE_GENERIC_READ,
+                                                           nullptr,
+                                                           IID_PPV_ARGS(&textureUploadBuffer[4 + i])));
+
+            void * pData = nullptr;
+            ThrowIfFailed(textureUploadBuffer[4 + i]->Map(0, nullptr, &pData));
+            pack->ReadAsync(entry, pData, requests[i]);
+            bc6PackedSize += (size_t)entry.size;
+        }
 
+        for (size_t i = 0; i < 2; ++i)
+        {
+            pack->Wait(requests[i]);
+            textureUploadBuffer[4 + i]->Unmap(0, nullptr);
+
+            // pack keeps subresources in copyable footprints layout, so they are copied as they are
+            const D3D12_RESOURCE_DESC desc = _texture[4 + i]->GetDesc();
+            const UINT subresourcesCount = desc.MipLevels * desc.DepthOrArraySize;
+            const CopyableFootprints footprints = ComputeCopyableFootprints(desc, 0, subresourcesCount, 0);
+            for (UINT subresource = 0; subresource < subresourcesCount; ++subresource)
+            {
+                CD3DX12_TEXTURE_COPY_LOCATION dst(_texture[4 + i].Get(), subresource);
+                CD3DX12_TEXTURE_COPY_LOCATION src(textureUploadBuffer[4 + i].Get(), footprints.layouts[subresource]);
+                pCmdList->CopyTextureRegion(&dst, 0, 0, 0, &src, nullptr);
+            }
+
+            CD3DX12_RESOURCE_BARRIER barrier = CD3DX12_RESOURCE_BARRIER::Transition(_texture[4 + i].Get(),
+                                                                                    D3D12_RESOURCE_STATE_COPY_DEST,
+                                                                                    D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+            pCmdList->ResourceBarrier(1, &barrier);
+
+            D3D12_SHADER_RESOURCE_VIEW_DESC packedSRVDesc = {};
+            packedSRVDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+            packedSRVDesc.Format = desc.Format;
+            packedSRVDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+            packedSRVDesc.Texture2D.MipLevels = desc.MipLevels;
+            _device->CreateShaderResourceView(_texture[4 + i].Get(), &packedSRVDesc, texturesHeapHandle);
+            texturesHeapHandle.ptr += CbvSrvUavHeapIncSize;
+        }
+    }
+    else
     {
-        // BC6S texture
-        ID3D12Resource * pTex_bc6 = nullptr;
-        ID3D12Resource * pTex_bc6_upload = nullptr;
-        ThrowIfFailed(CreateDDSTextureFromFile(_device.Get(), L"Assets/Textures/tex_bc6s.dds", 1024, true, &pTex_bc6, pCmdList, &pTex_bc6_upload, texturesHeapHandle));
-        assert(pTex_bc6 && pTex_bc6_upload);
-        _texture[5].Attach(pTex_bc6);
-        _texture[5]->SetName(L"BC6s");
-        textureUploadBuffer[5].Attach(pTex_bc6_upload);
-        texturesHeapHandle.ptr += CbvSrvUavHeapIncSize;
+        {
+            // BC6U texture - 2D
+            ID3D12Resource * pTex_bc6 = nullptr;
+            ID3D12Resource * pTex_bc6_upload = nullptr;
+            ThrowIfFailed(CreateDDSTextureFromFile(_device.Get(), L"Assets/Textures/tex_bc6u.dds", 1024, true, &pTex_bc6, pCmdList, &pTex_bc6_upload, texturesHeapHandle));
+            assert(pTex_bc6 && pTex_bc6_upload);
+            _texture[4].Attach(pTex_bc6);
+            _texture[4]->SetName(L"BC6u");
+            textureUploadBuffer[4].Attach(pTex_bc6_upload);
+            texturesHeapHandle.ptr += CbvSrvUavHeapIncSize;
+        }
+
+        {
+            // BC6S texture
+            ID3D12Resource * pTex_bc6 = nullptr;
+            ID3D12Resource * pTex_bc6_upload = nullptr;
+            ThrowIfFailed(CreateDDSTextureFromFile(_device.Get(), L"Assets/Textures/tex_bc6s.dds", 1024, true, &pTex_bc6, pCmdList, &pTex_bc6_upload, texturesHeapHandle));
+            assert(pTex_bc6 && pTex_bc6_upload);
+            _texture[5].Attach(pTex_bc6);
+            _texture[5]->SetName(L"BC6s");
+            textureUploadBuffer[5].Attach(pTex_bc6_upload);
+            texturesHeapHandle.ptr += CbvSrvUavHeapIncSize;
+        }
     }
+    duration<float, std::milli> bc6LoadingTime = high_resolution_clock::now() - bc6LoadingStart;
 
     {
         // *** TEX0 *** - 2D mips - default
@@ -328,7 +684,7 @@ void DX12Sample::CreateTextures()
         textureResourceDesc.SampleDesc.Count = 1;
         textureResourceDesc.DepthOrArraySize = (UINT16)textureSlices;
         textureResourceDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
-        textureResourceDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM_SRGB;
+        textureResourceDesc.Format = _cmdLineOpts.texture_compression ? compressedTexture.format : DXGI_FORMAT_R8G8B8A8_UNORM_SRGB;
 
         ThrowIfFailed(_device->CreateCommittedResource(&defaultHeapProp,
                                                        D3D12_HEAP_FLAG_NONE,
@@ -336,7 +692,7 @@ void DX12Sample::CreateTextures()
                                                        D3D12_RESOURCE_STATE_COPY_DEST, nullptr,
                                                        IID_PPV_ARGS(&_texture[0])));
 
-        uploadBufferSize = GetRequiredIntermediateSize(_texture[0].Get(), 0, (UINT)imagesGenerated);
+        uploadBufferSize = staging.GetRequiredIntermediateSize(_texture[0].Get(), 0, (UINT)imagesGenerated);
 
         // Create the GPU upload buffer
         uploadBufferDesc.Width = uploadBufferSize;
@@ -347,13 +703,13 @@ void DX12Sample::CreateTextures()
                                                        nullptr,
                                                        IID_PPV_ARGS(&textureUploadBuffer[0])));
 
-        UpdateSubresources(pCmdList,
-                           _texture[0].Get(),
-                           textureUploadBuffer[0].Get(),
-                           0,
-                           0,
-                           (UINT)imagesGenerated,
-                           textureMips.data());
+        staging.UpdateSubresources(pCmdList,
+                                   _texture[0].Get(),
+                                   textureUploadBuffer[0].Get(),
+                                   0,
+                                   0,
+                                   (UINT)imagesGenerated,
+                                   textureMips.data());
 
         // Add barrier to upload texture
         auto transition = CD3DX12_RESOURCE_BARRIER::Transition(_texture[0].Get(),
@@ -388,9 +744,9 @@ void DX12Sample::CreateTextures()
                                                        nullptr,
                                                        IID_PPV_ARGS(&_texture[1])));
 
-        uploadBufferSize = GetRequiredIntermediateSize(_texture[1].Get(),
-                                                       0,
-                                                       (UINT)imagesGenerated);
+        uploadBufferSize = staging.GetRequiredIntermediateSize(_texture[1].Get(),
+                                                               0,
+                                                               (UINT)imagesGenerated);
 
         // Create the GPU upload buffer
         uploadBufferDesc.Width = uploadBufferSize;
@@ -401,13 +757,13 @@ void DX12Sample::CreateTextures()
                                                        nullptr,
                                                        IID_PPV_ARGS(&textureUploadBuffer[1])));
 
-        UpdateSubresources(pCmdList,
-                           _texture[1].Get(),
-                           textureUploadBuffer[1].Get(),
-                           0,
-                           0,
-                           (UINT)imagesGenerated,
-                           textureMips.data());
+        staging.UpdateSubresources(pCmdList,
+                                   _texture[1].Get(),
+                                   textureUploadBuffer[1].Get(),
+                                   0,
+                                   0,
+                                   (UINT)imagesGenerated,
+                                   textureMips.data());
 
         // Add barrier to upload texture
         auto transition = CD3DX12_RESOURCE_BARRIER::Transition(_texture[1].Get(),
@@ -435,15 +791,20 @@ void DX12Sample::CreateTextures()
         textureSlices = 32;
 
         // Have to create and fill vertex buffer
-        mipsCount = generatePixels(texturePixels,
-                                   textureMips,
-                                   textureWidth,
-                                   textureHeight,
-                                   textureSlices,
-                                   true);
+        generationStart = high_resolution_clock::now();
+        mipsCount = TextureSynthesis::GenerateCheckerboard(texturePixels,
+                                                           textureMips,
+                                                           textureWidth,
+                                                           textureHeight,
+                                                           textureSlices,
+                                                           true);
+        if (_cmdLineOpts.filtered_mips)
+            filterMips(mipsCount, true);
+        generationTime += high_resolution_clock::now() - generationStart;
         imagesGenerated = textureMips.size();
 
         textureResourceDesc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE3D;
+        textureResourceDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM_SRGB;
         textureResourceDesc.Width = (UINT)textureWidth;
         textureResourceDesc.Height = (UINT)textureHeight;
         textureResourceDesc.MipLevels = (UINT16)mipsCount;
@@ -456,9 +817,9 @@ void DX12Sample::CreateTextures()
                                                        nullptr,
                                                        IID_PPV_ARGS(&_texture[2])));
 
-        uploadBufferSize = GetRequiredIntermediateSize(_texture[2].Get(),
-                                                       0,
-                                                       (UINT)imagesGenerated);
+        uploadBufferSize = staging.GetRequiredIntermediateSize(_texture[2].Get(),
+                                                               0,
+                                                               (UINT)imagesGenerated);
 
         // Create the GPU upload buffer
         uploadBufferDesc.Width = uploadBufferSize;
@@ -469,13 +830,13 @@ void DX12Sample::CreateTextures()
                                                        nullptr,
                                                        IID_PPV_ARGS(&textureUploadBuffer[2])));
 
-        UpdateSubresources(pCmdList,
-                           _texture[2].Get(),
-                           textureUploadBuffer[2].Get(),
-                           0,
-                           0,
-                           (UINT)imagesGenerated,
-                           textureMips.data());
+        staging.UpdateSubresources(pCmdList,
+                                   _texture[2].Get(),
+                                   textureUploadBuffer[2].Get(),
+                                   0,
+                                   0,
+                                   (UINT)imagesGenerated,
+                                   textureMips.data());
 
         // Add barrier to upload texture
         auto transition = CD3DX12_RESOURCE_BARRIER::Transition(_texture[2].Get(),
@@ -497,6 +858,23 @@ void DX12Sample::CreateTextures()
 
     uploadCommandList.Close();
     _sceneManager->ExecuteCommandLists(uploadCommandList);
+
+    std::ofstream textureLog {"textureInfo.log"};
+    textureLog << "Procedural textures generation: " << generationTime.count() << " ms";
+    textureLog << (_cmdLineOpts.filtered_mips ? " (Kaiser filtered mips)" : " (drawn mips)") << std::endl;
+    textureLog << compressionReport.str();
+    textureLog << "Procedural textures staging: " << staging.Statistics().bytesCopied / 1024 << " KB in ";
+    textureLog << staging.Statistics().copyMilliseconds << " ms, footprints computed ";
+    textureLog << staging.Statistics().footprintsComputed << " times for " << staging.Statistics().updates << " updates" << std::endl;
+    if (_cmdLineOpts.staging_benchmark)
+        textureLog << BenchmarkSubresourceStaging(_device);
+    textureLog << "BC6 textures loading: " << bc6LoadingTime.count() << " ms";
+    if (bc6PackedSize)
+        textureLog << " (" << bc6PackedSize / 1024 << " KB from " << packFileName << " with overlapped unbuffered reads)" << std::endl;
+    else
+        textureLog << " (loose DDS files, " << packFileName << " is not cooked)" << std::endl;
+    if (pack && _cmdLineOpts.pack_benchmark)
+        textureLog << BenchmarkAssetPack(*pack);
     _sceneManager->SetBackgroundCubemap(L"assets/textures/ibl_cubemap.dds");
 }
 
@@ -581,10 +959,13 @@ void DX12Sample::CreateObjects()
 {
     for (size_t i = 0; i < _drawObjectsCount; ++i)
     {
-        if (i % 2 == 0)
+        // cubes are too coarse to be simplified, spheres get LODs
+        if (i % 3 == 0)
             _objects.push_back(_sceneManager->CreateFilledCube());
-        else
+        else if (i % 3 == 1)
             _objects.push_back(_sceneManager->CreateOpenedCube());
+        else
+            _objects.push_back(_sceneManager->CreateSphere());
     }
 
     for (int i = 0; i < _drawObjectsCount; ++i)
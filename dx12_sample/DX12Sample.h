@@ -5,6 +5,7 @@
 #include "DXSample.h"
 #include "SceneManager.h"
 #include <utils/SceneObject.h>
+#include <utils/AssetPack.h>
 
 class DX12Sample :
     public DXSample
@@ -31,6 +32,8 @@ private:
 
     void DumpFeatures();
 
+    // cooked assets, textures and precompiled shaders are loaded from it when it exists
+    std::unique_ptr<AssetPack::Reader>          _pack = nullptr;
     std::unique_ptr<SceneManager>               _sceneManager = nullptr;
     std::unique_ptr<RenderTargetManager>        _RTManager = nullptr;
 
@@ -2,22 +2,43 @@
 
 #include "SceneManager.h"
 
+#include <utils/LuminanceHistogram.h>
+#include <utils/LuminanceReduction.h>
+#include <utils/MeshFile.h>
 #include <utils/RenderTargetManager.h>
-#include <utils/Shaders.h>
 
+#include <DirectXPackedVector.h>
+
+#include <algorithm>
+#include <cmath>
 #include <random>
 
 constexpr float clearColor[] = {0.0f, 0.4f, 0.7f, 1.0f};
 constexpr int depthMapSize = 2048;
-
+constexpr float maxLodPixelError = 1.0f;
+constexpr float maxTessellationFactor = 15.0f;
+constexpr uint32_t materialsCount = 3;
+constexpr size_t streamingChunkObjects = 32;
+const char* shaderCacheDirectory = "shaderCache";
+const char* pipelineLibraryFileName = "pipelines.bin";
+
+// geometry meshes keep positions in slot 0 and the rest of attributes in slot 1
 D3D12_INPUT_ELEMENT_DESC defaultGeometryInputElements[] =
 {
-    /* semantic name, semantics count, format,     ? , offset, vertex or instance , ?*/
+    /* semantic name, semantics count, format,     slot, offset, vertex or instance , ?*/
     {"POSITION",  0, DXGI_FORMAT_R32G32B32_FLOAT, 0,  0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
-    {"NORMAL",    0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
-    {"BINORMAL",  0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 24, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
-    {"TANGENT",   0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 36, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
-    {"TEXCOORD",  0, DXGI_FORMAT_R32G32_FLOAT,    0, 48, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
+    {"NORMAL",    0, DXGI_FORMAT_R32G32B32_FLOAT, 1,  0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
+    {"BINORMAL",  0, DXGI_FORMAT_R32G32B32_FLOAT, 1, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
+    {"TANGENT",   0, DXGI_FORMAT_R32G32B32_FLOAT, 1, 24, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
+    {"TEXCOORD",  0, DXGI_FORMAT_R32G32_FLOAT,    1, 36, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
+};
+
+D3D12_INPUT_ELEMENT_DESC packedGeometryInputElements[] =
+{
+    /* semantic name, semantics count, format,     slot, offset, vertex or instance , ?*/
+    {"POSITION",     0, DXGI_FORMAT_R16G16B16A16_SNORM, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
+    {"TANGENTFRAME", 0, DXGI_FORMAT_R16G16B16A16_SNORM, 1, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
+    {"TEXCOORD",     0, DXGI_FORMAT_R16G16_FLOAT,       1, 8, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
 };
 
 D3D12_INPUT_ELEMENT_DESC screenQuadInputElements[] =
@@ -29,6 +50,23 @@ D3D12_INPUT_ELEMENT_DESC screenQuadInputElements[] =
 
 constexpr auto pi = 3.14159265f;
 
+size_t GetTrianglesCount(const MeshObject& mesh, size_t lod)
+{
+    const auto& lods = mesh.Lods();
+    if (lods.empty())
+        return mesh.VerticesCount() / 3;
+
+    return lods[std::min(lod, lods.size() - 1)].indicesCount / 3;
+}
+
+// what a cached G-buffer list depends on for every object
+struct GBufferDraw
+{
+    const SceneObject*  object;
+    uint64_t            lod;
+    uint64_t            material;
+};
+
 unsigned GetRandomNumber(unsigned min, unsigned max)
 {
     std::random_device r;
@@ -45,7 +83,8 @@ SceneManager::SceneManager(ComPtr<ID3D12Device> pDevice,
                            ComPtr<ID3D12CommandQueue> pCmdQueue,
                            ComPtr<IDXGISwapChain3> pSwapChain,
                            RenderTargetManager * rtManager,
-                           size_t objectOnSceneInRow)
+                           size_t objectOnSceneInRow,
+                           const AssetPack::Reader * pPack)
     : _device(pDevice)
     , _screenWidth(screenWidth)
     , _screenHeight(screenHeight)
@@ -68,6 +107,7 @@ SceneManager::SceneManager(ComPtr<ID3D12Device> pDevice,
                     9.0f * pi / 18.0f,
                     depthMapSize / depthMapSize * objectOnSceneInRow * 3.0f,
                     depthMapSize / depthMapSize * objectOnSceneInRow * 3.0f)
+    , _shaderCache(shaderCacheDirectory)
 {
     assert(pDevice);
     assert(pTexturesHeap);
@@ -77,7 +117,7 @@ SceneManager::SceneManager(ComPtr<ID3D12Device> pDevice,
 
     SetThreadDescription(GetCurrentThread(), L"Main thread");
 
-    _meshManager.reset(new MeshManager(cmdLineOpts.tessellation, pDevice));
+    _meshManager.reset(new MeshManager(cmdLineOpts.tessellation, cmdLineOpts.cpu_tessellation, cmdLineOpts.packed_vertices, pDevice));
 
     _viewCamera.SetCenter({0.0f, 0.0f, 0.0f});
     _viewCamera.SetRadius((float)objectOnSceneInRow);
@@ -87,16 +127,13 @@ SceneManager::SceneManager(ComPtr<ID3D12Device> pDevice,
 
     if (cmdLineOpts.threads)
     {
-        unsigned concurrent_threads_count = std::thread::hardware_concurrency();
-        if (concurrent_threads_count == 0) // unable to detect
-            concurrent_threads_count = 8;
-
-        // create thread pool
-        _threadPool.resize(concurrent_threads_count);
-        for (size_t tid = 0; tid < concurrent_threads_count; ++tid)
-            _threadPool[tid] = std::thread([this, tid] {ThreadDrawRoutine(tid); });
+        // one thread per selected processor
+        const size_t threadsCount = _cpuTopology.SelectWorkerProcessors(cmdLineOpts.physical_core_workers, cmdLineOpts.reserved_cores).size();
+        StartWorkerThreads(threadsCount, cmdLineOpts.physical_core_workers, cmdLineOpts.thread_pinning);
     }
 
+    _workerVisibleRanges.resize(std::max<size_t>(_threadPool.size(), 1));
+
     // Have to create Fence and Event.
     ThrowIfFailed(pDevice->CreateFence(0,
                                        D3D12_FENCE_FLAG_NONE,
@@ -104,22 +141,18 @@ SceneManager::SceneManager(ComPtr<ID3D12Device> pDevice,
     _frameEndEvent = CreateEvent(NULL, FALSE, FALSE, nullptr);
 
     CreateRenderTargets();
+    _rootSignatureRegistry = std::make_unique<RootSignatureRegistry>(_device, shaderCacheDirectory);
+    _drawDataBinder = std::make_unique<DrawDataBinder>(_device, cmdLineOpts.draw_data);
     CreateRootSignatures();
+    if (pPack)
+        _shaderTable = std::make_unique<ShaderPermutations::Table>(*pPack);
+    _psoManager = std::make_unique<PipelineStateManager>(_device, pipelineLibraryFileName);
     CreateShadersAndPSOs();
     CreateCommandLists();
     CreateFrameConstantBuffers();
+    CreateMaterials();
     PopulateClearPassCommandList();
 
-    std::vector<screenQuadVertex> screenQuadVertices =
-    {
-        {{-1.0f,  1.0f}, {0.0f, 0.0f}},
-        {{1.0f,  1.0f}, {1.0f, 0.0f}},
-        {{1.0f, -1.0f}, {1.0f, 1.0f}},
-        {{-1.0f,  1.0f}, {0.0f, 0.0f}},
-        {{1.0f, -1.0f}, {1.0f, 1.0f}},
-        {{-1.0f, -1.0f}, {0.0f, 1.0f}},
-    };
-
     _objScreenQuad = std::make_unique<SceneObject>(_meshManager->CreateScreenQuad(), pDevice, nullptr);
 
     // Create Heap for the Texture
@@ -157,14 +190,15 @@ SceneManager::SceneManager(ComPtr<ID3D12Device> pDevice,
 
         // for HDR -> LDR pass
         // Intensity computing pass 1
-        // translate screen quad colored into intensity buffer
+        // translate screen quad colored into intensity buffer of 16x16 tiles, pass 2 reduces tiles
         pDevice->CreateShaderResourceView(_HDRRt->_texture.Get(), nullptr, customsHeapHandle);
         customsHeapHandle.ptr += CbvSrvUavHeapIncSize;
 
+        const UINT tilesCount = (UINT)LuminanceReduction::GetTilesCount(screenWidth, screenHeight);
         D3D12_RESOURCE_DESC intermediateBufferDesc = {};
         intermediateBufferDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
         intermediateBufferDesc.Flags = D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
-        intermediateBufferDesc.Width = screenHeight * sizeof(float) * 2; // screen quad height * 2 (average + max luma)
+        intermediateBufferDesc.Width = tilesCount * sizeof(float) * 2; // tiles count * 2 (sum of log luma + max luma)
         intermediateBufferDesc.Height = 1;
         intermediateBufferDesc.MipLevels = 1;
         intermediateBufferDesc.SampleDesc.Count = 1;
@@ -182,7 +216,7 @@ SceneManager::SceneManager(ComPtr<ID3D12Device> pDevice,
         uavDesc.Format = DXGI_FORMAT_UNKNOWN;
         uavDesc.ViewDimension = D3D12_UAV_DIMENSION_BUFFER;
         uavDesc.Buffer.FirstElement = 0;
-        uavDesc.Buffer.NumElements = screenHeight;
+        uavDesc.Buffer.NumElements = tilesCount;
         uavDesc.Buffer.StructureByteStride = sizeof(float) * 2;
         uavDesc.Buffer.CounterOffsetInBytes = 0;
         uavDesc.Buffer.Flags = D3D12_BUFFER_UAV_FLAG_NONE;
@@ -200,6 +234,68 @@ SceneManager::SceneManager(ComPtr<ID3D12Device> pDevice,
         uavDesc.Buffer.NumElements = 1;
         pDevice->CreateUnorderedAccessView(_finalIntensityBuffer.Get(), nullptr, &uavDesc, customsHeapHandle);
         customsHeapHandle.ptr += CbvSrvUavHeapIncSize;
+
+        if (cmdLineOpts.histogram_exposure)
+        {
+            // the next descriptor is taken by background cubemap
+            customsHeapHandle.ptr += CbvSrvUavHeapIncSize;
+
+            // histogram passes use u0 for histogram and u1 for the same final buffer,
+            // committed resources are zeroed, exposure pass clears histogram for the next frame
+            intermediateBufferDesc.Width = LuminanceHistogram::binsCount * sizeof(uint32_t);
+            ThrowIfFailed(pDevice->CreateCommittedResource(&defaultHeapProp,
+                                                           D3D12_HEAP_FLAG_NONE,
+                                                           &intermediateBufferDesc,
+                                                           D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
+                                                           nullptr,
+                                                           IID_PPV_ARGS(&_luminanceHistogramBuffer)));
+            _luminanceHistogramBuffer->SetName(L"LuminanceHistogram");
+            uavDesc.Buffer.NumElements = LuminanceHistogram::binsCount;
+            uavDesc.Buffer.StructureByteStride = sizeof(uint32_t);
+            pDevice->CreateUnorderedAccessView(_luminanceHistogramBuffer.Get(), nullptr, &uavDesc, customsHeapHandle);
+            customsHeapHandle.ptr += CbvSrvUavHeapIncSize;
+
+            uavDesc.Buffer.NumElements = 1;
+            uavDesc.Buffer.StructureByteStride = sizeof(float) * 2;
+            pDevice->CreateUnorderedAccessView(_finalIntensityBuffer.Get(), nullptr, &uavDesc, customsHeapHandle);
+            customsHeapHandle.ptr += CbvSrvUavHeapIncSize;
+        }
+
+        // GPU time of luminance passes is measured every frame
+        D3D12_QUERY_HEAP_DESC queryHeapDesc = {};
+        queryHeapDesc.Type = D3D12_QUERY_HEAP_TYPE_TIMESTAMP;
+        queryHeapDesc.Count = 2;
+        ThrowIfFailed(pDevice->CreateQueryHeap(&queryHeapDesc, IID_PPV_ARGS(&_timestampQueryHeap)));
+        ThrowIfFailed(pCmdQueue->GetTimestampFrequency(&_timestampFrequency));
+
+        D3D12_HEAP_PROPERTIES readbackHeapProp = {D3D12_HEAP_TYPE_READBACK};
+        intermediateBufferDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
+        intermediateBufferDesc.Width = queryHeapDesc.Count * sizeof(uint64_t);
+        ThrowIfFailed(pDevice->CreateCommittedResource(&readbackHeapProp,
+                                                       D3D12_HEAP_FLAG_NONE,
+                                                       &intermediateBufferDesc,
+                                                       D3D12_RESOURCE_STATE_COPY_DEST,
+                                                       nullptr,
+                                                       IID_PPV_ARGS(&_timestampReadbackBuffer)));
+        _timestampReadbackBuffer->SetName(L"TimestampReadback");
+
+        if (cmdLineOpts.luminance_validation)
+        {
+            // HDR image, tiles or histogram and the result of one frame are read back to check them on CPU
+            const D3D12_RESOURCE_DESC hdrDesc = _HDRRt->_texture->GetDesc();
+            pDevice->GetCopyableFootprints(&hdrDesc, 0, 1, 0, &_hdrReadbackFootprint, nullptr, nullptr, nullptr);
+            const UINT64 hdrBytes = (UINT64)_hdrReadbackFootprint.Footprint.RowPitch * _hdrReadbackFootprint.Footprint.Height;
+
+            intermediateBufferDesc.Width = hdrBytes + GetLuminanceIntermediateBytes() + sizeof(LuminanceReduction::Luminance);
+            ThrowIfFailed(pDevice->CreateCommittedResource(&readbackHeapProp,
+                                                           D3D12_HEAP_FLAG_NONE,
+                                                           &intermediateBufferDesc,
+                                                           D3D12_RESOURCE_STATE_COPY_DEST,
+                                                           nullptr,
+                                                           IID_PPV_ARGS(&_luminanceReadbackBuffer)));
+            _luminanceReadbackBuffer->SetName(L"LuminanceReadback");
+            _luminanceCapture = LuminanceCapture::Requested;
+        }
     }
 }
 
@@ -242,6 +338,7 @@ SceneManager::SceneObjectPtr SceneManager::CreateFilledCube()
     ComPtr<ID3D12PipelineState> pipelineState = _cmdLineOpts.bundles ? _mrtPipelineState->GetPSO() : nullptr;
     _objects.push_back(std::make_shared<SceneObject>(_meshManager->CreateCube(), _device, pipelineState));
     _objects.back()->Scale({0.5f, 0.5f, 0.5f});
+    _objects.back()->Material((uint32_t)(_objects.size() % materialsCount));
     return _objects.back();
 }
 
@@ -250,12 +347,23 @@ SceneManager::SceneObjectPtr SceneManager::CreateOpenedCube()
     ComPtr<ID3D12PipelineState> pipelineState = _cmdLineOpts.bundles ? _mrtPipelineState->GetPSO() : nullptr;
     _objects.push_back(std::make_shared<SceneObject>(_meshManager->CreateEmptyCube(), _device, pipelineState));
     _objects.back()->Scale({0.5f, 0.5f, 0.5f});
+    _objects.back()->Material((uint32_t)(_objects.size() % materialsCount));
+    return _objects.back();
+}
+
+SceneManager::SceneObjectPtr SceneManager::CreateSphere()
+{
+    ComPtr<ID3D12PipelineState> pipelineState = _cmdLineOpts.bundles ? _mrtPipelineState->GetPSO() : nullptr;
+    _objects.push_back(std::make_shared<SceneObject>(_meshManager->CreateSphere(), _device, pipelineState));
+    _objects.back()->Scale({0.5f, 0.5f, 0.5f});
+    _objects.back()->Material((uint32_t)(_objects.size() % materialsCount));
     return _objects.back();
 }
 
 SceneManager::SceneObjectPtr SceneManager::CreatePlane()
 {
     _objects.push_back(std::make_shared<SceneObject>(_meshManager->CreatePlane(), _device, nullptr));
+    _objects.back()->Material((uint32_t)(_objects.size() % materialsCount));
     return _objects.back();
 }
 
@@ -277,6 +385,11 @@ void SceneManager::DrawAll()
 
     FillViewProjMatrix();
     FillSceneProperties();
+    ProjectObjectBounds();
+    SelectLods();
+    if (_cmdLineOpts.tessellation)
+        SelectTessellationFactors();
+    UpdateDrawData();
 
     // Clear and shadow pass (if enabled)
     {
@@ -294,12 +407,18 @@ void SceneManager::DrawAll()
         PIXScopedEvent(_cmdQueue.Get(), PIX_COLOR(0, 255, 0), "G-buffer");
         cmdListArray.clear();
         PopulateWorkerCommandLists();
-        for (auto& pWorkList : _workerCmdLists)
-            cmdListArray.push_back(pWorkList->GetInternal().Get());
-        PIXSetMarker(_cmdQueue.Get(), 0, "Queue marker");
-        _cmdQueue->ExecuteCommandLists((UINT)_workerCmdLists.size(), cmdListArray.data());
+        // streamed lists are submitted during recording
+        if (!_cmdLineOpts.streaming_submission)
+        {
+            for (auto& pWorkList : _workerCmdLists)
+                cmdListArray.push_back(pWorkList->GetInternal().Get());
+            PIXSetMarker(_cmdQueue.Get(), 0, "Queue marker");
+            _cmdQueue->ExecuteCommandLists((UINT)_workerCmdLists.size(), cmdListArray.data());
+        }
     }
 
+    UpdateFrameStatistics();
+
     // Lighting and post-processing
     {
         PIXScopedEvent(_cmdQueue.Get(), PIX_COLOR(255, 255, 255), "Lighting and post-process");
@@ -312,6 +431,13 @@ void SceneManager::DrawAll()
     // Swap buffers
     _swapChain->Present(0, 0);
     WaitCurrentFrame();
+    ReadLuminanceTime();
+
+    if (_luminanceCapture == LuminanceCapture::Recorded)
+    {
+        ValidateLuminance("luminanceInfo.log");
+        _luminanceCapture = LuminanceCapture::Done;
+    }
 }
 
 void SceneManager::ExecuteCommandLists(const CommandList & commandList)
@@ -326,6 +452,151 @@ void SceneManager::ExecuteCommandLists(const CommandList & commandList)
     WaitCurrentFrame();
 }
 
+const FrameStatistics& SceneManager::GetFrameStatistics() const
+{
+    return _frameStatistics;
+}
+
+void SceneManager::SetTessellationEdgePixels(float pixels)
+{
+    _tessellationEdgePixels = std::max(pixels, 1.0f);
+}
+
+float SceneManager::GetTessellationEdgePixels() const
+{
+    return _tessellationEdgePixels;
+}
+
+void SceneManager::SetSubmissionBatchSize(size_t lists)
+{
+    _gbufferSubmissionBatch = std::clamp<size_t>(lists, 1, 256);
+}
+
+size_t SceneManager::GetSubmissionBatchSize() const
+{
+    return _gbufferSubmissionBatch;
+}
+
+void SceneManager::SetWorkerThreadsCount(size_t threadsCount)
+{
+    if (!_cmdLineOpts.threads)
+        return;
+
+    StartWorkerThreads(std::clamp<size_t>(threadsCount, 1, 256), _cmdLineOpts.physical_core_workers, _cmdLineOpts.thread_pinning);
+}
+
+size_t SceneManager::GetWorkerThreadsCount() const
+{
+    return std::max<size_t>(_threadPool.size(), 1);
+}
+
+void SceneManager::DumpMeshStatistics(const std::string& fileName) const
+{
+    _meshManager->DumpOptimizationReports(fileName);
+}
+
+void SceneManager::DumpShaderStatistics(const std::string& fileName) const
+{
+    // cold cache has misses only, warm one hits only
+    const ShaderCacheStatistics& statistics = _shaderCache.Statistics();
+    std::ofstream log {fileName};
+    const PipelineStateStatistics psoStatistics = _psoManager->Statistics();
+    log << "Shaders and PSOs creation: " << _shadersCreationTime.count() << " ms" << std::endl;
+    log << "Pipeline states: " << psoStatistics.requests << " requests, " << psoStatistics.deduplicated << " deduplicated, "
+        << psoStatistics.loadedFromLibrary << " loaded from " << pipelineLibraryFileName << ", " << psoStatistics.compiled << " compiled, "
+        << psoStatistics.pending << " still compiling in background" << std::endl;
+    log << "    Compilation (background threads): " << psoStatistics.compileMilliseconds << " ms" << std::endl;
+
+    const RootSignatureStatistics& rootSignatureStatistics = _rootSignatureRegistry->Statistics();
+    log << "Root signatures: " << rootSignatureStatistics.requests << " requests, " << rootSignatureStatistics.deduplicated << " shared, "
+        << rootSignatureStatistics.loadedFromDisk << " loaded from cache, " << rootSignatureStatistics.serialized << " serialized ("
+        << rootSignatureStatistics.milliseconds << " ms)" << std::endl;
+    _rootSignatureRegistry->DumpReport(log);
+    log << "Diffuse textures: " << (_cmdLineOpts.bindless_textures ? "bindless, material table" : "descriptor table per draw")
+        << " (" << _materials.size() << " materials)" << std::endl;
+    log << "Precompiled permutations: " << _precompiledShaders << " used, " << (_shaderTable ? _shaderTable->Size() : 0) << " in the pack" << std::endl;
+    log << "Shader cache: " << statistics.hits << " hits, " << statistics.misses << " misses (" << shaderCacheDirectory << " folder)" << std::endl;
+    log << "    Preprocessing: " << statistics.preprocessMilliseconds << " ms" << std::endl;
+    log << "    Loading of cached bytecode: " << statistics.loadMilliseconds << " ms" << std::endl;
+    log << "    Compilation: " << statistics.compileMilliseconds << " ms" << std::endl;
+}
+
+void SceneManager::BenchmarkDrawData(const std::string& fileName)
+{
+    std::ofstream log {fileName};
+    if (_objects.empty())
+        return;
+
+    // synthetic scenes repeat the real objects, every mode records the same G-buffer draws without bundles
+    std::vector<perDrawData> objectsDrawData(_objects.size());
+    for (size_t i = 0; i < _objects.size(); ++i)
+        _objects[i]->FillDrawData(objectsDrawData[i]);
+
+    const DrawDataMode modes[] = {DrawDataMode::ConstantBuffer, DrawDataMode::RootConstants, DrawDataMode::StructuredBuffer};
+    const size_t drawsCounts[] = {1000, 10000, 100000, 1000000};
+
+    log << "Per-draw data, " << _objects.size() << " objects repeated, CPU time of one frame" << std::endl;
+    for (DrawDataMode mode : modes)
+    {
+        DrawDataBinder binder {_device, mode};
+        RootSignature rootSignature;
+        CreateMRTPassRootSignature(rootSignature, binder, std::string("MRT pass (") + DrawDataBinder::GetModeName(mode) + ")");
+        std::unique_ptr<GraphicsPipelineState> pipelineState = CreateMRTPassPSO(rootSignature, binder);
+        CommandList commandList {CommandListType::Direct, _device, pipelineState->GetPSO()};
+        commandList.Close();
+
+        log << DrawDataBinder::GetModeName(mode) << " (" << binder.GetRootArgumentsSize() << " bytes of root arguments per draw):" << std::endl;
+        for (size_t drawsCount : drawsCounts)
+        {
+            std::vector<perDrawData> drawData(drawsCount);
+            for (size_t i = 0; i < drawsCount; ++i)
+                drawData[i] = objectsDrawData[i % objectsDrawData.size()];
+
+            // the first update allocates buffers
+            binder.Update(drawData);
+
+            auto start = std::chrono::high_resolution_clock::now();
+            const uint64_t uploadedBytes = binder.Update(drawData);
+            std::chrono::duration<double, std::milli> updateTime = std::chrono::high_resolution_clock::now() - start;
+
+            commandList.Reset();
+            ComPtr<ID3D12GraphicsCommandList> pCmdList = commandList.GetInternal();
+
+            start = std::chrono::high_resolution_clock::now();
+            pCmdList->IASetPrimitiveTopology(_cmdLineOpts.tessellation ? D3D_PRIMITIVE_TOPOLOGY_3_CONTROL_POINT_PATCHLIST : D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+            if (_cmdLineOpts.textures)
+            {
+                ID3D12DescriptorHeap* ppHeaps[] = {_texturesHeap.Get()};
+                pCmdList->SetDescriptorHeaps(_countof(ppHeaps), ppHeaps);
+            }
+            pCmdList->SetGraphicsRootSignature(rootSignature.GetInternal().Get());
+            pCmdList->SetGraphicsRootConstantBufferView(1, _cbvMrtFrameParams->GetGPUVirtualAddress());
+            binder.BindBuffer(pCmdList.Get(), GetMRTDrawBufferParameter());
+            BindTextures(pCmdList.Get());
+            for (size_t i = 0; i < drawsCount; ++i)
+            {
+                binder.Bind(pCmdList.Get(), 0, i);
+                BindMaterial(pCmdList.Get(), *_objects[i % _objects.size()]);
+
+                if (_cmdLineOpts.root_constants)
+                {
+                    float shift = 0.125f * i;
+                    pCmdList->SetGraphicsRoot32BitConstant(2, *reinterpret_cast<uint32_t*>(&shift), 0);
+                }
+
+                _objects[i % _objects.size()]->Draw(pCmdList, true);
+            }
+            std::chrono::duration<double, std::milli> recordingTime = std::chrono::high_resolution_clock::now() - start;
+
+            // recorded only for timing, never executed
+            commandList.Close();
+
+            log << "    " << drawsCount << " draws: update " << updateTime.count() << " ms, recording " << recordingTime.count() << " ms ("
+                << recordingTime.count() * 1e6 / drawsCount << " ns/draw), uploaded " << uploadedBytes / 1024 << " KB/frame" << std::endl;
+        }
+    }
+}
+
 Graphics::SphericalCamera * SceneManager::GetViewCamera()
 {
     return &_viewCamera;
@@ -367,6 +638,27 @@ void SceneManager::PopulateClearPassCommandList()
     _clearPassCmdList->Close();
 }
 
+void SceneManager::BindTextures(ID3D12GraphicsCommandList* pCmdList) const
+{
+    if (!_cmdLineOpts.bindless_textures)
+        return;
+
+    const UINT texturesParameter = _cmdLineOpts.root_constants ? 3 : 2;
+    pCmdList->SetGraphicsRootDescriptorTable(texturesParameter, _texturesHeap->GetGPUDescriptorHandleForHeapStart());
+    pCmdList->SetGraphicsRootShaderResourceView(texturesParameter + 1, _materialsBuffer->GetGPUVirtualAddress());
+}
+
+void SceneManager::BindMaterial(ID3D12GraphicsCommandList* pCmdList, const SceneObject& object) const
+{
+    if (!_cmdLineOpts.textures || _cmdLineOpts.bindless_textures)
+        return;
+
+    // diffuse texture binding
+    D3D12_GPU_DESCRIPTOR_HANDLE texHandle = _texturesHeap->GetGPUDescriptorHandleForHeapStart();
+    texHandle.ptr += _texturesDescriptorSize * _materials[object.Material()].diffuseTexture;
+    pCmdList->SetGraphicsRootDescriptorTable(_cmdLineOpts.root_constants ? 3 : 2, texHandle);
+}
+
 void SceneManager::PopulateDepthPassCommandList()
 {
     _depthPassCmdList->Reset();
@@ -392,10 +684,12 @@ void SceneManager::PopulateDepthPassCommandList()
 
     pCmdList->SetGraphicsRootSignature(_depthPassRootSignature.GetInternal().Get());
     pCmdList->SetGraphicsRootConstantBufferView(1, _cbvDepthFrameParams->GetGPUVirtualAddress());
+    _drawDataBinder->BindBuffer(pCmdList.Get(), 2);
     for (size_t i = 0; i < _objects.size(); ++i)
     {
-        pCmdList->SetGraphicsRootConstantBufferView(0, _objects[i]->GetConstantBuffer()->GetGPUVirtualAddress());
-        _objects[i]->Draw(pCmdList, true);
+        _drawDataBinder->Bind(pCmdList.Get(), 0, i);
+        // only tessellated depth pass needs normals and UVs for displacement
+        _objects[i]->Draw(pCmdList, true, !_cmdLineOpts.tessellation, _objectLods[i] + _cmdLineOpts.shadow_lod_bias);
     }
 
     PIXEndEvent(pCmdList.Get());
@@ -404,25 +698,175 @@ void SceneManager::PopulateDepthPassCommandList()
 
 void SceneManager::PopulateWorkerCommandLists()
 {
+    _meshletsTotal = 0;
+    _meshletsVisible = 0;
+    _gbufferTriangles = 0;
+
+    // workers take objects one by one or changed chunks of cached and streamed lists
+    const bool chunks = HasGBufferChunks();
+    if (chunks)
+        FindDirtyGBufferChunks();
+    _drawWorkCount = chunks ? _gbufferChunks.Dirty().size() : _objects.size();
+
+    if (_cmdLineOpts.streaming_submission)
+    {
+        // reused lists are ready before recording
+        _gbufferSubmissionQueue.Reset(_gbufferChunks.Size());
+        _gbufferSubmittedChunks = 0;
+        _gbufferRecordingStart = std::chrono::high_resolution_clock::now();
+        _frameStatistics.gbufferSubmissions = 0;
+        for (size_t i = 0; i < _gbufferChunks.Size(); ++i)
+        {
+            if (!_gbufferChunks[i].dirty)
+                _gbufferSubmissionQueue.Publish(i, _workerCmdLists[i]->GetInternal().Get());
+        }
+    }
+
     if (_cmdLineOpts.threads)
     {
-        // wake up worker threads
+        // wake up worker threads, spinning ones see the frame without kernel calls
         _drawObjectIndex = 0;
-        _pendingWorkers = _threadPool.size();
-        _workerBeginCV.notify_all();
+        _pendingWorkers.Store((uint32_t)_threadPool.size());
+        _workerFrame.Increment();
+
+        // GPU starts with the first chunks while workers record the rest
+        if (_cmdLineOpts.streaming_submission)
+            SubmitGBufferChunks(true);
 
         // wait until all work is completed
+        _pendingWorkers.WaitZero(_cmdLineOpts.worker_spin_count);
+    }
+    else if (chunks)
+    {
+        for (size_t chunk : _gbufferChunks.Dirty())
         {
-            std::unique_lock<std::mutex> lock(_workerMutex);
-            while (_drawObjectIndex < _objects.size() || _pendingWorkers)
-                _workerEndCV.wait(lock);
+            RecordGBufferChunk(chunk, 0);
+            if (_cmdLineOpts.streaming_submission)
+                SubmitGBufferChunks(false);
         }
+
+        if (_cmdLineOpts.streaming_submission)
+            SubmitGBufferChunks(true);
     }
     else
     {
         _drawObjectIndex = 0;
-        while (_drawObjectIndex < _objects.size())
-            ThreadDrawRoutine(0);
+        RecordGBufferWork(0);
+    }
+
+    if (_cmdLineOpts.gbuffer_cache)
+        UpdateGBufferCacheStatistics();
+}
+
+bool SceneManager::HasGBufferChunks() const
+{
+    return _cmdLineOpts.gbuffer_cache || _cmdLineOpts.streaming_submission;
+}
+
+void SceneManager::FindDirtyGBufferChunks()
+{
+    // one list per chunk of objects, so a change re-records only lists of its chunk,
+    // streamed chunks are small to be submitted early, so lists are added when the scene grows
+    const size_t chunksCount = _cmdLineOpts.streaming_submission ? (_objects.size() + streamingChunkObjects - 1) / streamingChunkObjects
+                                                                 : _workerCmdLists.size();
+    while (_workerCmdLists.size() < chunksCount)
+    {
+        _workerCmdLists.push_back(std::make_unique<CommandList>(CommandListType::Direct, _device, _mrtPipelineState->GetPSO()));
+        _workerCmdLists.back()->Close();
+    }
+
+    // per-draw data is read by address, only root constants put its values into lists
+    const D3D12_GPU_VIRTUAL_ADDRESS drawDataAddress = _drawDataBinder->GetBufferAddress();
+    const bool drawDataRecorded = _drawDataBinder->Mode() == DrawDataMode::RootConstants;
+    auto hashDraw = [&](size_t i, uint64_t hash)
+    {
+        GBufferDraw draw {_objects[i].get(), _objectLods[i], _objects[i]->Material()};
+        hash = MeshFile::Hash(&draw, sizeof(draw), hash);
+        if (drawDataRecorded)
+            hash = MeshFile::Hash(&_objectsDrawData[i], sizeof(perDrawData), hash);
+        return hash;
+    };
+
+    // without the cache all lists are recorded, visible meshlets depend on the view,
+    // so lists with cluster culling are recorded every frame too
+    const bool reuse = _cmdLineOpts.gbuffer_cache && !_cmdLineOpts.cluster_culling;
+    _gbufferChunks.Update(chunksCount, _objects.size(), MeshFile::Hash(&drawDataAddress, sizeof(drawDataAddress)), reuse, hashDraw);
+    for (size_t chunkIndex = 0; chunkIndex < chunksCount; ++chunkIndex)
+    {
+        if (!_gbufferChunks[chunkIndex].dirty)
+            _gbufferTriangles += _gbufferChunks[chunkIndex].triangles;
+    }
+}
+
+void SceneManager::RecordGBufferChunk(size_t chunkIndex, size_t threadId)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+
+    auto& chunk = _gbufferChunks[chunkIndex];
+    CommandList& commandList = *_workerCmdLists[chunkIndex];
+    BeginGBufferCommandList(commandList);
+
+    uint64_t triangles = 0;
+    for (size_t i = chunk.firstItem; i < chunk.firstItem + chunk.itemsCount; ++i)
+        triangles += RecordGBufferDraw(commandList.GetInternal(), i, threadId);
+
+    EndGBufferCommandList(commandList);
+
+    _gbufferTriangles += triangles;
+    chunk.triangles = triangles;
+    _gbufferChunks.MarkRecorded(chunkIndex);
+    chunk.recordingTime = std::chrono::high_resolution_clock::now() - start;
+
+    // the main thread submits the list when all previous chunks are published
+    if (_cmdLineOpts.streaming_submission)
+        _gbufferSubmissionQueue.Publish(chunkIndex, commandList.GetInternal().Get());
+}
+
+void SceneManager::UpdateGBufferCacheStatistics()
+{
+    // saved time is estimated by the last recording of reused lists
+    _frameStatistics.gbufferLists = _gbufferChunks.Size();
+    _frameStatistics.gbufferListsReused = _gbufferChunks.Size() - _gbufferChunks.Dirty().size();
+    _frameStatistics.gbufferRecordingMilliseconds = 0.0f;
+    _frameStatistics.gbufferSavedMilliseconds = 0.0f;
+    for (size_t i = 0; i < _gbufferChunks.Size(); ++i)
+    {
+        const auto& chunk = _gbufferChunks[i];
+        if (chunk.dirty)
+            _frameStatistics.gbufferRecordingMilliseconds += (float)chunk.recordingTime.count();
+        else
+            _frameStatistics.gbufferSavedMilliseconds += (float)chunk.recordingTime.count();
+    }
+
+    _gbufferCacheHits += _frameStatistics.gbufferListsReused;
+    _gbufferCacheLookups += _frameStatistics.gbufferLists;
+    _frameStatistics.gbufferCacheHitRate = (float)_gbufferCacheHits / _gbufferCacheLookups;
+}
+
+void SceneManager::SubmitGBufferChunks(bool waitAll)
+{
+    const size_t chunksCount = _gbufferSubmissionQueue.Size();
+    std::vector<ID3D12CommandList*> cmdListArray;
+    while (_gbufferSubmittedChunks < chunksCount)
+    {
+        // the last batch of the frame may be shorter
+        const size_t batchEnd = std::min(_gbufferSubmittedChunks + _gbufferSubmissionBatch, chunksCount);
+        const size_t published = waitAll ? _gbufferSubmissionQueue.WaitPrefix(batchEnd) : _gbufferSubmissionQueue.GetPrefix();
+        if (published < batchEnd)
+            return;
+
+        // all published lists go at once, the batch only limits calls for small chunks
+        cmdListArray.clear();
+        for (size_t i = _gbufferSubmittedChunks; i < published; ++i)
+            cmdListArray.push_back(_gbufferSubmissionQueue[i]);
+        _cmdQueue->ExecuteCommandLists((UINT)cmdListArray.size(), cmdListArray.data());
+        _gbufferSubmittedChunks = published;
+
+        std::chrono::duration<float, std::milli> time = std::chrono::high_resolution_clock::now() - _gbufferRecordingStart;
+        if (!_frameStatistics.gbufferSubmissions)
+            _frameStatistics.gbufferFirstSubmitMilliseconds = time.count();
+        _frameStatistics.gbufferLastSubmitMilliseconds = time.count();
+        ++_frameStatistics.gbufferSubmissions;
     }
 }
 
@@ -438,6 +882,11 @@ void SceneManager::PopulateLightPassCommandList()
     // Indicate that the back buffer will be used as a render target.
     ID3D12GraphicsCommandList *pCmdList = _lightPassCmdList->GetInternal().Get();
 
+    // the fallback state is used until the real one is compiled
+    pCmdList->SetPipelineState(_lightPassState->GetPSO().Get());
+    if (!_lightPassState->IsReady())
+        _frameStatistics.fallbackFrames++;
+
     PIXBeginEvent(pCmdList, 0, "Light rendering");
     pCmdList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
@@ -491,6 +940,7 @@ void SceneManager::PopulateLightPassCommandList()
     // This can be easily done with compute shaders
 
     PIXBeginEvent(pCmdList, 0, "Luminance computing");
+    pCmdList->EndQuery(_timestampQueryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, 0);
     {
         auto transition = CD3DX12_RESOURCE_BARRIER::Transition(_HDRRt->_texture.Get(), D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
         pCmdList->ResourceBarrier(1, &transition);
@@ -503,23 +953,67 @@ void SceneManager::PopulateLightPassCommandList()
     ppHeaps[0] = _customsHeap.Get();
     pCmdList->SetDescriptorHeaps(_countof(ppHeaps), ppHeaps);
 
-    pCmdList->SetPipelineState(_IntensityPassState->GetPSO().Get());
     pCmdList->SetComputeRootSignature(_computePassRootSignature.GetInternal().Get());
 
     D3D12_GPU_DESCRIPTOR_HANDLE inputBufferHandle = _customsHeap->GetGPUDescriptorHandleForHeapStart();
     inputBufferHandle.ptr += texHeapIncSize * (_cmdLineOpts.shadow_pass ? 4 : 3); // get colored RT as the first input
     pCmdList->SetComputeRootDescriptorTable(0, inputBufferHandle);
 
-    D3D12_GPU_DESCRIPTOR_HANDLE uavsBufferHandle = _customsHeap->GetGPUDescriptorHandleForHeapStart();
-    uavsBufferHandle.ptr += texHeapIncSize * (_cmdLineOpts.shadow_pass ? 5 : 4); // get two UAV buffers as the second input
-    pCmdList->SetComputeRootDescriptorTable(1, uavsBufferHandle);
+    if (_cmdLineOpts.histogram_exposure)
+    {
+        D3D12_GPU_DESCRIPTOR_HANDLE uavsBufferHandle = _customsHeap->GetGPUDescriptorHandleForHeapStart();
+        uavsBufferHandle.ptr += texHeapIncSize * (_cmdLineOpts.shadow_pass ? 8 : 7); // histogram and final UAVs after background cubemap
+        pCmdList->SetComputeRootDescriptorTable(1, uavsBufferHandle);
+
+        pCmdList->SetPipelineState(_HistogramPassState->GetPSO().Get());
+        pCmdList->Dispatch(LuminanceHistogram::GetGroupsCountX(_screenWidth), LuminanceHistogram::GetGroupsCountY(_screenHeight), 1);
+
+        // histogram is turned into exposure by one group
+        {
+            auto barrier = CD3DX12_RESOURCE_BARRIER::UAV(_luminanceHistogramBuffer.Get());
+            pCmdList->ResourceBarrier(1, &barrier);
+        }
+        if (_luminanceCapture == LuminanceCapture::Requested)
+            RecordLuminanceCapture(pCmdList, _luminanceHistogramBuffer.Get());
+
+        pCmdList->SetPipelineState(_ExposurePassState->GetPSO().Get());
+        pCmdList->Dispatch(1, 1, 1);
+    }
+    else
+    {
+        D3D12_GPU_DESCRIPTOR_HANDLE uavsBufferHandle = _customsHeap->GetGPUDescriptorHandleForHeapStart();
+        uavsBufferHandle.ptr += texHeapIncSize * (_cmdLineOpts.shadow_pass ? 5 : 4); // get two UAV buffers as the second input
+        pCmdList->SetComputeRootDescriptorTable(1, uavsBufferHandle);
+
+        pCmdList->SetPipelineState(_IntensityPassState->GetPSO().Get());
+        const UINT tilesInRow = (_screenWidth + LuminanceReduction::tileSize - 1) / LuminanceReduction::tileSize;
+        const UINT tilesInColumn = (_screenHeight + LuminanceReduction::tileSize - 1) / LuminanceReduction::tileSize;
+        pCmdList->Dispatch(tilesInRow, tilesInColumn, 1);
 
-    pCmdList->Dispatch((_screenHeight / 32) + 1, 1, 1);
+        // tiles are reduced by one group
+        {
+            auto barrier = CD3DX12_RESOURCE_BARRIER::UAV(_intermediateIntensityBuffer.Get());
+            pCmdList->ResourceBarrier(1, &barrier);
+        }
+        pCmdList->SetPipelineState(_IntensityReducePassState->GetPSO().Get());
+        pCmdList->Dispatch(1, 1, 1);
+
+        if (_luminanceCapture == LuminanceCapture::Requested)
+            RecordLuminanceCapture(pCmdList, _intermediateIntensityBuffer.Get());
+    }
+
+    if (_luminanceCapture == LuminanceCapture::Requested)
+    {
+        RecordLuminanceResultCapture(pCmdList);
+        _luminanceCapture = LuminanceCapture::Recorded;
+    }
 
     {
         auto transition = CD3DX12_RESOURCE_BARRIER::Transition(_finalIntensityBuffer.Get(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER);
         pCmdList->ResourceBarrier(1, &transition);
     }
+    pCmdList->EndQuery(_timestampQueryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, 1);
+    pCmdList->ResolveQueryData(_timestampQueryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, 0, 2, _timestampReadbackBuffer.Get(), 0);
     PIXEndEvent(pCmdList);
 
     //////////////////////////////////////////////////////////////////////////
@@ -570,105 +1064,128 @@ void SceneManager::WaitCurrentFrame()
     _frameIndex = _swapChain->GetCurrentBackBufferIndex();
 }
 
-void SceneManager::ThreadDrawRoutine(size_t threadId)
+void SceneManager::ThreadDrawRoutine(size_t threadId, uint32_t frame)
 {
-    if (!_threadPool.empty())
-        SetThreadDescription(GetCurrentThread(), L"Render thread");
+    SetThreadDescription(GetCurrentThread(), L"Render thread");
 
-    UINT rtvHeapIncSize = _device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
-    UINT texHeapIncSize = _device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+    // every worker takes part in each frame once, so the frame end barrier is a counter of pending workers
     while (true)
     {
+        // spin for a while after the previous frame, then park until the next one
+        frame = _workerFrame.WaitWhileEqual(frame, _cmdLineOpts.worker_spin_count);
         if (_workerThreadExit)
             return; // terminate thread
 
-        uint32_t currentObjectIndex = 0;
-        if (!_threadPool.empty())
-        {
-            std::unique_lock<std::mutex> lock(_workerMutex);
+        RecordGBufferWork(threadId);
+        _pendingWorkers.Decrement();
+    }
+}
 
-            while (_drawObjectIndex >= _objects.size())
-            {
-                // nothing to do, remove self from active threads and suspend.
-                --_pendingWorkers;
-                _workerEndCV.notify_one();
+void SceneManager::RecordGBufferWork(size_t threadId)
+{
+    uint32_t currentObjectIndex = _drawObjectIndex++;
 
-                _workerBeginCV.wait(lock);
+    // cached and streamed lists are split in chunks, only changed ones are recorded
+    if (HasGBufferChunks())
+    {
+        for (; currentObjectIndex < _drawWorkCount; currentObjectIndex = _drawObjectIndex++)
+            RecordGBufferChunk(_gbufferChunks.Dirty()[currentObjectIndex], threadId);
+        return;
+    }
 
-                if (_workerThreadExit)
-                    return; // terminate thread
-            }
+    if (currentObjectIndex >= _objects.size())
+        return;
 
-            currentObjectIndex = _drawObjectIndex++;
-            // mutex is unlocked here
-        }
+    // setting initial state of command lists here
+    CommandList& commandList = *_workerCmdLists[threadId];
+    BeginGBufferCommandList(commandList);
 
-        // setting initial state of command lists here
-        ComPtr<ID3D12GraphicsCommandList> pThreadCmdList = _workerCmdLists[threadId]->GetInternal();
-        _workerCmdLists[threadId]->Reset();
+    // draw all objects we can
+    while (currentObjectIndex < _objects.size())
+    {
+        _gbufferTriangles += RecordGBufferDraw(commandList.GetInternal(), currentObjectIndex, threadId);
+        currentObjectIndex = _drawObjectIndex++;
+    }
 
-        PIXBeginEvent(pThreadCmdList.Get(), 0, "G-Buffer objects rendering");
+    EndGBufferCommandList(commandList);
+}
 
-        if (_cmdLineOpts.tessellation)
-            pThreadCmdList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_3_CONTROL_POINT_PATCHLIST);
-        else
-            pThreadCmdList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+void SceneManager::BeginGBufferCommandList(CommandList& commandList)
+{
+    ComPtr<ID3D12GraphicsCommandList> pCmdList = commandList.GetInternal();
+    commandList.Reset();
 
-        // scissor
-        D3D12_RECT scissor = {0, 0, (LONG)_screenWidth, (LONG)_screenHeight};
-        pThreadCmdList->RSSetScissorRects(1, &scissor);
+    PIXBeginEvent(pCmdList.Get(), 0, "G-Buffer objects rendering");
 
-        // viewports
-        D3D12_VIEWPORT viewport = {0, 0, (FLOAT)_screenWidth, (FLOAT)_screenHeight, 0.0f, 1.0f};
-        pThreadCmdList->RSSetViewports(1, &viewport);
+    if (_cmdLineOpts.tessellation)
+        pCmdList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_3_CONTROL_POINT_PATCHLIST);
+    else
+        pCmdList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
-        RenderTarget* rts[8] = {_mrtRts[0].get(), _mrtRts[1].get(), _mrtRts[2].get()};
-        _rtManager->BindRenderTargets(rts, _mrtDepth.get(), *_workerCmdLists[threadId]);
+    // scissor
+    D3D12_RECT scissor = {0, 0, (LONG)_screenWidth, (LONG)_screenHeight};
+    pCmdList->RSSetScissorRects(1, &scissor);
 
-        if (_cmdLineOpts.textures)
-        {
-            // descriptor heaps
-            ID3D12DescriptorHeap* ppHeaps[] = {_texturesHeap.Get()};
-            pThreadCmdList->SetDescriptorHeaps(_countof(ppHeaps), ppHeaps);
-        }
+    // viewports
+    D3D12_VIEWPORT viewport = {0, 0, (FLOAT)_screenWidth, (FLOAT)_screenHeight, 0.0f, 1.0f};
+    pCmdList->RSSetViewports(1, &viewport);
 
-        // root signatures/constants
-        pThreadCmdList->SetGraphicsRootSignature(_MRTRootSignature.GetInternal().Get());
-        pThreadCmdList->SetGraphicsRootConstantBufferView(1, _cbvMrtFrameParams->GetGPUVirtualAddress());
+    RenderTarget* rts[8] = {_mrtRts[0].get(), _mrtRts[1].get(), _mrtRts[2].get()};
+    _rtManager->BindRenderTargets(rts, _mrtDepth.get(), commandList);
 
-        // draw all objects we can
-        while (currentObjectIndex < _objects.size())
-        {
-            pThreadCmdList->SetGraphicsRootConstantBufferView(0, _objects[currentObjectIndex]->GetConstantBuffer()->GetGPUVirtualAddress());
+    if (_cmdLineOpts.textures)
+    {
+        // descriptor heaps
+        ID3D12DescriptorHeap* ppHeaps[] = {_texturesHeap.Get()};
+        pCmdList->SetDescriptorHeaps(_countof(ppHeaps), ppHeaps);
+    }
 
-            if (_cmdLineOpts.textures)
-            {
-                UINT parameterOffset = _cmdLineOpts.root_constants ? 3 : 2;
+    // root signatures/constants
+    pCmdList->SetGraphicsRootSignature(_MRTRootSignature.GetInternal().Get());
+    pCmdList->SetGraphicsRootConstantBufferView(1, _cbvMrtFrameParams->GetGPUVirtualAddress());
+    _drawDataBinder->BindBuffer(pCmdList.Get(), GetMRTDrawBufferParameter());
+    BindTextures(pCmdList.Get());
+}
 
-                // diffuse texture binding
-                D3D12_GPU_DESCRIPTOR_HANDLE texHandle = _texturesHeap->GetGPUDescriptorHandleForHeapStart();
-                texHandle.ptr += texHeapIncSize * ((currentObjectIndex + 1) % 3);
-                pThreadCmdList->SetGraphicsRootDescriptorTable(parameterOffset, texHandle);
-            }
+uint64_t SceneManager::RecordGBufferDraw(const ComPtr<ID3D12GraphicsCommandList>& pCmdList, size_t objectIndex, size_t threadId)
+{
+    _drawDataBinder->Bind(pCmdList.Get(), 0, objectIndex);
+    BindMaterial(pCmdList.Get(), *_objects[objectIndex]);
 
-            if (_cmdLineOpts.root_constants)
-            {
-                float shift = 0.125f * currentObjectIndex;
-                pThreadCmdList->SetGraphicsRoot32BitConstant(2, *reinterpret_cast<uint32_t*>(&shift), 0);
-            }
+    if (_cmdLineOpts.root_constants)
+    {
+        float shift = 0.125f * objectIndex;
+        pCmdList->SetGraphicsRoot32BitConstant(2, *reinterpret_cast<uint32_t*>(&shift), 0);
+    }
 
-            _objects[currentObjectIndex]->Draw(pThreadCmdList);
-            currentObjectIndex = _drawObjectIndex++;
-        }
+    auto & object = _objects[objectIndex];
+    const size_t lod = _objectLods[objectIndex];
 
-        PIXEndEvent(pThreadCmdList.Get());
+    // meshlets are built for the most detailed LOD only
+    if (_cmdLineOpts.cluster_culling && lod == 0)
+    {
+        auto & visibleRanges = _workerVisibleRanges[threadId];
+        _meshletsVisible += object->DrawVisibleMeshlets(pCmdList,
+                                                        _viewFrustumPlanes,
+                                                        _viewEyePosition,
+                                                        !_cmdLineOpts.tessellation, // displacement breaks normal cones
+                                                        visibleRanges);
+        _meshletsTotal += object->GetMeshObject()->Meshlets().meshlets.size();
+
+        size_t visibleIndices = 0;
+        for (const auto & range : visibleRanges)
+            visibleIndices += range.second;
+        return visibleIndices / 3;
+    }
 
-        pThreadCmdList->Close();
+    object->Draw(pCmdList, false, false, lod);
+    return GetTrianglesCount(*object->GetMeshObject(), lod);
+}
 
-        // stop loop, we are the function only.
-        if (_threadPool.empty())
-            break;
-    }
+void SceneManager::EndGBufferCommandList(CommandList& commandList)
+{
+    PIXEndEvent(commandList.GetInternal().Get());
+    commandList.Close();
 }
 
 void SceneManager::CreateRenderTargets()
@@ -710,25 +1227,12 @@ void SceneManager::CreateRenderTargets()
 
 void SceneManager::CreateCommandLists()
 {
-    if (_cmdLineOpts.threads)
-    {
-        _workerCmdLists.resize(_threadPool.size());
-        for (uint32_t i = 0; i < _threadPool.size(); ++i)
-        {
-            _workerCmdLists[i] = std::make_unique<CommandList>(CommandListType::Direct, _device, _mrtPipelineState->GetPSO());
-            _workerCmdLists[i]->Close();
-        }
-    }
-    else
-    {
-        _workerCmdLists.push_back(std::make_unique<CommandList>(CommandListType::Direct, _device, _mrtPipelineState->GetPSO()));
-        _workerCmdLists.back()->Close();
-    }
+    CreateWorkerCommandLists();
 
     _clearPassCmdList = std::make_unique<CommandList>(CommandListType::Direct, _device, _mrtPipelineState->GetPSO());
     _clearPassCmdList->Close();
 
-    _lightPassCmdList = std::make_unique<CommandList>(CommandListType::Direct, _device, _lightPassState->GetPSO());
+    _lightPassCmdList = std::make_unique<CommandList>(CommandListType::Direct, _device, nullptr);
     _lightPassCmdList->Close();
 
     if (_cmdLineOpts.shadow_pass)
@@ -738,20 +1242,59 @@ void SceneManager::CreateCommandLists()
     }
 }
 
+void SceneManager::CreateWorkerCommandLists()
+{
+    // lists of finished threads are released, the single thread has one list too; streamed chunks lose
+    // their lists here and others are split differently, so all chunks are recorded again
+    _workerCmdLists.resize(std::max<size_t>(_threadPool.size(), 1));
+    _gbufferChunks.Clear();
+    for (auto& pWorkList : _workerCmdLists)
+    {
+        if (pWorkList)
+            continue;
+
+        pWorkList = std::make_unique<CommandList>(CommandListType::Direct, _device, _mrtPipelineState->GetPSO());
+        pWorkList->Close();
+    }
+}
+
+void SceneManager::StartWorkerThreads(size_t threadsCount, bool physicalCores, bool pinning)
+{
+    FinishWorkerThreads();
+
+    // threads take processors in order of filling
+    _threadPool.resize(std::max<size_t>(threadsCount, 1));
+    const std::vector<Threading::LogicalProcessor> processors = _cpuTopology.AssignWorkerProcessors(_threadPool.size(), physicalCores, _cmdLineOpts.reserved_cores);
+    pinning &= _cpuTopology.IsKnown();
+
+    const uint32_t frame = _workerFrame.Load();
+    for (size_t tid = 0; tid < _threadPool.size(); ++tid)
+    {
+        _threadPool[tid] = std::thread([this, tid, frame] {ThreadDrawRoutine(tid, frame); });
+        if (pinning)
+            Threading::PinThread(_threadPool[tid], processors[tid]);
+    }
+
+    _workerVisibleRanges.resize(_threadPool.size());
+    // the first lists are created with pipeline states
+    if (!_workerCmdLists.empty())
+        CreateWorkerCommandLists();
+}
+
 void SceneManager::FinishWorkerThreads()
 {
-    if (!_cmdLineOpts.threads)
+    if (_threadPool.empty())
         return;
 
     // wake up worker threads with term signal
-    {
-        std::unique_lock<std::mutex> lock(_workerMutex);
-        _workerThreadExit = true;
-        _workerBeginCV.notify_all();
-    }
+    _workerThreadExit = true;
+    _workerFrame.Increment();
 
     for (auto & tid : _threadPool)
         tid.join();
+
+    _threadPool.clear();
+    _workerThreadExit = false;
 }
 
 void SceneManager::CreateConstantBuffer(size_t bufferSize, ComPtr<ID3D12Resource> * pOutBuffer)
@@ -785,37 +1328,76 @@ void SceneManager::CreateFrameConstantBuffers()
     ThrowIfFailed(_cbvSceneParams->Map(0, &readRange, &_cbvScene));
 }
 
-void SceneManager::CreateMRTPassRootSignature()
+void SceneManager::CreateMaterials()
+{
+    // every material takes its own texture of the heap
+    _materials.resize(materialsCount);
+    for (uint32_t i = 0; i < materialsCount; ++i)
+        _materials[i].diffuseTexture = i;
+    _texturesDescriptorSize = _device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+
+    CreateConstantBuffer(_materials.size() * sizeof(materialData), &_materialsBuffer);
+    _materialsBuffer->SetName(L"Materials");
+
+    void* pData = nullptr;
+    D3D12_RANGE readRange = {0, 0};
+    ThrowIfFailed(_materialsBuffer->Map(0, &readRange, &pData));
+    memcpy(pData, _materials.data(), _materials.size() * sizeof(materialData));
+    _materialsBuffer->Unmap(0, nullptr);
+}
+
+void SceneManager::CreateMRTPassRootSignature(RootSignature& rootSignature, const DrawDataBinder& binder, const std::string& name)
 {
-    // 4 entries
+    // 6 entries
     //
-    // 1. constant buffer with model parameters
+    // 1. per-draw data: constant buffer with model parameters, root constants or draw ID
     // 2. constant buffer with frame parameters
     // 3. root constants with texture coords offset
-    // 4. texture table with diffuse texture
+    // 4. texture table with diffuse texture or all textures of the heap (bindless)
+    // 5. structured buffer with materials (bindless)
+    // 6. structured buffer with per-draw data of all objects
 
-    UINT entriesCount = 4;
-    if (!_cmdLineOpts.root_constants)
-        entriesCount--;
-    if (!_cmdLineOpts.textures)
-        entriesCount--;
+    UINT entriesCount = GetMRTDrawBufferParameter();
+    if (binder.HasBufferParameter())
+        entriesCount++;
 
-    _MRTRootSignature.Init(entriesCount, 1);
+    rootSignature.Init(entriesCount, 1);
 
-    _MRTRootSignature[0].InitAsCBV(0);
-    _MRTRootSignature[1].InitAsCBV(1);
+    binder.InitRootParameters(rootSignature[0], binder.HasBufferParameter() ? &rootSignature[GetMRTDrawBufferParameter()] : nullptr);
+    rootSignature[1].InitAsCBV(1);
 
     if (_cmdLineOpts.root_constants)
-        _MRTRootSignature[2].InitAsConstants(1, 2);
+        rootSignature[2].InitAsConstants(1, 2);
 
     if (_cmdLineOpts.textures)
     {
-        _MRTRootSignature[_cmdLineOpts.root_constants ? 3 : 2].InitAsDescriptorsTable(1);
-        _MRTRootSignature[_cmdLineOpts.root_constants ? 3 : 2].InitTableRange(0, 0, 1, D3D12_DESCRIPTOR_RANGE_TYPE_SRV);
+        const UINT texturesParameter = _cmdLineOpts.root_constants ? 3 : 2;
+        rootSignature[texturesParameter].InitAsDescriptorsTable(1);
+        if (_cmdLineOpts.bindless_textures)
+        {
+            rootSignature[texturesParameter].InitTableRange(0, 0, UINT_MAX, D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1);
+            rootSignature[texturesParameter + 1].InitAsSRV(2);
+        }
+        else
+        {
+            rootSignature[texturesParameter].InitTableRange(0, 0, 1, D3D12_DESCRIPTOR_RANGE_TYPE_SRV);
+        }
     }
 
-    _MRTRootSignature.InitStaticSampler(0, {});
-    _MRTRootSignature.Finalize(_device, D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
+    rootSignature.InitStaticSampler(0, {});
+    rootSignature.Finalize(*_rootSignatureRegistry, name, D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
+}
+
+UINT SceneManager::GetMRTDrawBufferParameter() const
+{
+    UINT parameter = 2;
+    if (_cmdLineOpts.root_constants)
+        parameter++;
+    if (_cmdLineOpts.textures)
+        parameter++;
+    if (_cmdLineOpts.bindless_textures)
+        parameter++;
+    return parameter;
 }
 
 void SceneManager::CreateLightPassRootSignature()
@@ -847,7 +1429,7 @@ void SceneManager::CreateLightPassRootSignature()
     _lightRootSignature.InitStaticSampler(0, textureSampler);
     _lightRootSignature.InitStaticSampler(1, shadowSampler);
 
-    _lightRootSignature.Finalize(_device, D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
+    _lightRootSignature.Finalize(*_rootSignatureRegistry, "Light pass", D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
 }
 
 void SceneManager::CreateLDRPassRootSignature()
@@ -866,17 +1448,17 @@ void SceneManager::CreateLDRPassRootSignature()
     textureSamplerDesc.AddressW = D3D12_TEXTURE_ADDRESS_MODE_CLAMP;
 
     _LDRRootSignature.InitStaticSampler(0, textureSampler);
-    _LDRRootSignature.Finalize(_device, D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
+    _LDRRootSignature.Finalize(*_rootSignatureRegistry, "LDR pass", D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
 }
 
 void SceneManager::CreateDepthPassRootSignature()
 {
-    _depthPassRootSignature.Init(2, 0);
+    _depthPassRootSignature.Init(_drawDataBinder->HasBufferParameter() ? 3 : 2, 0);
 
-    _depthPassRootSignature[0].InitAsCBV(0);
+    _drawDataBinder->InitRootParameters(_depthPassRootSignature[0], _drawDataBinder->HasBufferParameter() ? &_depthPassRootSignature[2] : nullptr);
     _depthPassRootSignature[1].InitAsCBV(1);
 
-    _depthPassRootSignature.Finalize(_device, D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
+    _depthPassRootSignature.Finalize(*_rootSignatureRegistry, "Depth pass", D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
 }
 
 void SceneManager::CreateIntensityPassRootSignature()
@@ -889,17 +1471,47 @@ void SceneManager::CreateIntensityPassRootSignature()
     _computePassRootSignature[1].InitAsDescriptorsTable(1);
     _computePassRootSignature[1].InitTableRange(0, 0, 2, D3D12_DESCRIPTOR_RANGE_TYPE_UAV);
 
-    _computePassRootSignature.Finalize(_device);
+    _computePassRootSignature.Finalize(*_rootSignatureRegistry, "Intensity pass");
 }
 
 void SceneManager::CreateShadersAndPSOs()
 {
-    CreateMRTPassPSO();
+    // pipelines are compiled in background, command lists and buffers are created meanwhile
+    auto start = std::chrono::high_resolution_clock::now();
+
+    _mrtPipelineState = CreateMRTPassPSO(_MRTRootSignature, *_drawDataBinder);
     CreateLightPassPSO();
     CreateLDRPassPSO();
     CreateIntensityPassPSO();
     if (_cmdLineOpts.shadow_pass)
         CreateDepthPassPSO();
+
+    _shadersCreationTime = std::chrono::high_resolution_clock::now() - start;
+}
+
+ComPtr<ID3DBlob> SceneManager::GetShader(ShaderPermutations::ShaderId shader, ShaderType stage, uint32_t features)
+{
+    // precompiled variants are taken from the pack, the rest are compiled through the cache
+    if (_shaderTable)
+    {
+        if (ComPtr<ID3DBlob> bytecode = _shaderTable->Find(shader, stage, features))
+        {
+            _precompiledShaders++;
+            return bytecode;
+        }
+    }
+
+    const std::vector<D3D_SHADER_MACRO> macro = ShaderPermutations::GetMacros(features);
+    return _shaderCache.CompileFromFile(ShaderPermutations::GetShaderInfo(shader).fileName, stage, macro.data());
+}
+
+D3D12_INPUT_LAYOUT_DESC SceneManager::GetGeometryInputLayout(bool positionsOnly) const
+{
+    // position is the first element of both layouts
+    if (_cmdLineOpts.packed_vertices)
+        return {packedGeometryInputElements, positionsOnly ? 1u : (UINT)_countof(packedGeometryInputElements)};
+
+    return {defaultGeometryInputElements, positionsOnly ? 1u : (UINT)_countof(defaultGeometryInputElements)};
 }
 
 void SceneManager::CreateDepthPassPSO()
@@ -910,22 +1522,16 @@ void SceneManager::CreateDepthPassPSO()
     ComPtr<ID3DBlob> HSblob = nullptr;
     ComPtr<ID3DBlob> DSblob = nullptr;
 
-    std::vector<D3D_SHADER_MACRO> macro;
-    if (_cmdLineOpts.tessellation)
-        macro.push_back({"UseTessellation", "1"});
-    macro.push_back({NULL, NULL});
-
-    std::wstring depthPassShader = L"assets/shaders/DepthPass.hlsl";
-    ShadersUtils::CompileShaderFromFile(depthPassShader, ShaderType::Vertex, &VSblob, macro.data());
+    const uint32_t features = ShaderPermutations::GetFeatures(ShaderPermutations::ShaderId::DepthPass, _cmdLineOpts);
+    VSblob = GetShader(ShaderPermutations::ShaderId::DepthPass, ShaderType::Vertex, features);
 
     if (_cmdLineOpts.tessellation)
     {
-        ShadersUtils::CompileShaderFromFile(depthPassShader, ShaderType::Hull, &HSblob, macro.data());
-        ShadersUtils::CompileShaderFromFile(depthPassShader, ShaderType::Domain, &DSblob, macro.data());
+        HSblob = GetShader(ShaderPermutations::ShaderId::DepthPass, ShaderType::Hull, features);
+        DSblob = GetShader(ShaderPermutations::ShaderId::DepthPass, ShaderType::Domain, features);
     }
 
-    _depthPassState = std::make_unique<GraphicsPipelineState>(_depthPassRootSignature,
-                                                              D3D12_INPUT_LAYOUT_DESC {defaultGeometryInputElements, _countof(defaultGeometryInputElements)});
+    _depthPassState = std::make_unique<GraphicsPipelineState>(_depthPassRootSignature, GetGeometryInputLayout(!_cmdLineOpts.tessellation));
     _depthPassState->SetShaderCode(VSblob, ShaderType::Vertex);
     if (_cmdLineOpts.tessellation)
     {
@@ -973,7 +1579,7 @@ void SceneManager::CreateDepthPassPSO()
     };
 
     _depthPassState->SetRasterizerState(rasterizerDesc);
-    _depthPassState->Finalize(_device);
+    _depthPassState->Finalize(*_psoManager, true);
 }
 
 void SceneManager::CreateLightPassPSO()
@@ -981,16 +1587,9 @@ void SceneManager::CreateLightPassPSO()
     // Prepare our HLSL shaders
     ComPtr<ID3DBlob> VSblob = nullptr;
     ComPtr<ID3DBlob> PSblob = nullptr;
-    D3D_SHADER_MACRO *macro = nullptr;
-
-    D3D_SHADER_MACRO ShadowMacro[] = {"ShadowMapping", "1", NULL, NULL};
-    macro = nullptr;
-    if (_cmdLineOpts.shadow_pass)
-        macro = ShadowMacro;
-
-    std::wstring squadFileName = L"assets/shaders/LightPass.hlsl";
-    ShadersUtils::CompileShaderFromFile(squadFileName, ShaderType::Vertex, &VSblob, macro);
-    ShadersUtils::CompileShaderFromFile(squadFileName, ShaderType::Pixel, &PSblob, macro);
+    const uint32_t features = ShaderPermutations::GetFeatures(ShaderPermutations::ShaderId::LightPass, _cmdLineOpts);
+    VSblob = GetShader(ShaderPermutations::ShaderId::LightPass, ShaderType::Vertex, features);
+    PSblob = GetShader(ShaderPermutations::ShaderId::LightPass, ShaderType::Pixel, features);
 
     _lightPassState = std::make_unique<GraphicsPipelineState>(_lightRootSignature,
                                                               D3D12_INPUT_LAYOUT_DESC {screenQuadInputElements, _countof(screenQuadInputElements)});
@@ -998,10 +1597,23 @@ void SceneManager::CreateLightPassPSO()
     _lightPassState->SetShaderCode(PSblob, ShaderType::Pixel);
     _lightPassState->SetRenderTargetFormats({DXGI_FORMAT_R16G16B16A16_FLOAT});
     _lightPassState->SetDepthStencilState({FALSE});
-    _lightPassState->Finalize(_device);
+    _lightPassState->Finalize(*_psoManager, true);
+
+    if (!features)
+        return;
+
+    // shadowed variant is compiled longer, the scene is lit without shadows until it's ready
+    _lightPassFallbackState = std::make_unique<GraphicsPipelineState>(_lightRootSignature,
+                                                                      D3D12_INPUT_LAYOUT_DESC {screenQuadInputElements, _countof(screenQuadInputElements)});
+    _lightPassFallbackState->SetShaderCode(GetShader(ShaderPermutations::ShaderId::LightPass, ShaderType::Vertex, 0), ShaderType::Vertex);
+    _lightPassFallbackState->SetShaderCode(GetShader(ShaderPermutations::ShaderId::LightPass, ShaderType::Pixel, 0), ShaderType::Pixel);
+    _lightPassFallbackState->SetRenderTargetFormats({DXGI_FORMAT_R16G16B16A16_FLOAT});
+    _lightPassFallbackState->SetDepthStencilState({FALSE});
+    _lightPassFallbackState->Finalize(*_psoManager, true);
+    _lightPassState->SetFallback(_lightPassFallbackState.get());
 }
 
-void SceneManager::CreateMRTPassPSO()
+std::unique_ptr<GraphicsPipelineState> SceneManager::CreateMRTPassPSO(const RootSignature& rootSignature, const DrawDataBinder& binder)
 {
     // Prepare our HLSL shaders
     ComPtr<ID3DBlob> VSblob = nullptr;
@@ -1009,40 +1621,34 @@ void SceneManager::CreateMRTPassPSO()
     ComPtr<ID3DBlob> HSblob = nullptr;
     ComPtr<ID3DBlob> DSblob = nullptr;
 
-    std::vector<D3D_SHADER_MACRO> macro;
-    if (_cmdLineOpts.root_constants)
-        macro.push_back({"RootConstants", "1"});
-    if (_cmdLineOpts.textures)
-        macro.push_back({"UseTextures", "1"});
-    if (_cmdLineOpts.tessellation)
-        macro.push_back({"UseTessellation", "1"});
-    macro.push_back({NULL, NULL});
-
-    std::wstring mrtShaders = L"assets/shaders/MRTPass.hlsl";
-    ShadersUtils::CompileShaderFromFile(mrtShaders, ShaderType::Vertex, &VSblob, macro.data());
-    ShadersUtils::CompileShaderFromFile(mrtShaders, ShaderType::Pixel, &PSblob, macro.data());
+    // the draw data benchmark creates states for every mode
+    CommandLineOptions options = _cmdLineOpts;
+    options.draw_data = binder.Mode();
+    const uint32_t features = ShaderPermutations::GetFeatures(ShaderPermutations::ShaderId::MRTPass, options);
+    VSblob = GetShader(ShaderPermutations::ShaderId::MRTPass, ShaderType::Vertex, features);
+    PSblob = GetShader(ShaderPermutations::ShaderId::MRTPass, ShaderType::Pixel, features);
     if (_cmdLineOpts.tessellation)
     {
-        ShadersUtils::CompileShaderFromFile(mrtShaders, ShaderType::Hull, &HSblob, macro.data());
-        ShadersUtils::CompileShaderFromFile(mrtShaders, ShaderType::Domain, &DSblob, macro.data());
+        HSblob = GetShader(ShaderPermutations::ShaderId::MRTPass, ShaderType::Hull, features);
+        DSblob = GetShader(ShaderPermutations::ShaderId::MRTPass, ShaderType::Domain, features);
     }
 
-    _mrtPipelineState = std::make_unique<GraphicsPipelineState>(_MRTRootSignature,
-                                                                D3D12_INPUT_LAYOUT_DESC {defaultGeometryInputElements, _countof(defaultGeometryInputElements)});
-    _mrtPipelineState->SetShaderCode(VSblob, ShaderType::Vertex);
-    _mrtPipelineState->SetShaderCode(PSblob, ShaderType::Pixel);
+    auto pipelineState = std::make_unique<GraphicsPipelineState>(rootSignature, GetGeometryInputLayout(false));
+    pipelineState->SetShaderCode(VSblob, ShaderType::Vertex);
+    pipelineState->SetShaderCode(PSblob, ShaderType::Pixel);
     if (_cmdLineOpts.tessellation)
     {
-        _mrtPipelineState->SetShaderCode(HSblob, ShaderType::Hull);
-        _mrtPipelineState->SetShaderCode(DSblob, ShaderType::Domain);
+        pipelineState->SetShaderCode(HSblob, ShaderType::Hull);
+        pipelineState->SetShaderCode(DSblob, ShaderType::Domain);
     }
-    _mrtPipelineState->SetRenderTargetFormats({DXGI_FORMAT_R8G8B8A8_UNORM, DXGI_FORMAT_R11G11B10_FLOAT, DXGI_FORMAT_R32_FLOAT});
-    _mrtPipelineState->SetDepthStencilFormat(DXGI_FORMAT_D24_UNORM_S8_UINT);
+    pipelineState->SetRenderTargetFormats({DXGI_FORMAT_R8G8B8A8_UNORM, DXGI_FORMAT_R11G11B10_FLOAT, DXGI_FORMAT_R32_FLOAT});
+    pipelineState->SetDepthStencilFormat(DXGI_FORMAT_D24_UNORM_S8_UINT);
 
     if (_cmdLineOpts.tessellation)
-        _mrtPipelineState->SetPritimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY_TYPE_PATCH);
+        pipelineState->SetPritimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY_TYPE_PATCH);
 
-    _mrtPipelineState->Finalize(_device);
+    pipelineState->Finalize(*_psoManager, true);
+    return pipelineState;
 }
 
 void SceneManager::CreateLDRPassPSO()
@@ -1050,11 +1656,8 @@ void SceneManager::CreateLDRPassPSO()
     // Prepare our HLSL shaders
     ComPtr<ID3DBlob> VSblob = nullptr;
     ComPtr<ID3DBlob> PSblob = nullptr;
-    D3D_SHADER_MACRO macro[] = {NULL, NULL};
-
-    std::wstring squadFileName = L"assets/shaders/LDRPass.hlsl";
-    ShadersUtils::CompileShaderFromFile(squadFileName, ShaderType::Vertex, &VSblob, macro);
-    ShadersUtils::CompileShaderFromFile(squadFileName, ShaderType::Pixel, &PSblob, macro);
+    VSblob = GetShader(ShaderPermutations::ShaderId::LDRPass, ShaderType::Vertex, 0);
+    PSblob = GetShader(ShaderPermutations::ShaderId::LDRPass, ShaderType::Pixel, 0);
 
     _LDRPassState = std::make_unique<GraphicsPipelineState>(_LDRRootSignature,
                                                             D3D12_INPUT_LAYOUT_DESC {screenQuadInputElements, _countof(screenQuadInputElements)});
@@ -1062,21 +1665,183 @@ void SceneManager::CreateLDRPassPSO()
     _LDRPassState->SetShaderCode(PSblob, ShaderType::Pixel);
     _LDRPassState->SetRenderTargetFormats({DXGI_FORMAT_R8G8B8A8_UNORM_SRGB});
     _LDRPassState->SetDepthStencilState({FALSE});
-    _LDRPassState->Finalize(_device);
+    _LDRPassState->Finalize(*_psoManager, true);
 }
 
 void SceneManager::CreateIntensityPassPSO()
 {
     // Prepare our HLSL shaders
     ComPtr<ID3DBlob> CSblob = nullptr;
-    D3D_SHADER_MACRO macro[] = {NULL, NULL};
-
-    std::wstring squadFileName = L"assets/shaders/IntensityPass.hlsl";
-    ShadersUtils::CompileShaderFromFile(squadFileName, ShaderType::Compute, &CSblob, macro);
+    CSblob = GetShader(ShaderPermutations::ShaderId::IntensityPass, ShaderType::Compute, 0);
 
     _IntensityPassState = std::make_unique<ComputePipelineState>(_computePassRootSignature);
     _IntensityPassState->SetShaderCode(CSblob);
-    _IntensityPassState->Finalize(_device);
+    _IntensityPassState->Finalize(*_psoManager, true);
+
+    // the same root signature, tiles are in u0 and the result is in u1
+    _IntensityReducePassState = std::make_unique<ComputePipelineState>(_computePassRootSignature);
+    _IntensityReducePassState->SetShaderCode(GetShader(ShaderPermutations::ShaderId::IntensityReducePass, ShaderType::Compute, 0));
+    _IntensityReducePassState->Finalize(*_psoManager, true);
+
+    // histogram exposure passes are drawn instead of reduction, histogram is in u0 and the result is in u1
+    if (_cmdLineOpts.histogram_exposure)
+    {
+        _HistogramPassState = std::make_unique<ComputePipelineState>(_computePassRootSignature);
+        _HistogramPassState->SetShaderCode(GetShader(ShaderPermutations::ShaderId::HistogramPass, ShaderType::Compute, 0));
+        _HistogramPassState->Finalize(*_psoManager, true);
+
+        _ExposurePassState = std::make_unique<ComputePipelineState>(_computePassRootSignature);
+        _ExposurePassState->SetShaderCode(GetShader(ShaderPermutations::ShaderId::ExposurePass, ShaderType::Compute, 0));
+        _ExposurePassState->Finalize(*_psoManager, true);
+    }
+}
+
+UINT64 SceneManager::GetLuminanceIntermediateBytes() const
+{
+    if (_cmdLineOpts.histogram_exposure)
+        return LuminanceHistogram::binsCount * sizeof(uint32_t);
+
+    return LuminanceReduction::GetTilesCount(_screenWidth, _screenHeight) * sizeof(LuminanceReduction::Luminance);
+}
+
+void SceneManager::RecordLuminanceCapture(ID3D12GraphicsCommandList* pCmdList, ID3D12Resource* pIntermediateBuffer)
+{
+    const UINT64 intermediateOffset = _hdrReadbackFootprint.Offset + (UINT64)_hdrReadbackFootprint.Footprint.RowPitch * _hdrReadbackFootprint.Footprint.Height;
+
+    D3D12_RESOURCE_BARRIER barriers[] = {
+        CD3DX12_RESOURCE_BARRIER::Transition(_HDRRt->_texture.Get(), D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_COPY_SOURCE),
+        CD3DX12_RESOURCE_BARRIER::Transition(pIntermediateBuffer, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_SOURCE),
+    };
+    pCmdList->ResourceBarrier(_countof(barriers), barriers);
+
+    CD3DX12_TEXTURE_COPY_LOCATION dst {_luminanceReadbackBuffer.Get(), _hdrReadbackFootprint};
+    CD3DX12_TEXTURE_COPY_LOCATION src {_HDRRt->_texture.Get(), 0};
+    pCmdList->CopyTextureRegion(&dst, 0, 0, 0, &src, nullptr);
+    pCmdList->CopyBufferRegion(_luminanceReadbackBuffer.Get(), intermediateOffset, pIntermediateBuffer, 0, GetLuminanceIntermediateBytes());
+
+    for (D3D12_RESOURCE_BARRIER& barrier : barriers)
+        std::swap(barrier.Transition.StateBefore, barrier.Transition.StateAfter);
+    pCmdList->ResourceBarrier(_countof(barriers), barriers);
+}
+
+void SceneManager::RecordLuminanceResultCapture(ID3D12GraphicsCommandList* pCmdList)
+{
+    const UINT64 resultOffset = _hdrReadbackFootprint.Offset + (UINT64)_hdrReadbackFootprint.Footprint.RowPitch * _hdrReadbackFootprint.Footprint.Height
+                              + GetLuminanceIntermediateBytes();
+
+    auto barrier = CD3DX12_RESOURCE_BARRIER::Transition(_finalIntensityBuffer.Get(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_SOURCE);
+    pCmdList->ResourceBarrier(1, &barrier);
+    pCmdList->CopyBufferRegion(_luminanceReadbackBuffer.Get(), resultOffset, _finalIntensityBuffer.Get(), 0, sizeof(LuminanceReduction::Luminance));
+    std::swap(barrier.Transition.StateBefore, barrier.Transition.StateAfter);
+    pCmdList->ResourceBarrier(1, &barrier);
+}
+
+void SceneManager::ReadLuminanceTime()
+{
+    D3D12_RANGE readRange = {0, sizeof(uint64_t) * 2};
+    uint64_t* timestamps = nullptr;
+    ThrowIfFailed(_timestampReadbackBuffer->Map(0, &readRange, reinterpret_cast<void**>(&timestamps)));
+    const uint64_t ticks = timestamps[1] - timestamps[0];
+    D3D12_RANGE writtenRange = {0, 0};
+    _timestampReadbackBuffer->Unmap(0, &writtenRange);
+
+    _frameStatistics.luminanceMicroseconds = (float)(ticks * 1000000.0 / _timestampFrequency);
+}
+
+void SceneManager::ValidateLuminance(const std::string& fileName)
+{
+    using namespace LuminanceReduction;
+
+    const UINT64 intermediateOffset = _hdrReadbackFootprint.Offset + (UINT64)_hdrReadbackFootprint.Footprint.RowPitch * _hdrReadbackFootprint.Footprint.Height;
+    const UINT64 intermediateBytes = GetLuminanceIntermediateBytes();
+
+    uint8_t* data = nullptr;
+    ThrowIfFailed(_luminanceReadbackBuffer->Map(0, nullptr, reinterpret_cast<void**>(&data)));
+
+    // HDR render target is R16G16B16A16_FLOAT
+    std::vector<float> texels((size_t)_screenWidth * _screenHeight * 4);
+    for (UINT y = 0; y < _screenHeight; ++y)
+    {
+        const uint8_t* row = data + _hdrReadbackFootprint.Offset + (size_t)y * _hdrReadbackFootprint.Footprint.RowPitch;
+        PackedVector::XMConvertHalfToFloatStream(&texels[(size_t)y * _screenWidth * 4],
+                                                 sizeof(float),
+                                                 reinterpret_cast<const PackedVector::HALF*>(row),
+                                                 sizeof(PackedVector::HALF),
+                                                 _screenWidth * 4);
+    }
+
+    const std::vector<uint8_t> intermediate(data + intermediateOffset, data + intermediateOffset + intermediateBytes);
+    Luminance gpuResult;
+    memcpy(&gpuResult, data + intermediateOffset + intermediateBytes, sizeof(Luminance));
+
+    D3D12_RANGE writtenRange = {0, 0};
+    _luminanceReadbackBuffer->Unmap(0, &writtenRange);
+
+    const size_t rowPitch = _screenWidth * sizeof(float) * 4;
+    std::ofstream log {fileName};
+    if (_cmdLineOpts.histogram_exposure)
+    {
+        using namespace LuminanceHistogram;
+
+        const uint32_t* binsData = reinterpret_cast<const uint32_t*>(intermediate.data());
+        const Histogram gpuHistogram(binsData, binsData + binsCount);
+
+        auto start = std::chrono::high_resolution_clock::now();
+        const Histogram cpuHistogram = Build(texels.data(), _screenWidth, _screenHeight, rowPitch);
+        const Luminance cpuResult = ComputeExposure(cpuHistogram);
+        const std::chrono::duration<double, std::milli> cpuTime = std::chrono::high_resolution_clock::now() - start;
+
+        // GPU log2() may move texels on bin edges to neighbours
+        size_t equalBins = 0;
+        uint64_t movedTexels = 0;
+        uint64_t texelsCount = 0;
+        for (uint32_t bin = 0; bin < binsCount; ++bin)
+        {
+            equalBins += gpuHistogram[bin] == cpuHistogram[bin];
+            movedTexels += std::max(gpuHistogram[bin], cpuHistogram[bin]) - std::min(gpuHistogram[bin], cpuHistogram[bin]);
+            texelsCount += cpuHistogram[bin];
+        }
+        const Luminance gpuHistogramResult = ComputeExposure(gpuHistogram);
+
+        log << "Histogram exposure of " << _screenWidth << "x" << _screenHeight << " frame, " << texelsCount << " texels after "
+            << downsampling << "x" << downsampling << " downsampling in " << binsCount << " bins, percentiles "
+            << lowPercentile << "-" << highPercentile << std::endl;
+        log << "    Equal bins: " << equalBins << " of " << binsCount << ", texels in other bins: " << movedTexels / 2 << std::endl;
+        log << "    GPU: average " << gpuResult.average << ", max " << gpuResult.max << std::endl;
+        log << "    CPU exposure of GPU histogram: average " << gpuHistogramResult.average << ", max " << gpuHistogramResult.max << std::endl;
+        log << "    CPU reference: average " << cpuResult.average << ", max " << cpuResult.max << " (" << cpuTime.count() << " ms)" << std::endl;
+        return;
+    }
+
+    const size_t tilesCount = GetTilesCount(_screenWidth, _screenHeight);
+    const Luminance* tilesData = reinterpret_cast<const Luminance*>(intermediate.data());
+    const std::vector<Luminance> gpuTiles(tilesData, tilesData + tilesCount);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    const std::vector<Luminance> cpuTiles = ReduceTiles(texels.data(), _screenWidth, _screenHeight, rowPitch);
+    const Luminance cpuResult = ReduceImage(cpuTiles, _screenWidth, _screenHeight);
+    const std::chrono::duration<double, std::milli> cpuTime = std::chrono::high_resolution_clock::now() - start;
+
+    // GPU log() and fused multiply-adds may change last bits of texel values, reduction itself is exact
+    size_t exactTiles = 0;
+    size_t exactMaxTiles = 0;
+    float maxRelativeError = 0.0f;
+    for (size_t i = 0; i < tilesCount; ++i)
+    {
+        exactTiles += memcmp(&gpuTiles[i], &cpuTiles[i], sizeof(Luminance)) == 0;
+        exactMaxTiles += gpuTiles[i].max == cpuTiles[i].max;
+        const float error = std::abs(gpuTiles[i].average - cpuTiles[i].average) / std::max(std::abs(cpuTiles[i].average), 1e-6f);
+        maxRelativeError = std::max(maxRelativeError, error);
+    }
+    const Luminance gpuTilesResult = ReduceImage(gpuTiles, _screenWidth, _screenHeight);
+
+    log << "Luminance reduction of " << _screenWidth << "x" << _screenHeight << " frame, " << tilesCount << " tiles of "
+        << tileSize << "x" << tileSize << std::endl;
+    log << "    Bit-exact tiles: " << exactTiles << " of " << tilesCount << ", equal maximums: " << exactMaxTiles << std::endl;
+    log << "    Max relative error of tile log sums: " << maxRelativeError << std::endl;
+    log << "    GPU: average " << gpuResult.average << ", max " << gpuResult.max << std::endl;
+    log << "    CPU reduction of GPU tiles: average " << gpuTilesResult.average << ", max " << gpuTilesResult.max << std::endl;
+    log << "    CPU reference: average " << cpuResult.average << ", max " << cpuResult.max << " (" << cpuTime.count() << " ms)" << std::endl;
 }
 
 void SceneManager::FillViewProjMatrix()
@@ -1091,6 +1856,12 @@ void SceneManager::FillViewProjMatrix()
         std::memcpy(reinterpret_cast<perFrameParamsConstantBuffer*>(_cbvMRT)->cameraPosition, &eye_pos, sizeof(XMFLOAT4));
     }
 
+    MeshletBuilder::ExtractFrustumPlanes(viewProjectionMatrix, _viewFrustumPlanes);
+    {
+        auto eye_pos = _viewCamera.GetEyePosition();
+        _viewEyePosition = {eye_pos.x, eye_pos.y, eye_pos.z};
+    }
+
     XMMATRIX depthProjectionMatrix = _shadowCamera.GetViewProjMatrix();
     std::memcpy(reinterpret_cast<perFrameParamsConstantBuffer*>(_cbvDepth)->viewProjectionMatrix, depthProjectionMatrix.r, sizeof(XMMATRIX));
     {
@@ -1125,9 +1896,100 @@ void SceneManager::FillSceneProperties()
     std::memcpy(cbuffer->camPosition, &eyePosition, sizeof(XMFLOAT4));
 }
 
+void SceneManager::ProjectObjectBounds()
+{
+    _objectSpheres.resize(_objects.size());
+    _objectProjectedRadii.resize(_objects.size());
+    for (size_t i = 0; i < _objects.size(); ++i)
+        _objectSpheres[i] = _objects[i]->GetWorldBoundingSphere();
+
+    _viewCamera.GetProjectedRadii(_objectSpheres.data(), _objectSpheres.size(), _objectProjectedRadii.data());
+}
+
+void SceneManager::SelectLods()
+{
+    _objectLods.resize(_objects.size());
+    for (size_t i = 0; i < _objects.size(); ++i)
+    {
+        const auto& lods = _objects[i]->GetMeshObject()->Lods();
+
+        size_t lod = 0;
+        if (_cmdLineOpts.lods && lods.size() > 1)
+        {
+            // LOD errors are relative to the bounding sphere radius, so this is an error in pixels
+            while (lod + 1 < lods.size() && lods[lod + 1].error * _objectProjectedRadii[i] <= maxLodPixelError)
+                ++lod;
+        }
+
+        _objectLods[i] = lod;
+    }
+}
+
+void SceneManager::SelectTessellationFactors()
+{
+    float factorsSum = 0.0f;
+    for (size_t i = 0; i < _objects.size(); ++i)
+    {
+        const auto& mesh = *_objects[i]->GetMeshObject();
+        const XMFLOAT3& extent = mesh.PositionBounds().extent;
+        const float meshRadius = std::sqrt(extent.x * extent.x + extent.y * extent.y + extent.z * extent.z);
+
+        // scale of the object cancels out: projected radius already includes it
+        float edgePixels = meshRadius > 0.0f ? mesh.AverageEdgeLength() / meshRadius * _objectProjectedRadii[i] : 0.0f;
+        float factor = std::clamp(edgePixels / _tessellationEdgePixels, 1.0f, maxTessellationFactor);
+
+        // the same factor is used by shadow pass, objects close to the camera dominate both of them
+        _objects[i]->SetTessellationFactor(factor, std::max(factor / 1.5f, 1.0f));
+        factorsSum += factor;
+    }
+
+    _frameStatistics.averageTessellationFactor = _objects.empty() ? 0.0f : factorsSum / _objects.size();
+}
+
+void SceneManager::UpdateDrawData()
+{
+    _objectsDrawData.resize(_objects.size());
+    for (size_t i = 0; i < _objects.size(); ++i)
+        _objects[i]->FillDrawData(_objectsDrawData[i]);
+
+    _frameStatistics.drawDataBytes = _drawDataBinder->Update(_objectsDrawData);
+}
+
+void SceneManager::UpdateFrameStatistics()
+{
+    uint64_t geometryBytes = 0;
+    uint64_t shadowGeometryBytes = 0;
+    uint64_t shadowTriangles = 0;
+    for (size_t i = 0; i < _objects.size(); ++i)
+    {
+        const auto& mesh = *_objects[i]->GetMeshObject();
+        uint64_t positionBytes = mesh.VertexBufferView().SizeInBytes;
+        uint64_t attributeBytes = mesh.AttributeBufferView().SizeInBytes;
+        uint64_t indexSize = mesh.IndexBufferView().Format == DXGI_FORMAT_R16_UINT ? sizeof(uint16_t) : sizeof(uint32_t);
+
+        size_t shadowLod = _objectLods[i] + _cmdLineOpts.shadow_lod_bias;
+        geometryBytes += GetTrianglesCount(mesh, _objectLods[i]) * 3 * indexSize + positionBytes + attributeBytes;
+        shadowGeometryBytes += GetTrianglesCount(mesh, shadowLod) * 3 * indexSize + positionBytes + (_cmdLineOpts.tessellation ? attributeBytes : 0);
+        shadowTriangles += GetTrianglesCount(mesh, shadowLod);
+    }
+
+    if (!_cmdLineOpts.shadow_pass)
+    {
+        shadowGeometryBytes = 0;
+        shadowTriangles = 0;
+    }
+
+    _frameStatistics.shadowGeometryBytes = shadowGeometryBytes;
+    _frameStatistics.geometryBytes = geometryBytes + shadowGeometryBytes;
+    _frameStatistics.shadowTriangles = shadowTriangles;
+    _frameStatistics.triangles = _gbufferTriangles + shadowTriangles;
+    _frameStatistics.meshletsTotal = _meshletsTotal;
+    _frameStatistics.meshletsVisible = _meshletsVisible;
+}
+
 void SceneManager::CreateRootSignatures()
 {
-    CreateMRTPassRootSignature();
+    CreateMRTPassRootSignature(_MRTRootSignature, *_drawDataBinder, "MRT pass");
     CreateLightPassRootSignature();
     CreateLDRPassRootSignature();
     CreateIntensityPassRootSignature();
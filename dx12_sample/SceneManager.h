@@ -1,14 +1,21 @@
 #pragma once
 
 #include <utils/RenderTargetManager.h>
+#include <utils/ChunkedListCache.h>
 #include <utils/ComputePipelineState.h>
+#include <utils/CpuTopology.h>
+#include <utils/DrawDataBinder.h>
 #include <utils/GraphicsPipelineState.h>
 #include <utils/MeshManager.h>
+#include <utils/OrderedQueue.h>
 #include <utils/RootSignature.h>
 #include <utils/SceneObject.h>
+#include <utils/ShaderCache.h>
+#include <utils/ShaderPermutations.h>
 #include <utils/CommandList.h>
 #include <utils/Types.h>
 #include <utils/SphericalCamera.h>
+#include <utils/WaitableCounter.h>
 
 #include "stdafx.h"
 
@@ -25,7 +32,8 @@ public:
                  ComPtr<ID3D12CommandQueue> pCmdQueue,
                  ComPtr<IDXGISwapChain3> pSwapChain,
                  RenderTargetManager * rtManager,
-                 size_t objectOnSceneInRow);
+                 size_t objectOnSceneInRow,
+                 const AssetPack::Reader * pPack);
     ~SceneManager();
 
     SceneManager(const SceneManager&) = delete;
@@ -37,6 +45,7 @@ public:
 
     SceneObjectPtr CreateFilledCube();
     SceneObjectPtr CreateOpenedCube();
+    SceneObjectPtr CreateSphere();
     SceneObjectPtr CreatePlane();
 
     void DrawAll();
@@ -44,17 +53,56 @@ public:
     // only for texture creation!
     void ExecuteCommandLists(const CommandList & commandList);
 
+    const FrameStatistics& GetFrameStatistics() const;
+    // screen-space error target of tessellation: desired length of tessellated edges in pixels
+    void SetTessellationEdgePixels(float pixels);
+    float GetTessellationEdgePixels() const;
+    // minimal count of G-buffer lists in one submission with --enable_streaming_submission
+    void SetSubmissionBatchSize(size_t lists);
+    size_t GetSubmissionBatchSize() const;
+    // render threads are started again on processors selected by topology
+    void SetWorkerThreadsCount(size_t threadsCount);
+    size_t GetWorkerThreadsCount() const;
+    void DumpMeshStatistics(const std::string& fileName) const;
+    void DumpShaderStatistics(const std::string& fileName) const;
+    // CPU cost and uploaded bytes of every per-draw data mode for synthetic scenes of 1K-1M draws
+    void BenchmarkDrawData(const std::string& fileName);
+
     Graphics::SphericalCamera * GetViewCamera();
     Graphics::SphericalCamera * GetShadowCamera();
 
 private:
-    void ThreadDrawRoutine(size_t threadId);
+    void ThreadDrawRoutine(size_t threadId, uint32_t frame);
+    // previous threads are finished, new ones wait for the next frame
+    void StartWorkerThreads(size_t threadsCount, bool physicalCores, bool pinning);
+    // records objects or chunks taken from _drawObjectIndex until the frame has no more work
+    void RecordGBufferWork(size_t threadId);
     void FinishWorkerThreads();
 
+    // G-buffer recording shared by workers and cached lists
+    void BeginGBufferCommandList(CommandList& commandList);
+    // returns triangles of the draw
+    uint64_t RecordGBufferDraw(const ComPtr<ID3D12GraphicsCommandList>& pCmdList, size_t objectIndex, size_t threadId);
+    void EndGBufferCommandList(CommandList& commandList);
+
+    // G-buffer lists of object chunks are used by the cache and streaming submission
+    bool HasGBufferChunks() const;
+    // splits objects into chunks and collects ones to record, the cache keeps chunks with the same draws
+    void FindDirtyGBufferChunks();
+    void RecordGBufferChunk(size_t chunkIndex, size_t threadId);
+    void UpdateGBufferCacheStatistics();
+    // submits published prefix of chunk lists in batches, waitAll waits for the rest of chunks
+    void SubmitGBufferChunks(bool waitAll);
+
     void CreateCommandLists();
+    // one list per render thread
+    void CreateWorkerCommandLists();
     void CreateConstantBuffer(size_t bufferSize, ComPtr<ID3D12Resource> * pOutBuffer);
     void CreateFrameConstantBuffers();
-    void CreateMRTPassRootSignature();
+    void CreateMaterials();
+    void CreateMRTPassRootSignature(RootSignature& rootSignature, const DrawDataBinder& binder, const std::string& name);
+    // structured buffer of per-draw data is the last parameter of MRT root signature
+    UINT GetMRTDrawBufferParameter() const;
     void CreateLightPassRootSignature();
     void CreateDepthPassRootSignature();
     void CreateLDRPassRootSignature();
@@ -62,18 +110,41 @@ private:
     void CreateDepthPassPSO();
     void CreateLDRPassPSO();
     void CreateLightPassPSO();
-    void CreateMRTPassPSO();
+    std::unique_ptr<GraphicsPipelineState> CreateMRTPassPSO(const RootSignature& rootSignature, const DrawDataBinder& binder);
     void CreateRootSignatures();
     void CreateRenderTargets();
+    D3D12_INPUT_LAYOUT_DESC GetGeometryInputLayout(bool positionsOnly) const;
+    ComPtr<ID3DBlob> GetShader(ShaderPermutations::ShaderId shader, ShaderType stage, uint32_t features);
 
     void FillViewProjMatrix();
     void FillSceneProperties();
+    void ProjectObjectBounds();
+    void SelectLods();
+    void SelectTessellationFactors();
+    void UpdateDrawData();
+    void UpdateFrameStatistics();
+
+    // textures of the whole heap and the material table with bindless textures, nothing otherwise
+    void BindTextures(ID3D12GraphicsCommandList* pCmdList) const;
+    // descriptor table with the diffuse texture of the object, nothing with bindless textures
+    void BindMaterial(ID3D12GraphicsCommandList* pCmdList, const SceneObject& object) const;
 
     void PopulateDepthPassCommandList();
     void PopulateWorkerCommandLists();
     void PopulateClearPassCommandList();
     void PopulateLightPassCommandList();
 
+    // size of tiles or histogram between luminance passes
+    UINT64 GetLuminanceIntermediateBytes() const;
+    // copies HDR image and tiles or histogram to readback buffer
+    void RecordLuminanceCapture(ID3D12GraphicsCommandList* pCmdList, ID3D12Resource* pIntermediateBuffer);
+    // copies the result of luminance passes after them
+    void RecordLuminanceResultCapture(ID3D12GraphicsCommandList* pCmdList);
+    // fills luminance time of frame statistics from timestamps of the finished frame
+    void ReadLuminanceTime();
+    // compares captured luminance with CPU reference
+    void ValidateLuminance(const std::string& fileName);
+
     void WaitCurrentFrame();
 
     std::unique_ptr<MeshManager>                _meshManager = nullptr;
@@ -97,8 +168,12 @@ private:
     std::unique_ptr<GraphicsPipelineState>      _depthPassState = nullptr;
     std::unique_ptr<GraphicsPipelineState>      _mrtPipelineState = nullptr;
     std::unique_ptr<GraphicsPipelineState>      _lightPassState = nullptr;
+    std::unique_ptr<GraphicsPipelineState>      _lightPassFallbackState = nullptr;   // without shadows
     std::unique_ptr<GraphicsPipelineState>      _LDRPassState = nullptr;
     std::unique_ptr<ComputePipelineState>       _IntensityPassState = nullptr;
+    std::unique_ptr<ComputePipelineState>       _IntensityReducePassState = nullptr;
+    std::unique_ptr<ComputePipelineState>       _HistogramPassState = nullptr;
+    std::unique_ptr<ComputePipelineState>       _ExposurePassState = nullptr;
 
     // sync primitives
     HANDLE                                      _frameEndEvent = nullptr;
@@ -107,15 +182,57 @@ private:
     ComPtr<ID3D12Fence>                         _frameFence = nullptr;
 
     // multithreading objects
-    std::condition_variable                     _workerBeginCV {};
-    std::condition_variable                     _workerEndCV {};
+    Threading::WaitableCounter                  _workerFrame {};        // incremented to start workers
+    Threading::WaitableCounter                  _pendingWorkers {};     // workers of the frame which haven't finished
     std::atomic_bool                            _workerThreadExit = false;
-    std::atomic_size_t                          _pendingWorkers = 0;
-    std::mutex                                  _workerMutex {};
     std::atomic_uint32_t                        _drawObjectIndex = ~0x0;
+    std::atomic_size_t                          _drawWorkCount = 0;     // objects or dirty chunks
     std::vector<std::thread>                    _threadPool {};
+    Threading::CpuTopology                      _cpuTopology = Threading::CpuTopology::Query();
+
+    // cluster culling
+    XMFLOAT4                                    _viewFrustumPlanes[6] = {};
+    XMFLOAT3                                    _viewEyePosition = {};
+    std::vector<std::vector<std::pair<uint32_t, uint32_t>>> _workerVisibleRanges {};
+    std::atomic_uint64_t                        _meshletsTotal = 0;
+    std::atomic_uint64_t                        _meshletsVisible = 0;
+
+    // bounding spheres of objects and their projected radii in pixels for current frame
+    std::vector<XMFLOAT4>                       _objectSpheres {};
+    std::vector<float>                          _objectProjectedRadii {};
+
+    // LOD of every object selected for current frame
+    std::vector<size_t>                         _objectLods {};
+    float                                       _tessellationEdgePixels = 8.0f;
+    std::atomic_uint64_t                        _gbufferTriangles = 0;
+
+    // G-buffer lists of object chunks, they are kept while draws of chunks are the same (--enable_gbuffer_cache)
+    struct GBufferChunk
+    {
+        uint64_t                                    triangles = 0;
+        std::chrono::duration<double, std::milli>   recordingTime {};
+    };
+    ChunkedListCache<GBufferChunk>              _gbufferChunks {};
+    uint64_t                                    _gbufferCacheHits = 0;
+    uint64_t                                    _gbufferCacheLookups = 0;
+
+    // lists of recorded chunks are submitted in order while workers record next ones (--enable_streaming_submission)
+    Threading::OrderedQueue<ID3D12CommandList*> _gbufferSubmissionQueue {};
+    size_t                                      _gbufferSubmittedChunks = 0;
+    size_t                                      _gbufferSubmissionBatch = 4;
+    std::chrono::high_resolution_clock::time_point _gbufferRecordingStart {};
+
+    // per-draw data of all objects, written once per frame for both geometry passes
+    std::unique_ptr<DrawDataBinder>             _drawDataBinder = nullptr;
+    std::vector<perDrawData>                    _objectsDrawData {};
+
+    // objects keep indices in the material table
+    std::vector<materialData>                   _materials {};
+    ComPtr<ID3D12Resource>                      _materialsBuffer = nullptr;
+    UINT                                        _texturesDescriptorSize = 0;
 
     // root signatures
+    std::unique_ptr<RootSignatureRegistry>      _rootSignatureRegistry = nullptr;
     RootSignature                               _depthPassRootSignature;
     RootSignature                               _MRTRootSignature;
     RootSignature                               _lightRootSignature;
@@ -138,6 +255,12 @@ private:
     ComPtr<ID3D12Resource>                      _backgroundTexture;
     ComPtr<ID3D12Resource>                      _intermediateIntensityBuffer = nullptr;
     ComPtr<ID3D12Resource>                      _finalIntensityBuffer = nullptr;
+    ComPtr<ID3D12Resource>                      _luminanceHistogramBuffer = nullptr;
+    ComPtr<ID3D12Resource>                      _luminanceReadbackBuffer = nullptr;
+    ComPtr<ID3D12QueryHeap>                     _timestampQueryHeap = nullptr;
+    ComPtr<ID3D12Resource>                      _timestampReadbackBuffer = nullptr;
+    uint64_t                                    _timestampFrequency = 0;
+    D3D12_PLACED_SUBRESOURCE_FOOTPRINT          _hdrReadbackFootprint = {};
     Graphics::SphericalCamera                   _viewCamera;
     Graphics::SphericalCamera                   _shadowCamera;
     RenderTargetManager *                       _rtManager = nullptr;
@@ -150,6 +273,23 @@ private:
     std::shared_ptr<DepthStencil>               _shadowDepth;
     bool                                        _isFrameWaiting = false;
 
+    // luminance of the first frame is checked with --enable_luminance_validation
+    enum class LuminanceCapture
+    {
+        None,
+        Requested,
+        Recorded,
+        Done
+    };
+    LuminanceCapture                            _luminanceCapture = LuminanceCapture::None;
+    FrameStatistics                             _frameStatistics {};
+
+    ShaderCache                                 _shaderCache;
+    std::unique_ptr<ShaderPermutations::Table>  _shaderTable = nullptr;
+    size_t                                      _precompiledShaders = 0;
+    std::unique_ptr<PipelineStateManager>       _psoManager = nullptr;  // waits for pipelines, so destroyed before root signatures
+    std::chrono::duration<double, std::milli>   _shadersCreationTime {};
+
     void CreateIntensityPassPSO();
     void CreateIntensityPassRootSignature();
 };
@@ -18,12 +18,33 @@ int WINAPI WinMain(HINSTANCE, HINSTANCE, LPSTR, int)
 #endif
 
     const std::map<std::wstring, optTypes> argumentToString = {
+        { L"--disable_bindless_textures",     disable_bindless_textures },
         { L"--disable_bundles",               disable_bundles },
         { L"--disable_concurrency",           disable_concurrency },
+        { L"--disable_lods",                  disable_lods },
         { L"--disable_root_constants",        disable_root_constants },
         { L"--disable_textures",              disable_textures },
         { L"--disable_shadow_pass",           disable_shadow_pass },
+        { L"--disable_worker_spinning",       disable_worker_spinning },
+        { L"--enable_cluster_culling",        enable_cluster_culling},
+        { L"--enable_core_reservation",       enable_core_reservation},
+        { L"--enable_cpu_tessellation",       enable_cpu_tessellation},
+        { L"--enable_draw_data_benchmark",    enable_draw_data_benchmark},
+        { L"--enable_draw_data_buffer",       enable_draw_data_buffer},
+        { L"--enable_draw_root_constants",    enable_draw_root_constants},
+        { L"--enable_filtered_mips",          enable_filtered_mips},
+        { L"--enable_gbuffer_cache",          enable_gbuffer_cache},
+        { L"--enable_histogram_exposure",     enable_histogram_exposure},
+        { L"--enable_luminance_validation",   enable_luminance_validation},
+        { L"--enable_pack_benchmark",         enable_pack_benchmark},
+        { L"--enable_physical_core_workers",  enable_physical_core_workers},
+        { L"--enable_shadow_lod_bias",        enable_shadow_lod_bias},
+        { L"--enable_staging_benchmark",      enable_staging_benchmark},
+        { L"--enable_streaming_submission",   enable_streaming_submission},
         { L"--enable_tessellation",           enable_tessellation},
+        { L"--enable_texture_compression",    enable_texture_compression},
+        { L"--enable_thread_pinning",         enable_thread_pinning},
+        { L"--enable_vertex_packing",         enable_vertex_packing},
         { L"--legacy_swapchain",              legacy_swapchain }
     };
 
@@ -4,6 +4,10 @@
 #define WIN32_LEAN_AND_MEAN             // Exclude rarely-used stuff from Windows headers.
 #endif
 
+#ifndef NOMINMAX
+#define NOMINMAX                        // Don't break std::min and std::max.
+#endif
+
 #include <windows.h>
 #include <wrl.h>
 #include <d3d12.h>
@@ -0,0 +1,79 @@
+#include "stdafx.h"
+
+#include "Tests.h"
+
+#include <utils/AssetPack.h>
+
+namespace
+{
+using AlignedBuffer = std::unique_ptr<uint8_t, decltype(&_aligned_free)>;
+
+AlignedBuffer AllocateAligned(size_t size)
+{
+    AlignedBuffer buffer {static_cast<uint8_t*>(_aligned_malloc(size, AssetPack::dataAlignment)), &_aligned_free};
+    if (!buffer)
+        throw std::bad_alloc();
+    return buffer;
+}
+
+// entries of different sizes, none of them is multiple of the alignment
+std::string WritePack(std::vector<std::vector<uint8_t>>& contents)
+{
+    const std::string fileName = (std::filesystem::temp_directory_path() / "utils_tests_reads.pack").string();
+    AssetPack::Writer writer {fileName};
+    for (size_t i = 0; i < 3; ++i)
+    {
+        std::vector<uint8_t> data(1000 + i * 70000);
+        for (size_t j = 0; j < data.size(); ++j)
+            data[j] = (uint8_t)(j * 7 + i);
+
+        writer.AddData("entry" + std::to_string(i), AssetPack::EntryType::Raw, data.data(), data.size());
+        contents.push_back(std::move(data));
+    }
+    writer.Finish();
+    return fileName;
+}
+}
+
+TEST(AssetPack, AsyncReadsMatchMappedData)
+{
+    std::vector<std::vector<uint8_t>> contents;
+    AssetPack::Reader pack {WritePack(contents)};
+    CHECK_EQUAL(contents.size(), pack.Entries().size());
+
+    std::vector<AlignedBuffer> buffers;
+    std::vector<AssetPack::ReadRequest> requests(contents.size());
+    for (size_t i = 0; i < contents.size(); ++i)
+    {
+        buffers.push_back(AllocateAligned(AssetPack::GetAlignedSize(pack.Entries()[i])));
+        pack.ReadAsync(pack.Entries()[i], buffers[i].get(), requests[i]);
+    }
+
+    for (size_t i = 0; i < contents.size(); ++i)
+    {
+        pack.Wait(requests[i]);
+        CHECK(memcmp(buffers[i].get(), contents[i].data(), contents[i].size()) == 0);
+        CHECK(memcmp(pack.Data(pack.Entries()[i]), contents[i].data(), contents[i].size()) == 0);
+    }
+}
+
+// a request dropped by an exception doesn't leave the read writing to freed memory, the reader stays usable
+TEST(AssetPack, DestroyedRequestStopsRead)
+{
+    std::vector<std::vector<uint8_t>> contents;
+    AssetPack::Reader pack {WritePack(contents)};
+    const AssetPack::Entry& entry = pack.Entries().back();
+
+    for (size_t i = 0; i < 4; ++i)
+    {
+        AlignedBuffer buffer = AllocateAligned(AssetPack::GetAlignedSize(entry));
+        AssetPack::ReadRequest request;
+        pack.ReadAsync(entry, buffer.get(), request);
+    }
+
+    AlignedBuffer buffer = AllocateAligned(AssetPack::GetAlignedSize(entry));
+    AssetPack::ReadRequest request;
+    pack.ReadAsync(entry, buffer.get(), request);
+    pack.Wait(request);
+    CHECK(memcmp(buffer.get(), contents.back().data(), contents.back().size()) == 0);
+}
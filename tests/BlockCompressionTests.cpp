@@ -0,0 +1,214 @@
+#include "stdafx.h"
+
+#include "Tests.h"
+
+#include <utils/BlockCompression.h>
+#include <utils/TextureSynthesis.h>
+
+using namespace BlockCompression;
+
+namespace
+{
+// Reference images are generated, so they are the same on every machine. Sizes which aren't multiple
+// of 4 check padding of partial blocks.
+struct Image
+{
+    DXGI_FORMAT          format;
+    size_t               width;
+    size_t               height;
+    std::vector<uint8_t> texels;
+
+    D3D12_SUBRESOURCE_DATA Subresource() const
+    {
+        const size_t texelSize = format == DXGI_FORMAT_R32G32B32A32_FLOAT ? 16 : 4;
+        return {texels.data(), (LONG_PTR)(width * texelSize), (LONG_PTR)(width * height * texelSize)};
+    }
+};
+
+Image CreateLDRImage(size_t width, size_t height)
+{
+    Image image {DXGI_FORMAT_R8G8B8A8_UNORM, width, height, std::vector<uint8_t>(width * height * 4)};
+    for (size_t y = 0; y < height; ++y)
+    {
+        for (size_t x = 0; x < width; ++x)
+        {
+            uint8_t* texel = &image.texels[(y * width + x) * 4];
+            texel[0] = (uint8_t)(x * 255 / (width - 1));
+            texel[1] = (uint8_t)(y * 255 / (height - 1));
+            texel[2] = (uint8_t)(128 + 127 * std::sin(x * 0.2) * std::cos(y * 0.15));
+            texel[3] = (uint8_t)((x + y) * 255 / (width + height - 2));
+        }
+    }
+    return image;
+}
+
+// smooth noise with sharp edges between cells, closer to photos than gradients
+Image CreateNoiseImage(size_t width, size_t height)
+{
+    constexpr size_t cellSize = 6;
+    const size_t cellsX = width / cellSize + 2;
+    const size_t cellsY = height / cellSize + 2;
+
+    std::mt19937 generator {42};
+    std::vector<uint8_t> lattice(cellsX * cellsY * 4);
+    for (uint8_t& value : lattice)
+        value = (uint8_t)(generator() >> 24);
+
+    Image image {DXGI_FORMAT_R8G8B8A8_UNORM, width, height, std::vector<uint8_t>(width * height * 4)};
+    for (size_t y = 0; y < height; ++y)
+    {
+        for (size_t x = 0; x < width; ++x)
+        {
+            const size_t cellX = x / cellSize;
+            const size_t cellY = y / cellSize;
+            const float fx = float(x % cellSize) / cellSize;
+            const float fy = float(y % cellSize) / cellSize;
+            for (size_t c = 0; c < 4; ++c)
+            {
+                auto at = [&](size_t i, size_t j) { return (float)lattice[((cellY + j) * cellsX + cellX + i) * 4 + c]; };
+                const float top = at(0, 0) * (1.0f - fx) + at(1, 0) * fx;
+                const float bottom = at(0, 1) * (1.0f - fx) + at(1, 1) * fx;
+                image.texels[(y * width + x) * 4 + c] = (uint8_t)(top * (1.0f - fy) + bottom * fy + 0.5f);
+            }
+        }
+    }
+    return image;
+}
+
+Image CreateCheckerboardImage()
+{
+    std::vector<uint8_t> pixels;
+    std::vector<D3D12_SUBRESOURCE_DATA> mips;
+    TextureSynthesis::GenerateCheckerboard(pixels, mips, 64, 64, 1);
+
+    const uint8_t* first = static_cast<const uint8_t*>(mips[0].pData);
+    return {DXGI_FORMAT_R8G8B8A8_UNORM, 64, 64, std::vector<uint8_t>(first, first + mips[0].SlicePitch)};
+}
+
+// exponential ramp up to 16 with colored stripes, values above 1 are the point of BC6H
+Image CreateHDRImage(size_t width, size_t height)
+{
+    Image image {DXGI_FORMAT_R32G32B32A32_FLOAT, width, height, std::vector<uint8_t>(width * height * 16)};
+    float* texels = reinterpret_cast<float*>(image.texels.data());
+    for (size_t y = 0; y < height; ++y)
+    {
+        for (size_t x = 0; x < width; ++x)
+        {
+            const float intensity = std::exp2(4.0f * x / (width - 1)) - 0.9f;
+            float* texel = &texels[(y * width + x) * 4];
+            texel[0] = intensity;
+            texel[1] = intensity * (0.5f + 0.5f * std::sin(y * 0.3f));
+            texel[2] = intensity * (y % 16 < 8 ? 0.25f : 1.0f);
+            texel[3] = 1.0f;
+        }
+    }
+    return image;
+}
+
+double CompressAndMeasure(const Image& image, Format format, Preset preset)
+{
+    const D3D12_SUBRESOURCE_DATA source = image.Subresource();
+    const CompressedTexture texture = Compress(image.format, image.width, image.height, 1, &source, 1, format, preset);
+    CHECK_EQUAL(size_t(1), texture.subresources.size());
+    return MeasurePSNR(image.format, source, image.width, image.height, format, texture.subresources[0]);
+}
+
+const char* GetFormatName(Format format)
+{
+    const char* names[] = {"BC1", "BC4", "BC5", "BC6H", "BC7"};
+    return names[(size_t)format];
+}
+
+struct QualityCase
+{
+    Format format;
+    double fast;     // minimal PSNR in dB, about 1 dB below the measured one
+    double refined;
+};
+
+void CheckQuality(const Image& image, const QualityCase* cases, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        const double fast = CompressAndMeasure(image, cases[i].format, Preset::Fast);
+        const double refined = CompressAndMeasure(image, cases[i].format, Preset::Refined);
+        if (fast < cases[i].fast || refined < cases[i].refined || refined < fast)
+        {
+            std::ostringstream message;
+            message << GetFormatName(cases[i].format) << " PSNR: fast " << fast << " dB (min " << cases[i].fast << "), refined "
+                    << refined << " dB (min " << cases[i].refined << ")";
+            Tests::Fail(__FILE__, __LINE__, message.str());
+        }
+    }
+}
+}
+
+TEST(BlockCompression, GradientQuality)
+{
+    const QualityCase cases[] = {
+        {Format::BC1, 32.5, 33.5},
+        {Format::BC4, 50.0, 55.0},
+        {Format::BC5, 49.5, 52.0},
+        {Format::BC7, 34.5, 36.0},
+    };
+    CheckQuality(CreateLDRImage(61, 37), cases, std::size(cases));
+}
+
+TEST(BlockCompression, NoiseQuality)
+{
+    const QualityCase cases[] = {
+        {Format::BC1, 25.0, 26.5},
+        {Format::BC4, 37.5, 38.5},
+        {Format::BC5, 37.5, 38.5},
+        {Format::BC7, 25.5, 28.0},
+    };
+    CheckQuality(CreateNoiseImage(64, 64), cases, std::size(cases));
+}
+
+// two colors per block are stored exactly by BC4/BC5, BC1 and BC7 lose only endpoint precision
+TEST(BlockCompression, CheckerboardQuality)
+{
+    const QualityCase cases[] = {
+        {Format::BC1, 49.0, 49.0},
+        {Format::BC4, 100.0, 100.0},
+        {Format::BC5, 100.0, 100.0},
+        {Format::BC7, 56.0, 56.0},
+    };
+    CheckQuality(CreateCheckerboardImage(), cases, std::size(cases));
+}
+
+TEST(BlockCompression, HDRQuality)
+{
+    const QualityCase cases[] = {
+        {Format::BC6H, 35.0, 37.0},
+    };
+    CheckQuality(CreateHDRImage(66, 30), cases, std::size(cases));
+}
+
+BENCHMARK(BlockCompression, Throughput)
+{
+    const Image ldr = CreateNoiseImage(512, 512);
+    const Image hdr = CreateHDRImage(512, 512);
+
+    for (Format format : {Format::BC1, Format::BC4, Format::BC5, Format::BC6H, Format::BC7})
+    {
+        const Image& image = format == Format::BC6H ? hdr : ldr;
+        const D3D12_SUBRESOURCE_DATA source = image.Subresource();
+
+        for (Preset preset : {Preset::Fast, Preset::Refined})
+        {
+            // the best of several runs hides thread pool start and page faults
+            double bestTime = std::numeric_limits<double>::max();
+            for (size_t run = 0; run < 3; ++run)
+            {
+                auto start = std::chrono::high_resolution_clock::now();
+                Compress(image.format, image.width, image.height, 1, &source, 1, format, preset);
+                std::chrono::duration<double, std::micro> time = std::chrono::high_resolution_clock::now() - start;
+                bestTime = std::min(bestTime, time.count());
+            }
+
+            Tests::Log() << "    " << GetFormatName(format) << (preset == Preset::Fast ? " fast: " : " refined: ")
+                         << image.width * image.height / bestTime << " MPix/s" << std::endl;
+        }
+    }
+}
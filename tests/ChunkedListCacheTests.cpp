@@ -0,0 +1,140 @@
+#include "stdafx.h"
+
+#include "Tests.h"
+
+#include <utils/ChunkedListCache.h>
+
+namespace
+{
+struct Triangles
+{
+    uint64_t triangles = 0;
+};
+
+using Cache = ChunkedListCache<Triangles>;
+
+// items are values like a draw of SceneManager, every hashed item is counted
+struct Items
+{
+    std::vector<uint64_t>   values;
+    size_t                  hashed = 0;
+
+    uint64_t operator()(size_t index, uint64_t hash)
+    {
+        ++hashed;
+        return MeshFile::Hash(&values[index], sizeof(uint64_t), hash);
+    }
+};
+
+// records dirty chunks the way SceneManager::RecordGBufferChunk does
+void Record(Cache& cache)
+{
+    for (size_t chunkIndex : cache.Dirty())
+    {
+        cache[chunkIndex].triangles = cache[chunkIndex].itemsCount * 12;
+        cache.MarkRecorded(chunkIndex);
+    }
+}
+}
+
+TEST(ChunkedListCache, SplitsItemsEvenly)
+{
+    for (size_t itemsCount : {0, 1, 5, 7, 100})
+    {
+        for (size_t chunksCount : {1, 3, 8})
+        {
+            Items items {std::vector<uint64_t>(itemsCount, 1)};
+            Cache cache;
+            const std::vector<size_t>& dirty = cache.Update(chunksCount, itemsCount, 0, true, items);
+            CHECK_EQUAL(chunksCount, cache.Size());
+            CHECK_EQUAL(chunksCount, dirty.size());
+            CHECK_EQUAL(itemsCount, items.hashed);
+
+            // chunks follow each other and differ in size by one item at most
+            size_t nextItem = 0;
+            for (size_t i = 0; i < chunksCount; ++i)
+            {
+                CHECK_EQUAL(i, dirty[i]);
+                CHECK_EQUAL(nextItem, cache[i].firstItem);
+                CHECK(cache[i].itemsCount == itemsCount / chunksCount || cache[i].itemsCount == itemsCount / chunksCount + 1);
+                nextItem += cache[i].itemsCount;
+            }
+            CHECK_EQUAL(itemsCount, nextItem);
+        }
+    }
+}
+
+TEST(ChunkedListCache, RecordsChunksWithChangedHashes)
+{
+    const size_t itemsCount = 100;
+    const size_t chunksCount = 8;
+    Items items {std::vector<uint64_t>(itemsCount)};
+    for (size_t i = 0; i < itemsCount; ++i)
+        items.values[i] = i;
+
+    Cache cache;
+    CHECK_EQUAL(chunksCount, cache.Update(chunksCount, itemsCount, 1, true, items).size());
+    Record(cache);
+
+    // the same items reuse every list with its payload
+    CHECK(cache.Update(chunksCount, itemsCount, 1, true, items).empty());
+    for (size_t i = 0; i < chunksCount; ++i)
+    {
+        CHECK(!cache[i].dirty);
+        CHECK_EQUAL(cache[i].itemsCount * 12, cache[i].triangles);
+    }
+
+    // a changed item records its chunk only
+    items.values[50] = 1000;
+    std::vector<size_t> dirty = cache.Update(chunksCount, itemsCount, 1, true, items);
+    CHECK_EQUAL(size_t(1), dirty.size());
+    CHECK(cache[dirty[0]].firstItem <= 50 && 50 < cache[dirty[0]].firstItem + cache[dirty[0]].itemsCount);
+
+    // a list which wasn't recorded isn't reused
+    CHECK(cache.Update(chunksCount, itemsCount, 1, true, items) == dirty);
+    Record(cache);
+    CHECK(cache.Update(chunksCount, itemsCount, 1, true, items).empty());
+
+    // the state all lists depend on records everything
+    CHECK_EQUAL(chunksCount, cache.Update(chunksCount, itemsCount, 2, true, items).size());
+    Record(cache);
+
+    // moved borders record chunks of the same items too, an added chunk is recorded
+    for (size_t newChunksCount : {chunksCount, chunksCount + 1})
+    {
+        std::vector<std::pair<size_t, size_t>> ranges;
+        for (size_t i = 0; i < cache.Size(); ++i)
+            ranges.emplace_back(cache[i].firstItem, cache[i].itemsCount);
+
+        items.values.push_back(items.values.size());
+        cache.Update(newChunksCount, items.values.size(), 2, true, items);
+        for (size_t i = 0; i < newChunksCount; ++i)
+        {
+            const bool moved = i >= ranges.size() || ranges[i] != std::make_pair(cache[i].firstItem, cache[i].itemsCount);
+            CHECK_EQUAL(moved, cache[i].dirty);
+        }
+        CHECK(!cache.Dirty().empty());
+        Record(cache);
+    }
+}
+
+TEST(ChunkedListCache, RecordsEveryChunkWithoutReuse)
+{
+    Items items {std::vector<uint64_t>(20, 3)};
+    Cache cache;
+    cache.Update(4, 20, 0, true, items);
+    Record(cache);
+
+    // hashes aren't computed, and lists recorded without reuse aren't reused later without recording
+    items.hashed = 0;
+    CHECK_EQUAL(size_t(4), cache.Update(4, 20, 0, false, items).size());
+    CHECK_EQUAL(size_t(0), items.hashed);
+    CHECK_EQUAL(size_t(4), cache.Update(4, 20, 0, true, items).size());
+    Record(cache);
+
+    // lost lists are recorded again
+    cache.Clear();
+    CHECK_EQUAL(size_t(0), cache.Size());
+    CHECK(cache.Dirty().empty());
+    CHECK_EQUAL(size_t(4), cache.Update(4, 20, 0, true, items).size());
+}
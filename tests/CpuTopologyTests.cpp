@@ -0,0 +1,339 @@
+#include "stdafx.h"
+
+#include "Tests.h"
+
+#include <utils/CpuTopology.h>
+#include <utils/WaitableCounter.h>
+
+using namespace Threading;
+
+namespace
+{
+// GetLogicalProcessorInformationEx(RelationAll) output of a made-up system
+class TopologyRecords
+{
+public:
+    void AddCore(WORD group, KAFFINITY mask)
+    {
+        SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX& entry = Add(RelationProcessorCore);
+        entry.Processor.GroupCount = 1;
+        entry.Processor.GroupMask[0] = {mask, group};
+    }
+
+    void AddCache(BYTE level, PROCESSOR_CACHE_TYPE type, WORD group, KAFFINITY mask)
+    {
+        SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX& entry = Add(RelationCache);
+        entry.Cache.Level = level;
+        entry.Cache.Type = type;
+        entry.Cache.GroupMask = {mask, group};
+    }
+
+    void AddNumaNode(DWORD node, WORD group, KAFFINITY mask)
+    {
+        SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX& entry = Add(RelationNumaNode);
+        entry.NumaNode.NodeNumber = node;
+        entry.NumaNode.GroupMask = {mask, group};
+    }
+
+    CpuTopology Parse() const
+    {
+        return CpuTopology::Parse(_buffer.data(), _buffer.size());
+    }
+
+    std::vector<uint8_t>& Buffer()
+    {
+        return _buffer;
+    }
+
+private:
+    SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX& Add(LOGICAL_PROCESSOR_RELATIONSHIP relationship)
+    {
+        const size_t offset = _buffer.size();
+        _buffer.resize(offset + sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX), 0x0);
+
+        auto& entry = *reinterpret_cast<SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*>(_buffer.data() + offset);
+        entry.Relationship = relationship;
+        entry.Size = sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX);
+        return entry;
+    }
+
+    std::vector<uint8_t> _buffer;
+};
+
+// 2 NUMA nodes in 2 processor groups, 2 L3 caches per node, 2 SMT2 cores per cache: 16 logical processors.
+// Caches take every other core, so the order of cores differs from the order they are reported in.
+TopologyRecords CreateServerRecords()
+{
+    TopologyRecords records;
+    for (WORD group = 0; group < 2; ++group)
+    {
+        for (uint32_t core = 0; core < 4; ++core)
+        {
+            const KAFFINITY siblings = (KAFFINITY)0x3 << (core * 2);
+            records.AddCore(group, siblings);
+            records.AddCache(1, CacheData, group, siblings);
+            records.AddCache(1, CacheInstruction, group, siblings);
+            records.AddCache(2, CacheUnified, group, siblings);
+        }
+
+        records.AddCache(3, CacheUnified, group, 0x33);
+        records.AddCache(3, CacheUnified, group, 0xcc);
+    }
+
+    // the second node is reported first
+    records.AddNumaNode(1, 1, 0xff);
+    records.AddNumaNode(0, 0, 0xff);
+    return records;
+}
+
+bool IsSame(const LogicalProcessor& left, const LogicalProcessor& right)
+{
+    return std::tie(left.group, left.number, left.core, left.cache, left.numaNode) ==
+           std::tie(right.group, right.number, right.core, right.cache, right.numaNode);
+}
+
+size_t CountCores(const std::vector<LogicalProcessor>& processors)
+{
+    std::set<uint32_t> cores;
+    for (const LogicalProcessor& processor : processors)
+        cores.insert(processor.core);
+    return cores.size();
+}
+}
+
+TEST(CpuTopology, ParsesProcessorInformation)
+{
+    const CpuTopology topology = CreateServerRecords().Parse();
+    CHECK(topology.IsKnown());
+    CHECK_EQUAL(16u, topology.Processors().size());
+    CHECK_EQUAL(8u, topology.CoresCount());
+    CHECK_EQUAL(4u, topology.CachesCount());
+    CHECK_EQUAL(2u, topology.NumaNodesCount());
+
+    // ordered by node, last level cache and core, SMT siblings are next to each other
+    const std::vector<LogicalProcessor>& processors = topology.Processors();
+    for (size_t i = 0; i < processors.size(); ++i)
+    {
+        const LogicalProcessor& processor = processors[i];
+        CHECK_EQUAL(i / 8, (size_t)processor.numaNode);
+        CHECK_EQUAL(processor.numaNode, (uint32_t)processor.group);
+        CHECK_EQUAL(i / 4, (size_t)processor.cache);
+        CHECK_EQUAL(processor.core, processor.group * 4u + processor.number / 2u);
+    }
+
+    // the first cache of a node takes cores 0 and 2 of its group, their siblings follow them
+    const uint8_t numbers[] = {0, 1, 4, 5, 2, 3, 6, 7};
+    for (size_t i = 0; i < 8; ++i)
+    {
+        CHECK_EQUAL((int)numbers[i], (int)processors[i].number);
+        CHECK_EQUAL((int)numbers[i], (int)processors[i + 8].number);
+    }
+}
+
+TEST(CpuTopology, RejectsBrokenRecords)
+{
+    auto throws = [](TopologyRecords records, size_t size)
+    {
+        try
+        {
+            CpuTopology::Parse(records.Buffer().data(), size);
+        }
+        catch (const std::runtime_error&)
+        {
+            return true;
+        }
+        return false;
+    };
+
+    TopologyRecords records = CreateServerRecords();
+    const size_t size = records.Buffer().size();
+    CHECK(!throws(records, size));
+    CHECK(throws(records, size - 1));
+    CHECK(throws(records, 0));
+
+    // a record of zero size would loop forever
+    reinterpret_cast<SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*>(records.Buffer().data())->Size = 0;
+    CHECK(throws(records, size));
+
+    TopologyRecords cachesOnly;
+    cachesOnly.AddCache(3, CacheUnified, 0, 0xff);
+    CHECK(throws(cachesOnly, cachesOnly.Buffer().size()));
+}
+
+TEST(CpuTopology, SelectsCoresBeforeSiblings)
+{
+    const CpuTopology topology = CreateServerRecords().Parse();
+
+    const std::vector<LogicalProcessor> all = topology.SelectWorkerProcessors(false, 0);
+    CHECK_EQUAL(16u, all.size());
+    for (size_t i = 0; i < 8; ++i)
+    {
+        // the first pass goes through nodes and caches in order, one processor per core
+        CHECK_EQUAL(i / 4, (size_t)all[i].numaNode);
+        CHECK_EQUAL(i / 2, (size_t)all[i].cache);
+        CHECK_EQUAL(all[i].core, all[i + 8].core);
+        CHECK(all[i].number != all[i + 8].number);
+    }
+    CHECK_EQUAL(8u, CountCores({all.begin(), all.begin() + 8}));
+
+    const std::vector<LogicalProcessor> physical = topology.SelectWorkerProcessors(true, 0);
+    CHECK_EQUAL(8u, physical.size());
+    CHECK(std::equal(physical.begin(), physical.end(), all.begin(), IsSame));
+}
+
+TEST(CpuTopology, ReservesFirstCores)
+{
+    const CpuTopology topology = CreateServerRecords().Parse();
+    const std::vector<LogicalProcessor> all = topology.SelectWorkerProcessors(false, 0);
+
+    // both siblings of the first two cores are left to the main and I/O threads
+    const std::vector<LogicalProcessor> reserved = topology.SelectWorkerProcessors(false, 2);
+    CHECK_EQUAL(12u, reserved.size());
+    CHECK_EQUAL(6u, CountCores(reserved));
+    for (const LogicalProcessor& processor : reserved)
+    {
+        CHECK(processor.core != all[0].core);
+        CHECK(processor.core != all[1].core);
+    }
+
+    const std::vector<LogicalProcessor> physical = topology.SelectWorkerProcessors(true, 2);
+    CHECK_EQUAL(6u, physical.size());
+    CHECK(std::equal(physical.begin(), physical.end(), all.begin() + 2, IsSame));
+
+    // at least one core is kept for workers
+    CHECK_EQUAL(2u, topology.SelectWorkerProcessors(false, 100).size());
+    CHECK_EQUAL(1u, topology.SelectWorkerProcessors(true, 100).size());
+    CHECK(IsSame(all[7], topology.SelectWorkerProcessors(true, 100)[0]));
+
+    // a single core system has nothing to reserve
+    TopologyRecords single;
+    single.AddCore(0, 0x3);
+    CHECK_EQUAL(2u, single.Parse().SelectWorkerProcessors(false, 2).size());
+}
+
+TEST(CpuTopology, WrapsMoreWorkersThanProcessors)
+{
+    const CpuTopology topology = CreateServerRecords().Parse();
+    for (bool physicalCoresOnly : {false, true})
+    {
+        const std::vector<LogicalProcessor> selected = topology.SelectWorkerProcessors(physicalCoresOnly, 2);
+        const std::vector<LogicalProcessor> assigned = topology.AssignWorkerProcessors(selected.size() * 2 + 3, physicalCoresOnly, 2);
+
+        CHECK_EQUAL(selected.size() * 2 + 3, assigned.size());
+        for (size_t worker = 0; worker < assigned.size(); ++worker)
+            CHECK(IsSame(selected[worker % selected.size()], assigned[worker]));
+
+        // fewer workers take the first ones
+        const std::vector<LogicalProcessor> few = topology.AssignWorkerProcessors(3, physicalCoresOnly, 2);
+        CHECK_EQUAL(3u, few.size());
+        CHECK(std::equal(few.begin(), few.end(), selected.begin(), IsSame));
+    }
+
+    // the fallback of Query when the OS doesn't report the topology, a core per processor
+    std::vector<LogicalProcessor> processors(4);
+    for (uint32_t i = 0; i < 4; ++i)
+        processors[i].core = i;
+
+    const CpuTopology unknown {processors, false};
+    CHECK(!unknown.IsKnown());
+    const std::vector<LogicalProcessor> assigned = unknown.AssignWorkerProcessors(7, true, 1);
+    CHECK_EQUAL(7u, assigned.size());
+    CHECK_EQUAL(1u, assigned[0].core);
+    CHECK_EQUAL(1u, assigned[3].core);
+    CHECK_EQUAL(3u, assigned[5].core);
+    CHECK_EQUAL(1u, assigned[6].core);
+}
+
+// Frame loop of render threads over a CPU-bound share of draws: every draw transforms its bounds and writes
+// commands to the list of the worker, like G-buffer recording does. Average frame time of 1 to all selected
+// processors with unpinned threads, threads pinned to logical processors and to physical cores.
+BENCHMARK(CpuTopology, WorkerPlacement)
+{
+    const CpuTopology topology = CpuTopology::Query();
+    Tests::Log() << "    " << topology.Describe() << std::endl;
+
+    constexpr size_t drawsCount = 16384;
+    constexpr size_t commandBytes = 64;
+    constexpr size_t framesCount = 50;
+
+    std::vector<XMFLOAT4X4> transforms(drawsCount);
+    for (size_t i = 0; i < drawsCount; ++i)
+        XMStoreFloat4x4(&transforms[i], XMMatrixTranslation((float)i, 0.0f, 1.0f));
+
+    struct Placement
+    {
+        const char* name;
+        bool        physicalCores;
+        bool        pinning;
+    };
+    const Placement placements[] = {
+        {"unpinned", false, false}, {"pinned to logical processors", false, true}, {"pinned to physical cores", true, true}
+    };
+
+    for (const Placement& placement : placements)
+    {
+        if (placement.pinning && !topology.IsKnown())
+            continue;
+
+        const size_t processorsCount = topology.SelectWorkerProcessors(placement.physicalCores, 0).size();
+        Tests::Log() << "    " << placement.name << ":" << std::endl;
+        for (size_t count = 1; ; count = std::min(count * 2, processorsCount))
+        {
+            WaitableCounter frame;
+            WaitableCounter pending;
+            std::atomic_size_t nextDraw = 0;
+            std::atomic_bool exit = false;
+
+            auto worker = [&]()
+            {
+                std::vector<uint8_t> commands;
+                for (uint32_t current = frame.WaitWhileEqual(0, 4096); !exit; current = frame.WaitWhileEqual(current, 4096))
+                {
+                    commands.clear();
+                    for (size_t draw = nextDraw++; draw < drawsCount; draw = nextDraw++)
+                    {
+                        XMFLOAT4 bounds;
+                        XMStoreFloat4(&bounds, XMVector3TransformCoord(XMVectorSet(1.0f, 1.0f, 1.0f, 1.0f), XMLoadFloat4x4(&transforms[draw])));
+                        commands.resize(commands.size() + commandBytes);
+                        std::memcpy(commands.data() + commands.size() - commandBytes, &bounds, sizeof(bounds));
+                    }
+                    pending.Decrement();
+                }
+            };
+
+            const std::vector<LogicalProcessor> processors = topology.AssignWorkerProcessors(count, placement.physicalCores, 0);
+            std::vector<std::thread> threads;
+            for (size_t i = 0; i < count; ++i)
+            {
+                threads.emplace_back(worker);
+                if (placement.pinning)
+                    PinThread(threads.back(), processors[i]);
+            }
+
+            auto runFrame = [&]()
+            {
+                nextDraw = 0;
+                pending.Store((uint32_t)count);
+                frame.Increment();
+                pending.WaitZero(4096);
+            };
+
+            // the first frame wakes new threads up and grows their lists
+            runFrame();
+
+            auto start = std::chrono::high_resolution_clock::now();
+            for (size_t i = 0; i < framesCount; ++i)
+                runFrame();
+            std::chrono::duration<double, std::milli> frameTime = (std::chrono::high_resolution_clock::now() - start) / framesCount;
+
+            exit = true;
+            frame.Increment();
+            for (auto& thread : threads)
+                thread.join();
+
+            Tests::Log() << "        " << count << " threads: " << frameTime.count() << " ms" << std::endl;
+            if (count == processorsCount)
+                break;
+        }
+    }
+}
@@ -0,0 +1,140 @@
+#include "stdafx.h"
+
+#include "Tests.h"
+
+#include <utils/DrawDataBinder.h>
+
+namespace
+{
+// affine world matrix with distinct values, the last column is (0, 0, 0, 1)
+XMFLOAT4X4 CreateWorldMatrix()
+{
+    XMFLOAT4X4 world;
+    for (size_t row = 0; row < 4; ++row)
+    {
+        for (size_t column = 0; column < 3; ++column)
+            world.m[row][column] = 1.0f + row * 3 + column;
+        world.m[row][3] = row == 3 ? 1.0f : 0.0f;
+    }
+    return world;
+}
+
+// the way SceneObject::FillDrawData stores the matrix: transposed, without the last row
+perDrawData CreateDrawData(const XMFLOAT4X4& world, uint32_t material)
+{
+    XMFLOAT4X4 transposed;
+    XMStoreFloat4x4(&transposed, XMMatrixTranspose(XMLoadFloat4x4(&world)));
+
+    perDrawData data = {};
+    memcpy(data.worldMatrix, &transposed, sizeof(data.worldMatrix));
+    data.positionScale[0] = 0.5f;
+    data.positionScale[1] = 2.0f;
+    data.positionScale[2] = 4.0f;
+    data.tessellationEdges = 7.0f;
+    data.positionOffset[0] = -1.0f;
+    data.positionOffset[1] = 0.25f;
+    data.positionOffset[2] = 3.0f;
+    data.tessellationInside = 5.0f;
+    data.material = material;
+    return data;
+}
+
+const DrawDataMode modes[] = {DrawDataMode::ConstantBuffer, DrawDataMode::RootConstants, DrawDataMode::StructuredBuffer};
+}
+
+// constant buffers get the whole matrix and vectors with zero w, like SceneObject wrote them before per-draw data
+TEST(DrawDataBinder, ConstantBufferRestoresWorldMatrix)
+{
+    const XMFLOAT4X4 world = CreateWorldMatrix();
+    perModelParamsConstantBuffer buffer;
+    memset(&buffer, 0xcd, sizeof(buffer));
+    DrawDataBinder::FillConstantBuffer(CreateDrawData(world, 9), buffer);
+
+    for (size_t row = 0; row < 4; ++row)
+    {
+        for (size_t column = 0; column < 4; ++column)
+            CHECK_EQUAL(world.m[row][column], buffer.worldMatrix[row][column]);
+    }
+
+    const float positionScale[] = {0.5f, 2.0f, 4.0f, 0.0f};
+    const float positionOffset[] = {-1.0f, 0.25f, 3.0f, 0.0f};
+    for (size_t i = 0; i < 4; ++i)
+    {
+        CHECK_EQUAL(positionScale[i], buffer.positionScale[i]);
+        CHECK_EQUAL(positionOffset[i], buffer.positionOffset[i]);
+    }
+
+    CHECK_EQUAL(7.0f, buffer.tessellationFactor[0]);
+    CHECK_EQUAL(5.0f, buffer.tessellationFactor[1]);
+    CHECK_EQUAL(9u, buffer.material);
+    CHECK_EQUAL(0.0f, buffer.padding);
+}
+
+// the binder is created on WARP device, the sandbox without D3D12 runtime only reports that the test was skipped
+TEST(DrawDataBinder, ModesDescribeRootArgumentsAndUploads)
+{
+    ComPtr<ID3D12Device> device = Tests::CreateWarpDevice();
+    if (!device)
+    {
+        Tests::Log() << "    WARP device isn't available, the binder isn't checked" << std::endl;
+        return;
+    }
+
+    const size_t drawsCount = 100;
+    const std::vector<perDrawData> drawData(drawsCount, CreateDrawData(CreateWorldMatrix(), 1));
+
+    for (DrawDataMode mode : modes)
+    {
+        DrawDataBinder binder {device, mode};
+        CHECK(binder.Mode() == mode);
+        Tests::Log() << "    " << DrawDataBinder::GetModeName(mode) << std::endl;
+
+        RootParameter drawParameter;
+        RootParameter bufferParameter;
+        binder.InitRootParameters(drawParameter, &bufferParameter);
+        const D3D12_ROOT_PARAMETER& draw = drawParameter;
+        const D3D12_ROOT_PARAMETER& buffer = bufferParameter;
+
+        const uint64_t uploaded = binder.Update(drawData);
+        const D3D12_GPU_VIRTUAL_ADDRESS address = binder.GetBufferAddress();
+
+        switch (mode)
+        {
+        case DrawDataMode::ConstantBuffer:
+            CHECK_EQUAL((int)D3D12_ROOT_PARAMETER_TYPE_CBV, (int)draw.ParameterType);
+            CHECK_EQUAL(0u, draw.Descriptor.ShaderRegister);
+            CHECK(!binder.HasBufferParameter());
+            CHECK_EQUAL(sizeof(D3D12_GPU_VIRTUAL_ADDRESS), binder.GetRootArgumentsSize());
+            CHECK_EQUAL(drawsCount * sizeof(perModelParamsConstantBuffer), uploaded);
+            CHECK(address && address % D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT == 0);
+            break;
+        case DrawDataMode::RootConstants:
+            // 21 values are declared as 6 registers
+            CHECK_EQUAL((int)D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS, (int)draw.ParameterType);
+            CHECK_EQUAL(24u, draw.Constants.Num32BitValues);
+            CHECK_EQUAL(0u, draw.Constants.ShaderRegister);
+            CHECK(!binder.HasBufferParameter());
+            CHECK_EQUAL(sizeof(perDrawData), binder.GetRootArgumentsSize());
+            CHECK_EQUAL(0u, uploaded);
+            CHECK_EQUAL(0u, address);
+            break;
+        case DrawDataMode::StructuredBuffer:
+            CHECK_EQUAL((int)D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS, (int)draw.ParameterType);
+            CHECK_EQUAL(1u, draw.Constants.Num32BitValues);
+            CHECK_EQUAL(0u, draw.Constants.ShaderRegister);
+            CHECK_EQUAL((int)D3D12_ROOT_PARAMETER_TYPE_SRV, (int)buffer.ParameterType);
+            CHECK_EQUAL(1u, buffer.Descriptor.ShaderRegister);
+            CHECK(binder.HasBufferParameter());
+            CHECK_EQUAL(sizeof(uint32_t), binder.GetRootArgumentsSize());
+            CHECK_EQUAL(drawsCount * sizeof(perDrawData), uploaded);
+            CHECK(address);
+            break;
+        }
+
+        // fewer draws fit the buffer, more draws grow it
+        CHECK_EQUAL(uploaded / 2, binder.Update({drawData.begin(), drawData.begin() + drawsCount / 2}));
+        CHECK_EQUAL(address, binder.GetBufferAddress());
+        CHECK_EQUAL(uploaded / drawsCount * (drawsCount + 1), binder.Update(std::vector<perDrawData>(drawsCount + 1, drawData[0])));
+        CHECK(!binder.GetBufferAddress() == !address);
+    }
+}
@@ -0,0 +1,125 @@
+#include "stdafx.h"
+
+#include "Tests.h"
+
+#include <utils/LuminanceHistogram.h>
+
+using namespace LuminanceHistogram;
+
+namespace
+{
+// gray 2x2 blocks, so every texel of the downsampled image has the luminance of its block
+LuminanceHistogram::Histogram BuildFromBlocks(const std::vector<float>& luminances)
+{
+    const uint32_t width = (uint32_t)luminances.size() * downsampling;
+    const uint32_t height = downsampling;
+    std::vector<float> texels(width * height * 4);
+    for (uint32_t y = 0; y < height; ++y)
+    {
+        for (uint32_t x = 0; x < width; ++x)
+        {
+            float* texel = texels.data() + (y * width + x) * 4;
+            texel[0] = texel[1] = texel[2] = luminances[x / downsampling];
+            texel[3] = 1.0f;
+        }
+    }
+    return Build(texels.data(), width, height, width * 4 * sizeof(float));
+}
+
+uint32_t GetBin(float luminance)
+{
+    const LuminanceHistogram::Histogram histogram = BuildFromBlocks({luminance});
+    return (uint32_t)(std::find(histogram.begin(), histogram.end(), 1u) - histogram.begin());
+}
+
+// log2 luminance of the bin center, bins 1..126 split [-10; 2] evenly
+float BinCenter(uint32_t bin)
+{
+    return -10.0f + (bin - 0.5f) * 12.0f / 126.0f;
+}
+
+// far from rounding errors of the luminance and the logarithm, a bin is 0.095 wide
+constexpr float edgeOffset = 0.01f;
+}
+
+TEST(LuminanceHistogram, BinsAtRangeEdges)
+{
+    CHECK_EQUAL(0u, GetBin(std::exp2(-10.0f - edgeOffset)));
+    CHECK_EQUAL(1u, GetBin(std::exp2(-10.0f + edgeOffset)));
+    CHECK_EQUAL(126u, GetBin(std::exp2(2.0f - edgeOffset)));
+    CHECK_EQUAL(127u, GetBin(std::exp2(2.0f + edgeOffset)));
+    CHECK_EQUAL(127u, GetBin(1e30f));
+
+    for (uint32_t bin = 1; bin < binsCount - 1; ++bin)
+        CHECK_EQUAL(bin, GetBin(std::exp2(BinCenter(bin))));
+}
+
+// HLSL saturate turns NaN into 0, so it is counted in the first bin of the range
+TEST(LuminanceHistogram, ClampsInvalidLuminance)
+{
+    CHECK_EQUAL(0u, GetBin(0.0f));
+    CHECK_EQUAL(0u, GetBin(-1.0f));
+    CHECK_EQUAL(1u, GetBin(std::numeric_limits<float>::quiet_NaN()));
+    CHECK_EQUAL(127u, GetBin(std::numeric_limits<float>::infinity()));
+
+    // every texel is counted once, the vector path handles partial groups of four
+    const LuminanceHistogram::Histogram histogram = BuildFromBlocks({0.0f, std::numeric_limits<float>::quiet_NaN(), 1.0f, 0.25f, 0.0f});
+    CHECK_EQUAL(binsCount, (uint32_t)histogram.size());
+    CHECK_EQUAL(2u, histogram[0]);
+    CHECK_EQUAL(1u, histogram[1]);
+    CHECK_EQUAL(5u, std::accumulate(histogram.begin(), histogram.end(), 0u));
+}
+
+// odd sizes average the last row and column with themselves
+TEST(LuminanceHistogram, DownsamplesOddSizes)
+{
+    const float dark = std::exp2(BinCenter(20));
+    const float bright = std::exp2(BinCenter(100));
+    const float texels[] = {
+        dark, dark, dark, 1.0f,   dark, dark, dark, 1.0f,   bright, bright, bright, 1.0f,
+    };
+
+    const LuminanceHistogram::Histogram histogram = Build(texels, 3, 1, sizeof(texels));
+    CHECK_EQUAL(2u, std::accumulate(histogram.begin(), histogram.end(), 0u));
+    CHECK_EQUAL(1u, histogram[20]);
+    CHECK_EQUAL(1u, histogram[100]);
+}
+
+TEST(LuminanceHistogram, ExposureOfHandComputedHistograms)
+{
+    // a single bin is both the average and the white point
+    LuminanceHistogram::Histogram histogram(binsCount, 0);
+    histogram[100] = 1000;
+    LuminanceReduction::Luminance exposure = ComputeExposure(histogram);
+    CHECK_NEAR(std::exp2(BinCenter(100)), exposure.average, 1e-5);
+    CHECK_NEAR(std::exp2(BinCenter(100)), exposure.max, 1e-5);
+
+    // texels below the 50th percentile are clipped: 30 of bin 60 and 15 of bin 90 remain, bin 90 is the white point
+    histogram.assign(binsCount, 0);
+    histogram[20] = 40;
+    histogram[60] = 40;
+    histogram[90] = 20;
+    exposure = ComputeExposure(histogram);
+    CHECK_NEAR(std::exp2((30.0 * BinCenter(60) + 15.0 * BinCenter(90)) / 45.0), exposure.average, 1e-5);
+    CHECK_EQUAL(LuminanceReduction::minMaxLuminance, exposure.max);
+
+    // texels above the 95th percentile are clipped too, the white point is the bin where it falls
+    histogram.assign(binsCount, 0);
+    histogram[0] = 50;
+    histogram[105] = 45;
+    histogram[127] = 5;
+    exposure = ComputeExposure(histogram);
+    CHECK_NEAR(std::exp2(BinCenter(105)), exposure.average, 1e-5);
+    CHECK_NEAR(std::exp2(BinCenter(105)), exposure.max, 1e-5);
+
+    // bright white point is clamped from above
+    histogram.assign(binsCount, 0);
+    histogram[126] = 10;
+    CHECK_EQUAL(LuminanceReduction::maxMaxLuminance, ComputeExposure(histogram).max);
+
+    // an empty histogram stays finite
+    histogram.assign(binsCount, 0);
+    exposure = ComputeExposure(histogram);
+    CHECK_EQUAL(1.0f, exposure.average);
+    CHECK_EQUAL(LuminanceReduction::minMaxLuminance, exposure.max);
+}
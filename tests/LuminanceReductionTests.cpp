@@ -0,0 +1,166 @@
+#include "stdafx.h"
+
+#include "Tests.h"
+
+#include <utils/LuminanceReduction.h>
+
+using namespace LuminanceReduction;
+
+namespace
+{
+struct Image
+{
+    uint32_t            width;
+    uint32_t            height;
+    size_t              rowPitch;
+    std::vector<float>  texels;
+
+    const float* Texel(uint32_t x, uint32_t y) const
+    {
+        return texels.data() + y * rowPitch / sizeof(float) + x * 4;
+    }
+};
+
+// HDR values over several orders of magnitude, rows are padded like in readback buffers
+Image CreateImage(uint32_t width, uint32_t height)
+{
+    Image image {width, height, (width * 4 * sizeof(float) + 255) / 256 * 256};
+    image.texels.resize(image.rowPitch / sizeof(float) * height);
+
+    std::mt19937 generator {width * 31 + height};
+    std::uniform_real_distribution<float> exponent {-6.0f, 3.0f};
+    for (float& value : image.texels)
+        value = std::exp2(exponent(generator));
+    return image;
+}
+
+// Threads of IntensityPass.hlsl one by one: a group per tile, groupshared arrays, halving strides
+std::vector<Luminance> SimulateTilePass(const Image& image)
+{
+    const uint32_t tilesInRow = (image.width + tileSize - 1) / tileSize;
+    const uint32_t tilesInColumn = (image.height + tileSize - 1) / tileSize;
+    std::vector<Luminance> tiles(tilesInRow * tilesInColumn);
+
+    for (uint32_t groupY = 0; groupY < tilesInColumn; ++groupY)
+    {
+        for (uint32_t groupX = 0; groupX < tilesInRow; ++groupX)
+        {
+            float tileLogLuminance[tileSize * tileSize];
+            float tileMaxLuminance[tileSize * tileSize];
+            for (uint32_t groupIndex = 0; groupIndex < tileSize * tileSize; ++groupIndex)
+            {
+                const uint32_t x = groupX * tileSize + groupIndex % tileSize;
+                const uint32_t y = groupY * tileSize + groupIndex / tileSize;
+
+                float logLuminance = 0.0f;
+                float maxLuminance = 0.0f;
+                if (x < image.width && y < image.height)
+                {
+                    const float* rgb = image.Texel(x, y);
+                    const float luminance = 0.2126f * rgb[0] + 0.7152f * rgb[1] + 0.0722f * rgb[2];
+                    logLuminance = std::log(0.001f + luminance);
+                    maxLuminance = luminance;
+                }
+                tileLogLuminance[groupIndex] = logLuminance;
+                tileMaxLuminance[groupIndex] = maxLuminance;
+            }
+
+            for (uint32_t stride = tileSize * tileSize / 2; stride > 0; stride >>= 1)
+            {
+                for (uint32_t groupIndex = 0; groupIndex < stride; ++groupIndex)
+                {
+                    tileLogLuminance[groupIndex] += tileLogLuminance[groupIndex + stride];
+                    tileMaxLuminance[groupIndex] = std::max(tileMaxLuminance[groupIndex], tileMaxLuminance[groupIndex + stride]);
+                }
+            }
+
+            tiles[groupY * tilesInRow + groupX] = {tileLogLuminance[0], tileMaxLuminance[0]};
+        }
+    }
+    return tiles;
+}
+
+// Threads of IntensityReducePass.hlsl one by one
+Luminance SimulateReducePass(const std::vector<Luminance>& tiles, uint32_t width, uint32_t height)
+{
+    float logLuminance[reduceGroupSize];
+    float maxLuminance[reduceGroupSize];
+    for (uint32_t groupIndex = 0; groupIndex < reduceGroupSize; ++groupIndex)
+    {
+        float threadLogLuminance = 0.0f;
+        float threadMaxLuminance = 0.0f;
+        for (size_t i = groupIndex; i < tiles.size(); i += reduceGroupSize)
+        {
+            threadLogLuminance += tiles[i].average;
+            threadMaxLuminance = std::max(threadMaxLuminance, tiles[i].max);
+        }
+        logLuminance[groupIndex] = threadLogLuminance;
+        maxLuminance[groupIndex] = threadMaxLuminance;
+    }
+
+    for (uint32_t stride = reduceGroupSize / 2; stride > 0; stride >>= 1)
+    {
+        for (uint32_t groupIndex = 0; groupIndex < stride; ++groupIndex)
+        {
+            logLuminance[groupIndex] += logLuminance[groupIndex + stride];
+            maxLuminance[groupIndex] = std::max(maxLuminance[groupIndex], maxLuminance[groupIndex + stride]);
+        }
+    }
+
+    return {std::exp(logLuminance[0] / (float)(width * height)), std::clamp(maxLuminance[0], 0.4f, 1.2f)};
+}
+
+bool BitwiseEqual(float expected, float actual)
+{
+    return memcmp(&expected, &actual, sizeof(float)) == 0;
+}
+}
+
+// sizes cover partial tiles, tiles count below, equal to and above the group size of the second pass
+TEST(LuminanceReduction, MatchesShaderSimulation)
+{
+    const uint32_t sizes[][2] = {{1, 1}, {15, 16}, {17, 33}, {100, 7}, {256, 256}, {257, 255}, {250, 130}, {1920, 1080}};
+    for (const auto& size : sizes)
+    {
+        const Image image = CreateImage(size[0], size[1]);
+
+        const std::vector<Luminance> expectedTiles = SimulateTilePass(image);
+        const std::vector<Luminance> tiles = ReduceTiles(image.texels.data(), image.width, image.height, image.rowPitch);
+        CHECK_EQUAL(GetTilesCount(image.width, image.height), tiles.size());
+        CHECK_EQUAL(expectedTiles.size(), tiles.size());
+        for (size_t i = 0; i < tiles.size(); ++i)
+        {
+            CHECK(BitwiseEqual(expectedTiles[i].average, tiles[i].average));
+            CHECK(BitwiseEqual(expectedTiles[i].max, tiles[i].max));
+        }
+
+        const Luminance expected = SimulateReducePass(expectedTiles, image.width, image.height);
+        const Luminance result = ReduceImage(tiles, image.width, image.height);
+        CHECK(BitwiseEqual(expected.average, result.average));
+        CHECK(BitwiseEqual(expected.max, result.max));
+    }
+}
+
+// sums in tree order differ from sequential ones, but both approximate the mean
+TEST(LuminanceReduction, AverageIsGeometricMean)
+{
+    Image image = CreateImage(67, 45);
+    double logSum = 0.0;
+    float maxLuminance = 0.0f;
+    for (uint32_t y = 0; y < image.height; ++y)
+    {
+        for (uint32_t x = 0; x < image.width; ++x)
+        {
+            const float* rgb = image.Texel(x, y);
+            const double luminance = 0.2126 * rgb[0] + 0.7152 * rgb[1] + 0.0722 * rgb[2];
+            logSum += std::log(0.001 + luminance);
+            maxLuminance = std::max(maxLuminance, (float)luminance);
+        }
+    }
+
+    const Luminance result = ReduceImage(ReduceTiles(image.texels.data(), image.width, image.height, image.rowPitch),
+                                         image.width, image.height);
+    const double average = std::exp(logSum / (image.width * image.height));
+    CHECK_NEAR(average, result.average, average * 1e-4);
+    CHECK_EQUAL(std::clamp(maxLuminance, minMaxLuminance, maxMaxLuminance), result.max);
+}
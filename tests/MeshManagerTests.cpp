@@ -0,0 +1,77 @@
+#include "stdafx.h"
+
+#include "Tests.h"
+
+#include <utils/MeshManager.h>
+
+namespace
+{
+uint64_t GetUploadedBytes(const MeshObject& mesh)
+{
+    return mesh.VertexBufferView().SizeInBytes + mesh.AttributeBufferView().SizeInBytes + mesh.IndexBufferView().SizeInBytes;
+}
+}
+
+// meshes are uploaded to WARP device, the sandbox without D3D12 runtime only reports that tests were skipped
+TEST(MeshManager, SharesIdenticalMeshes)
+{
+    ComPtr<ID3D12Device> device = Tests::CreateWarpDevice();
+    if (!device)
+    {
+        Tests::Log() << "    WARP device isn't available, the cache isn't checked" << std::endl;
+        return;
+    }
+
+    MeshManager manager {false, false, false, device};
+    const std::shared_ptr<MeshObject> cube = manager.CreateCube();
+    const std::shared_ptr<MeshObject> plane = manager.CreatePlane();
+    const std::shared_ptr<MeshObject> quad = manager.CreateScreenQuad();
+    CHECK(cube != plane);
+    CHECK_EQUAL(3u, manager.CacheStatistics().requests);
+    CHECK_EQUAL(0u, manager.CacheStatistics().hits);
+
+    CHECK(cube == manager.CreateCube());
+    CHECK(plane == manager.CreatePlane());
+    CHECK(quad == manager.CreateScreenQuad());
+    CHECK_EQUAL(6u, manager.CacheStatistics().requests);
+    CHECK_EQUAL(3u, manager.CacheStatistics().hits);
+    CHECK_EQUAL(GetUploadedBytes(*cube) + GetUploadedBytes(*plane) + GetUploadedBytes(*quad), manager.CacheStatistics().bytesSaved);
+
+    // the empty cube has the same vertices and different indices
+    const std::shared_ptr<MeshObject> emptyCube = manager.CreateEmptyCube();
+    CHECK(emptyCube != cube);
+    CHECK_EQUAL(3u, manager.CacheStatistics().hits);
+
+    // another vertex format is another cache
+    MeshManager packedManager {false, false, true, device};
+    CHECK(packedManager.CreateCube() != cube);
+    CHECK_EQUAL(0u, packedManager.CacheStatistics().hits);
+}
+
+TEST(MeshManager, EvictsReleasedMeshes)
+{
+    ComPtr<ID3D12Device> device = Tests::CreateWarpDevice();
+    if (!device)
+    {
+        Tests::Log() << "    WARP device isn't available, the cache isn't checked" << std::endl;
+        return;
+    }
+
+    MeshManager manager {false, false, false, device};
+    std::shared_ptr<MeshObject> cube = manager.CreateCube();
+    const std::weak_ptr<MeshObject> released = cube;
+    cube.reset();
+    CHECK(released.expired());
+
+    // a released mesh isn't returned, it's created again and the expired entry is removed before adding one
+    cube = manager.CreateCube();
+    CHECK_EQUAL(0u, manager.CacheStatistics().hits);
+    CHECK_EQUAL(1u, manager.CacheStatistics().evictions);
+
+    // meshes still in use stay cached
+    const std::shared_ptr<MeshObject> plane = manager.CreatePlane();
+    CHECK_EQUAL(1u, manager.CacheStatistics().evictions);
+    CHECK(cube == manager.CreateCube());
+    CHECK(plane == manager.CreatePlane());
+    CHECK_EQUAL(2u, manager.CacheStatistics().hits);
+}
@@ -0,0 +1,218 @@
+#include "stdafx.h"
+
+#include "Tests.h"
+
+#include <utils/MeshOptimizer.h>
+
+namespace
+{
+struct Vertex
+{
+    float position[3];
+    float uv[2];
+};
+
+struct Mesh
+{
+    std::vector<uint8_t>  vertexData;
+    std::vector<uint32_t> indices;
+
+    size_t VerticesCount() const
+    {
+        return vertexData.size() / sizeof(Vertex);
+    }
+
+    size_t UsedVerticesCount() const
+    {
+        return std::set<uint32_t>(indices.begin(), indices.end()).size();
+    }
+};
+
+// Closed UV sphere, seam and pole vertices differ by UV, so all vertices are unique, two pole vertices
+// aren't used. Triangles are shuffled to look like an exported mesh without any cache optimizations.
+Mesh CreateSphere(uint32_t rings, uint32_t segments)
+{
+    std::vector<Vertex> vertices;
+    for (uint32_t ring = 0; ring <= rings; ++ring)
+    {
+        const float theta = 3.14159265f * ring / rings;
+        for (uint32_t segment = 0; segment <= segments; ++segment)
+        {
+            const float phi = 2.0f * 3.14159265f * segment / segments;
+            vertices.push_back({{std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi)},
+                                {(float)segment / segments, (float)ring / rings}});
+        }
+    }
+
+    std::vector<std::array<uint32_t, 3>> triangles;
+    for (uint32_t ring = 0; ring < rings; ++ring)
+    {
+        for (uint32_t segment = 0; segment < segments; ++segment)
+        {
+            const uint32_t a = ring * (segments + 1) + segment;
+            const uint32_t b = a + segments + 1;
+            if (ring != 0)
+                triangles.push_back({a, a + 1, b});
+            if (ring != rings - 1)
+                triangles.push_back({a + 1, b + 1, b});
+        }
+    }
+
+    std::mt19937 generator {5};
+    std::shuffle(triangles.begin(), triangles.end(), generator);
+
+    Mesh mesh;
+    mesh.vertexData.resize(vertices.size() * sizeof(Vertex));
+    memcpy(mesh.vertexData.data(), vertices.data(), mesh.vertexData.size());
+    for (const auto& triangle : triangles)
+        mesh.indices.insert(mesh.indices.end(), triangle.begin(), triangle.end());
+    return mesh;
+}
+
+// every triangle has own vertices, like meshes loaded without an index buffer
+Mesh CreateTriangleSoup(const Mesh& mesh)
+{
+    Mesh soup;
+    for (uint32_t index : mesh.indices)
+    {
+        const uint8_t* vertex = mesh.vertexData.data() + index * sizeof(Vertex);
+        soup.indices.push_back((uint32_t)soup.VerticesCount());
+        soup.vertexData.insert(soup.vertexData.end(), vertex, vertex + sizeof(Vertex));
+    }
+    return soup;
+}
+
+// Triangles as vertex contents rotated to start from the smallest vertex, so the winding is kept
+std::multiset<std::array<std::string, 3>> GetTriangles(const Mesh& mesh)
+{
+    std::multiset<std::array<std::string, 3>> triangles;
+    for (size_t i = 0; i < mesh.indices.size(); i += 3)
+    {
+        std::array<std::string, 3> triangle;
+        for (size_t corner = 0; corner < 3; ++corner)
+        {
+            const char* vertex = reinterpret_cast<const char*>(mesh.vertexData.data()) + mesh.indices[i + corner] * sizeof(Vertex);
+            triangle[corner] = std::string(vertex, sizeof(Vertex));
+        }
+        std::rotate(triangle.begin(), std::min_element(triangle.begin(), triangle.end()), triangle.end());
+        triangles.insert(triangle);
+    }
+    return triangles;
+}
+
+constexpr uint32_t sphereRings = 24;
+constexpr uint32_t sphereSegments = 48;
+}
+
+TEST(MeshOptimizer, AnalyzeCountsFifoMisses)
+{
+    // two triangles sharing an edge: 4 misses
+    MeshOptimizer::VertexCacheStatistics statistics = MeshOptimizer::AnalyzeVertexCache({0, 1, 2, 2, 1, 3}, 4);
+    CHECK_NEAR(2.0, statistics.acmr, 1e-6);
+    CHECK_NEAR(1.0, statistics.atvr, 1e-6);
+
+    // vertex 0 is pushed out of the cache of 3 vertices by 1, 2 and 3
+    statistics = MeshOptimizer::AnalyzeVertexCache({0, 1, 2, 2, 1, 3, 3, 1, 0}, 4, 3);
+    CHECK_NEAR(5.0 / 3.0, statistics.acmr, 1e-6);
+    CHECK_NEAR(5.0 / 4.0, statistics.atvr, 1e-6);
+}
+
+TEST(MeshOptimizer, WeldMergesIdenticalVertices)
+{
+    const Mesh sphere = CreateSphere(sphereRings, sphereSegments);
+    Mesh soup = CreateTriangleSoup(sphere);
+    const auto triangles = GetTriangles(soup);
+
+    const size_t verticesCount = MeshOptimizer::WeldVertices(soup.vertexData, sizeof(Vertex), soup.indices);
+    CHECK_EQUAL(sphere.UsedVerticesCount(), verticesCount);
+    CHECK_EQUAL(verticesCount, soup.VerticesCount());
+    CHECK(triangles == GetTriangles(soup));
+
+    std::set<std::string> vertices;
+    for (size_t i = 0; i < verticesCount; ++i)
+        vertices.insert(std::string(reinterpret_cast<const char*>(soup.vertexData.data()) + i * sizeof(Vertex), sizeof(Vertex)));
+    CHECK_EQUAL(verticesCount, vertices.size());
+}
+
+TEST(MeshOptimizer, PassesKeepTriangles)
+{
+    Mesh mesh = CreateSphere(sphereRings, sphereSegments);
+    const auto triangles = GetTriangles(mesh);
+    const size_t usedVerticesCount = mesh.UsedVerticesCount();
+
+    const std::vector<size_t> hardBoundaries = MeshOptimizer::OptimizeVertexCache(mesh.indices, mesh.VerticesCount());
+    CHECK(triangles == GetTriangles(mesh));
+    CHECK(std::is_sorted(hardBoundaries.begin(), hardBoundaries.end()));
+    CHECK(hardBoundaries.empty() || hardBoundaries.back() < mesh.indices.size() / 3);
+
+    MeshOptimizer::OptimizeOverdraw(mesh.indices, hardBoundaries, mesh.vertexData, sizeof(Vertex));
+    CHECK(triangles == GetTriangles(mesh));
+
+    const size_t verticesCount = MeshOptimizer::OptimizeVertexFetch(mesh.vertexData, sizeof(Vertex), mesh.indices);
+    CHECK_EQUAL(usedVerticesCount, verticesCount);
+    CHECK_EQUAL(verticesCount, mesh.VerticesCount());
+    CHECK(triangles == GetTriangles(mesh));
+
+    // vertices are in the order of first use
+    uint32_t nextVertex = 0;
+    for (uint32_t index : mesh.indices)
+    {
+        CHECK(index <= nextVertex);
+        if (index == nextVertex)
+            nextVertex++;
+    }
+    CHECK_EQUAL(verticesCount, (size_t)nextVertex);
+}
+
+// The limits are measured values rounded up, the lower bound of ACMR for such meshes is about 0.5.
+TEST(MeshOptimizer, CacheStatisticsDontRegress)
+{
+    Mesh soup = CreateTriangleSoup(CreateSphere(sphereRings, sphereSegments));
+    const auto triangles = GetTriangles(soup);
+
+    const MeshOptimizer::OptimizationReport report = MeshOptimizer::Optimize(soup.vertexData, sizeof(Vertex), soup.indices);
+    Tests::Log() << "    ACMR " << report.before.acmr << " -> " << report.after.acmr << ", ATVR " << report.before.atvr << " -> "
+                 << report.after.atvr << std::endl;
+
+    CHECK(triangles == GetTriangles(soup));
+    CHECK_EQUAL(soup.indices.size() / 3, report.trianglesCount);
+    CHECK_EQUAL(soup.indices.size(), report.verticesBefore);
+    CHECK_EQUAL(soup.VerticesCount(), report.verticesAfter);
+
+    CHECK_NEAR(3.0, report.before.acmr, 1e-6);
+    CHECK(report.after.acmr <= 0.75f);
+    CHECK(report.after.atvr <= 1.35f);
+
+    // indexed mesh with shuffled triangles gets the same result
+    Mesh sphere = CreateSphere(sphereRings, sphereSegments);
+    const MeshOptimizer::OptimizationReport indexed = MeshOptimizer::Optimize(sphere.vertexData, sizeof(Vertex), sphere.indices);
+    CHECK(indexed.after.acmr < indexed.before.acmr);
+    CHECK(indexed.after.acmr <= 0.75f);
+    CHECK(indexed.after.atvr <= 1.35f);
+
+    // already optimized mesh isn't made worse by the second run
+    const MeshOptimizer::OptimizationReport again = MeshOptimizer::Optimize(soup.vertexData, sizeof(Vertex), soup.indices);
+    CHECK(again.after.acmr <= report.after.acmr * 1.01f);
+}
+
+BENCHMARK(MeshOptimizer, Optimize)
+{
+    const Mesh sphere = CreateSphere(256, 512);
+    const size_t trianglesCount = sphere.indices.size() / 3;
+
+    // every run gets the same unwelded and shuffled source, the best one is printed
+    double bestTime = std::numeric_limits<double>::max();
+    MeshOptimizer::OptimizationReport report;
+    for (size_t run = 0; run < 3; ++run)
+    {
+        Mesh soup = CreateTriangleSoup(sphere);
+        auto start = std::chrono::high_resolution_clock::now();
+        report = MeshOptimizer::Optimize(soup.vertexData, sizeof(Vertex), soup.indices);
+        std::chrono::duration<double> time = std::chrono::high_resolution_clock::now() - start;
+        bestTime = std::min(bestTime, time.count());
+    }
+
+    Tests::Log() << "    " << trianglesCount << " triangles: " << trianglesCount / bestTime / 1e6 << " MTriangles/s" << std::endl;
+    Tests::Log() << "    ACMR " << report.before.acmr << " -> " << report.after.acmr << ", ATVR " << report.before.atvr << " -> "
+                 << report.after.atvr << std::endl;
+}
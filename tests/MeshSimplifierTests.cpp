@@ -0,0 +1,339 @@
+#include "stdafx.h"
+
+#include "Tests.h"
+
+#include <utils/MeshSimplifier.h>
+
+namespace
+{
+struct Vertex
+{
+    float position[3];
+    float uv[2];
+};
+
+struct Mesh
+{
+    std::vector<uint8_t>  vertexData;
+    std::vector<uint32_t> indices;
+
+    const Vertex& GetVertex(uint32_t index) const
+    {
+        return reinterpret_cast<const Vertex*>(vertexData.data())[index];
+    }
+};
+
+Mesh CreateMesh(const std::vector<Vertex>& vertices, std::vector<uint32_t>&& indices)
+{
+    Mesh mesh;
+    mesh.vertexData.resize(vertices.size() * sizeof(Vertex));
+    memcpy(mesh.vertexData.data(), vertices.data(), mesh.vertexData.size());
+    mesh.indices = std::move(indices);
+    return mesh;
+}
+
+// poles and the seam are exact, so their vertices have the same positions
+XMFLOAT3 SpherePoint(uint32_t ring, uint32_t rings, uint32_t segment, uint32_t segments)
+{
+    if (ring == 0 || ring == rings)
+        return {0.0f, ring == 0 ? 1.0f : -1.0f, 0.0f};
+
+    segment %= segments;
+    const float theta = 3.14159265f * ring / rings;
+    const float phi = 2.0f * 3.14159265f * segment / segments;
+    return {std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi)};
+}
+
+// unit sphere where every position is a single vertex
+Mesh CreateClosedSphere(uint32_t rings, uint32_t segments)
+{
+    const XMFLOAT3 top = SpherePoint(0, rings, 0, segments);
+    std::vector<Vertex> vertices = {{{top.x, top.y, top.z}, {0.0f, 0.0f}}};
+    for (uint32_t ring = 1; ring < rings; ++ring)
+    {
+        for (uint32_t segment = 0; segment < segments; ++segment)
+        {
+            const XMFLOAT3 p = SpherePoint(ring, rings, segment, segments);
+            vertices.push_back({{p.x, p.y, p.z}, {0.0f, 0.0f}});
+        }
+    }
+    const XMFLOAT3 bottomPoint = SpherePoint(rings, rings, 0, segments);
+    vertices.push_back({{bottomPoint.x, bottomPoint.y, bottomPoint.z}, {0.0f, 0.0f}});
+
+    const uint32_t bottom = (uint32_t)vertices.size() - 1;
+    auto index = [segments](uint32_t ring, uint32_t segment) { return 1 + (ring - 1) * segments + segment % segments; };
+
+    std::vector<uint32_t> indices;
+    for (uint32_t segment = 0; segment < segments; ++segment)
+    {
+        indices.insert(indices.end(), {0, index(1, segment + 1), index(1, segment)});
+        indices.insert(indices.end(), {bottom, index(rings - 1, segment), index(rings - 1, segment + 1)});
+        for (uint32_t ring = 1; ring + 1 < rings; ++ring)
+        {
+            const uint32_t a = index(ring, segment), b = index(ring, segment + 1);
+            const uint32_t c = index(ring + 1, segment), d = index(ring + 1, segment + 1);
+            indices.insert(indices.end(), {a, b, c, b, d, c});
+        }
+    }
+    return CreateMesh(vertices, std::move(indices));
+}
+
+// unit UV sphere, the seam at u = 0 and both poles have a vertex for every segment
+Mesh CreateSeamedSphere(uint32_t rings, uint32_t segments)
+{
+    std::vector<Vertex> vertices;
+    for (uint32_t ring = 0; ring <= rings; ++ring)
+    {
+        for (uint32_t segment = 0; segment <= segments; ++segment)
+        {
+            const XMFLOAT3 p = SpherePoint(ring, rings, segment, segments);
+            vertices.push_back({{p.x, p.y, p.z}, {(float)segment / segments, (float)ring / rings}});
+        }
+    }
+
+    std::vector<uint32_t> indices;
+    for (uint32_t ring = 0; ring < rings; ++ring)
+    {
+        for (uint32_t segment = 0; segment < segments; ++segment)
+        {
+            const uint32_t a = ring * (segments + 1) + segment;
+            const uint32_t b = a + segments + 1;
+            if (ring != 0)
+                indices.insert(indices.end(), {a, a + 1, b});
+            if (ring != rings - 1)
+                indices.insert(indices.end(), {a + 1, b + 1, b});
+        }
+    }
+    return CreateMesh(vertices, std::move(indices));
+}
+
+// unit cube like the procedural one of MeshManager, but every face is split into a grid; faces have own
+// vertices, so all edges of the cube are seams and corners have three wedges
+Mesh CreateSubdividedCube(uint32_t size)
+{
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+    for (uint32_t face = 0; face < 6; ++face)
+    {
+        const uint32_t axis = face / 2;
+        const float side = face % 2 ? 0.5f : -0.5f;
+        const uint32_t baseVertex = (uint32_t)vertices.size();
+        for (uint32_t v = 0; v <= size; ++v)
+        {
+            for (uint32_t u = 0; u <= size; ++u)
+            {
+                Vertex vertex = {{}, {(float)u / size, (float)v / size}};
+                vertex.position[axis] = side;
+                vertex.position[(axis + 1) % 3] = (float)u / size - 0.5f;
+                vertex.position[(axis + 2) % 3] = (float)v / size - 0.5f;
+                vertices.push_back(vertex);
+            }
+        }
+
+        for (uint32_t v = 0; v < size; ++v)
+        {
+            for (uint32_t u = 0; u < size; ++u)
+            {
+                const uint32_t a = baseVertex + v * (size + 1) + u;
+                const uint32_t b = a + size + 1;
+                if (face % 2)
+                    indices.insert(indices.end(), {a, a + 1, b, a + 1, b + 1, b});
+                else
+                    indices.insert(indices.end(), {a, b, a + 1, a + 1, b, b + 1});
+            }
+        }
+    }
+    return CreateMesh(vertices, std::move(indices));
+}
+
+// flat square in XZ plane, its outline is a border
+Mesh CreateGrid(uint32_t size)
+{
+    std::vector<Vertex> vertices;
+    for (uint32_t z = 0; z <= size; ++z)
+        for (uint32_t x = 0; x <= size; ++x)
+            vertices.push_back({{(float)x / size, 0.0f, (float)z / size}, {(float)x / size, (float)z / size}});
+
+    std::vector<uint32_t> indices;
+    for (uint32_t z = 0; z < size; ++z)
+    {
+        for (uint32_t x = 0; x < size; ++x)
+        {
+            const uint32_t a = z * (size + 1) + x;
+            const uint32_t b = a + size + 1;
+            indices.insert(indices.end(), {a, b, a + 1, a + 1, b, b + 1});
+        }
+    }
+    return CreateMesh(vertices, std::move(indices));
+}
+
+// every edge between positions has the opposite one, so seams haven't been opened
+bool IsClosed(const Mesh& mesh, const std::vector<uint32_t>& indices)
+{
+    auto key = [&](uint32_t index)
+    {
+        const float* p = mesh.GetVertex(index).position;
+        return std::make_tuple(p[0], p[1], p[2]);
+    };
+
+    std::multiset<std::pair<std::tuple<float, float, float>, std::tuple<float, float, float>>> halfEdges;
+    for (size_t i = 0; i < indices.size(); i += 3)
+        for (size_t k = 0; k < 3; ++k)
+            halfEdges.insert({key(indices[i + k]), key(indices[i + (k + 1) % 3])});
+
+    for (const auto& edge : halfEdges)
+        if (halfEdges.count({edge.second, edge.first}) != halfEdges.count(edge))
+            return false;
+    return true;
+}
+
+// the largest distance between the unit sphere and centers of the triangles
+float MeasureSphereDeviation(const Mesh& mesh, const std::vector<uint32_t>& indices)
+{
+    float deviation = 0.0f;
+    for (size_t i = 0; i < indices.size(); i += 3)
+    {
+        XMFLOAT3 center = {};
+        for (size_t k = 0; k < 3; ++k)
+        {
+            const float* p = mesh.GetVertex(indices[i + k]).position;
+            center = {center.x + p[0] / 3.0f, center.y + p[1] / 3.0f, center.z + p[2] / 3.0f};
+        }
+        deviation = std::max(deviation, 1.0f - std::sqrt(center.x * center.x + center.y * center.y + center.z * center.z));
+    }
+    return deviation;
+}
+
+constexpr float targetError = 0.02f;
+// errors are relative to the half diagonal of the bounding box, it is sqrt(3) for the unit sphere; the quadric
+// error is a weighted mean of distances to planes, the largest deviation measured is about 1.6 times bigger
+constexpr float maxDeviation = 2.0f * targetError * 1.7320508f;
+}
+
+TEST(MeshSimplifier, ClosedMeshLosesTriangles)
+{
+    const Mesh sphere = CreateClosedSphere(24, 48);
+
+    // without the target count the error bound stops simplification
+    float error = 0.0f;
+    const std::vector<uint32_t> simplified = MeshSimplifier::Simplify(sphere.indices, sphere.vertexData, sizeof(Vertex),
+                                                                      0, targetError, &error);
+    CHECK(simplified.size() * 4 <= sphere.indices.size());
+    CHECK(error > 0.0f && error <= targetError);
+    CHECK(IsClosed(sphere, simplified));
+    CHECK(MeasureSphereDeviation(sphere, simplified) <= maxDeviation);
+}
+
+TEST(MeshSimplifier, SeamedMeshLosesTriangles)
+{
+    const Mesh sphere = CreateSeamedSphere(24, 48);
+    CHECK(IsClosed(sphere, sphere.indices));
+
+    // without the target count the error bound stops simplification
+    float error = 0.0f;
+    const std::vector<uint32_t> simplified = MeshSimplifier::Simplify(sphere.indices, sphere.vertexData, sizeof(Vertex),
+                                                                      0, targetError, &error);
+    CHECK(simplified.size() * 4 <= sphere.indices.size());
+    CHECK(error > 0.0f && error <= targetError);
+    CHECK(IsClosed(sphere, simplified));
+    CHECK(MeasureSphereDeviation(sphere, simplified) <= maxDeviation);
+
+    // seam vertices are collapsed along the seam too
+    auto countSeamVertices = [&](const std::vector<uint32_t>& indices)
+    {
+        std::set<uint32_t> seam;
+        for (uint32_t index : indices)
+        {
+            const Vertex& vertex = sphere.GetVertex(index);
+            if (vertex.uv[0] == 0.0f && vertex.uv[1] > 0.0f && vertex.uv[1] < 1.0f)
+                seam.insert(index);
+        }
+        return seam.size();
+    };
+    CHECK(countSeamVertices(simplified) * 2 <= countSeamVertices(sphere.indices));
+
+    // a triangle with wedges of both sides of the seam would stretch over the whole texture
+    for (size_t i = 0; i < simplified.size(); i += 3)
+    {
+        const float u0 = sphere.GetVertex(simplified[i + 0]).uv[0];
+        const float u1 = sphere.GetVertex(simplified[i + 1]).uv[0];
+        const float u2 = sphere.GetVertex(simplified[i + 2]).uv[0];
+        CHECK(std::max({u0, u1, u2}) - std::min({u0, u1, u2}) < 0.5f);
+    }
+}
+
+// flat faces are simplified without any error down to two triangles, even though every edge is a seam
+TEST(MeshSimplifier, SeamedCubeCollapsesToCorners)
+{
+    const Mesh cube = CreateSubdividedCube(4);
+    CHECK(IsClosed(cube, cube.indices));
+
+    float error = 1.0f;
+    const std::vector<uint32_t> simplified = MeshSimplifier::Simplify(cube.indices, cube.vertexData, sizeof(Vertex),
+                                                                      0, targetError, &error);
+    CHECK_EQUAL((size_t)12 * 3, simplified.size());
+    CHECK_EQUAL(0.0f, error);
+    CHECK(IsClosed(cube, simplified));
+
+    // corners keep the texture coordinates of their faces
+    for (uint32_t index : simplified)
+    {
+        const Vertex& vertex = cube.GetVertex(index);
+        CHECK(vertex.uv[0] == 0.0f || vertex.uv[0] == 1.0f);
+        CHECK(vertex.uv[1] == 0.0f || vertex.uv[1] == 1.0f);
+    }
+}
+
+TEST(MeshSimplifier, BordersAreKept)
+{
+    const Mesh grid = CreateGrid(16);
+
+    float error = 1.0f;
+    const std::vector<uint32_t> simplified = MeshSimplifier::Simplify(grid.indices, grid.vertexData, sizeof(Vertex),
+                                                                      0, targetError, &error);
+    CHECK(simplified.size() * 4 <= grid.indices.size());
+    CHECK_EQUAL(0.0f, error);
+
+    // the outline and the area stay the same
+    const std::set<uint32_t> used(simplified.begin(), simplified.end());
+    float area = 0.0f;
+    for (size_t i = 0; i < simplified.size(); i += 3)
+    {
+        const float* a = grid.GetVertex(simplified[i + 0]).position;
+        const float* b = grid.GetVertex(simplified[i + 1]).position;
+        const float* c = grid.GetVertex(simplified[i + 2]).position;
+        const float normalY = (b[2] - a[2]) * (c[0] - a[0]) - (b[0] - a[0]) * (c[2] - a[2]);
+        CHECK(normalY > 0.0f);
+        area += normalY * 0.5f;
+    }
+    CHECK_NEAR(1.0, area, 1e-5);
+
+    for (uint32_t i = 0; i <= 16; ++i)
+    {
+        CHECK(used.count(i) && used.count(16 * 17 + i));
+        CHECK(used.count(i * 17) && used.count(i * 17 + 16));
+    }
+}
+
+BENCHMARK(MeshSimplifier, Throughput)
+{
+    const Mesh sphere = CreateSeamedSphere(256, 512);
+
+    // the same chain as MeshManager builds: every LOD halves the previous one
+    std::vector<uint32_t> lodIndices = sphere.indices;
+    size_t simplifiedTriangles = 0;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (size_t lod = 1; lod < 5; ++lod)
+    {
+        float error = 0.0f;
+        std::vector<uint32_t> simplified = MeshSimplifier::Simplify(lodIndices, sphere.vertexData, sizeof(Vertex),
+                                                                    lodIndices.size() / 6 * 3, 0.1f, &error);
+        Tests::Log() << "    LOD " << lod << ": " << simplified.size() / 3 << " triangles, error " << error << std::endl;
+
+        simplifiedTriangles += lodIndices.size() / 3;
+        lodIndices = std::move(simplified);
+    }
+    std::chrono::duration<double> time = std::chrono::high_resolution_clock::now() - start;
+
+    Tests::Log() << "    " << simplifiedTriangles / time.count() / 1e6 << " MTriangles/s" << std::endl;
+}
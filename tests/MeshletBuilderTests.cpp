@@ -0,0 +1,300 @@
+#include "stdafx.h"
+
+#include "Tests.h"
+
+#include <utils/MeshletBuilder.h>
+
+using namespace MeshletBuilder;
+
+namespace
+{
+struct Mesh
+{
+    std::vector<XMFLOAT3> positions;
+    std::vector<uint32_t> indices;
+
+    std::vector<uint8_t> VertexData() const
+    {
+        return {reinterpret_cast<const uint8_t*>(positions.data()), reinterpret_cast<const uint8_t*>(positions.data() + positions.size())};
+    }
+};
+
+// unit UV sphere, triangles face outside
+Mesh CreateSphere(uint32_t rings, uint32_t segments)
+{
+    Mesh mesh;
+    for (uint32_t ring = 0; ring <= rings; ++ring)
+    {
+        const float theta = 3.14159265f * ring / rings;
+        for (uint32_t segment = 0; segment <= segments; ++segment)
+        {
+            const float phi = 2.0f * 3.14159265f * segment / segments;
+            mesh.positions.push_back({std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi)});
+        }
+    }
+
+    for (uint32_t ring = 0; ring < rings; ++ring)
+    {
+        for (uint32_t segment = 0; segment < segments; ++segment)
+        {
+            const uint32_t a = ring * (segments + 1) + segment;
+            const uint32_t b = a + segments + 1;
+            if (ring != 0)
+                mesh.indices.insert(mesh.indices.end(), {a, a + 1, b});
+            if (ring != rings - 1)
+                mesh.indices.insert(mesh.indices.end(), {a + 1, b + 1, b});
+        }
+    }
+    return mesh;
+}
+
+// flat unit square in XZ plane facing +Y, small enough to be a single meshlet
+Mesh CreateGrid(uint32_t size)
+{
+    Mesh mesh;
+    for (uint32_t z = 0; z <= size; ++z)
+        for (uint32_t x = 0; x <= size; ++x)
+            mesh.positions.push_back({(float)x / size - 0.5f, 0.0f, (float)z / size - 0.5f});
+
+    for (uint32_t z = 0; z < size; ++z)
+    {
+        for (uint32_t x = 0; x < size; ++x)
+        {
+            const uint32_t a = z * (size + 1) + x;
+            const uint32_t b = a + size + 1;
+            mesh.indices.insert(mesh.indices.end(), {a, b, a + 1, a + 1, b, b + 1});
+        }
+    }
+    return mesh;
+}
+
+float Distance(const XMFLOAT3& a, const XMFLOAT3& b)
+{
+    return std::sqrt((a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y) + (a.z - b.z) * (a.z - b.z));
+}
+
+// meshlets follow the index buffer, so the source triangles are covered one by one in order
+void CheckMeshlets(const Mesh& mesh, const MeshletData& data, size_t maxVertices, size_t maxTriangles)
+{
+    uint32_t nextTriangle = 0;
+    uint32_t nextVertex = 0;
+    for (const Meshlet& meshlet : data.meshlets)
+    {
+        CHECK(meshlet.vertexCount >= 3 && meshlet.vertexCount <= maxVertices);
+        CHECK(meshlet.triangleCount >= 1 && meshlet.triangleCount <= maxTriangles);
+        CHECK_EQUAL(nextTriangle, meshlet.triangleOffset);
+        CHECK_EQUAL(nextVertex, meshlet.vertexOffset);
+
+        for (uint32_t t = 0; t < meshlet.triangleCount; ++t)
+        {
+            for (uint32_t k = 0; k < 3; ++k)
+            {
+                const uint8_t localIndex = data.triangles[(meshlet.triangleOffset + t) * 3 + k];
+                CHECK(localIndex < meshlet.vertexCount);
+                CHECK_EQUAL(mesh.indices[(meshlet.triangleOffset + t) * 3 + k], data.vertices[meshlet.vertexOffset + localIndex]);
+            }
+        }
+
+        // vertices of a meshlet are unique and inside of its bounding sphere
+        std::set<uint32_t> vertices;
+        for (uint32_t i = 0; i < meshlet.vertexCount; ++i)
+        {
+            const uint32_t vertex = data.vertices[meshlet.vertexOffset + i];
+            CHECK(vertices.insert(vertex).second);
+            CHECK(Distance(mesh.positions[vertex], meshlet.center) <= meshlet.radius * 1.0001f);
+        }
+
+        nextTriangle += meshlet.triangleCount;
+        nextVertex += meshlet.vertexCount;
+    }
+
+    CHECK_EQUAL(mesh.indices.size() / 3, (size_t)nextTriangle);
+    CHECK_EQUAL(data.vertices.size(), (size_t)nextVertex);
+    CHECK_EQUAL(mesh.indices.size(), data.triangles.size());
+}
+
+struct View
+{
+    XMFLOAT4 planes[6];
+    XMFLOAT3 eye;
+};
+
+View CreateView(const XMFLOAT3& eye, const XMFLOAT3& focus, const XMFLOAT3& up)
+{
+    const XMMATRIX viewMatrix = XMMatrixLookAtLH(XMLoadFloat3(&eye), XMLoadFloat3(&focus), XMLoadFloat3(&up));
+    const XMMATRIX projectionMatrix = XMMatrixPerspectiveFovLH(3.14159265f / 3.0f, 16.0f / 9.0f, 0.1f, 100.0f);
+
+    View view;
+    ExtractFrustumPlanes(XMMatrixMultiply(viewMatrix, projectionMatrix), view.planes);
+    view.eye = eye;
+    return view;
+}
+
+size_t CountVisible(const MeshletData& data, FXMMATRIX world, const View& view, bool coneCulling,
+                    std::vector<std::pair<uint32_t, uint32_t>>& ranges)
+{
+    ranges.clear();
+    return Cull(data, world, view.planes, view.eye, coneCulling, ranges);
+}
+}
+
+TEST(MeshletBuilder, MeshletsCoverTrianglesWithinLimits)
+{
+    const Mesh sphere = CreateSphere(32, 64);
+    const std::vector<uint8_t> vertexData = sphere.VertexData();
+
+    const MeshletData defaultData = Build(sphere.indices, vertexData, sizeof(XMFLOAT3));
+    CheckMeshlets(sphere, defaultData, DefaultMaxVertices, DefaultMaxTriangles);
+
+    const MeshletStatistics statistics = ComputeStatistics(defaultData);
+    CHECK_EQUAL(defaultData.meshlets.size(), statistics.meshletsCount);
+    CHECK(statistics.averageVertices <= DefaultMaxVertices);
+    CHECK(statistics.averageTriangles <= DefaultMaxTriangles);
+
+    // small limits, the triangle limit is hit before the vertex one
+    for (const auto& limits : {std::make_pair<size_t, size_t>(3, 1), {16, 8}, {32, 126}, {255, 256}})
+        CheckMeshlets(sphere, Build(sphere.indices, vertexData, sizeof(XMFLOAT3), limits.first, limits.second),
+                      limits.first, limits.second);
+}
+
+// normals of all triangles are inside the cone: the angle to the axis is below asin(coneCutoff)
+TEST(MeshletBuilder, ConesBoundNormals)
+{
+    const Mesh sphere = CreateSphere(32, 64);
+    const MeshletData data = Build(sphere.indices, sphere.VertexData(), sizeof(XMFLOAT3));
+
+    size_t cones = 0;
+    for (const Meshlet& meshlet : data.meshlets)
+    {
+        if (meshlet.coneCutoff >= 1.0f)
+            continue;
+
+        cones++;
+        const float minDot = std::sqrt(1.0f - meshlet.coneCutoff * meshlet.coneCutoff);
+        for (uint32_t t = 0; t < meshlet.triangleCount; ++t)
+        {
+            const uint32_t* triangle = &sphere.indices[(meshlet.triangleOffset + t) * 3];
+            const XMVECTOR p0 = XMLoadFloat3(&sphere.positions[triangle[0]]);
+            const XMVECTOR p1 = XMLoadFloat3(&sphere.positions[triangle[1]]);
+            const XMVECTOR p2 = XMLoadFloat3(&sphere.positions[triangle[2]]);
+            const XMVECTOR normal = XMVector3Normalize(XMVector3Cross(XMVectorSubtract(p1, p0), XMVectorSubtract(p2, p0)));
+            CHECK(XMVectorGetX(XMVector3Dot(normal, XMLoadFloat3(&meshlet.coneAxis))) >= minDot - 1e-5f);
+        }
+    }
+
+    // a dense sphere has narrow cones everywhere except triangle fans at the poles
+    CHECK(cones * 2 >= data.meshlets.size());
+}
+
+TEST(MeshletBuilder, CullsByFrustumAndCone)
+{
+    const Mesh grid = CreateGrid(4);
+    const MeshletData data = Build(grid.indices, grid.VertexData(), sizeof(XMFLOAT3));
+    CHECK_EQUAL((size_t)1, data.meshlets.size());
+    CHECK_EQUAL(0.0f, data.meshlets[0].coneCutoff);
+
+    const XMMATRIX world = XMMatrixTranslation(0.0f, 0.0f, 10.0f);
+    const View front = CreateView({0.0f, 5.0f, 10.0f}, {0.0f, 0.0f, 10.0f}, {0.0f, 0.0f, 1.0f});
+    const View back = CreateView({0.0f, -5.0f, 10.0f}, {0.0f, 0.0f, 10.0f}, {0.0f, 0.0f, 1.0f});
+    const View away = CreateView({0.0f, 5.0f, 10.0f}, {0.0f, 10.0f, 10.0f}, {0.0f, 0.0f, 1.0f});
+
+    // visible meshlets are returned as one range of the index buffer
+    std::vector<std::pair<uint32_t, uint32_t>> ranges;
+    CHECK_EQUAL((size_t)1, CountVisible(data, world, front, true, ranges));
+    CHECK_EQUAL((size_t)1, ranges.size());
+    CHECK_EQUAL(0u, ranges[0].first);
+    CHECK_EQUAL((uint32_t)grid.indices.size(), ranges[0].second);
+
+    CHECK_EQUAL((size_t)0, CountVisible(data, world, back, true, ranges));
+    CHECK(ranges.empty());
+    CHECK_EQUAL((size_t)1, CountVisible(data, world, back, false, ranges));
+    CHECK_EQUAL((size_t)0, CountVisible(data, world, away, false, ranges));
+
+    // non-uniform scale makes the cone unreliable, so it isn't used
+    const XMMATRIX stretched = XMMatrixMultiply(XMMatrixScaling(1.0f, 2.0f, 1.0f), world);
+    CHECK_EQUAL((size_t)1, CountVisible(data, stretched, back, true, ranges));
+
+    // a uniformly scaled mesh is still culled
+    const XMMATRIX scaled = XMMatrixMultiply(XMMatrixScaling(2.0f, 2.0f, 2.0f), world);
+    CHECK_EQUAL((size_t)0, CountVisible(data, scaled, back, true, ranges));
+}
+
+// from the distance of 5 radii less than a half of the sphere faces the eye, meshlets are small enough on the
+// dense sphere for their cones to follow it; adjacent meshlets are merged into ranges
+TEST(MeshletBuilder, CullsBackHalfOfSphere)
+{
+    const Mesh sphere = CreateSphere(128, 256);
+    const MeshletData data = Build(sphere.indices, sphere.VertexData(), sizeof(XMFLOAT3));
+    const View view = CreateView({0.0f, 0.0f, -5.0f}, {0.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f});
+
+    std::vector<std::pair<uint32_t, uint32_t>> ranges;
+    CHECK_EQUAL(data.meshlets.size(), CountVisible(data, XMMatrixIdentity(), view, false, ranges));
+    CHECK_EQUAL((size_t)1, ranges.size());
+
+    const size_t visible = CountVisible(data, XMMatrixIdentity(), view, true, ranges);
+    CHECK(visible * 10 < data.meshlets.size() * 6);
+    CHECK(visible * 10 > data.meshlets.size() * 3);
+
+    // every meshlet that has a triangle facing the eye is kept
+    size_t indicesCount = 0;
+    for (const auto& range : ranges)
+        indicesCount += range.second;
+    CHECK(ranges.size() <= visible);
+
+    size_t frontIndices = 0;
+    for (const Meshlet& meshlet : data.meshlets)
+    {
+        bool facing = false;
+        for (uint32_t t = 0; t < meshlet.triangleCount && !facing; ++t)
+        {
+            const uint32_t* triangle = &sphere.indices[(meshlet.triangleOffset + t) * 3];
+            const XMVECTOR p0 = XMLoadFloat3(&sphere.positions[triangle[0]]);
+            const XMVECTOR normal = XMVector3Cross(XMVectorSubtract(XMLoadFloat3(&sphere.positions[triangle[1]]), p0),
+                                                   XMVectorSubtract(XMLoadFloat3(&sphere.positions[triangle[2]]), p0));
+            facing = XMVectorGetX(XMVector3Dot(normal, XMVectorSubtract(XMLoadFloat3(&view.eye), p0))) > 0.0f;
+        }
+
+        if (!facing)
+            continue;
+
+        frontIndices += meshlet.triangleCount * 3;
+        bool kept = false;
+        for (const auto& range : ranges)
+            kept = kept || (meshlet.triangleOffset * 3 >= range.first && meshlet.triangleOffset * 3 < range.first + range.second);
+        CHECK(kept);
+    }
+    CHECK(frontIndices <= indicesCount);
+}
+
+BENCHMARK(MeshletBuilder, BuildAndCull)
+{
+    const Mesh sphere = CreateSphere(512, 1024);
+    const std::vector<uint8_t> vertexData = sphere.VertexData();
+    const size_t trianglesCount = sphere.indices.size() / 3;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    const MeshletData data = Build(sphere.indices, vertexData, sizeof(XMFLOAT3));
+    std::chrono::duration<double> buildTime = std::chrono::high_resolution_clock::now() - start;
+
+    Tests::Log() << "    " << trianglesCount << " triangles, " << data.meshlets.size() << " meshlets" << std::endl;
+    Tests::Log() << "    build: " << trianglesCount / buildTime.count() / 1e6 << " MTriangles/s" << std::endl;
+
+    // the best of several runs, like a frame with the same view
+    const View view = CreateView({0.0f, 0.5f, -3.0f}, {0.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f});
+    std::vector<std::pair<uint32_t, uint32_t>> ranges;
+    for (bool coneCulling : {false, true})
+    {
+        double bestTime = std::numeric_limits<double>::max();
+        size_t visible = 0;
+        for (size_t run = 0; run < 5; ++run)
+        {
+            auto cullStart = std::chrono::high_resolution_clock::now();
+            visible = CountVisible(data, XMMatrixIdentity(), view, coneCulling, ranges);
+            std::chrono::duration<double> time = std::chrono::high_resolution_clock::now() - cullStart;
+            bestTime = std::min(bestTime, time.count());
+        }
+
+        Tests::Log() << "    cull" << (coneCulling ? " with cones: " : ": ") << data.meshlets.size() / bestTime / 1e6
+                     << " MMeshlets/s, " << visible << " visible in " << ranges.size() << " ranges" << std::endl;
+    }
+}
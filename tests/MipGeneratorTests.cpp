@@ -0,0 +1,357 @@
+#include "stdafx.h"
+
+#include "Tests.h"
+
+#include <utils/MipGenerator.h>
+
+using namespace MipGenerator;
+
+namespace
+{
+using Rgba8 = std::array<uint8_t, 4>;
+
+// tightly packed top level of every slice, rows of 3D textures are stored layer after layer
+struct Source
+{
+    TextureDesc                         desc;
+    std::vector<uint8_t>                data;
+    std::vector<D3D12_SUBRESOURCE_DATA> slices;
+};
+
+template<typename Texel>
+Source CreateSource(const TextureDesc& desc, const std::vector<Texel>& texels)
+{
+    const bool volume = desc.dimension == D3D12_RESOURCE_DIMENSION_TEXTURE3D;
+    const size_t slicesCount = volume ? 1 : desc.depthOrArraySize;
+    const size_t rowPitch = desc.width * sizeof(Texel);
+    const size_t slicePitch = rowPitch * desc.height;
+
+    Source source {desc};
+    source.data.resize(texels.size() * sizeof(Texel));
+    std::memcpy(source.data.data(), texels.data(), source.data.size());
+    for (size_t slice = 0; slice < slicesCount; ++slice)
+    {
+        const size_t sliceSize = slicePitch * (volume ? desc.depthOrArraySize : 1);
+        source.slices.push_back({source.data.data() + slice * sliceSize, (LONG_PTR)rowPitch, (LONG_PTR)slicePitch});
+    }
+    return source;
+}
+
+MipChain Generate(const Source& source, Filter filter, size_t mipLevels = 0)
+{
+    return MipGenerator::Generate(source.desc, source.slices.data(), filter, mipLevels);
+}
+
+template<typename Texel>
+const Texel& GetTexel(const MipChain& chain, size_t subresource, size_t x, size_t y, size_t z = 0)
+{
+    const D3D12_SUBRESOURCE_DATA& data = chain.subresources[subresource];
+    const uint8_t* row = static_cast<const uint8_t*>(data.pData) + z * data.SlicePitch + y * data.RowPitch;
+    return reinterpret_cast<const Texel*>(row)[x];
+}
+
+float GetRed(const MipChain& chain, size_t subresource, size_t x, size_t y = 0, size_t z = 0)
+{
+    return GetTexel<XMFLOAT4>(chain, subresource, x, y, z).x;
+}
+
+TextureDesc CreateDesc(DXGI_FORMAT format, size_t width, size_t height, size_t depthOrArraySize = 1,
+                       D3D12_RESOURCE_DIMENSION dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D)
+{
+    TextureDesc desc;
+    desc.dimension = dimension;
+    desc.format = format;
+    desc.width = width;
+    desc.height = height;
+    desc.depthOrArraySize = depthOrArraySize;
+    return desc;
+}
+
+// one float channel per texel, the rest are constant so the channels can't be mixed up
+std::vector<XMFLOAT4> CreateTexels(const std::vector<float>& values)
+{
+    std::vector<XMFLOAT4> texels;
+    for (float value : values)
+        texels.push_back({value, 0.25f, 0.5f, 1.0f});
+    return texels;
+}
+
+// 1 pixel black and white checker, the finest detail the top level can keep
+std::vector<Rgba8> CreateChecker(size_t width, size_t height)
+{
+    std::vector<Rgba8> texels;
+    for (size_t y = 0; y < height; ++y)
+    {
+        for (size_t x = 0; x < width; ++x)
+        {
+            const uint8_t value = (x + y) % 2 ? 255 : 0;
+            texels.push_back({value, value, value, 255});
+        }
+    }
+    return texels;
+}
+
+const Filter filters[] = {Filter::Box, Filter::Kaiser, Filter::Lanczos};
+}
+
+TEST(MipGenerator, BoxAveragesTexels)
+{
+    const Source source = CreateSource(CreateDesc(DXGI_FORMAT_R32G32B32A32_FLOAT, 4, 2), CreateTexels({
+        1.0f, 2.0f, 10.0f, 20.0f,
+        3.0f, 6.0f, 30.0f, 41.0f,
+    }));
+
+    const MipChain chain = Generate(source, Filter::Box);
+    CHECK_EQUAL(3u, chain.mipLevels);
+    CHECK_EQUAL(3u, chain.subresources.size());
+
+    // the top level is kept as is
+    CHECK_EQUAL(41.0f, GetRed(chain, 0, 3, 1));
+    CHECK_EQUAL(3.0f, GetRed(chain, 1, 0));
+    CHECK_EQUAL(25.25f, GetRed(chain, 1, 1));
+    CHECK_EQUAL(14.125f, GetRed(chain, 2, 0));
+
+    const XMFLOAT4& texel = GetTexel<XMFLOAT4>(chain, 2, 0, 0);
+    CHECK_EQUAL(0.25f, texel.y);
+    CHECK_EQUAL(0.5f, texel.z);
+    CHECK_EQUAL(1.0f, texel.w);
+
+    // 8 bit channels are rounded to the nearest value
+    const Source bytes = CreateSource(CreateDesc(DXGI_FORMAT_R8G8B8A8_UNORM, 2, 2), std::vector<Rgba8> {
+        {10, 0, 255, 255}, {20, 1, 255, 255},
+        {30, 1, 0, 255},   {41, 1, 0, 255},
+    });
+
+    const auto& average = GetTexel<Rgba8>(Generate(bytes, Filter::Box), 1, 0, 0);
+    CHECK_EQUAL(25, (int)average[0]);
+    CHECK_EQUAL(1, (int)average[1]);
+    CHECK_EQUAL(128, (int)average[2]);
+    CHECK_EQUAL(255, (int)average[3]);
+}
+
+// 50% coverage of white is 0.5 of linear light, it is 188 in sRGB and 128 in linear formats
+TEST(MipGenerator, FiltersSRGBInLinearSpace)
+{
+    // sharp filters see clamped edges as a different pattern, so only texels they don't reach are checked
+    const size_t size = 32;
+    const auto checker = CreateChecker(size, size);
+    for (Filter filter : filters)
+    {
+        const MipChain srgb = Generate(CreateSource(CreateDesc(DXGI_FORMAT_R8G8B8A8_UNORM_SRGB, size, size), checker), filter, 2);
+        const MipChain bgra = Generate(CreateSource(CreateDesc(DXGI_FORMAT_B8G8R8A8_UNORM_SRGB, size, size), checker), filter, 2);
+        const MipChain linear = Generate(CreateSource(CreateDesc(DXGI_FORMAT_R8G8B8A8_UNORM, size, size), checker), filter, 2);
+
+        // 0.5 of 255 is on a rounding edge, sums of many weights may fall on either side of it
+        const size_t border = filter == Filter::Box ? 0 : 3;
+        const double tolerance = filter == Filter::Box ? 0.0 : 1.0;
+        for (size_t y = border; y < size / 2 - border; ++y)
+        {
+            for (size_t x = border; x < size / 2 - border; ++x)
+            {
+                for (size_t channel = 0; channel < 3; ++channel)
+                {
+                    CHECK_NEAR(188, GetTexel<Rgba8>(srgb, 1, x, y)[channel], tolerance);
+                    CHECK_NEAR(188, GetTexel<Rgba8>(bgra, 1, x, y)[channel], tolerance);
+                    CHECK_NEAR(128, GetTexel<Rgba8>(linear, 1, x, y)[channel], tolerance);
+                }
+
+                // alpha is always linear
+                CHECK_EQUAL(255, (int)GetTexel<Rgba8>(srgb, 1, x, y)[3]);
+            }
+        }
+    }
+
+    // the rest of the chain averages the same gray
+    const MipChain chain = Generate(CreateSource(CreateDesc(DXGI_FORMAT_R8G8B8A8_UNORM_SRGB, size, size), checker), Filter::Box);
+    CHECK_EQUAL(6u, chain.mipLevels);
+    for (size_t mip = 1; mip < chain.mipLevels; ++mip)
+        CHECK_EQUAL(188, (int)GetTexel<Rgba8>(chain, mip, 0, 0)[0]);
+
+    // blue and red of BGRA are not swapped on the way back
+    const Source bgra = CreateSource(CreateDesc(DXGI_FORMAT_B8G8R8A8_UNORM, 2, 1), std::vector<Rgba8> {
+        {200, 100, 0, 255}, {200, 100, 0, 255},
+    });
+
+    const auto& texel = GetTexel<Rgba8>(Generate(bgra, Filter::Box), 1, 0, 0);
+    CHECK_EQUAL(200, (int)texel[0]);
+    CHECK_EQUAL(100, (int)texel[1]);
+    CHECK_EQUAL(0, (int)texel[2]);
+}
+
+// sizes are halved and rounded down, a box of an odd size takes the middle texel to the second destination
+TEST(MipGenerator, OddAndNonPowerOfTwoSizes)
+{
+    const Source row = CreateSource(CreateDesc(DXGI_FORMAT_R32G32B32A32_FLOAT, 5, 1), CreateTexels({1.0f, 2.0f, 3.0f, 4.0f, 5.0f}));
+    MipChain chain = Generate(row, Filter::Box);
+    CHECK_EQUAL(3u, chain.mipLevels);
+    CHECK_EQUAL(1.5f, GetRed(chain, 1, 0));
+    CHECK_EQUAL(4.0f, GetRed(chain, 1, 1));
+    CHECK_EQUAL(2.75f, GetRed(chain, 2, 0));
+
+    // 3 texels go to one
+    const Source column = CreateSource(CreateDesc(DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 3), CreateTexels({3.0f, 6.0f, 12.0f}));
+    chain = Generate(column, Filter::Box);
+    CHECK_EQUAL(2u, chain.mipLevels);
+    CHECK_EQUAL(7.0f, GetRed(chain, 1, 0));
+
+    // every filter keeps a constant color and the layout of copyable footprints
+    const size_t width = 67;
+    const size_t height = 13;
+    for (Filter filter : filters)
+    {
+        const Source constant = CreateSource(CreateDesc(DXGI_FORMAT_R32G32B32A32_FLOAT, width, height),
+                                             CreateTexels(std::vector<float>(width * height, 0.75f)));
+        chain = Generate(constant, filter);
+        CHECK_EQUAL(7u, chain.mipLevels);
+
+        for (size_t mip = 0; mip < chain.mipLevels; ++mip)
+        {
+            const size_t mipWidth = std::max<size_t>(width >> mip, 1);
+            const size_t mipHeight = std::max<size_t>(height >> mip, 1);
+            const D3D12_SUBRESOURCE_DATA& subresource = chain.subresources[mip];
+            CHECK_EQUAL(0u, (static_cast<const uint8_t*>(subresource.pData) - chain.data.data()) % D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+            CHECK_EQUAL(0, subresource.RowPitch % D3D12_TEXTURE_DATA_PITCH_ALIGNMENT);
+            CHECK(subresource.RowPitch >= (LONG_PTR)(mipWidth * sizeof(XMFLOAT4)));
+            CHECK_EQUAL(subresource.RowPitch * (LONG_PTR)mipHeight, subresource.SlicePitch);
+
+            for (size_t y = 0; y < mipHeight; ++y)
+            {
+                for (size_t x = 0; x < mipWidth; ++x)
+                    CHECK_NEAR(0.75, GetRed(chain, mip, x, y), 1e-5);
+            }
+        }
+    }
+
+    // a partial chain stops early
+    chain = Generate(CreateSource(CreateDesc(DXGI_FORMAT_R32G32B32A32_FLOAT, 4, 2), CreateTexels(std::vector<float>(8, 1.0f))),
+                     Filter::Box, 2);
+    CHECK_EQUAL(2u, chain.mipLevels);
+    CHECK_EQUAL(2u, chain.subresources.size());
+}
+
+// layers of 3D textures are averaged like rows and columns, slices of arrays are independent
+TEST(MipGenerator, VolumeReducesDepth)
+{
+    std::vector<float> values;
+    for (size_t z = 0; z < 4; ++z)
+    {
+        for (size_t i = 0; i < 4; ++i)
+            values.push_back((float)(z * 4 + i));
+    }
+
+    const Source volume = CreateSource(CreateDesc(DXGI_FORMAT_R32G32B32A32_FLOAT, 2, 2, 4, D3D12_RESOURCE_DIMENSION_TEXTURE3D),
+                                       CreateTexels(values));
+    MipChain chain = Generate(volume, Filter::Box);
+    CHECK_EQUAL(3u, chain.mipLevels);
+    CHECK_EQUAL(3u, chain.subresources.size());
+    CHECK_EQUAL(15.0f, GetRed(chain, 0, 1, 1, 3));
+    CHECK_EQUAL(3.5f, GetRed(chain, 1, 0, 0, 0));
+    CHECK_EQUAL(11.5f, GetRed(chain, 1, 0, 0, 1));
+    CHECK_EQUAL(7.5f, GetRed(chain, 2, 0, 0, 0));
+
+    // depth alone defines the chain length
+    const Source deep = CreateSource(CreateDesc(DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 1, 8, D3D12_RESOURCE_DIMENSION_TEXTURE3D),
+                                     CreateTexels({0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f}));
+    chain = Generate(deep, Filter::Box);
+    CHECK_EQUAL(4u, chain.mipLevels);
+    CHECK_EQUAL(0.5f, GetRed(chain, 1, 0, 0, 0));
+    CHECK_EQUAL(6.5f, GetRed(chain, 1, 0, 0, 3));
+    CHECK_EQUAL(3.5f, GetRed(chain, 3, 0, 0, 0));
+
+    const Source array = CreateSource(CreateDesc(DXGI_FORMAT_R32G32B32A32_FLOAT, 2, 2, 4), CreateTexels(values));
+    chain = Generate(array, Filter::Box);
+    CHECK_EQUAL(2u, chain.mipLevels);
+    CHECK_EQUAL(8u, chain.subresources.size());
+    for (size_t slice = 0; slice < 4; ++slice)
+        CHECK_EQUAL(slice * 4 + 1.5f, GetRed(chain, slice * chain.mipLevels + 1, 0, 0));
+}
+
+// sharp filters are normalized and symmetric: a ramp stays a ramp away from clamped edges, and detail finer
+// than the destination can keep is filtered out to its average
+TEST(MipGenerator, SharpFiltersKeepRampsAndRemoveAliasing)
+{
+    const size_t width = 64;
+    std::vector<float> ramp, stripes;
+    for (size_t x = 0; x < width; ++x)
+    {
+        ramp.push_back(x + 0.5f);
+        stripes.push_back(x % 2 ? 1.0f : 0.0f);
+    }
+
+    for (Filter filter : filters)
+    {
+        const MipChain rampChain = Generate(CreateSource(CreateDesc(DXGI_FORMAT_R32G32B32A32_FLOAT, width, 1), CreateTexels(ramp)), filter, 2);
+        const MipChain stripesChain = Generate(CreateSource(CreateDesc(DXGI_FORMAT_R32G32B32A32_FLOAT, width, 1), CreateTexels(stripes)), filter, 2);
+
+        // kernels reach 6 source texels at most
+        for (size_t x = 3; x < width / 2 - 3; ++x)
+        {
+            CHECK_NEAR(2.0 * x + 1.0, GetRed(rampChain, 1, x), 1e-3);
+            CHECK_NEAR(0.5, GetRed(stripesChain, 1, x), 1e-5);
+        }
+    }
+
+    // 8 bit formats clamp the overshoot of sharp filters at hard edges instead of wrapping it around
+    std::vector<Rgba8> edge;
+    for (size_t x = 0; x < width; ++x)
+        edge.push_back({x < width / 2 ? uint8_t(0) : uint8_t(255), 0, 0, 255});
+
+    const MipChain lanczos = Generate(CreateSource(CreateDesc(DXGI_FORMAT_R8G8B8A8_UNORM, width, 1), edge), Filter::Lanczos, 2);
+    for (size_t x = 0; x < width / 2; ++x)
+    {
+        const int value = GetTexel<Rgba8>(lanczos, 1, x, 0)[0];
+        CHECK(x < width / 4 ? value < 16 : value > 240);
+    }
+}
+
+TEST(MipGenerator, RejectsInvalidTextures)
+{
+    const Source source = CreateSource(CreateDesc(DXGI_FORMAT_R8G8B8A8_UNORM, 2, 2), CreateChecker(2, 2));
+
+    auto throws = [&](const TextureDesc& desc)
+    {
+        try
+        {
+            MipGenerator::Generate(desc, source.slices.data(), Filter::Box);
+        }
+        catch (const std::runtime_error&)
+        {
+            return true;
+        }
+        return false;
+    };
+
+    CHECK(throws(CreateDesc(DXGI_FORMAT_BC1_UNORM, 2, 2)));
+    CHECK(throws(CreateDesc(DXGI_FORMAT_R8G8B8A8_UNORM, 0, 2)));
+    CHECK(throws(CreateDesc(DXGI_FORMAT_R8G8B8A8_UNORM, 2, 2, 1, D3D12_RESOURCE_DIMENSION_TEXTURE1D)));
+
+    TextureDesc cube = CreateDesc(DXGI_FORMAT_R8G8B8A8_UNORM, 2, 2, 4);
+    cube.cube = true;
+    CHECK(throws(cube));
+}
+
+BENCHMARK(MipGenerator, Filters)
+{
+    const size_t size = 2048;
+    std::vector<Rgba8> texels(size * size);
+    std::mt19937 generator {size};
+    for (auto& texel : texels)
+        texel = {(uint8_t)generator(), (uint8_t)generator(), (uint8_t)generator(), 255};
+
+    const Source source = CreateSource(CreateDesc(DXGI_FORMAT_R8G8B8A8_UNORM_SRGB, size, size), texels);
+    const char* names[] = {"box", "kaiser", "lanczos"};
+    for (Filter filter : filters)
+    {
+        // the best of several runs hides thread pool start and page faults
+        double bestTime = std::numeric_limits<double>::max();
+        for (size_t run = 0; run < 3; ++run)
+        {
+            auto start = std::chrono::high_resolution_clock::now();
+            Generate(source, filter);
+            std::chrono::duration<double, std::micro> time = std::chrono::high_resolution_clock::now() - start;
+            bestTime = std::min(bestTime, time.count());
+        }
+
+        Tests::Log() << "    " << names[(int)filter] << ": " << size * size / bestTime << " MPix/s" << std::endl;
+    }
+}
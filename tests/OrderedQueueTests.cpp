@@ -0,0 +1,110 @@
+#include "stdafx.h"
+
+#include "Tests.h"
+
+#include <utils/OrderedQueue.h>
+
+namespace
+{
+struct Item
+{
+    size_t round;
+    size_t index;
+};
+
+std::ostream& operator<<(std::ostream& stream, const Item& item)
+{
+    return stream << "{round " << item.round << ", slot " << item.index << "}";
+}
+
+bool operator==(const Item& a, const Item& b)
+{
+    return a.round == b.round && a.index == b.index;
+}
+}
+
+// Producers publish a random permutation of slots, some slots are published before them like reused lists.
+// The consumer takes batches like SceneManager::SubmitGBufferChunks and has to see every slot of the round
+// once and in order. The queue is reused between rounds with the same and different sizes.
+TEST(OrderedQueue, ConsumesPublishedSlotsInOrderOnce)
+{
+    constexpr size_t roundsCount = 300;
+    constexpr size_t maxSize = 257;
+    constexpr size_t maxBatch = 8;
+    constexpr size_t maxProducers = 8;
+
+    std::mt19937 generator {7};
+    Threading::OrderedQueue<Item> queue;
+
+    for (size_t round = 0; round < roundsCount; ++round)
+    {
+        const size_t size = 1 + generator() % maxSize;
+        const size_t batch = 1 + generator() % maxBatch;
+        const size_t producersCount = 1 + generator() % maxProducers;
+        queue.Reset(size);
+        CHECK_EQUAL(size, queue.Size());
+        CHECK_EQUAL(size_t(0), queue.GetPrefix());
+
+        std::vector<size_t> order(size);
+        for (size_t i = 0; i < size; ++i)
+            order[i] = i;
+        std::shuffle(order.begin(), order.end(), generator);
+
+        // the first quarter of the permutation is published by the consumer thread before producers start
+        const size_t prepublished = size / 4;
+        for (size_t i = 0; i < prepublished; ++i)
+            queue.Publish(order[i], {round, order[i]});
+
+        std::atomic_size_t next = prepublished;
+        std::vector<std::thread> producers;
+        for (size_t p = 0; p < producersCount; ++p)
+        {
+            producers.emplace_back([&, seed = generator()]()
+            {
+                std::minstd_rand delay {seed};
+                for (size_t i = next++; i < size; i = next++)
+                {
+                    if (delay() % 4 == 0)
+                        std::this_thread::yield();
+                    queue.Publish(order[i], {round, order[i]});
+                }
+            });
+        }
+
+        // polls without waiting first, then waits for whole batches; producers never wait for the consumer,
+        // so they are joined before a failed check leaves the test
+        std::vector<size_t> consumed(size, 0);
+        try
+        {
+            size_t taken = 0;
+            while (taken < size)
+            {
+                const size_t batchEnd = std::min(taken + batch, size);
+                size_t published = queue.GetPrefix();
+                if (published < batchEnd)
+                    published = queue.WaitPrefix(batchEnd);
+
+                CHECK(published >= batchEnd);
+                CHECK(published <= size);
+                for (size_t i = taken; i < published; ++i)
+                {
+                    CHECK_EQUAL(Item({round, i}), queue[i]);
+                    consumed[i]++;
+                }
+                taken = published;
+            }
+        }
+        catch (...)
+        {
+            for (std::thread& producer : producers)
+                producer.join();
+            throw;
+        }
+
+        for (std::thread& producer : producers)
+            producer.join();
+
+        CHECK_EQUAL(size, queue.GetPrefix());
+        CHECK(std::all_of(consumed.begin(), consumed.end(), [](size_t count) { return count == 1; }));
+    }
+}
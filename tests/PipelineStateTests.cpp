@@ -0,0 +1,206 @@
+#include "stdafx.h"
+
+#include "Tests.h"
+
+#include <utils/PipelineStateHash.h>
+#include <utils/SharedFutureCache.h>
+
+#include <future>
+
+namespace
+{
+const char vertexShader[] = "DXBC vertex shader";
+const char pixelShader[] = "DXBC pixel shader";
+
+const D3D12_INPUT_ELEMENT_DESC inputElements[] = {
+    {"POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
+    {"TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
+};
+
+// garbage in unused fields and padding has to be ignored, so descriptions are built over a filled memory
+D3D12_GRAPHICS_PIPELINE_STATE_DESC MakeDesc(uint8_t garbage)
+{
+    D3D12_GRAPHICS_PIPELINE_STATE_DESC desc;
+    memset(&desc, garbage, sizeof(desc));
+
+    desc.pRootSignature = reinterpret_cast<ID3D12RootSignature*>((uintptr_t)garbage);
+    desc.VS = {vertexShader, sizeof(vertexShader)};
+    desc.PS = {pixelShader, sizeof(pixelShader)};
+    desc.DS = {};
+    desc.HS = {};
+    desc.GS = {};
+    desc.StreamOutput = {};
+    desc.BlendState.AlphaToCoverageEnable = FALSE;
+    desc.BlendState.IndependentBlendEnable = FALSE;
+    desc.BlendState.RenderTarget[0] = {FALSE, FALSE, D3D12_BLEND_ONE, D3D12_BLEND_ZERO, D3D12_BLEND_OP_ADD, D3D12_BLEND_ONE,
+                                       D3D12_BLEND_ZERO, D3D12_BLEND_OP_ADD, D3D12_LOGIC_OP_NOOP, D3D12_COLOR_WRITE_ENABLE_ALL};
+    desc.SampleMask = UINT_MAX;
+    desc.RasterizerState = CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT);
+    desc.DepthStencilState.DepthEnable = TRUE;
+    desc.DepthStencilState.DepthWriteMask = D3D12_DEPTH_WRITE_MASK_ALL;
+    desc.DepthStencilState.DepthFunc = D3D12_COMPARISON_FUNC_LESS;
+    desc.DepthStencilState.StencilEnable = FALSE;
+    desc.DepthStencilState.StencilReadMask = D3D12_DEFAULT_STENCIL_READ_MASK;
+    desc.DepthStencilState.StencilWriteMask = D3D12_DEFAULT_STENCIL_WRITE_MASK;
+    desc.DepthStencilState.FrontFace = {D3D12_STENCIL_OP_KEEP, D3D12_STENCIL_OP_KEEP, D3D12_STENCIL_OP_KEEP, D3D12_COMPARISON_FUNC_ALWAYS};
+    desc.DepthStencilState.BackFace = desc.DepthStencilState.FrontFace;
+    desc.InputLayout = {inputElements, _countof(inputElements)};
+    desc.IBStripCutValue = D3D12_INDEX_BUFFER_STRIP_CUT_VALUE_DISABLED;
+    desc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
+    desc.NumRenderTargets = 1;
+    desc.RTVFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM;
+    desc.DSVFormat = DXGI_FORMAT_D32_FLOAT;
+    desc.SampleDesc = {1, 0};
+    desc.NodeMask = 0;
+    desc.CachedPSO = {reinterpret_cast<void*>((uintptr_t)garbage), garbage};
+    desc.Flags = D3D12_PIPELINE_STATE_FLAG_NONE;
+    return desc;
+}
+}
+
+TEST(PipelineState, KeyIgnoresPointersAndPadding)
+{
+    // shaders and semantic names are compared by value
+    const std::string vertexCopy = vertexShader;
+    const std::string semanticCopy = inputElements[0].SemanticName;
+    D3D12_INPUT_ELEMENT_DESC elementsCopy[_countof(inputElements)] = {inputElements[0], inputElements[1]};
+    elementsCopy[0].SemanticName = semanticCopy.c_str();
+
+    const D3D12_GRAPHICS_PIPELINE_STATE_DESC first = MakeDesc(0x00);
+    D3D12_GRAPHICS_PIPELINE_STATE_DESC second = MakeDesc(0xcd);
+    second.VS = {vertexCopy.c_str(), vertexCopy.size() + 1};
+    second.InputLayout = {elementsCopy, _countof(elementsCopy)};
+
+    CHECK_EQUAL(HashPipelineState(first, 42), HashPipelineState(first, 42));
+    CHECK_EQUAL(HashPipelineState(first, 42), HashPipelineState(second, 42));
+}
+
+TEST(PipelineState, DifferentDescriptionsDontCollide)
+{
+    const D3D12_INPUT_ELEMENT_DESC otherElements[] = {
+        {"NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
+        {"TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
+    };
+    const char otherShader[] = "DXBC other shader";
+
+    // every variant changes one field of the base description
+    std::vector<std::function<void(D3D12_GRAPHICS_PIPELINE_STATE_DESC&)>> variants = {
+        [](D3D12_GRAPHICS_PIPELINE_STATE_DESC&) {},
+        [&](D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc) { desc.VS = {otherShader, sizeof(otherShader)}; },
+        [&](D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc) { desc.PS = {otherShader, sizeof(otherShader)}; },
+        [&](D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc) { desc.HS = {otherShader, sizeof(otherShader)}; },
+        [&](D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc) { desc.DS = {otherShader, sizeof(otherShader)}; },
+        // the same bytecode in another stage
+        [](D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc) { desc.GS = desc.PS; desc.PS = {}; },
+        [](D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc) { desc.BlendState.RenderTarget[0].BlendEnable = TRUE; },
+        [](D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc) { desc.BlendState.RenderTarget[0].RenderTargetWriteMask = D3D12_COLOR_WRITE_ENABLE_RED; },
+        [](D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc) { desc.SampleMask = 1; },
+        [](D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc) { desc.RasterizerState.CullMode = D3D12_CULL_MODE_NONE; },
+        [](D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc) { desc.RasterizerState.DepthBias = 1; },
+        [](D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc) { desc.DepthStencilState.DepthEnable = FALSE; },
+        [](D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc) { desc.DepthStencilState.DepthFunc = D3D12_COMPARISON_FUNC_LESS_EQUAL; },
+        [](D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc) { desc.DepthStencilState.BackFace.StencilFailOp = D3D12_STENCIL_OP_ZERO; },
+        [&](D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc) { desc.InputLayout = {otherElements, _countof(otherElements)}; },
+        [](D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc) { desc.InputLayout.NumElements = 1; },
+        [](D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc) { desc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_LINE; },
+        [](D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc) { desc.RTVFormats[0] = DXGI_FORMAT_R16G16B16A16_FLOAT; },
+        [](D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc) { desc.NumRenderTargets = 2; desc.RTVFormats[1] = DXGI_FORMAT_R8G8B8A8_UNORM; },
+        [](D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc) { desc.DSVFormat = DXGI_FORMAT_D24_UNORM_S8_UINT; },
+        [](D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc) { desc.SampleDesc.Count = 4; },
+    };
+
+    std::set<uint64_t> keys;
+    for (const auto& variant : variants)
+    {
+        D3D12_GRAPHICS_PIPELINE_STATE_DESC desc = MakeDesc(0);
+        variant(desc);
+        CHECK(keys.insert(HashPipelineState(desc, 42)).second);
+    }
+
+    // root signatures and compute pipelines with the same bytecode are different pipelines
+    CHECK(keys.insert(HashPipelineState(MakeDesc(0), 43)).second);
+    D3D12_COMPUTE_PIPELINE_STATE_DESC compute = {};
+    compute.CS = {vertexShader, sizeof(vertexShader)};
+    CHECK(keys.insert(HashPipelineState(compute, 42)).second);
+    compute.CS = {otherShader, sizeof(otherShader)};
+    CHECK(keys.insert(HashPipelineState(compute, 42)).second);
+}
+
+TEST(PipelineState, EqualKeysShareOneFuture)
+{
+    std::atomic_int creations = 0;
+    SharedFutureCache<int> cache;
+    auto create = [&creations]() { return ++creations; };
+
+    bool deduplicated = true;
+    SharedFutureCache<int>::Future first = cache.Request(1, false, create, deduplicated);
+    CHECK(!deduplicated);
+    SharedFutureCache<int>::Future second = cache.Request(1, true, create, deduplicated);
+    CHECK(deduplicated);
+    SharedFutureCache<int>::Future other = cache.Request(2, false, create, deduplicated);
+    CHECK(!deduplicated);
+
+    // deferred values are created by the first waiter
+    CHECK_EQUAL(0, creations.load());
+    CHECK_EQUAL(&first.get(), &second.get());
+    CHECK_EQUAL(1, second.get());
+    CHECK_EQUAL(2, other.get());
+    CHECK_EQUAL(2, creations.load());
+    CHECK_EQUAL(2u, cache.Size());
+}
+
+TEST(PipelineState, ConcurrentRequestsCreateOnce)
+{
+    constexpr size_t threadsCount = 8;
+    constexpr uint64_t keysCount = 64;
+
+    std::atomic_int creations = 0;
+    std::atomic_int deduplications = 0;
+    std::atomic_int wrongValues = 0;
+    SharedFutureCache<uint64_t> cache;
+    std::vector<std::thread> threads;
+    for (size_t tid = 0; tid < threadsCount; ++tid)
+    {
+        threads.emplace_back([&]()
+        {
+            for (uint64_t key = 0; key < keysCount; ++key)
+            {
+                bool deduplicated = false;
+                auto future = cache.Request(key, key % 2 == 0, [&creations, key]() { ++creations; return key; }, deduplicated);
+                deduplications += deduplicated ? 1 : 0;
+                wrongValues += future.get() != key ? 1 : 0;
+            }
+        });
+    }
+
+    for (std::thread& thread : threads)
+        thread.join();
+
+    CHECK_EQUAL((int)keysCount, creations.load());
+    CHECK_EQUAL(0, wrongValues.load());
+    CHECK_EQUAL((int)(keysCount * (threadsCount - 1)), deduplications.load());
+    CHECK_EQUAL(0u, cache.PendingCount());
+}
+
+// the light pass is drawn with its fallback while the background request isn't ready
+TEST(PipelineState, BackgroundRequestIsPendingUntilCreated)
+{
+    std::promise<void> compiled;
+    std::shared_future<void> gate = compiled.get_future().share();
+    std::atomic_int idleCalls = 0;
+    SharedFutureCache<int> cache {[&idleCalls]() { ++idleCalls; }};
+
+    bool deduplicated = false;
+    SharedFutureCache<int>::Future pipeline = cache.Request(1, true, [gate]() { gate.wait(); return 1; }, deduplicated);
+    SharedFutureCache<int>::Future fallback = cache.Request(2, false, []() { return 2; }, deduplicated);
+
+    CHECK_EQUAL(1u, cache.PendingCount());
+    CHECK(pipeline.wait_for(std::chrono::milliseconds(10)) == std::future_status::timeout);
+    CHECK_EQUAL(2, fallback.get());
+    CHECK_EQUAL(0, idleCalls.load());
+
+    compiled.set_value();
+    CHECK_EQUAL(1, pipeline.get());
+    CHECK_EQUAL(0u, cache.PendingCount());
+    CHECK_EQUAL(1, idleCalls.load());
+}
@@ -0,0 +1,206 @@
+#include "stdafx.h"
+
+#include "Tests.h"
+
+#include <utils/RootSignature.h>
+#include <utils/RootSignatureRegistry.h>
+
+namespace
+{
+// Table of two ranges, 5 root constants, a root CBV and a static sampler. Unused bytes of the parameters
+// are filled with garbage, and every description has its own copy of the arrays, so only values are shared.
+struct Signature
+{
+    std::vector<D3D12_DESCRIPTOR_RANGE>     ranges;
+    std::vector<D3D12_ROOT_PARAMETER>       parameters;
+    std::vector<D3D12_STATIC_SAMPLER_DESC>  samplers;
+
+    explicit Signature(uint8_t garbage)
+    {
+        ranges.resize(2);
+        ranges[0] = {D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 2, 0, 0, D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND};
+        ranges[1] = {D3D12_DESCRIPTOR_RANGE_TYPE_CBV, 1, 0, 0, D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND};
+
+        parameters.resize(3);
+        memset(parameters.data(), garbage, parameters.size() * sizeof(D3D12_ROOT_PARAMETER));
+        parameters[0].ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
+        parameters[0].ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
+        parameters[1].ParameterType = D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS;
+        parameters[1].Constants = {1, 0, 5};
+        parameters[1].ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
+        parameters[2].ParameterType = D3D12_ROOT_PARAMETER_TYPE_CBV;
+        parameters[2].Descriptor = {2, 0};
+        parameters[2].ShaderVisibility = D3D12_SHADER_VISIBILITY_VERTEX;
+
+        D3D12_STATIC_SAMPLER_DESC sampler = {};
+        sampler.Filter = D3D12_FILTER_MIN_MAG_MIP_LINEAR;
+        sampler.AddressU = D3D12_TEXTURE_ADDRESS_MODE_WRAP;
+        sampler.AddressV = D3D12_TEXTURE_ADDRESS_MODE_WRAP;
+        sampler.AddressW = D3D12_TEXTURE_ADDRESS_MODE_WRAP;
+        sampler.ComparisonFunc = D3D12_COMPARISON_FUNC_NEVER;
+        sampler.MaxLOD = D3D12_FLOAT32_MAX;
+        sampler.ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
+        samplers.push_back(sampler);
+    }
+
+    D3D12_ROOT_SIGNATURE_DESC Desc()
+    {
+        parameters[0].DescriptorTable = {(UINT)ranges.size(), ranges.data()};
+        return {(UINT)parameters.size(), parameters.data(), (UINT)samplers.size(), samplers.data(),
+                D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT};
+    }
+};
+
+const std::filesystem::path cacheDirectory = std::filesystem::temp_directory_path() / "utils_tests_root_signatures";
+}
+
+TEST(RootSignatureRegistry, HashIgnoresPointersAndUnusedMembers)
+{
+    Signature signature {0x00};
+    Signature copy {0xcd};
+    CHECK_EQUAL(HashRootSignature(signature.Desc()), HashRootSignature(copy.Desc()));
+}
+
+TEST(RootSignatureRegistry, HashDependsOnEveryValue)
+{
+    const uint64_t hash = HashRootSignature(Signature {0}.Desc());
+
+    struct Change
+    {
+        const char* name;
+        void (*apply)(Signature&);
+    };
+
+    const Change changes[] =
+    {
+        {"range register", [](Signature& s) { s.ranges[1].BaseShaderRegister = 1; }},
+        {"range type", [](Signature& s) { s.ranges[0].RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_UAV; }},
+        {"ranges count", [](Signature& s) { s.ranges.pop_back(); }},
+        {"visibility", [](Signature& s) { s.parameters[0].ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL; }},
+        {"constants count", [](Signature& s) { s.parameters[1].Constants.Num32BitValues = 4; }},
+        {"descriptor space", [](Signature& s) { s.parameters[2].Descriptor.RegisterSpace = 1; }},
+        {"descriptor type", [](Signature& s) { s.parameters[2].ParameterType = D3D12_ROOT_PARAMETER_TYPE_SRV; }},
+        {"parameters order", [](Signature& s) { std::swap(s.parameters[1], s.parameters[2]); }},
+        {"parameters count", [](Signature& s) { s.parameters.pop_back(); }},
+        {"sampler filter", [](Signature& s) { s.samplers[0].Filter = D3D12_FILTER_MIN_MAG_MIP_POINT; }},
+        {"samplers count", [](Signature& s) { s.samplers.clear(); }},
+    };
+
+    std::set<uint64_t> hashes = {hash};
+    for (const Change& change : changes)
+    {
+        Signature changed {0};
+        change.apply(changed);
+        if (!hashes.insert(HashRootSignature(changed.Desc())).second)
+            Tests::Fail(__FILE__, __LINE__, std::string("hash doesn't depend on ") + change.name);
+    }
+
+    Signature noFlags {0};
+    D3D12_ROOT_SIGNATURE_DESC desc = noFlags.Desc();
+    desc.Flags = D3D12_ROOT_SIGNATURE_FLAG_NONE;
+    CHECK(hashes.insert(HashRootSignature(desc)).second);
+}
+
+// tables cost 1 DWORD, root descriptors 2 and constants 1 per value
+TEST(RootSignatureRegistry, CostCountsDwords)
+{
+    Signature signature {0};
+    CHECK_EQUAL(8u, GetRootSignatureCost(signature.Desc()));
+
+    signature.parameters[1].Constants.Num32BitValues = 60;
+    CHECK_EQUAL(63u, GetRootSignatureCost(signature.Desc()));
+
+    const D3D12_ROOT_SIGNATURE_DESC empty = {};
+    CHECK_EQUAL(0u, GetRootSignatureCost(empty));
+}
+
+// signatures are created on WARP device, the sandbox without D3D12 runtime only reports that the test was skipped
+TEST(RootSignatureRegistry, SharesSignaturesAndCachesBlobs)
+{
+    ComPtr<ID3D12Device> device = Tests::CreateWarpDevice();
+    if (!device)
+    {
+        Tests::Log() << "    WARP device isn't available, the registry isn't checked" << std::endl;
+        return;
+    }
+
+    std::filesystem::remove_all(cacheDirectory);
+
+    Signature signature {0};
+    Signature copy {0xcd};
+    Signature other {0};
+    other.parameters.pop_back();
+    {
+        RootSignatureRegistry registry {device, cacheDirectory.string()};
+        ComPtr<ID3D12RootSignature> first = registry.Create(signature.Desc(), "first");
+        CHECK(first.Get() == registry.Create(copy.Desc(), "copy").Get());
+        CHECK(first.Get() != registry.Create(other.Desc(), "other").Get());
+
+        CHECK_EQUAL(3u, registry.Statistics().requests);
+        CHECK_EQUAL(1u, registry.Statistics().deduplicated);
+        CHECK_EQUAL(2u, registry.Statistics().serialized);
+        CHECK_EQUAL(0u, registry.Statistics().loadedFromDisk);
+
+        std::ostringstream report;
+        registry.DumpReport(report);
+        CHECK(report.str().find("copy: 8/64 DWORDs (1 table + 5 constants + 2 CBV), same as first") != std::string::npos);
+    }
+
+    // the next start loads both blobs
+    std::vector<std::filesystem::path> files;
+    for (const auto& file : std::filesystem::directory_iterator(cacheDirectory))
+        files.push_back(file.path());
+    CHECK_EQUAL(2u, files.size());
+    {
+        RootSignatureRegistry registry {device, cacheDirectory.string()};
+        registry.Create(signature.Desc(), "first");
+        registry.Create(other.Desc(), "other");
+        CHECK_EQUAL(2u, registry.Statistics().loadedFromDisk);
+        CHECK_EQUAL(0u, registry.Statistics().serialized);
+    }
+
+    // broken blobs are serialized again and replaced
+    for (const std::filesystem::path& file : files)
+        std::ofstream(file, std::ios::binary) << "DXBC broken";
+    {
+        RootSignatureRegistry registry {device, cacheDirectory.string()};
+        registry.Create(signature.Desc(), "first");
+        registry.Create(other.Desc(), "other");
+        CHECK_EQUAL(0u, registry.Statistics().loadedFromDisk);
+        CHECK_EQUAL(2u, registry.Statistics().serialized);
+    }
+    {
+        RootSignatureRegistry registry {device, cacheDirectory.string()};
+        registry.Create(signature.Desc(), "first");
+        CHECK_EQUAL(1u, registry.Statistics().loadedFromDisk);
+    }
+
+    std::filesystem::remove_all(cacheDirectory);
+}
+
+// the textures heap of bindless materials is one unbounded range in its own register space
+TEST(RootSignatureRegistry, UnboundedTableKeepsRegisterSpace)
+{
+    RootParameter textures;
+    textures.InitAsDescriptorsTable(1, D3D12_SHADER_VISIBILITY_PIXEL);
+    textures.InitTableRange(0, 0, UINT_MAX, D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1);
+
+    const D3D12_ROOT_PARAMETER& parameter = textures;
+    CHECK_EQUAL(1u, parameter.DescriptorTable.NumDescriptorRanges);
+    const D3D12_DESCRIPTOR_RANGE& range = parameter.DescriptorTable.pDescriptorRanges[0];
+    CHECK_EQUAL(UINT_MAX, range.NumDescriptors);
+    CHECK_EQUAL(1u, range.RegisterSpace);
+    CHECK_EQUAL(0u, range.BaseShaderRegister);
+    CHECK_EQUAL((UINT)D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND, range.OffsetInDescriptorsFromTableStart);
+
+    // the whole heap costs one DWORD, and the space tells it from a table of t0
+    D3D12_ROOT_SIGNATURE_DESC desc = {1, &parameter};
+    CHECK_EQUAL(1u, GetRootSignatureCost(desc));
+    const uint64_t hash = HashRootSignature(desc);
+
+    RootParameter defaultSpace;
+    defaultSpace.InitAsDescriptorsTable(1, D3D12_SHADER_VISIBILITY_PIXEL);
+    defaultSpace.InitTableRange(0, 0, UINT_MAX, D3D12_DESCRIPTOR_RANGE_TYPE_SRV);
+    desc.pParameters = &static_cast<const D3D12_ROOT_PARAMETER&>(defaultSpace);
+    CHECK(hash != HashRootSignature(desc));
+}
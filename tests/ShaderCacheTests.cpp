@@ -0,0 +1,248 @@
+#include "stdafx.h"
+
+#include "Tests.h"
+
+#include <utils/ShaderCache.h>
+#include <utils/Shaders.h>
+
+#include <iomanip>
+
+namespace
+{
+// Files are kept in memory, "#include name" lines are replaced by the content of the file like D3DPreprocess
+// does, defined macros are appended, so the source depends on everything the real preprocessor sees.
+struct FakeShaders
+{
+    std::map<std::wstring, std::string> files;
+    size_t                              compilations = 0;
+    std::string                         lastProfile;
+    uint32_t                            lastFlags = 0;
+
+    std::string Preprocess(const std::wstring& fileName, const D3D_SHADER_MACRO* macro) const
+    {
+        auto it = files.find(fileName);
+        if (it == files.end())
+            throw std::runtime_error("Unable to open shader");
+
+        std::istringstream lines {it->second};
+        std::string result;
+        for (std::string line; std::getline(lines, line);)
+        {
+            const std::string includeDirective = "#include ";
+            if (line.compare(0, includeDirective.size(), includeDirective) == 0)
+            {
+                const std::string include = line.substr(includeDirective.size());
+                result += Preprocess(std::wstring(include.begin(), include.end()), nullptr);
+            }
+            else
+            {
+                result += line + "\n";
+            }
+        }
+
+        for (; macro && macro->Name; ++macro)
+            result += std::string("// ") + macro->Name + "=" + (macro->Definition ? macro->Definition : "") + "\n";
+        return result;
+    }
+
+    // the bytecode is a DXBC header followed by the source, so loaded files can be compared with it
+    ComPtr<ID3DBlob> Compile(const std::string& source, const std::string& profile, uint32_t flags)
+    {
+        compilations++;
+        lastProfile = profile;
+        lastFlags = flags;
+        return CreateBytecode(source);
+    }
+
+    static ComPtr<ID3DBlob> CreateBytecode(const std::string& payload)
+    {
+        const uint32_t header[8] = {0, 0, 0, 0, 0, 1, uint32_t(32 + payload.size()), 0};
+        ComPtr<ID3DBlob> bytecode;
+        ThrowIfFailed(D3DCreateBlob(sizeof(header) + payload.size(), &bytecode));
+
+        uint8_t* data = static_cast<uint8_t*>(bytecode->GetBufferPointer());
+        memcpy(data, header, sizeof(header));
+        memcpy(data, "DXBC", 4);
+        memcpy(data + sizeof(header), payload.data(), payload.size());
+        return bytecode;
+    }
+
+    ShaderCache CreateCache(const std::string& directory)
+    {
+        return ShaderCache(directory,
+                           [this](const std::wstring& fileName, const D3D_SHADER_MACRO* macro) { return Preprocess(fileName, macro); },
+                           [this](const std::string& source, const std::string&, const std::string&, const std::string& profile, uint32_t flags)
+                           {
+                               return Compile(source, profile, flags);
+                           });
+    }
+};
+
+std::string CreateCacheDirectory()
+{
+    const std::filesystem::path directory = std::filesystem::temp_directory_path() / "utils_tests_shader_cache";
+    std::filesystem::remove_all(directory);
+    return directory.string();
+}
+
+std::string GetCacheFileName(const std::string& directory, uint64_t key)
+{
+    std::ostringstream fileName;
+    fileName << directory << "/" << std::hex << std::setw(16) << std::setfill('0') << key << ".cso";
+    return fileName.str();
+}
+
+std::string ToString(ID3DBlob* blob)
+{
+    return std::string(static_cast<const char*>(blob->GetBufferPointer()), blob->GetBufferSize());
+}
+
+const D3D_SHADER_MACRO shadowMacros[] = {{"ShadowMapping", "1"}, {nullptr, nullptr}};
+}
+
+TEST(ShaderCache, HitSkipsCompiler)
+{
+    const std::string directory = CreateCacheDirectory();
+    FakeShaders shaders;
+    shaders.files[L"Light.hlsl"] = "float4 ps_main() : SV_TARGET { return 1; }\n";
+
+    ComPtr<ID3DBlob> compiled = shaders.CreateCache(directory).CompileFromFile(L"Light.hlsl", ShaderType::Pixel, shadowMacros);
+    CHECK(compiled);
+    CHECK_EQUAL(size_t(1), shaders.compilations);
+    CHECK_EQUAL(ShadersUtils::GetShaderVersion(ShaderType::Pixel), shaders.lastProfile);
+    CHECK_EQUAL(ShadersUtils::GetCompileFlags(), shaders.lastFlags);
+
+    // a new cache object reads the same directory like the next run of the sample
+    ShaderCache cache = shaders.CreateCache(directory);
+    ComPtr<ID3DBlob> loaded = cache.CompileFromFile(L"Light.hlsl", ShaderType::Pixel, shadowMacros);
+    CHECK(loaded);
+    CHECK_EQUAL(size_t(1), shaders.compilations);
+    CHECK_EQUAL(size_t(1), cache.Statistics().hits);
+    CHECK_EQUAL(size_t(0), cache.Statistics().misses);
+    CHECK(ToString(compiled.Get()) == ToString(loaded.Get()));
+}
+
+TEST(ShaderCache, MacrosMiss)
+{
+    const std::string directory = CreateCacheDirectory();
+    FakeShaders shaders;
+    shaders.files[L"Depth.hlsl"] = "float4 vs_main() : SV_POSITION { return 0; }\n";
+    ShaderCache cache = shaders.CreateCache(directory);
+
+    const D3D_SHADER_MACRO otherValue[] = {{"ShadowMapping", "0"}, {nullptr, nullptr}};
+    const D3D_SHADER_MACRO otherName[] = {{"UseTextures", "1"}, {nullptr, nullptr}};
+    const D3D_SHADER_MACRO added[] = {{"ShadowMapping", "1"}, {"UseTextures", "1"}, {nullptr, nullptr}};
+    const D3D_SHADER_MACRO noDefinition[] = {{"ShadowMapping", nullptr}, {nullptr, nullptr}};
+
+    for (const D3D_SHADER_MACRO* macro : {(const D3D_SHADER_MACRO*)nullptr, shadowMacros, otherValue, otherName, added, noDefinition})
+        cache.CompileFromFile(L"Depth.hlsl", ShaderType::Vertex, macro);
+    CHECK_EQUAL(size_t(6), shaders.compilations);
+    CHECK_EQUAL(size_t(6), cache.Statistics().misses);
+
+    cache.CompileFromFile(L"Depth.hlsl", ShaderType::Vertex, shadowMacros);
+    CHECK_EQUAL(size_t(6), shaders.compilations);
+    CHECK_EQUAL(size_t(1), cache.Statistics().hits);
+}
+
+TEST(ShaderCache, IncludeContentMisses)
+{
+    const std::string directory = CreateCacheDirectory();
+    FakeShaders shaders;
+    shaders.files[L"MRT.hlsl"] = "#include Common.hlsl\nfloat4 ps_main() : SV_TARGET { return color; }\n";
+    shaders.files[L"Common.hlsl"] = "static const float4 color = 1;\n";
+    ShaderCache cache = shaders.CreateCache(directory);
+
+    cache.CompileFromFile(L"MRT.hlsl", ShaderType::Pixel);
+    shaders.files[L"Common.hlsl"] = "static const float4 color = 0.5;\n";
+    cache.CompileFromFile(L"MRT.hlsl", ShaderType::Pixel);
+    CHECK_EQUAL(size_t(2), shaders.compilations);
+
+    // the old content is cached too
+    shaders.files[L"Common.hlsl"] = "static const float4 color = 1;\n";
+    cache.CompileFromFile(L"MRT.hlsl", ShaderType::Pixel);
+    CHECK_EQUAL(size_t(2), shaders.compilations);
+    CHECK_EQUAL(size_t(1), cache.Statistics().hits);
+}
+
+TEST(ShaderCache, FlagsAndProfileMiss)
+{
+    const std::string directory = CreateCacheDirectory();
+    FakeShaders shaders;
+    shaders.files[L"Quad.hlsl"] = "float4 vs_main() : SV_POSITION { return 0; }\nfloat4 ps_main() : SV_TARGET { return 0; }\n";
+
+    const std::string source = shaders.Preprocess(L"Quad.hlsl", nullptr);
+    const std::string entryPoint = ShadersUtils::GetEntryPoint(ShaderType::Vertex);
+    const std::string profile = ShadersUtils::GetShaderVersion(ShaderType::Vertex);
+    const uint32_t flags = ShadersUtils::GetCompileFlags();
+
+    const uint64_t key = ShaderCache::ComputeKey(source, nullptr, entryPoint, profile, flags);
+    const uint64_t otherFlagsKey = ShaderCache::ComputeKey(source, nullptr, entryPoint, profile, flags ^ D3DCOMPILE_SKIP_OPTIMIZATION);
+    const uint64_t otherProfileKey = ShaderCache::ComputeKey(source, nullptr, entryPoint, "vs_5_0", flags);
+    CHECK(key != otherFlagsKey);
+    CHECK(key != otherProfileKey);
+
+    // bytecode compiled with other flags or profile is in the cache, but it isn't taken
+    std::filesystem::create_directories(directory);
+    for (uint64_t otherKey : {otherFlagsKey, otherProfileKey})
+    {
+        ComPtr<ID3DBlob> bytecode = FakeShaders::CreateBytecode("other");
+        std::ofstream file {GetCacheFileName(directory, otherKey), std::ios::binary};
+        file.write(static_cast<const char*>(bytecode->GetBufferPointer()), bytecode->GetBufferSize());
+    }
+
+    ShaderCache cache = shaders.CreateCache(directory);
+    ComPtr<ID3DBlob> bytecode = cache.CompileFromFile(L"Quad.hlsl", ShaderType::Vertex);
+    CHECK_EQUAL(size_t(1), shaders.compilations);
+    CHECK(ToString(FakeShaders::CreateBytecode(source).Get()) == ToString(bytecode.Get()));
+    CHECK(std::filesystem::exists(GetCacheFileName(directory, key)));
+
+    // the same source with another profile and entry point
+    cache.CompileFromFile(L"Quad.hlsl", ShaderType::Pixel);
+    CHECK_EQUAL(size_t(2), shaders.compilations);
+    CHECK_EQUAL(ShadersUtils::GetShaderVersion(ShaderType::Pixel), shaders.lastProfile);
+}
+
+TEST(ShaderCache, DamagedFilesRecompile)
+{
+    const std::string directory = CreateCacheDirectory();
+    FakeShaders shaders;
+    shaders.files[L"Light.hlsl"] = "float4 ps_main() : SV_TARGET { return 1; }\n";
+
+    const std::string source = shaders.Preprocess(L"Light.hlsl", nullptr);
+    const uint64_t key = ShaderCache::ComputeKey(source,
+                                                 nullptr,
+                                                 ShadersUtils::GetEntryPoint(ShaderType::Pixel),
+                                                 ShadersUtils::GetShaderVersion(ShaderType::Pixel),
+                                                 ShadersUtils::GetCompileFlags());
+    const std::string fileName = GetCacheFileName(directory, key);
+    const std::string bytecode = ToString(FakeShaders::CreateBytecode(source).Get());
+
+    // empty, shorter than the header, cut after the header, foreign file of the right size
+    const std::string damagedFiles[] = {
+        "",
+        bytecode.substr(0, 16),
+        bytecode.substr(0, bytecode.size() - 1),
+        "DXBD" + bytecode.substr(4),
+        std::string(bytecode.size(), 'x'),
+    };
+
+    for (const std::string& damaged : damagedFiles)
+    {
+        shaders.CreateCache(directory).CompileFromFile(L"Light.hlsl", ShaderType::Pixel);
+        {
+            std::ofstream file {fileName, std::ios::binary | std::ios::trunc};
+            file.write(damaged.data(), damaged.size());
+        }
+
+        const size_t compilations = shaders.compilations;
+        ShaderCache cache = shaders.CreateCache(directory);
+        ComPtr<ID3DBlob> loaded = cache.CompileFromFile(L"Light.hlsl", ShaderType::Pixel);
+        CHECK_EQUAL(compilations + 1, shaders.compilations);
+        CHECK_EQUAL(size_t(1), cache.Statistics().misses);
+        CHECK(bytecode == ToString(loaded.Get()));
+
+        // the file is written again
+        cache.CompileFromFile(L"Light.hlsl", ShaderType::Pixel);
+        CHECK_EQUAL(size_t(1), cache.Statistics().hits);
+    }
+}
@@ -0,0 +1,118 @@
+#include "stdafx.h"
+
+#include "Tests.h"
+
+#include <utils/AssetPack.h>
+#include <utils/ShaderPermutations.h>
+
+using namespace ShaderPermutations;
+
+namespace
+{
+// every combination of options which change shader features, bindless textures are already checked against the device
+std::vector<CommandLineOptions> EnumerateOptions()
+{
+    std::vector<CommandLineOptions> allOptions;
+    for (uint32_t flags = 0; flags < (1u << 6); ++flags)
+    {
+        for (DrawDataMode mode : {DrawDataMode::ConstantBuffer, DrawDataMode::RootConstants, DrawDataMode::StructuredBuffer})
+        {
+            CommandLineOptions options;
+            options.root_constants = (flags & 1) != 0;
+            options.textures = (flags & 2) != 0;
+            options.bindless_textures = (flags & 4) != 0;
+            options.tessellation = (flags & 8) != 0;
+            options.packed_vertices = (flags & 16) != 0;
+            options.shadow_pass = (flags & 32) != 0;
+            options.draw_data = mode;
+            allOptions.push_back(options);
+        }
+    }
+    return allOptions;
+}
+}
+
+TEST(ShaderPermutations, EnumeratedVariantsAreValidAndUnique)
+{
+    std::set<std::string> names;
+    for (const Permutation& permutation : Enumerate())
+    {
+        CHECK(IsValid(permutation.shader, permutation.features));
+        const std::vector<ShaderType> stages = GetStages(permutation.shader, permutation.features);
+        CHECK(std::find(stages.begin(), stages.end(), permutation.stage) != stages.end());
+        CHECK(names.insert(GetEntryName(permutation)).second);
+    }
+
+    // every shader has at least its default variant
+    for (size_t shader = 0; shader < (size_t)ShaderId::Count; ++shader)
+        CHECK(IsValid((ShaderId)shader, 0));
+}
+
+// the sample never compiles shaders at runtime when the pack is cooked
+TEST(ShaderPermutations, RuntimeFeaturesArePrecompiled)
+{
+    const std::vector<Permutation> permutations = Enumerate();
+    std::set<std::string> names;
+    for (const Permutation& permutation : permutations)
+        names.insert(GetEntryName(permutation));
+
+    // entries hold their names instead of bytecode, so the table is checked to find the right ones
+    const std::string packFileName = (std::filesystem::temp_directory_path() / "utils_tests_permutations.pack").string();
+    {
+        AssetPack::Writer writer {packFileName};
+        for (const Permutation& permutation : permutations)
+        {
+            const std::string name = GetEntryName(permutation);
+            writer.AddData(name, AssetPack::EntryType::Shader, name.data(), name.size());
+        }
+        writer.Finish();
+    }
+
+    AssetPack::Reader pack {packFileName};
+    Table table {pack};
+    CHECK_EQUAL(permutations.size(), table.Size());
+
+    for (const CommandLineOptions& options : EnumerateOptions())
+    {
+        for (size_t shader = 0; shader < (size_t)ShaderId::Count; ++shader)
+        {
+            const uint32_t features = GetFeatures((ShaderId)shader, options);
+            CHECK(IsValid((ShaderId)shader, features));
+
+            for (ShaderType stage : GetStages((ShaderId)shader, features))
+            {
+                const std::string name = GetEntryName({(ShaderId)shader, stage, features});
+                CHECK(names.count(name) != 0);
+
+                ComPtr<ID3DBlob> bytecode = table.Find((ShaderId)shader, stage, features);
+                CHECK(bytecode);
+                CHECK_EQUAL(name, std::string(static_cast<const char*>(bytecode->GetBufferPointer()), bytecode->GetBufferSize()));
+            }
+        }
+    }
+}
+
+// the textures heap is indexed by materials only when textures are on, other passes don't sample textures
+TEST(ShaderPermutations, BindlessTexturesNeedTextures)
+{
+    CHECK(IsValid(ShaderId::MRTPass, UseTextures | BindlessTextures));
+    CHECK(!IsValid(ShaderId::MRTPass, BindlessTextures));
+    CHECK(!IsValid(ShaderId::DepthPass, BindlessTextures));
+
+    CommandLineOptions options;
+    options.textures = true;
+    options.bindless_textures = true;
+    CHECK_EQUAL((uint32_t)(UseTextures | BindlessTextures), GetFeatures(ShaderId::MRTPass, options) & (UseTextures | BindlessTextures));
+    CHECK_EQUAL(0u, GetFeatures(ShaderId::DepthPass, options) & BindlessTextures);
+
+    options.bindless_textures = false;
+    CHECK_EQUAL((uint32_t)UseTextures, GetFeatures(ShaderId::MRTPass, options) & (UseTextures | BindlessTextures));
+
+    options.textures = false;
+    options.bindless_textures = true;
+    CHECK_EQUAL(0u, GetFeatures(ShaderId::MRTPass, options) & (UseTextures | BindlessTextures));
+
+    // names keep the feature above the first two hex digits
+    const std::string name = GetEntryName({ShaderId::MRTPass, ShaderType::Pixel, UseTextures | BindlessTextures});
+    CHECK_EQUAL(std::string("shaders/MRTPass/ps/102"), name);
+}
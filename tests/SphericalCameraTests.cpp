@@ -0,0 +1,108 @@
+#include "stdafx.h"
+
+#include "Tests.h"
+
+#include <utils/SphericalCamera.h>
+
+using Graphics::ProjectionType;
+using Graphics::SphericalCamera;
+
+namespace
+{
+// tan(fov / 2) = 1, so a sphere of radius r at distance d covers r / d of the half of the screen height
+SphericalCamera CreateCamera(ProjectionType type)
+{
+    return SphericalCamera(type, 0.1f, 100.0f, 2.0f * std::atan(1.0f), 800.0f, 600.0f);
+}
+
+// spheres around the camera, every 16th one contains the eye
+std::vector<XMFLOAT4> CreateSpheres(const XMFLOAT4& eye, size_t count)
+{
+    std::mt19937 generator {5};
+    auto random = [&](float from, float to) { return from + (to - from) * (generator() / 4294967296.0f); };
+
+    std::vector<XMFLOAT4> spheres(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        spheres[i] = {random(-50.0f, 50.0f), random(-50.0f, 50.0f), random(-50.0f, 50.0f), random(0.1f, 5.0f)};
+        if (i % 16 == 0)
+            spheres[i] = {eye.x + 0.5f, eye.y - 1.0f, eye.z, 2.0f};
+    }
+    return spheres;
+}
+}
+
+TEST(SphericalCamera, ProjectedRadiusMatchesPinholeProjection)
+{
+    SphericalCamera camera = CreateCamera(ProjectionType::Perspective);
+    camera.SetRadius(10.0f);
+    const XMFLOAT4 eye = camera.GetEyePosition();
+    CHECK_NEAR(10.0, std::sqrt(eye.x * eye.x + eye.y * eye.y + eye.z * eye.z), 1e-5);
+
+    CHECK_NEAR(30.0, camera.GetProjectedRadius({0.0f, 0.0f, 0.0f}, 1.0f), 1e-3);
+    CHECK_NEAR(60.0, camera.GetProjectedRadius({0.0f, 0.0f, 0.0f}, 2.0f), 1e-3);
+    CHECK_NEAR(30.0, camera.GetProjectedRadius({-eye.x, -eye.y, -eye.z}, 2.0f), 1e-3);
+
+    // the sphere around the eye covers the whole screen
+    CHECK_EQUAL(600.0f, camera.GetProjectedRadius({eye.x, eye.y + 1.0f, eye.z}, 2.0f));
+
+    // orthographic view size is set in world units
+    SphericalCamera orthographic = CreateCamera(ProjectionType::Orthographic);
+    CHECK_EQUAL(2.5f, orthographic.GetProjectedRadius({0.0f, 0.0f, 0.0f}, 2.5f));
+}
+
+// four spheres per iteration and the scalar tail give the same radii as one sphere at a time
+TEST(SphericalCamera, ProjectedRadiiMatchScalarPath)
+{
+    for (ProjectionType type : {ProjectionType::Perspective, ProjectionType::Orthographic})
+    {
+        SphericalCamera camera = CreateCamera(type);
+        camera.SetCenter({1.0f, 2.0f, 3.0f});
+        camera.SetRadius(20.0f);
+        camera.SetRotation(30.0f);
+        camera.SetInclination(70.0f);
+
+        for (size_t count : {0, 3, 4, 1023})
+        {
+            const std::vector<XMFLOAT4> spheres = CreateSpheres(camera.GetEyePosition(), count);
+            std::vector<float> radii(count, -1.0f);
+            camera.GetProjectedRadii(spheres.data(), count, radii.data());
+
+            for (size_t i = 0; i < count; ++i)
+            {
+                const float expected = camera.GetProjectedRadius({spheres[i].x, spheres[i].y, spheres[i].z}, spheres[i].w);
+                CHECK_NEAR(expected, radii[i], expected * 1e-5);
+            }
+        }
+    }
+}
+
+BENCHMARK(SphericalCamera, ProjectedRadii)
+{
+    SphericalCamera camera = CreateCamera(ProjectionType::Perspective);
+    camera.SetRadius(20.0f);
+    const std::vector<XMFLOAT4> spheres = CreateSpheres(camera.GetEyePosition(), 1 << 16);
+    std::vector<float> radii(spheres.size());
+
+    // the best of several runs, like a frame with the same view
+    for (bool batched : {false, true})
+    {
+        double bestTime = std::numeric_limits<double>::max();
+        for (size_t run = 0; run < 5; ++run)
+        {
+            auto start = std::chrono::high_resolution_clock::now();
+            if (batched)
+                camera.GetProjectedRadii(spheres.data(), spheres.size(), radii.data());
+            else
+            {
+                for (size_t i = 0; i < spheres.size(); ++i)
+                    radii[i] = camera.GetProjectedRadius({spheres[i].x, spheres[i].y, spheres[i].z}, spheres[i].w);
+            }
+            std::chrono::duration<double> time = std::chrono::high_resolution_clock::now() - start;
+            bestTime = std::min(bestTime, time.count());
+        }
+
+        Tests::Log() << "    " << (batched ? "GetProjectedRadii: " : "GetProjectedRadius: ") << spheres.size() / bestTime / 1e6
+                     << " MSpheres/s" << std::endl;
+    }
+}
@@ -0,0 +1,148 @@
+#include "stdafx.h"
+
+#include "Tests.h"
+
+#include <utils/SubresourceStaging.h>
+
+namespace
+{
+struct ExpectedLayout
+{
+    UINT64                      offset;
+    D3D12_SUBRESOURCE_FOOTPRINT footprint;
+    UINT                        numRows;
+    UINT64                      rowSizeInBytes;
+};
+
+struct FootprintsCase
+{
+    const char*                 name;
+    D3D12_RESOURCE_DESC         desc;
+    UINT                        firstSubresource;
+    UINT                        numSubresources;
+    UINT64                      baseOffset;
+    UINT64                      totalBytes;
+    std::vector<ExpectedLayout> layouts;
+};
+
+// Results of ID3D12Device::GetCopyableFootprints, FootprintsTableMatchesDevice checks the table against WARP device
+// where it can be created. Footprints of BC formats cover whole blocks, the last row isn't padded.
+const FootprintsCase footprintsCases[] = {
+    {"buffer", CD3DX12_RESOURCE_DESC::Buffer(1000), 0, 1, 0, 1000, {
+        {0, {DXGI_FORMAT_UNKNOWN, 1000, 1, 1, 1024}, 1, 1000},
+    }},
+    {"buffer at offset", CD3DX12_RESOURCE_DESC::Buffer(70000), 0, 1, 1024, 70000, {
+        {1024, {DXGI_FORMAT_UNKNOWN, 70000, 1, 1, 70144}, 1, 70000},
+    }},
+    {"BC1 5x7 with mips", CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_BC1_UNORM, 5, 7, 1, 3), 0, 3, 0, 1032, {
+        {0, {DXGI_FORMAT_BC1_UNORM, 8, 8, 1, 256}, 2, 16},
+        {512, {DXGI_FORMAT_BC1_UNORM, 4, 4, 1, 256}, 1, 8},
+        {1024, {DXGI_FORMAT_BC1_UNORM, 4, 4, 1, 256}, 1, 8},
+    }},
+    {"BC7 130x66 full chain", CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_BC7_UNORM, 130, 66, 1, 8), 0, 8, 0, 21008, {
+        {0, {DXGI_FORMAT_BC7_UNORM, 132, 68, 1, 768}, 17, 528},
+        {13312, {DXGI_FORMAT_BC7_UNORM, 68, 36, 1, 512}, 9, 272},
+        {17920, {DXGI_FORMAT_BC7_UNORM, 32, 16, 1, 256}, 4, 128},
+        {18944, {DXGI_FORMAT_BC7_UNORM, 16, 8, 1, 256}, 2, 64},
+        {19456, {DXGI_FORMAT_BC7_UNORM, 8, 4, 1, 256}, 1, 32},
+        {19968, {DXGI_FORMAT_BC7_UNORM, 4, 4, 1, 256}, 1, 16},
+        {20480, {DXGI_FORMAT_BC7_UNORM, 4, 4, 1, 256}, 1, 16},
+        {20992, {DXGI_FORMAT_BC7_UNORM, 4, 4, 1, 256}, 1, 16},
+    }},
+    {"BC7 1024x1024 full chain", CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_BC7_UNORM, 1024, 1024, 1, 11), 0, 11, 0, 1401360, {
+        {0, {DXGI_FORMAT_BC7_UNORM, 1024, 1024, 1, 4096}, 256, 4096},
+        {1048576, {DXGI_FORMAT_BC7_UNORM, 512, 512, 1, 2048}, 128, 2048},
+        {1310720, {DXGI_FORMAT_BC7_UNORM, 256, 256, 1, 1024}, 64, 1024},
+        {1376256, {DXGI_FORMAT_BC7_UNORM, 128, 128, 1, 512}, 32, 512},
+        {1392640, {DXGI_FORMAT_BC7_UNORM, 64, 64, 1, 256}, 16, 256},
+        {1396736, {DXGI_FORMAT_BC7_UNORM, 32, 32, 1, 256}, 8, 128},
+        {1398784, {DXGI_FORMAT_BC7_UNORM, 16, 16, 1, 256}, 4, 64},
+        {1399808, {DXGI_FORMAT_BC7_UNORM, 8, 8, 1, 256}, 2, 32},
+        {1400320, {DXGI_FORMAT_BC7_UNORM, 4, 4, 1, 256}, 1, 16},
+        {1400832, {DXGI_FORMAT_BC7_UNORM, 4, 4, 1, 256}, 1, 16},
+        {1401344, {DXGI_FORMAT_BC7_UNORM, 4, 4, 1, 256}, 1, 16},
+    }},
+    {"RGBA8 mip tail", CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R8G8B8A8_UNORM, 64, 64, 1, 7), 4, 3, 0, 1540, {
+        {0, {DXGI_FORMAT_R8G8B8A8_UNORM, 4, 4, 1, 256}, 4, 16},
+        {1024, {DXGI_FORMAT_R8G8B8A8_UNORM, 2, 2, 1, 256}, 2, 8},
+        {1536, {DXGI_FORMAT_R8G8B8A8_UNORM, 1, 1, 1, 256}, 1, 4},
+    }},
+    {"R8 wide rows", CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R8_UNORM, 300, 2, 1, 2), 0, 2, 0, 1174, {
+        {0, {DXGI_FORMAT_R8_UNORM, 300, 2, 1, 512}, 2, 300},
+        {1024, {DXGI_FORMAT_R8_UNORM, 150, 1, 1, 256}, 1, 150},
+    }},
+    {"RGBA16F array slices", CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R16G16B16A16_FLOAT, 17, 9, 3, 2), 2, 3, 512, 5768, {
+        {512, {DXGI_FORMAT_R16G16B16A16_FLOAT, 17, 9, 1, 256}, 9, 136},
+        {3072, {DXGI_FORMAT_R16G16B16A16_FLOAT, 8, 4, 1, 256}, 4, 64},
+        {4096, {DXGI_FORMAT_R16G16B16A16_FLOAT, 17, 9, 1, 256}, 9, 136},
+    }},
+    {"BC3 array", CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_BC3_UNORM, 6, 6, 2, 2), 0, 4, 0, 1552, {
+        {0, {DXGI_FORMAT_BC3_UNORM, 8, 8, 1, 256}, 2, 32},
+        {512, {DXGI_FORMAT_BC3_UNORM, 4, 4, 1, 256}, 1, 16},
+        {1024, {DXGI_FORMAT_BC3_UNORM, 8, 8, 1, 256}, 2, 32},
+        {1536, {DXGI_FORMAT_BC3_UNORM, 4, 4, 1, 256}, 1, 16},
+    }},
+    {"RGBA8 volume", CD3DX12_RESOURCE_DESC::Tex3D(DXGI_FORMAT_R8G8B8A8_UNORM, 33, 17, 5, 3), 0, 3, 0, 26912, {
+        {0, {DXGI_FORMAT_R8G8B8A8_UNORM, 33, 17, 5, 256}, 17, 132},
+        {22016, {DXGI_FORMAT_R8G8B8A8_UNORM, 16, 8, 2, 256}, 8, 64},
+        {26112, {DXGI_FORMAT_R8G8B8A8_UNORM, 8, 4, 1, 256}, 4, 32},
+    }},
+    {"BC1 volume", CD3DX12_RESOURCE_DESC::Tex3D(DXGI_FORMAT_BC1_UNORM, 10, 6, 3, 2), 0, 2, 0, 1552, {
+        {0, {DXGI_FORMAT_BC1_UNORM, 12, 8, 3, 256}, 2, 24},
+        {1536, {DXGI_FORMAT_BC1_UNORM, 8, 4, 1, 256}, 1, 16},
+    }},
+};
+
+std::string Describe(UINT64 offset, const D3D12_SUBRESOURCE_FOOTPRINT& footprint, UINT numRows, UINT64 rowSizeInBytes)
+{
+    std::ostringstream text;
+    text << "{offset " << offset << ", format " << footprint.Format << ", " << footprint.Width << "x" << footprint.Height << "x"
+         << footprint.Depth << ", pitch " << footprint.RowPitch << ", rows " << numRows << ", row size " << rowSizeInBytes << "}";
+    return text.str();
+}
+
+// the whole case is compared as text, so a failure shows its name and every layout
+void CheckFootprints(const FootprintsCase& test, const CopyableFootprints& footprints)
+{
+    CHECK_EQUAL(test.layouts.size(), footprints.layouts.size());
+    CHECK_EQUAL(test.layouts.size(), footprints.numRows.size());
+    CHECK_EQUAL(test.layouts.size(), footprints.rowSizesInBytes.size());
+
+    std::string expected = std::string(test.name) + ": " + std::to_string(test.totalBytes) + " bytes";
+    std::string actual = std::string(test.name) + ": " + std::to_string(footprints.totalBytes) + " bytes";
+    for (size_t i = 0; i < test.layouts.size(); ++i)
+    {
+        const ExpectedLayout& layout = test.layouts[i];
+        expected += " " + Describe(layout.offset, layout.footprint, layout.numRows, layout.rowSizeInBytes);
+        actual += " " + Describe(footprints.layouts[i].Offset, footprints.layouts[i].Footprint, footprints.numRows[i], footprints.rowSizesInBytes[i]);
+    }
+    CHECK_EQUAL(expected, actual);
+}
+}
+
+TEST(SubresourceStaging, ComputesDeviceFootprints)
+{
+    for (const FootprintsCase& test : footprintsCases)
+        CheckFootprints(test, ComputeCopyableFootprints(test.desc, test.firstSubresource, test.numSubresources, test.baseOffset));
+}
+
+TEST(SubresourceStaging, FootprintsTableMatchesDevice)
+{
+    ComPtr<ID3D12Device> device = Tests::CreateWarpDevice();
+    if (!device)
+    {
+        Tests::Log() << "    WARP device isn't available, the table isn't checked" << std::endl;
+        return;
+    }
+
+    for (const FootprintsCase& test : footprintsCases)
+    {
+        CopyableFootprints footprints;
+        footprints.layouts.resize(test.numSubresources);
+        footprints.numRows.resize(test.numSubresources);
+        footprints.rowSizesInBytes.resize(test.numSubresources);
+        device->GetCopyableFootprints(&test.desc, test.firstSubresource, test.numSubresources, test.baseOffset, footprints.layouts.data(),
+                                      footprints.numRows.data(), footprints.rowSizesInBytes.data(), &footprints.totalBytes);
+        CheckFootprints(test, footprints);
+    }
+}
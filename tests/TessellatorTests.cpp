@@ -0,0 +1,94 @@
+#include "stdafx.h"
+
+#include "Tests.h"
+
+#include <utils/Tessellator.h>
+
+// Reference values are surfaceHeight() and ds_main() of MRTPass.hlsl evaluated in double precision.
+namespace
+{
+struct HeightSample
+{
+    float u;
+    float v;
+    float height;
+};
+
+struct DisplacedSample
+{
+    uint32_t i;  // barycentrics are i / factor and j / factor
+    uint32_t j;
+    float    position[3];
+    float    normal[3];
+    float    binormal[3];
+    float    tangent[3];
+    float    uv[2];
+};
+
+constexpr float heightTolerance = 1e-6f;
+constexpr float positionTolerance = 1e-5f;
+// the frame comes from differences of heights 0.02 apart in UV, so float rounding is amplified
+constexpr float frameTolerance = 1e-4f;
+
+void CheckVector(const float* expected, const float* actual, size_t count, float tolerance)
+{
+    for (size_t i = 0; i < count; ++i)
+        CHECK_NEAR(expected[i], actual[i], tolerance);
+}
+}
+
+TEST(Tessellator, SurfaceHeightMatchesShader)
+{
+    const HeightSample samples[] = {
+        {0.00f, 0.00f, 0.0000000f},
+        {0.45f, 0.20f, 0.1999948f},
+        {0.40f, 0.25f, 0.1639857f},
+        {0.30f, 0.10f, 0.0526014f},
+        {0.55f, 0.30f, 0.0905152f},
+        {1.45f, -0.80f, 0.1999897f},
+        {0.95f, 0.70f, 0.0000000f},
+    };
+
+    for (const HeightSample& sample : samples)
+        CHECK_NEAR(sample.height, Tessellator::SurfaceHeight(sample.u, sample.v), heightTolerance);
+}
+
+TEST(Tessellator, DisplacementMatchesDomainShader)
+{
+    // ds_main takes the frame of the first patch vertex only, so the others have different ones
+    std::vector<geometryVertex> vertices(3);
+    vertices[0] = {{0.0f, 0.0f, 0.0f}, {0.0f, 0.8f, 0.6f}, {1.0f, 0.0f, 0.0f}, {0.0f, 0.6f, -0.8f}, {0.3f, 0.1f}};
+    vertices[1] = {{2.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f}, {0.0f, 0.0f, 1.0f}, {1.0f, 0.0f, 0.0f}, {0.6f, 0.15f}};
+    vertices[2] = {{0.0f, 1.2f, 1.6f}, {1.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f}, {0.0f, 0.0f, 1.0f}, {0.4f, 0.35f}};
+    const std::vector<uint32_t> indices = {0, 1, 2};
+
+    const uint32_t factor = 4;
+    const DisplacedSample samples[] = {
+        {0, 0, {0.000000f, 0.042081f, 0.031561f}, {-0.526952f, 0.423063f, 0.737116f}, {0.828865f, 0.447559f, 0.335669f}, {0.000000f, 0.867302f, -0.497782f}, {0.300000f, 0.100000f}},
+        {4, 0, {2.000000f, 0.057973f, 0.043480f}, {0.662418f, 0.450324f, 0.598674f}, {0.735670f, -0.541872f, -0.406404f}, {0.000000f, 0.799155f, -0.601125f}, {0.600000f, 0.150000f}},
+        {0, 4, {0.000000f, 1.257850f, 1.643387f}, {-0.208934f, 0.973037f, -0.097702f}, {0.960361f, 0.223007f, 0.167255f}, {0.000000f, -0.099907f, -0.994997f}, {0.400000f, 0.350000f}},
+        {1, 1, {0.500000f, 0.440885f, 0.505664f}, {-0.554555f, 0.461059f, 0.692744f}, {0.816578f, 0.461788f, 0.346341f}, {0.000000f, 0.832477f, -0.554059f}, {0.400000f, 0.175000f}},
+        {2, 1, {1.000000f, 0.455254f, 0.516440f}, {0.343081f, 0.627333f, 0.699106f}, {0.937135f, -0.279173f, -0.209380f}, {0.000000f, 0.744279f, -0.667869f}, {0.475000f, 0.187500f}},
+        {1, 2, {0.500000f, 0.747693f, 0.910770f}, {-0.311747f, 0.939642f, 0.141024f}, {0.937018f, 0.279424f, 0.209568f}, {0.000000f, 0.148420f, -0.988924f}, {0.425000f, 0.237500f}},
+        {3, 1, {1.500000f, 0.407692f, 0.480769f}, {0.736107f, 0.539305f, 0.409019f}, {0.676860f, -0.588890f, -0.441667f}, {0.000000f, 0.604284f, -0.796769f}, {0.550000f, 0.200000f}},
+    };
+
+    std::vector<geometryVertex> outVertices;
+    std::vector<uint32_t> outIndices;
+    Tessellator::Tessellate(vertices, indices, factor, outVertices, outIndices);
+    CHECK_EQUAL(size_t((factor + 1) * (factor + 2) / 2), outVertices.size());
+    CHECK_EQUAL(size_t(factor * factor * 3), outIndices.size());
+
+    for (const DisplacedSample& sample : samples)
+    {
+        // vertices are stored row by row, row j holds factor + 1 - j of them
+        const uint32_t index = sample.j * (factor + 1) - sample.j * (sample.j - 1) / 2 + sample.i;
+        const geometryVertex& vertex = outVertices[index];
+
+        CheckVector(sample.position, vertex.position, 3, positionTolerance);
+        CheckVector(sample.uv, vertex.uv, 2, positionTolerance);
+        CheckVector(sample.normal, vertex.normal, 3, frameTolerance);
+        CheckVector(sample.binormal, vertex.binormal, 3, frameTolerance);
+        CheckVector(sample.tangent, vertex.tangent, 3, frameTolerance);
+    }
+}
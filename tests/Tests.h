@@ -0,0 +1,74 @@
+#pragma once
+
+#include "stdafx.h"
+
+// Tests of CPU parts of utils, they don't create windows and use WARP device only to check recorded values.
+// TEST(Group, Name) registers a test, groups are run by ctest one by one; BENCHMARK(Group, Name) is run with
+// --benchmarks only and prints its results.
+// A failed check throws, so a test stops at the first one.
+namespace Tests
+{
+using TestFunc = void (*)();
+
+struct TestCase
+{
+    const char* group;
+    const char* name;
+    TestFunc    func;
+    bool        benchmark;
+};
+
+std::vector<TestCase>& Registry();
+
+struct Registrar
+{
+    Registrar(const char* group, const char* name, TestFunc func, bool benchmark);
+};
+
+[[noreturn]] void Fail(const char* file, int line, const std::string& message);
+
+template<typename Expected, typename Actual>
+void CheckEqual(const Expected& expected, const Actual& actual, const char* expression, const char* file, int line)
+{
+    if (expected == actual)
+        return;
+
+    std::ostringstream message;
+    message << expression << ": expected " << expected << ", got " << actual;
+    Fail(file, line, message.str());
+}
+
+inline void CheckNear(double expected, double actual, double tolerance, const char* expression, const char* file, int line)
+{
+    if (std::abs(expected - actual) <= tolerance)
+        return;
+
+    std::ostringstream message;
+    message << expression << ": expected " << expected << " +- " << tolerance << ", got " << actual;
+    Fail(file, line, message.str());
+}
+
+// output of benchmarks
+std::ostream& Log();
+
+// WARP device for tests that check recorded values, nullptr when it isn't available
+ComPtr<ID3D12Device> CreateWarpDevice();
+}
+
+#define TEST_REGISTER(group, name, benchmark)                                                                     \
+    static void group##_##name();                                                                               \
+    static const Tests::Registrar group##_##name##_registrar {#group, #name, &group##_##name, benchmark};       \
+    static void group##_##name()
+
+#define TEST(group, name) TEST_REGISTER(group, name, false)
+#define BENCHMARK(group, name) TEST_REGISTER(group, name, true)
+
+#define CHECK(condition)                                                \
+    do                                                                  \
+    {                                                                   \
+        if (!(condition))                                               \
+            Tests::Fail(__FILE__, __LINE__, #condition);                \
+    } while (false)
+
+#define CHECK_EQUAL(expected, actual) Tests::CheckEqual((expected), (actual), #actual, __FILE__, __LINE__)
+#define CHECK_NEAR(expected, actual, tolerance) Tests::CheckNear((expected), (actual), (tolerance), #actual, __FILE__, __LINE__)
@@ -0,0 +1,146 @@
+#include "stdafx.h"
+
+#include "Tests.h"
+
+#include <utils/TextureSynthesis.h>
+
+namespace
+{
+// scalar generator the sample used before TextureSynthesis, kept as the reference of the layout and colors
+size_t GeneratePixelsReference(std::vector<uint8_t>& pixels,
+                               std::vector<D3D12_SUBRESOURCE_DATA>& mips_data,
+                               const size_t width,
+                               const size_t height,
+                               const size_t depth,
+                               const bool is_volumed = false)
+{
+    const int bytepp = 4;
+    const size_t row_size_limit = 256 / bytepp;
+    size_t generated_mips = 0;
+
+    if (!width || !height || !depth)
+        return 0;
+
+    const size_t align_width = (width > row_size_limit) ? width + (row_size_limit - width % row_size_limit) : row_size_limit;
+
+    pixels.clear();
+    mips_data.clear();
+
+    pixels.resize(align_width * height * bytepp * 10 * depth, 0x0);
+
+    uint32_t* p_pixels = (uint32_t*)pixels.data();
+
+    size_t array_size = is_volumed ? 1 : depth;
+    size_t max_depth = is_volumed ? depth : 1;
+
+    for (size_t level = 0; level < array_size; ++level)
+    {
+        size_t mip_width = width;
+        size_t mip_height = height;
+        size_t mip_depth = max_depth;
+        generated_mips = 0;
+
+        // for each mip...
+        while (true)
+        {
+            mips_data.push_back({(void*)p_pixels, (int64_t)(mip_width * bytepp), (int64_t)(mip_width * mip_height * bytepp)});
+
+            for (size_t slice = 0; slice < mip_depth; ++slice)
+            {
+                size_t delimx = (mip_width >= 8) ? 8 : mip_width;
+                size_t delimy = (mip_width >= 8) ? 8 : mip_height;
+
+                for (UINT row = 0; row < mip_height; row++)
+                {
+                    for (UINT col = 0; col < mip_width; col++)
+                    {
+                        size_t xBlock = col * delimx / mip_width;
+                        size_t yBlock = row * delimy / mip_height;
+
+                        if (xBlock % 2 == yBlock % 2)
+                        {
+                            p_pixels[mip_width*row + col] = slice & 1 ? 0xFF'FF'FF'FF : 0xFF'C4'92'00;
+                        }
+                        else
+                        {
+                            p_pixels[mip_width*row + col] = slice & 1 ? 0xFF'C4'92'00 : 0xFF'FF'FF'FF;
+                        }
+                    }
+                }
+                p_pixels += mip_width * mip_height;
+            }
+            ++generated_mips;
+
+            if (level == array_size - 1 && mip_width == 1 && mip_height == 1 && mip_depth == 1)
+                break;
+
+            size_t row_padding = 0;
+            if (mip_width % row_size_limit)
+            {
+                row_padding = row_size_limit - mip_width % row_size_limit;
+                p_pixels += row_padding * mip_height * mip_depth; // add row padding for alignment
+            }
+
+            if (((mip_width + row_padding) * mip_height * mip_depth) & (2 * row_size_limit - 1))
+                p_pixels += row_size_limit;                       // add mip padding for alignment
+
+            if (mip_width == 1 && mip_height == 1 && mip_depth == 1)
+                break;
+
+            mip_width = mip_width > 1 ? mip_width >> 1 : 1;
+            mip_height = mip_height > 1 ? mip_height >> 1 : 1;
+            mip_depth = mip_depth > 1 ? mip_depth >> 1 : 1;
+        }
+    }
+    pixels.resize((uint8_t*)p_pixels - pixels.data());
+    return generated_mips;
+}
+
+struct CheckerboardCase
+{
+    size_t width;
+    size_t height;
+    size_t depth;
+    bool   volume;
+};
+}
+
+TEST(TextureSynthesis, MatchesScalarReference)
+{
+    // odd sizes hit the scalar tails of rows, 1x1x1 has the only mip without padding
+    const CheckerboardCase cases[] = {
+        {255, 255, 30, false},
+        {32, 32, 32, true},
+        {256, 256, 4, false},
+        {7, 13, 3, false},
+        {100, 3, 5, true},
+        {1, 1, 1, false},
+        {64, 64, 1, false},
+        {300, 17, 2, true},
+    };
+
+    for (const CheckerboardCase& test : cases)
+    {
+        std::vector<uint8_t> expectedPixels;
+        std::vector<D3D12_SUBRESOURCE_DATA> expectedMips;
+        const size_t expectedCount = GeneratePixelsReference(expectedPixels, expectedMips, test.width, test.height, test.depth, test.volume);
+
+        std::vector<uint8_t> pixels;
+        std::vector<D3D12_SUBRESOURCE_DATA> mips;
+        const size_t count = TextureSynthesis::GenerateCheckerboard(pixels, mips, test.width, test.height, test.depth, test.volume);
+
+        CHECK_EQUAL(expectedCount, count);
+        CHECK_EQUAL(expectedPixels.size(), pixels.size());
+        CHECK(expectedPixels == pixels);
+        CHECK_EQUAL(expectedMips.size(), mips.size());
+
+        for (size_t i = 0; i < mips.size(); ++i)
+        {
+            const ptrdiff_t expectedOffset = static_cast<const uint8_t*>(expectedMips[i].pData) - expectedPixels.data();
+            const ptrdiff_t offset = static_cast<const uint8_t*>(mips[i].pData) - pixels.data();
+            CHECK_EQUAL(expectedOffset, offset);
+            CHECK_EQUAL(expectedMips[i].RowPitch, mips[i].RowPitch);
+            CHECK_EQUAL(expectedMips[i].SlicePitch, mips[i].SlicePitch);
+        }
+    }
+}
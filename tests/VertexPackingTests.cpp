@@ -0,0 +1,210 @@
+#include "stdafx.h"
+
+#include "Tests.h"
+
+#include <utils/VertexPacking.h>
+
+namespace
+{
+struct float3
+{
+    float x, y, z;
+};
+
+float3 Load(const float* v)
+{
+    return {v[0], v[1], v[2]};
+}
+
+float Dot(const float3& a, const float3& b)
+{
+    return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+float3 Cross(const float3& a, const float3& b)
+{
+    return {a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x};
+}
+
+float3 Normalize(const float3& a)
+{
+    const float length = std::sqrt(Dot(a, a));
+    return {a.x / length, a.y / length, a.z / length};
+}
+
+float Distance(const float3& a, const float3& b)
+{
+    const float3 difference = {a.x - b.x, a.y - b.y, a.z - b.z};
+    return std::sqrt(Dot(difference, difference));
+}
+
+// R16G16B16A16_SNORM fetch
+float DecodeSnorm(int16_t value)
+{
+    return std::max(value / 32767.0f, -1.0f);
+}
+
+// decodeTangentFrame() of TangentFrame.hlsl
+void DecodeTangentFrame(const int16_t packed[4], float3& normal, float3& binormal, float3& tangent)
+{
+    const float w = DecodeSnorm(packed[3]);
+    const float handedness = w < 0.0f ? -1.0f : 1.0f;
+
+    float q[4] = {DecodeSnorm(packed[0]), DecodeSnorm(packed[1]), DecodeSnorm(packed[2]), std::fabs(w)};
+    const float length = std::sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+    const float x = q[0] / length, y = q[1] / length, z = q[2] / length, qw = q[3] / length;
+
+    binormal = {handedness * (1.0f - 2.0f * (y * y + z * z)), handedness * 2.0f * (x * y + z * qw), handedness * 2.0f * (x * z - y * qw)};
+    tangent = {2.0f * (x * y - z * qw), 1.0f - 2.0f * (x * x + z * z), 2.0f * (y * z + x * qw)};
+    normal = {2.0f * (x * z + y * qw), 2.0f * (y * z - x * qw), 1.0f - 2.0f * (x * x + y * y)};
+}
+
+// Random frames with both handedness, the tangent isn't orthogonal to the normal like after UV seams welding.
+// Frames with the quaternion w equal to zero (rotation by 180 degrees) are generated in both handedness.
+std::vector<geometryVertex> CreateVertices(size_t count)
+{
+    std::mt19937 generator {11};
+    auto random = [&](float from, float to) { return from + (to - from) * (generator() / 4294967296.0f); };
+
+    std::vector<geometryVertex> vertices(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        geometryVertex& vertex = vertices[i];
+        const float3 position = {random(-50.0f, 150.0f), random(-2.0f, 2.0f), random(10.0f, 10.5f)};
+
+        float3 normal = Normalize({random(-1.0f, 1.0f), random(-1.0f, 1.0f), random(-1.0f, 1.0f)});
+        if (i % 8 < 2)
+            normal = {0.0f, 0.0f, -1.0f};
+        float3 tangent = Normalize(Cross(normal, Normalize({random(-1.0f, 1.0f), random(-1.0f, 1.0f), random(-1.0f, 1.0f)})));
+        if (i % 8 < 2)
+            tangent = {0.0f, -1.0f, 0.0f};
+        const float3 skew = {tangent.x + normal.x * 0.1f, tangent.y + normal.y * 0.1f, tangent.z + normal.z * 0.1f};
+        float3 binormal = Cross(tangent, normal);
+        if (i % 2)
+            binormal = {-binormal.x, -binormal.y, -binormal.z};
+
+        memcpy(vertex.position, &position, sizeof(position));
+        memcpy(vertex.normal, &normal, sizeof(normal));
+        memcpy(vertex.tangent, &skew, sizeof(skew));
+        memcpy(vertex.binormal, &binormal, sizeof(binormal));
+        vertex.uv[0] = random(0.0f, 1.0f);
+        vertex.uv[1] = random(-4.0f, 4.0f);
+    }
+    return vertices;
+}
+
+constexpr size_t verticesCount = 4096;
+}
+
+// half of SNORM step of the extent, decoded like vertex shaders do: position * scale + offset
+TEST(VertexPacking, PositionsStayWithinQuantizationStep)
+{
+    const std::vector<geometryVertex> vertices = CreateVertices(verticesCount);
+    const VertexPacking::PositionBounds bounds = VertexPacking::ComputeBounds(vertices.data(), vertices.size());
+    CHECK_NEAR(50.0, bounds.center.x, 0.5);
+    CHECK_NEAR(100.0, bounds.extent.x, 0.5);
+
+    std::vector<packedGeometryVertex> packed(vertices.size());
+    VertexPacking::PackVertices(vertices.data(), vertices.size(), bounds, packed.data());
+
+    const float extent[3] = {bounds.extent.x, bounds.extent.y, bounds.extent.z};
+    const float center[3] = {bounds.center.x, bounds.center.y, bounds.center.z};
+    for (size_t i = 0; i < vertices.size(); ++i)
+    {
+        for (size_t axis = 0; axis < 3; ++axis)
+        {
+            const float decoded = DecodeSnorm(packed[i].position[axis]) * extent[axis] + center[axis];
+            const double tolerance = extent[axis] * 0.5 / 32767.0 + std::fabs(vertices[i].position[axis]) * 1e-6;
+            CHECK_NEAR(vertices[i].position[axis], decoded, tolerance);
+        }
+    }
+}
+
+// the frame is orthonormalized around the normal before packing, so the reference is orthonormalized too
+TEST(VertexPacking, TangentFrameMatchesShaderDecoding)
+{
+    const std::vector<geometryVertex> vertices = CreateVertices(verticesCount);
+    std::vector<packedGeometryVertex> packed(vertices.size());
+    VertexPacking::PackVertices(vertices.data(), vertices.size(), VertexPacking::ComputeBounds(vertices.data(), vertices.size()), packed.data());
+
+    std::vector<geometryVertex> unpacked(vertices.size());
+    VertexPacking::UnpackVertices(packed.data(), packed.size(), VertexPacking::ComputeBounds(vertices.data(), vertices.size()), unpacked.data());
+
+    // SNORM16 quaternion components are off by 1.5e-5 at most, vectors rotate by twice of it per component,
+    // and w is clamped to 2 / 32767 to keep the handedness
+    constexpr float tolerance = 2e-4f;
+    float maxError = 0.0f;
+    for (size_t i = 0; i < vertices.size(); ++i)
+    {
+        const float3 normal = Normalize(Load(vertices[i].normal));
+        const float3 skew = Load(vertices[i].tangent);
+        const float3 tangent = Normalize({skew.x - normal.x * Dot(normal, skew), skew.y - normal.y * Dot(normal, skew), skew.z - normal.z * Dot(normal, skew)});
+        float3 binormal = Cross(tangent, normal);
+        if (Dot(binormal, Load(vertices[i].binormal)) < 0.0f)
+            binormal = {-binormal.x, -binormal.y, -binormal.z};
+
+        float3 decodedNormal, decodedBinormal, decodedTangent;
+        DecodeTangentFrame(packed[i].tangentFrame, decodedNormal, decodedBinormal, decodedTangent);
+
+        maxError = std::max({maxError, Distance(normal, decodedNormal), Distance(tangent, decodedTangent), Distance(binormal, decodedBinormal)});
+        CHECK(Distance(normal, decodedNormal) <= tolerance);
+        CHECK(Distance(tangent, decodedTangent) <= tolerance);
+        CHECK(Distance(binormal, decodedBinormal) <= tolerance);
+
+        // CPU unpacking used by the mesh cache gives the same frame
+        CHECK(Distance(decodedNormal, Load(unpacked[i].normal)) <= 1e-5f);
+        CHECK(Distance(decodedTangent, Load(unpacked[i].tangent)) <= 1e-5f);
+        CHECK(Distance(decodedBinormal, Load(unpacked[i].binormal)) <= 1e-5f);
+    }
+    Tests::Log() << "    max tangent frame error " << maxError << std::endl;
+}
+
+// half floats keep 11 significant bits
+TEST(VertexPacking, TextureCoordinatesKeepHalfPrecision)
+{
+    const std::vector<geometryVertex> vertices = CreateVertices(verticesCount);
+    const VertexPacking::PositionBounds bounds = VertexPacking::ComputeBounds(vertices.data(), vertices.size());
+    std::vector<packedGeometryVertex> packed(vertices.size());
+    VertexPacking::PackVertices(vertices.data(), vertices.size(), bounds, packed.data());
+
+    std::vector<geometryVertex> unpacked(vertices.size());
+    VertexPacking::UnpackVertices(packed.data(), packed.size(), bounds, unpacked.data());
+
+    for (size_t i = 0; i < vertices.size(); ++i)
+    {
+        for (size_t c = 0; c < 2; ++c)
+        {
+            const double tolerance = std::max<double>(std::fabs(vertices[i].uv[c]), std::ldexp(1.0, -14)) * std::ldexp(1.0, -11);
+            CHECK_NEAR(vertices[i].uv[c], unpacked[i].uv[c], tolerance);
+        }
+    }
+}
+
+// both vertex formats: the position stream holds positions in the vertex order, the attribute stream follows it
+TEST(VertexPacking, SplitsPositionStream)
+{
+    const std::vector<geometryVertex> vertices = CreateVertices(verticesCount);
+    const VertexPacking::PositionBounds bounds = VertexPacking::ComputeBounds(vertices.data(), vertices.size());
+    std::vector<packedGeometryVertex> packed(vertices.size());
+    VertexPacking::PackVertices(vertices.data(), vertices.size(), bounds, packed.data());
+
+    auto check = [](const auto& source, size_t positionStride)
+    {
+        const size_t stride = sizeof(source[0]);
+        const size_t attributeStride = stride - positionStride;
+        const uint8_t* sourceBytes = reinterpret_cast<const uint8_t*>(source.data());
+
+        std::vector<uint8_t> streams(source.size() * stride);
+        VertexPacking::SplitPositionStream(sourceBytes, source.size(), stride, positionStride, streams.data());
+
+        const uint8_t* attributes = streams.data() + source.size() * positionStride;
+        for (size_t i = 0; i < source.size(); ++i)
+        {
+            CHECK(!memcmp(sourceBytes + i * stride, streams.data() + i * positionStride, positionStride));
+            CHECK(!memcmp(sourceBytes + i * stride + positionStride, attributes + i * attributeStride, attributeStride));
+        }
+    };
+
+    check(vertices, sizeof(geometryVertex::position));
+    check(packed, sizeof(packedGeometryVertex::position));
+}
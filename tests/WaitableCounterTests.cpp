@@ -0,0 +1,289 @@
+#include "stdafx.h"
+
+#include "Tests.h"
+
+#include <utils/WaitableCounter.h>
+
+#include <condition_variable>
+
+using namespace std::chrono;
+using Threading::WaitableCounter;
+
+namespace
+{
+// Frame start and end signals of render threads with a mutex and condition variables, the way the pool worked before
+class ConditionVariableSignals
+{
+public:
+    explicit ConditionVariableSignals(uint32_t /*spinCount*/) {}
+
+    void Start(uint32_t workersCount)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _pending = workersCount;
+        ++_frame;
+        _startCV.notify_all();
+    }
+
+    uint32_t WaitStart(uint32_t frame)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        while (_frame == frame)
+            _startCV.wait(lock);
+        return _frame;
+    }
+
+    void Finish()
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        if (--_pending == 0)
+            _endCV.notify_one();
+    }
+
+    void WaitFinish()
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        while (_pending)
+            _endCV.wait(lock);
+    }
+
+private:
+    std::mutex              _mutex;
+    std::condition_variable _startCV;
+    std::condition_variable _endCV;
+    uint32_t                _frame = 0;
+    uint32_t                _pending = 0;
+};
+
+// The same signals of SceneManager on spin-then-park counters
+class WaitableCounterSignals
+{
+public:
+    explicit WaitableCounterSignals(uint32_t spinCount)
+        : _spinCount(spinCount)
+    {
+    }
+
+    void Start(uint32_t workersCount)
+    {
+        _pending.Store(workersCount);
+        _frame.Increment();
+    }
+
+    uint32_t WaitStart(uint32_t frame)
+    {
+        return _frame.WaitWhileEqual(frame, _spinCount);
+    }
+
+    void Finish()
+    {
+        _pending.Decrement();
+    }
+
+    void WaitFinish()
+    {
+        _pending.WaitZero(_spinCount);
+    }
+
+private:
+    WaitableCounter _frame;
+    WaitableCounter _pending;
+    uint32_t        _spinCount = 0;
+};
+
+// average microseconds from the frame start to the first and the last worker seeing it
+template<typename Signals>
+std::pair<double, double> MeasureWakeup(uint32_t threadsCount, uint32_t spinCount)
+{
+    constexpr size_t roundsCount = 500;
+    // main thread work between frames, workers go through the whole spin budget if it's shorter
+    constexpr duration<double, std::micro> frameGap {200.0};
+
+    Signals signals {spinCount};
+    std::atomic_bool exit = false;
+    std::vector<high_resolution_clock::time_point> wakeTimes(threadsCount);
+
+    std::vector<std::thread> threads;
+    for (uint32_t i = 0; i < threadsCount; ++i)
+    {
+        threads.emplace_back([&, i]()
+        {
+            for (uint32_t frame = signals.WaitStart(0); !exit; frame = signals.WaitStart(frame))
+            {
+                wakeTimes[i] = high_resolution_clock::now();
+                signals.Finish();
+            }
+        });
+    }
+
+    duration<double, std::micro> first {};
+    duration<double, std::micro> last {};
+    for (size_t round = 0; round < roundsCount; ++round)
+    {
+        const auto gapEnd = high_resolution_clock::now() + duration_cast<high_resolution_clock::duration>(frameGap);
+        while (high_resolution_clock::now() < gapEnd)
+            YieldProcessor();
+
+        const auto start = high_resolution_clock::now();
+        signals.Start(threadsCount);
+        signals.WaitFinish();
+
+        const auto [firstWake, lastWake] = std::minmax_element(wakeTimes.begin(), wakeTimes.end());
+        first += *firstWake - start;
+        last += *lastWake - start;
+    }
+
+    exit = true;
+    signals.Start(threadsCount);
+    for (auto& thread : threads)
+        thread.join();
+
+    return {first.count() / roundsCount, last.count() / roundsCount};
+}
+
+uint32_t GetHardwareThreads()
+{
+    const uint32_t hardwareThreads = std::thread::hardware_concurrency();
+    return hardwareThreads ? hardwareThreads : 8; // 0 when unable to detect
+}
+
+// no spinning, the shortest one and the default budget of render threads
+const uint32_t spinCounts[] = {0, 1, 4096};
+}
+
+TEST(WaitableCounter, WaitWhileEqualReturnsNewValue)
+{
+    for (uint32_t spinCount : spinCounts)
+    {
+        // a changed value is returned at once
+        WaitableCounter counter {3};
+        CHECK_EQUAL(3u, counter.WaitWhileEqual(2, spinCount));
+
+        // a waiter parked or spinning on the old value sees the stored one
+        uint32_t seen = 0;
+        std::thread waiter([&]() { seen = counter.WaitWhileEqual(3, spinCount); });
+        std::this_thread::sleep_for(milliseconds(10));
+        counter.Store(7);
+        waiter.join();
+        CHECK_EQUAL(7u, seen);
+
+        waiter = std::thread([&]() { seen = counter.WaitWhileEqual(7, spinCount); });
+        std::this_thread::sleep_for(milliseconds(10));
+        CHECK_EQUAL(8u, counter.Increment());
+        waiter.join();
+        CHECK_EQUAL(8u, seen);
+    }
+}
+
+TEST(WaitableCounter, WaitZeroReturnsAfterDecrements)
+{
+    const uint32_t threadsCount = GetHardwareThreads();
+    for (uint32_t spinCount : spinCounts)
+    {
+        WaitableCounter pending {threadsCount};
+        std::atomic_uint32_t finished = 0;
+
+        std::vector<std::thread> threads;
+        for (uint32_t i = 0; i < threadsCount; ++i)
+        {
+            threads.emplace_back([&, i]()
+            {
+                std::this_thread::sleep_for(microseconds(100 * i));
+                ++finished;
+                pending.Decrement();
+            });
+        }
+
+        // decrements above zero don't wake the waiter, it sleeps on a stale value until the last one
+        pending.WaitZero(spinCount);
+        CHECK_EQUAL(threadsCount, finished.load());
+        CHECK_EQUAL(0u, pending.Load());
+
+        for (auto& thread : threads)
+            thread.join();
+
+        // zero returns at once
+        pending.WaitZero(spinCount);
+    }
+}
+
+// a lost wakeup leaves both sides parked forever, ctest reports it by the timeout of the group
+TEST(WaitableCounter, NoLostWakeupsWithoutSpinning)
+{
+    // ping-pong: every change has a parked or parking waiter on the other side
+    constexpr uint32_t exchangesCount = 20000;
+    WaitableCounter counter;
+    std::thread partner([&]()
+    {
+        for (uint32_t value = 1; value < 2 * exchangesCount; value += 2)
+        {
+            counter.WaitWhileEqual(value - 1, 0);
+            counter.Increment();
+        }
+    });
+
+    for (uint32_t value = 0; value < 2 * exchangesCount; value += 2)
+    {
+        counter.Increment();
+        CHECK_EQUAL(value + 2, counter.WaitWhileEqual(value + 1, 0));
+    }
+    partner.join();
+
+    // frame loop of render threads: every worker sees every frame start, the main thread sees every end
+    constexpr uint32_t framesCount = 2000;
+    const uint32_t threadsCount = GetHardwareThreads();
+    WaitableCounterSignals signals {0};
+    std::vector<uint32_t> framesSeen(threadsCount, 0);
+
+    std::vector<std::thread> threads;
+    for (uint32_t i = 0; i < threadsCount; ++i)
+    {
+        threads.emplace_back([&, i]()
+        {
+            for (uint32_t frame = signals.WaitStart(0); frame <= framesCount; frame = signals.WaitStart(frame))
+            {
+                framesSeen[i]++;
+                signals.Finish();
+            }
+        });
+    }
+
+    for (uint32_t frame = 0; frame < framesCount; ++frame)
+    {
+        signals.Start(threadsCount);
+        signals.WaitFinish();
+    }
+
+    signals.Start(threadsCount);
+    for (auto& thread : threads)
+        thread.join();
+
+    for (uint32_t seen : framesSeen)
+        CHECK_EQUAL(framesCount, seen);
+}
+
+// Wake-to-first-work latency of render threads with condition variables and with WaitableCounter at several spin budgets
+BENCHMARK(WaitableCounter, WakeLatency)
+{
+    const uint32_t benchmarkSpinCounts[] = {0, 256, 4096, 65536};
+    const uint32_t hardwareThreads = GetHardwareThreads();
+
+    std::vector<uint32_t> threadsCounts;
+    for (uint32_t count = 1; count < hardwareThreads; count *= 2)
+        threadsCounts.push_back(count);
+    threadsCounts.push_back(hardwareThreads);
+
+    Tests::Log() << "    first/last worker latency of a frame start, " << hardwareThreads << " hardware threads" << std::endl;
+    for (uint32_t threadsCount : threadsCounts)
+    {
+        Tests::Log() << "    " << threadsCount << " threads:" << std::endl;
+        auto [first, last] = MeasureWakeup<ConditionVariableSignals>(threadsCount, 0);
+        Tests::Log() << "        condition variables: " << first << " us / " << last << " us" << std::endl;
+        for (uint32_t spinCount : benchmarkSpinCounts)
+        {
+            std::tie(first, last) = MeasureWakeup<WaitableCounterSignals>(threadsCount, spinCount);
+            Tests::Log() << "        spin " << spinCount << (spinCount ? " then park: " : " (park only): ");
+            Tests::Log() << first << " us / " << last << " us" << std::endl;
+        }
+    }
+}
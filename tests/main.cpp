@@ -0,0 +1,94 @@
+#include "stdafx.h"
+
+#include "Tests.h"
+
+namespace Tests
+{
+namespace
+{
+struct Failure : std::runtime_error
+{
+    using std::runtime_error::runtime_error;
+};
+}
+
+std::vector<TestCase>& Registry()
+{
+    static std::vector<TestCase> registry;
+    return registry;
+}
+
+Registrar::Registrar(const char* group, const char* name, TestFunc func, bool benchmark)
+{
+    Registry().push_back({group, name, func, benchmark});
+}
+
+void Fail(const char* file, int line, const std::string& message)
+{
+    std::ostringstream text;
+    text << file << "(" << line << "): " << message;
+    throw Failure(text.str());
+}
+
+std::ostream& Log()
+{
+    return std::cout;
+}
+
+ComPtr<ID3D12Device> CreateWarpDevice()
+{
+    ComPtr<IDXGIFactory4> factory;
+    ComPtr<IDXGIAdapter> adapter;
+    ComPtr<ID3D12Device> device;
+    if (FAILED(CreateDXGIFactory2(0, IID_PPV_ARGS(&factory))) ||
+        FAILED(factory->EnumWarpAdapter(IID_PPV_ARGS(&adapter))) ||
+        FAILED(D3D12CreateDevice(adapter.Get(), D3D_FEATURE_LEVEL_11_0, IID_PPV_ARGS(&device))))
+        return nullptr;
+
+    return device;
+}
+}
+
+// usage: utils_tests [group] [--benchmarks], all tests are run without arguments
+int main(int argc, char* argv[])
+{
+    std::string group;
+    bool benchmarks = false;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::string(argv[i]) == "--benchmarks")
+            benchmarks = true;
+        else
+            group = argv[i];
+    }
+
+    size_t passed = 0;
+    size_t failed = 0;
+    for (const Tests::TestCase& test : Tests::Registry())
+    {
+        if (test.benchmark != benchmarks || (!group.empty() && group != test.group))
+            continue;
+
+        const std::string name = std::string(test.group) + "." + test.name;
+        try
+        {
+            test.func();
+            std::cout << "[  OK  ] " << name << std::endl;
+            passed++;
+        }
+        catch (const std::exception& e)
+        {
+            std::cout << "[FAILED] " << name << ": " << e.what() << std::endl;
+            failed++;
+        }
+    }
+
+    std::cout << passed << " passed, " << failed << " failed" << std::endl;
+    if (passed + failed == 0)
+    {
+        std::cout << "No tests in " << (group.empty() ? "the registry" : group) << std::endl;
+        return 1;
+    }
+
+    return failed ? 1 : 0;
+}
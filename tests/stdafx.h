@@ -0,0 +1,42 @@
+#pragma once
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN             // Exclude rarely-used stuff from Windows headers.
+#endif
+
+#ifndef NOMINMAX
+#define NOMINMAX                        // Don't break std::min and std::max.
+#endif
+
+#include <windows.h>
+#include <wrl.h>
+#include <d3d12.h>
+#include <dxgi1_4.h>
+#include <D3Dcompiler.h>
+#include <DirectXMath.h>
+
+#include <string>
+#include <chrono>
+#include <vector>
+#include <set>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <mutex>
+#include <fstream>
+#include <thread>
+#include <atomic>
+#include <iostream>
+#include <filesystem>
+#include <algorithm>
+#include <array>
+#include <tuple>
+#include <numeric>
+#include <random>
+#include <cmath>
+
+#include <3rdparty/d3dx12.h>
+#include <utils/DXSampleHelper.h>
+
+using namespace DirectX;
+using namespace Microsoft::WRL;
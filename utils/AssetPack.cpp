@@ -0,0 +1,262 @@
+#include "stdafx.h"
+
+#include "AssetPack.h"
+
+#include "SubresourceStaging.h"
+
+namespace AssetPack
+{
+namespace
+{
+constexpr uint32_t magic = 0x4b434150; // "PACK"
+constexpr uint32_t version = 1;
+
+struct Header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entriesCount;
+    uint32_t reserved;
+    uint64_t indexOffset;
+};
+
+uint64_t Align(uint64_t value, uint64_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+}
+
+D3D12_RESOURCE_DESC GetTextureDesc(const Entry& entry)
+{
+    D3D12_RESOURCE_DESC desc = {};
+    desc.Dimension = (D3D12_RESOURCE_DIMENSION)entry.texture.dimension;
+    desc.Format = (DXGI_FORMAT)entry.texture.format;
+    desc.Width = entry.texture.width;
+    desc.Height = entry.texture.height;
+    desc.DepthOrArraySize = (UINT16)entry.texture.depthOrArraySize;
+    desc.MipLevels = (UINT16)entry.texture.mipLevels;
+    desc.SampleDesc.Count = 1;
+    desc.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
+    desc.Flags = D3D12_RESOURCE_FLAG_NONE;
+    return desc;
+}
+
+size_t GetAlignedSize(const Entry& entry)
+{
+    return (size_t)Align(entry.size, dataAlignment);
+}
+
+Writer::Writer(const std::string& fileName)
+    : _file(fileName, std::ios::binary)
+    , _fileName(fileName)
+{
+    if (!_file)
+        throw std::runtime_error("Failed to create asset pack " + fileName);
+
+    // the header is rewritten in Finish
+    Header header = {};
+    _file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+}
+
+void Writer::AddTexture(const std::string& name, const D3D12_RESOURCE_DESC& desc, const D3D12_SUBRESOURCE_DATA* subresources, bool cube /*= false*/)
+{
+    const UINT arraySize = desc.Dimension == D3D12_RESOURCE_DIMENSION_TEXTURE3D ? 1 : desc.DepthOrArraySize;
+    const CopyableFootprints footprints = ComputeCopyableFootprints(desc, 0, desc.MipLevels * arraySize, 0);
+
+    std::vector<uint8_t> data((size_t)footprints.totalBytes, 0x0);
+    SubresourceStaging staging;
+    staging.CopySubresources(footprints, data.data(), subresources);
+
+    Entry& entry = BeginEntry(name, EntryType::Texture, data.size());
+    entry.texture = {(uint32_t)desc.Dimension, (uint32_t)desc.Format, (uint32_t)desc.Width, desc.Height,
+                     desc.DepthOrArraySize, desc.MipLevels, cube ? 1u : 0u};
+    _file.write(reinterpret_cast<const char*>(data.data()), data.size());
+}
+
+void Writer::AddData(const std::string& name, EntryType type, const void* data, size_t size)
+{
+    BeginEntry(name, type, size);
+    _file.write(static_cast<const char*>(data), size);
+}
+
+void Writer::Finish()
+{
+    Pad();
+
+    Header header = {magic, version, (uint32_t)_entries.size(), 0, (uint64_t)_file.tellp()};
+    _file.write(reinterpret_cast<const char*>(_entries.data()), _entries.size() * sizeof(Entry));
+
+    // unbuffered reads of the last entry may read up to the next 4 KB boundary
+    Pad();
+
+    _file.seekp(0);
+    _file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    _file.close();
+
+    if (!_file)
+        throw std::runtime_error("Failed to write asset pack " + _fileName);
+}
+
+Entry& Writer::BeginEntry(const std::string& name, EntryType type, size_t size)
+{
+    Entry entry = {};
+    if (name.size() >= sizeof(entry.name))
+        throw std::runtime_error("Asset name is too long: " + name);
+
+    Pad();
+
+    name.copy(entry.name, name.size());
+    entry.type = type;
+    entry.offset = (uint64_t)_file.tellp();
+    entry.size = size;
+
+    _entries.push_back(entry);
+    return _entries.back();
+}
+
+void Writer::Pad()
+{
+    static const char zeros[dataAlignment] = {};
+    const uint64_t position = (uint64_t)_file.tellp();
+    _file.write(zeros, (std::streamsize)(Align(position, dataAlignment) - position));
+}
+
+ReadRequest::~ReadRequest()
+{
+    // the kernel still owns the overlapped structure and the destination until the read completes
+    if (_pending)
+    {
+        DWORD bytesRead = 0;
+        CancelIoEx(_file, &_overlapped);
+        GetOverlappedResult(_file, &_overlapped, &bytesRead, TRUE);
+    }
+
+    if (_overlapped.hEvent)
+        CloseHandle(_overlapped.hEvent);
+}
+
+Reader::Reader(const std::string& fileName)
+{
+    _file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (_file == INVALID_HANDLE_VALUE)
+        throw std::runtime_error("Failed to open asset pack " + fileName);
+
+    LARGE_INTEGER size = {};
+    GetFileSizeEx(_file, &size);
+    _size = (uint64_t)size.QuadPart;
+
+    _mapping = CreateFileMappingA(_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (_mapping)
+        _view = static_cast<const uint8_t*>(MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0));
+
+    _unbufferedFile = CreateFileA(fileName.c_str(),
+                                  GENERIC_READ,
+                                  FILE_SHARE_READ,
+                                  nullptr,
+                                  OPEN_EXISTING,
+                                  FILE_FLAG_OVERLAPPED | FILE_FLAG_NO_BUFFERING,
+                                  nullptr);
+
+    Header header = {};
+    if (!_view || _unbufferedFile == INVALID_HANDLE_VALUE || _size < sizeof(Header))
+    {
+        Close();
+        throw std::runtime_error("Failed to map asset pack " + fileName);
+    }
+
+    std::memcpy(&header, _view, sizeof(header));
+    if (header.magic != magic || header.version != version || header.indexOffset + header.entriesCount * sizeof(Entry) > _size)
+    {
+        Close();
+        throw std::runtime_error("Asset pack " + fileName + " is corrupted or has old version");
+    }
+
+    _entries.resize(header.entriesCount);
+    std::memcpy(_entries.data(), _view + header.indexOffset, _entries.size() * sizeof(Entry));
+
+    for (Entry& entry : _entries)
+    {
+        entry.name[sizeof(entry.name) - 1] = 0;
+        if (entry.offset % dataAlignment || entry.offset + GetAlignedSize(entry) > _size)
+        {
+            Close();
+            throw std::runtime_error("Asset pack " + fileName + " has entry out of file bounds");
+        }
+    }
+}
+
+Reader::~Reader()
+{
+    Close();
+}
+
+void Reader::Close()
+{
+    if (_view)
+        UnmapViewOfFile(_view);
+    if (_mapping)
+        CloseHandle(_mapping);
+    if (_unbufferedFile != INVALID_HANDLE_VALUE)
+        CloseHandle(_unbufferedFile);
+    if (_file != INVALID_HANDLE_VALUE)
+        CloseHandle(_file);
+
+    _view = nullptr;
+    _mapping = nullptr;
+    _unbufferedFile = INVALID_HANDLE_VALUE;
+    _file = INVALID_HANDLE_VALUE;
+}
+
+const std::vector<Entry>& Reader::Entries() const
+{
+    return _entries;
+}
+
+const Entry* Reader::Find(const std::string& name) const
+{
+    for (const Entry& entry : _entries)
+    {
+        if (name == entry.name)
+            return &entry;
+    }
+    return nullptr;
+}
+
+const uint8_t* Reader::Data(const Entry& entry) const
+{
+    return _view + entry.offset;
+}
+
+void Reader::ReadAsync(const Entry& entry, void* destination, ReadRequest& request) const
+{
+    const size_t size = GetAlignedSize(entry);
+    if (request._pending || size > MAXDWORD || (uintptr_t)destination % dataAlignment)
+        throw std::runtime_error("Invalid asynchronous read of " + std::string(entry.name));
+
+    if (!request._overlapped.hEvent)
+        request._overlapped.hEvent = CreateEvent(nullptr, TRUE, FALSE, nullptr);
+
+    request._overlapped.Offset = (DWORD)entry.offset;
+    request._overlapped.OffsetHigh = (DWORD)(entry.offset >> 32);
+    request._size = (size_t)entry.size;
+    request._file = _unbufferedFile;
+
+    if (!ReadFile(_unbufferedFile, destination, (DWORD)size, nullptr, &request._overlapped) && GetLastError() != ERROR_IO_PENDING)
+        throw std::runtime_error("Failed to read " + std::string(entry.name));
+
+    request._pending = true;
+}
+
+void Reader::Wait(ReadRequest& request) const
+{
+    if (!request._pending)
+        return;
+
+    DWORD bytesRead = 0;
+    const BOOL result = GetOverlappedResult(_unbufferedFile, &request._overlapped, &bytesRead, TRUE);
+    request._pending = false;
+
+    if (!result || bytesRead < request._size)
+        throw std::runtime_error("Asynchronous read of asset pack failed");
+}
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include "stdafx.h"
+
+// One file with cooked assets and an index of named entries. Data of every entry starts at 4 KB boundary,
+// so entries can be read with unbuffered I/O straight to upload buffers, texture entries keep their
+// subresources in copyable footprints layout (see ComputeCopyableFootprints).
+namespace AssetPack
+{
+enum class EntryType : uint32_t
+{
+    Texture,
+    Mesh,       // MeshFile data
+    Shader,     // bytecode
+    Raw
+};
+
+struct TextureInfo
+{
+    uint32_t    dimension;          // D3D12_RESOURCE_DIMENSION
+    uint32_t    format;             // DXGI_FORMAT
+    uint32_t    width;
+    uint32_t    height;
+    uint32_t    depthOrArraySize;
+    uint32_t    mipLevels;
+    uint32_t    cube;
+};
+
+struct Entry
+{
+    char        name[96];
+    EntryType   type;
+    uint32_t    reserved;
+    uint64_t    offset;
+    uint64_t    size;               // not aligned
+    TextureInfo texture;            // textures only
+};
+
+constexpr size_t dataAlignment = 4096;
+
+D3D12_RESOURCE_DESC GetTextureDesc(const Entry& entry);
+
+// Size of unbuffered read of the entry, destination buffers have to be at least that big
+size_t GetAlignedSize(const Entry& entry);
+
+class Writer
+{
+public:
+    explicit Writer(const std::string& fileName);
+
+    // subresources are laid out by copyable footprints of desc
+    void AddTexture(const std::string& name, const D3D12_RESOURCE_DESC& desc, const D3D12_SUBRESOURCE_DATA* subresources, bool cube = false);
+    void AddData(const std::string& name, EntryType type, const void* data, size_t size);
+
+    // writes index, no entries can be added after it
+    void Finish();
+
+private:
+    Entry& BeginEntry(const std::string& name, EntryType type, size_t size);
+    void Pad();
+
+    std::ofstream       _file;
+    std::string         _fileName;
+    std::vector<Entry>  _entries;
+};
+
+// State of one asynchronous read. Destruction cancels a pending read and waits until it stops, so the
+// destination isn't written after that; requests have to be destroyed before their reader.
+class ReadRequest
+{
+public:
+    ReadRequest() = default;
+    ReadRequest(const ReadRequest&) = delete;
+    ReadRequest& operator=(const ReadRequest&) = delete;
+    ~ReadRequest();
+
+private:
+    friend class Reader;
+
+    OVERLAPPED      _overlapped = {};
+    HANDLE          _file = INVALID_HANDLE_VALUE;   // handle of the pending read
+    size_t          _size = 0;
+    bool            _pending = false;
+};
+
+// Maps the whole pack for random access and keeps another unbuffered handle for asynchronous reads,
+// which don't go through the system file cache.
+class Reader
+{
+public:
+    explicit Reader(const std::string& fileName);
+    Reader(const Reader&) = delete;
+    Reader& operator=(const Reader&) = delete;
+    ~Reader();
+
+    const std::vector<Entry>& Entries() const;
+    const Entry* Find(const std::string& name) const;
+
+    // entry data in the mapped view
+    const uint8_t* Data(const Entry& entry) const;
+
+    // destination has to be 4 KB aligned (mapped upload buffers are) and have GetAlignedSize(entry) bytes
+    void ReadAsync(const Entry& entry, void* destination, ReadRequest& request) const;
+    void Wait(ReadRequest& request) const;
+
+private:
+    void Close();
+
+    HANDLE              _file = INVALID_HANDLE_VALUE;
+    HANDLE              _unbufferedFile = INVALID_HANDLE_VALUE;
+    HANDLE              _mapping = nullptr;
+    const uint8_t *     _view = nullptr;
+    uint64_t            _size = 0;
+    std::vector<Entry>  _entries;
+};
+}
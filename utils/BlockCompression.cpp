@@ -0,0 +1,1026 @@
+#include "stdafx.h"
+
+#include "BlockCompression.h"
+
+#include "ParallelFor.h"
+
+#include <DirectXPackedVector.h>
+#include <immintrin.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace DirectX::PackedVector;
+
+namespace BlockCompression
+{
+namespace
+{
+constexpr size_t blockTexels = 16;
+
+// interpolation weights of BC6H and BC7, in 1/64
+constexpr int weights2[4] = {0, 21, 43, 64};
+constexpr int weights4[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+// 4x4 texels stored by channels, so 4 texels are processed by one SSE instruction.
+// LDR formats keep values in [0; 255], BC6H keeps float values.
+struct Block
+{
+    alignas(16) float texels[4][blockTexels];
+};
+
+using Palette = float[blockTexels][4];
+
+class BitWriter
+{
+public:
+    BitWriter(uint8_t* block, size_t size)
+        : _block(block)
+    {
+        std::memset(block, 0, size);
+    }
+
+    void Write(uint32_t value, size_t bits)
+    {
+        for (size_t i = 0; i < bits; ++i, ++_position)
+        {
+            if (value >> i & 1)
+                _block[_position >> 3] |= (uint8_t)(1 << (_position & 7));
+        }
+    }
+
+private:
+    uint8_t *   _block = nullptr;
+    size_t      _position = 0;
+};
+
+class BitReader
+{
+public:
+    explicit BitReader(const uint8_t* block)
+        : _block(block)
+    {
+    }
+
+    uint32_t Read(size_t bits)
+    {
+        uint32_t value = 0;
+        for (size_t i = 0; i < bits; ++i, ++_position)
+            value |= (uint32_t)(_block[_position >> 3] >> (_position & 7) & 1) << i;
+        return value;
+    }
+
+private:
+    const uint8_t * _block = nullptr;
+    size_t          _position = 0;
+};
+
+bool IsLDR(Format format)
+{
+    return format != Format::BC6H;
+}
+
+size_t GetSourceTexelSize(DXGI_FORMAT format)
+{
+    switch (format)
+    {
+    case DXGI_FORMAT_R8G8B8A8_UNORM:
+    case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+    case DXGI_FORMAT_B8G8R8A8_UNORM:
+    case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+        return 4;
+    case DXGI_FORMAT_R16G16B16A16_FLOAT:
+        return 8;
+    case DXGI_FORMAT_R32G32B32A32_FLOAT:
+        return 16;
+    default:
+        throw std::runtime_error("Unsupported source format for block compression");
+    }
+}
+
+XMVECTOR LoadTexel(const uint8_t* row, size_t x, DXGI_FORMAT format)
+{
+    switch (format)
+    {
+    case DXGI_FORMAT_R16G16B16A16_FLOAT:
+        return XMLoadHalf4(reinterpret_cast<const XMHALF4*>(row) + x);
+    case DXGI_FORMAT_R32G32B32A32_FLOAT:
+        return XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(row) + x);
+    case DXGI_FORMAT_B8G8R8A8_UNORM:
+    case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+        return XMVectorSwizzle<2, 1, 0, 3>(XMLoadUByteN4(reinterpret_cast<const XMUBYTEN4*>(row) + x));
+    default:
+        return XMLoadUByteN4(reinterpret_cast<const XMUBYTEN4*>(row) + x);
+    }
+}
+
+void LoadBlock(const D3D12_SUBRESOURCE_DATA& source, DXGI_FORMAT sourceFormat, size_t width, size_t height,
+               size_t blockX, size_t blockY, bool ldr, Block& block)
+{
+    const XMVECTOR ldrScale = XMVectorReplicate(255.0f);
+
+    for (size_t i = 0; i < blockTexels; ++i)
+    {
+        // edge texels are repeated in partial blocks
+        const size_t x = std::min(blockX * 4 + i % 4, width - 1);
+        const size_t y = std::min(blockY * 4 + i / 4, height - 1);
+        const uint8_t * row = static_cast<const uint8_t*>(source.pData) + y * source.RowPitch;
+
+        XMFLOAT4 texel;
+        XMVECTOR value = LoadTexel(row, x, sourceFormat);
+        XMStoreFloat4(&texel, ldr ? XMVectorMultiply(XMVectorSaturate(value), ldrScale) : value);
+
+        block.texels[0][i] = texel.x;
+        block.texels[1][i] = texel.y;
+        block.texels[2][i] = texel.z;
+        block.texels[3][i] = texel.w;
+    }
+}
+
+// Nearest palette entry for every texel over channels [first; first + count), returns squared error
+float FindIndices(const Block& block, const Palette& palette, size_t paletteSize, size_t first, size_t count, uint8_t indices[blockTexels])
+{
+    float error = 0.0f;
+
+    for (size_t i = 0; i < blockTexels; i += 4)
+    {
+        __m128 best = _mm_set1_ps(std::numeric_limits<float>::max());
+        __m128i bestIndex = _mm_setzero_si128();
+
+        for (size_t p = 0; p < paletteSize; ++p)
+        {
+            __m128 distance = _mm_setzero_ps();
+            for (size_t c = first; c < first + count; ++c)
+            {
+                __m128 difference = _mm_sub_ps(_mm_load_ps(&block.texels[c][i]), _mm_set1_ps(palette[p][c]));
+                distance = _mm_add_ps(distance, _mm_mul_ps(difference, difference));
+            }
+
+            __m128i closer = _mm_castps_si128(_mm_cmplt_ps(distance, best));
+            best = _mm_min_ps(distance, best);
+            bestIndex = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32((int)p)), _mm_andnot_si128(closer, bestIndex));
+        }
+
+        alignas(16) int32_t blockIndices[4];
+        alignas(16) float blockErrors[4];
+        _mm_store_si128(reinterpret_cast<__m128i*>(blockIndices), bestIndex);
+        _mm_store_ps(blockErrors, best);
+
+        for (size_t k = 0; k < 4; ++k)
+        {
+            indices[i + k] = (uint8_t)blockIndices[k];
+            error += blockErrors[k];
+        }
+    }
+
+    return error;
+}
+
+// Inset bounding box, its diagonal is selected by signs of covariances with the widest channel
+void FitBoundingBox(const Block& block, size_t first, size_t count, float e0[4], float e1[4])
+{
+    float mean[4] = {};
+    size_t widest = first;
+    for (size_t c = first; c < first + count; ++c)
+    {
+        e0[c] = *std::min_element(block.texels[c], block.texels[c] + blockTexels);
+        e1[c] = *std::max_element(block.texels[c], block.texels[c] + blockTexels);
+        for (size_t i = 0; i < blockTexels; ++i)
+            mean[c] += block.texels[c][i] / blockTexels;
+
+        if (e1[c] - e0[c] > e1[widest] - e0[widest])
+            widest = c;
+    }
+
+    for (size_t c = first; c < first + count; ++c)
+    {
+        const float inset = (e1[c] - e0[c]) / 16.0f;
+        e0[c] += inset;
+        e1[c] -= inset;
+
+        float covariance = 0.0f;
+        for (size_t i = 0; i < blockTexels; ++i)
+            covariance += (block.texels[c][i] - mean[c]) * (block.texels[widest][i] - mean[widest]);
+
+        if (covariance < 0.0f)
+            std::swap(e0[c], e1[c]);
+    }
+}
+
+// The shortest segment along principal axis of texels covering all of them
+void FitPrincipalAxis(const Block& block, size_t first, size_t count, float e0[4], float e1[4])
+{
+    float mean[4] = {};
+    float axis[4] = {};
+    for (size_t c = first; c < first + count; ++c)
+    {
+        for (size_t i = 0; i < blockTexels; ++i)
+            mean[c] += block.texels[c][i] / blockTexels;
+
+        axis[c] = *std::max_element(block.texels[c], block.texels[c] + blockTexels) -
+                  *std::min_element(block.texels[c], block.texels[c] + blockTexels);
+    }
+
+    float covariance[4][4] = {};
+    for (size_t a = first; a < first + count; ++a)
+    {
+        for (size_t b = first; b < first + count; ++b)
+        {
+            for (size_t i = 0; i < blockTexels; ++i)
+                covariance[a][b] += (block.texels[a][i] - mean[a]) * (block.texels[b][i] - mean[b]);
+        }
+    }
+
+    // power iterations
+    for (size_t iteration = 0; iteration < 8; ++iteration)
+    {
+        float next[4] = {};
+        float length = 0.0f;
+        for (size_t a = first; a < first + count; ++a)
+        {
+            for (size_t b = first; b < first + count; ++b)
+                next[a] += covariance[a][b] * axis[b];
+            length = std::max(length, std::abs(next[a]));
+        }
+
+        if (length < 1e-12f)
+            break;
+
+        for (size_t c = first; c < first + count; ++c)
+            axis[c] = next[c] / length;
+    }
+
+    float axisLength = 0.0f;
+    for (size_t c = first; c < first + count; ++c)
+        axisLength += axis[c] * axis[c];
+
+    float tMin = 0.0f, tMax = 0.0f;
+    if (axisLength > 1e-12f)
+    {
+        tMin = std::numeric_limits<float>::max();
+        tMax = -tMin;
+        for (size_t i = 0; i < blockTexels; ++i)
+        {
+            float t = 0.0f;
+            for (size_t c = first; c < first + count; ++c)
+                t += (block.texels[c][i] - mean[c]) * axis[c];
+            tMin = std::min(tMin, t / axisLength);
+            tMax = std::max(tMax, t / axisLength);
+        }
+    }
+
+    for (size_t c = first; c < first + count; ++c)
+    {
+        e0[c] = mean[c] + axis[c] * tMin;
+        e1[c] = mean[c] + axis[c] * tMax;
+    }
+}
+
+// Least squares endpoints for the given indices, texel = e0 * (1 - t) + e1 * t
+bool RefineEndpoints(const Block& block, size_t first, size_t count, const uint8_t indices[blockTexels], const float* t,
+                     float maxValue, float e0[4], float e1[4])
+{
+    float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+    float ax[4] = {}, bx[4] = {};
+    for (size_t i = 0; i < blockTexels; ++i)
+    {
+        const float b = t[indices[i]];
+        const float a = 1.0f - b;
+        aa += a * a;
+        ab += a * b;
+        bb += b * b;
+        for (size_t c = first; c < first + count; ++c)
+        {
+            ax[c] += a * block.texels[c][i];
+            bx[c] += b * block.texels[c][i];
+        }
+    }
+
+    const float determinant = aa * bb - ab * ab;
+    if (std::abs(determinant) < 1e-6f)
+        return false;
+
+    for (size_t c = first; c < first + count; ++c)
+    {
+        e0[c] = std::clamp((bb * ax[c] - ab * bx[c]) / determinant, 0.0f, maxValue);
+        e1[c] = std::clamp((aa * bx[c] - ab * ax[c]) / determinant, 0.0f, maxValue);
+    }
+    return true;
+}
+
+// Quantized endpoints and indices of one subset
+struct Endpoints
+{
+    uint32_t    quantized[2][4] = {};
+    uint32_t    pBits[2] = {};
+    uint8_t     indices[blockTexels] = {};
+    float       t[blockTexels] = {};        // interpolation factor of every index value, for refinement
+};
+
+// Fits endpoints, quantize(e0, e1, endpoints) selects indices and returns error. With Refined preset the
+// endpoints are refined by least squares while the error goes down.
+template<typename Quantize>
+float FitEndpoints(const Block& block, size_t first, size_t count, Preset preset, float maxValue, Endpoints& best, Quantize quantize)
+{
+    float e0[4] = {}, e1[4] = {};
+    if (preset == Preset::Fast)
+        FitBoundingBox(block, first, count, e0, e1);
+    else
+        FitPrincipalAxis(block, first, count, e0, e1);
+
+    float error = quantize(e0, e1, best);
+    if (preset == Preset::Fast)
+        return error;
+
+    for (size_t iteration = 0; iteration < 2 && error > 0.0f; ++iteration)
+    {
+        if (!RefineEndpoints(block, first, count, best.indices, best.t, maxValue, e0, e1))
+            break;
+
+        Endpoints candidate;
+        float candidateError = quantize(e0, e1, candidate);
+        if (candidateError >= error)
+            break;
+
+        best = candidate;
+        error = candidateError;
+    }
+
+    return error;
+}
+
+int Interpolate(int e0, int e1, int weight)
+{
+    return ((64 - weight) * e0 + weight * e1 + 32) >> 6;
+}
+
+// The most significant bit of the first index is implicit zero, endpoints are swapped if it isn't
+void FixAnchorIndex(Endpoints& endpoints, size_t indexBits)
+{
+    const uint8_t maxIndex = (uint8_t)((1 << indexBits) - 1);
+    if (endpoints.indices[0] <= maxIndex >> 1)
+        return;
+
+    std::swap(endpoints.quantized[0], endpoints.quantized[1]);
+    std::swap(endpoints.pBits[0], endpoints.pBits[1]);
+    for (uint8_t& index : endpoints.indices)
+        index = (uint8_t)(maxIndex - index);
+}
+
+// BC1
+
+uint16_t PackRGB565(const float color[4])
+{
+    uint32_t r = (uint32_t)std::lround(std::clamp(color[0], 0.0f, 255.0f) * 31.0f / 255.0f);
+    uint32_t g = (uint32_t)std::lround(std::clamp(color[1], 0.0f, 255.0f) * 63.0f / 255.0f);
+    uint32_t b = (uint32_t)std::lround(std::clamp(color[2], 0.0f, 255.0f) * 31.0f / 255.0f);
+    return (uint16_t)(r << 11 | g << 5 | b);
+}
+
+void UnpackRGB565(uint32_t packed, float color[4])
+{
+    uint32_t r = packed >> 11 & 31, g = packed >> 5 & 63, b = packed & 31;
+    color[0] = (float)(r << 3 | r >> 2);
+    color[1] = (float)(g << 2 | g >> 4);
+    color[2] = (float)(b << 3 | b >> 2);
+    color[3] = 255.0f;
+}
+
+void EncodeBC1(const Block& block, Preset preset, uint8_t* output)
+{
+    Endpoints endpoints;
+    FitEndpoints(block, 0, 3, preset, 255.0f, endpoints, [&](const float* e0, const float* e1, Endpoints& result)
+    {
+        uint32_t color0 = PackRGB565(e0);
+        uint32_t color1 = PackRGB565(e1);
+        // color0 > color1 selects 4 colors mode
+        if (color0 < color1)
+            std::swap(color0, color1);
+
+        Palette palette = {};
+        UnpackRGB565(color0, palette[0]);
+        UnpackRGB565(color1, palette[1]);
+        for (size_t c = 0; c < 3; ++c)
+        {
+            palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+            palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+        }
+
+        result.quantized[0][0] = color0;
+        result.quantized[1][0] = color1;
+        result.t[0] = 0.0f;
+        result.t[1] = 1.0f;
+        result.t[2] = 1.0f / 3.0f;
+        result.t[3] = 2.0f / 3.0f;
+        return FindIndices(block, palette, color0 == color1 ? 1 : 4, 0, 3, result.indices);
+    });
+
+    BitWriter writer {output, 8};
+    writer.Write(endpoints.quantized[0][0], 16);
+    writer.Write(endpoints.quantized[1][0], 16);
+    for (size_t i = 0; i < blockTexels; ++i)
+        writer.Write(endpoints.indices[i], 2);
+}
+
+// BC4, BC5 is two of them
+
+void EncodeBC4(const Block& block, size_t channel, Preset preset, uint8_t* output)
+{
+    Endpoints endpoints;
+    FitEndpoints(block, channel, 1, preset, 255.0f, endpoints, [&](const float* e0, const float* e1, Endpoints& result)
+    {
+        // red0 > red1 selects 8 values mode
+        const uint32_t red0 = (uint32_t)std::lround(std::clamp(std::max(e0[channel], e1[channel]), 0.0f, 255.0f));
+        const uint32_t red1 = (uint32_t)std::lround(std::clamp(std::min(e0[channel], e1[channel]), 0.0f, 255.0f));
+
+        Palette palette = {};
+        result.t[0] = 0.0f;
+        result.t[1] = 1.0f;
+        for (size_t k = 2; k < 8; ++k)
+            result.t[k] = (k - 1) / 7.0f;
+        for (size_t k = 0; k < 8; ++k)
+            palette[k][channel] = red0 * (1.0f - result.t[k]) + red1 * result.t[k];
+
+        result.quantized[0][0] = red0;
+        result.quantized[1][0] = red1;
+        return FindIndices(block, palette, red0 == red1 ? 1 : 8, channel, 1, result.indices);
+    });
+
+    BitWriter writer {output, 8};
+    writer.Write(endpoints.quantized[0][0], 8);
+    writer.Write(endpoints.quantized[1][0], 8);
+    for (size_t i = 0; i < blockTexels; ++i)
+        writer.Write(endpoints.indices[i], 3);
+}
+
+// BC7, modes with one subset only: 6 (RGBA 7.7.7.7 + p-bit, 4 bits indices) and 5 (RGB 7.7.7 and A8 with separate 2 bits indices)
+
+// Endpoint value is (q << 1 | p), both p-bits are tried
+void QuantizeWithPBit(const float value[4], uint32_t quantized[4], uint32_t& pBit)
+{
+    float bestError = std::numeric_limits<float>::max();
+    for (uint32_t p = 0; p < 2; ++p)
+    {
+        uint32_t q[4];
+        float error = 0.0f;
+        for (size_t c = 0; c < 4; ++c)
+        {
+            q[c] = (uint32_t)std::clamp<long>(std::lround((value[c] - p) / 2.0f), 0, 127);
+            float difference = (float)(q[c] << 1 | p) - value[c];
+            error += difference * difference;
+        }
+
+        if (error < bestError)
+        {
+            bestError = error;
+            pBit = p;
+            std::copy(q, q + 4, quantized);
+        }
+    }
+}
+
+float EncodeBC7Mode6(const Block& block, Preset preset, uint8_t* output)
+{
+    Endpoints endpoints;
+    float error = FitEndpoints(block, 0, 4, preset, 255.0f, endpoints, [&](const float* e0, const float* e1, Endpoints& result)
+    {
+        QuantizeWithPBit(e0, result.quantized[0], result.pBits[0]);
+        QuantizeWithPBit(e1, result.quantized[1], result.pBits[1]);
+
+        Palette palette;
+        for (size_t k = 0; k < 16; ++k)
+        {
+            result.t[k] = weights4[k] / 64.0f;
+            for (size_t c = 0; c < 4; ++c)
+            {
+                palette[k][c] = (float)Interpolate((int)(result.quantized[0][c] << 1 | result.pBits[0]),
+                                                   (int)(result.quantized[1][c] << 1 | result.pBits[1]),
+                                                   weights4[k]);
+            }
+        }
+
+        return FindIndices(block, palette, 16, 0, 4, result.indices);
+    });
+
+    FixAnchorIndex(endpoints, 4);
+
+    BitWriter writer {output, 16};
+    writer.Write(1 << 6, 7);
+    for (size_t c = 0; c < 4; ++c)
+    {
+        writer.Write(endpoints.quantized[0][c], 7);
+        writer.Write(endpoints.quantized[1][c], 7);
+    }
+    writer.Write(endpoints.pBits[0], 1);
+    writer.Write(endpoints.pBits[1], 1);
+    for (size_t i = 0; i < blockTexels; ++i)
+        writer.Write(endpoints.indices[i], i == 0 ? 3 : 4);
+
+    return error;
+}
+
+float EncodeBC7Mode5(const Block& block, Preset preset, uint8_t* output)
+{
+    // color and alpha have their own indices, so they are fitted independently
+    Endpoints color;
+    float error = FitEndpoints(block, 0, 3, preset, 255.0f, color, [&](const float* e0, const float* e1, Endpoints& result)
+    {
+        Palette palette = {};
+        for (size_t c = 0; c < 3; ++c)
+        {
+            result.quantized[0][c] = (uint32_t)std::lround(std::clamp(e0[c], 0.0f, 255.0f) * 127.0f / 255.0f);
+            result.quantized[1][c] = (uint32_t)std::lround(std::clamp(e1[c], 0.0f, 255.0f) * 127.0f / 255.0f);
+            for (size_t k = 0; k < 4; ++k)
+            {
+                palette[k][c] = (float)Interpolate((int)(result.quantized[0][c] << 1 | result.quantized[0][c] >> 6),
+                                                   (int)(result.quantized[1][c] << 1 | result.quantized[1][c] >> 6),
+                                                   weights2[k]);
+            }
+        }
+
+        for (size_t k = 0; k < 4; ++k)
+            result.t[k] = weights2[k] / 64.0f;
+        return FindIndices(block, palette, 4, 0, 3, result.indices);
+    });
+
+    Endpoints alpha;
+    error += FitEndpoints(block, 3, 1, preset, 255.0f, alpha, [&](const float* e0, const float* e1, Endpoints& result)
+    {
+        result.quantized[0][0] = (uint32_t)std::lround(std::clamp(e0[3], 0.0f, 255.0f));
+        result.quantized[1][0] = (uint32_t)std::lround(std::clamp(e1[3], 0.0f, 255.0f));
+
+        Palette palette = {};
+        for (size_t k = 0; k < 4; ++k)
+        {
+            result.t[k] = weights2[k] / 64.0f;
+            palette[k][3] = (float)Interpolate((int)result.quantized[0][0], (int)result.quantized[1][0], weights2[k]);
+        }
+        return FindIndices(block, palette, 4, 3, 1, result.indices);
+    });
+
+    FixAnchorIndex(color, 2);
+    FixAnchorIndex(alpha, 2);
+
+    BitWriter writer {output, 16};
+    writer.Write(1 << 5, 6);
+    writer.Write(0, 2);     // no channels rotation
+    for (size_t c = 0; c < 3; ++c)
+    {
+        writer.Write(color.quantized[0][c], 7);
+        writer.Write(color.quantized[1][c], 7);
+    }
+    writer.Write(alpha.quantized[0][0], 8);
+    writer.Write(alpha.quantized[1][0], 8);
+    for (size_t i = 0; i < blockTexels; ++i)
+        writer.Write(color.indices[i], i == 0 ? 1 : 2);
+    for (size_t i = 0; i < blockTexels; ++i)
+        writer.Write(alpha.indices[i], i == 0 ? 1 : 2);
+
+    return error;
+}
+
+void EncodeBC7(const Block& block, Preset preset, uint8_t* output)
+{
+    float error = EncodeBC7Mode6(block, preset, output);
+    if (preset == Preset::Fast || error == 0.0f)
+        return;
+
+    uint8_t candidate[16];
+    if (EncodeBC7Mode5(block, preset, candidate) < error)
+        std::memcpy(output, candidate, sizeof(candidate));
+}
+
+// BC6H, mode 11 (one region, 10 bits endpoints without deltas, 4 bits indices), unsigned only.
+// Blocks are encoded in "unquantized" space: 16 bits integers which are linear in half float bits,
+// hardware interpolates them and the result is converted to half as (value * 31) >> 6.
+
+float ToBC6HSpace(float value)
+{
+    return XMConvertFloatToHalf(std::clamp(value, 0.0f, 65504.0f)) * 64.0f / 31.0f;
+}
+
+float FromBC6HSpace(uint32_t value)
+{
+    return XMConvertHalfToFloat((HALF)((value * 31) >> 6));
+}
+
+uint32_t UnquantizeBC6H(uint32_t value)
+{
+    if (value == 0)
+        return 0;
+    if (value == 1023)
+        return 0xFFFF;
+    return ((value << 16) + 0x8000) >> 10;
+}
+
+uint32_t QuantizeBC6H(float value)
+{
+    const long nearest = std::lround((value - 32.0f) / 64.0f);
+    uint32_t best = 0;
+    float bestError = std::numeric_limits<float>::max();
+    for (long candidate = nearest - 1; candidate <= nearest + 1; ++candidate)
+    {
+        uint32_t quantized = (uint32_t)std::clamp<long>(candidate, 0, 1023);
+        float error = std::abs((float)UnquantizeBC6H(quantized) - value);
+        if (error < bestError)
+        {
+            bestError = error;
+            best = quantized;
+        }
+    }
+    return best;
+}
+
+void EncodeBC6H(const Block& source, Preset preset, uint8_t* output)
+{
+    Block block = {};
+    for (size_t c = 0; c < 3; ++c)
+    {
+        for (size_t i = 0; i < blockTexels; ++i)
+            block.texels[c][i] = ToBC6HSpace(source.texels[c][i]);
+    }
+
+    Endpoints endpoints;
+    FitEndpoints(block, 0, 3, preset, 65535.0f, endpoints, [&](const float* e0, const float* e1, Endpoints& result)
+    {
+        Palette palette = {};
+        for (size_t c = 0; c < 3; ++c)
+        {
+            result.quantized[0][c] = QuantizeBC6H(e0[c]);
+            result.quantized[1][c] = QuantizeBC6H(e1[c]);
+            for (size_t k = 0; k < 16; ++k)
+            {
+                palette[k][c] = (float)Interpolate((int)UnquantizeBC6H(result.quantized[0][c]),
+                                                   (int)UnquantizeBC6H(result.quantized[1][c]),
+                                                   weights4[k]);
+            }
+        }
+
+        for (size_t k = 0; k < 16; ++k)
+            result.t[k] = weights4[k] / 64.0f;
+        return FindIndices(block, palette, 16, 0, 3, result.indices);
+    });
+
+    FixAnchorIndex(endpoints, 4);
+
+    BitWriter writer {output, 16};
+    writer.Write(0x03, 5);
+    for (size_t e = 0; e < 2; ++e)
+    {
+        for (size_t c = 0; c < 3; ++c)
+            writer.Write(endpoints.quantized[e][c], 10);
+    }
+    for (size_t i = 0; i < blockTexels; ++i)
+        writer.Write(endpoints.indices[i], i == 0 ? 3 : 4);
+}
+
+void EncodeBlock(const Block& block, Format format, Preset preset, uint8_t* output)
+{
+    switch (format)
+    {
+    case Format::BC1:
+        EncodeBC1(block, preset, output);
+        break;
+    case Format::BC4:
+        EncodeBC4(block, 0, preset, output);
+        break;
+    case Format::BC5:
+        EncodeBC4(block, 0, preset, output);
+        EncodeBC4(block, 1, preset, output + 8);
+        break;
+    case Format::BC6H:
+        EncodeBC6H(block, preset, output);
+        break;
+    case Format::BC7:
+        EncodeBC7(block, preset, output);
+        break;
+    }
+}
+
+// Decoders are used for quality measurements, BC7 and BC6H ones know only the modes the encoder writes
+
+void DecodeBC1(const uint8_t* input, Block& block)
+{
+    BitReader reader {input};
+    const uint16_t color0 = (uint16_t)reader.Read(16);
+    const uint16_t color1 = (uint16_t)reader.Read(16);
+
+    Palette palette = {};
+    UnpackRGB565(color0, palette[0]);
+    UnpackRGB565(color1, palette[1]);
+    for (size_t c = 0; c < 3; ++c)
+    {
+        if (color0 > color1)
+        {
+            palette[2][c] = std::floor((2.0f * palette[0][c] + palette[1][c] + 1.0f) / 3.0f);
+            palette[3][c] = std::floor((palette[0][c] + 2.0f * palette[1][c] + 1.0f) / 3.0f);
+        }
+        else
+        {
+            palette[2][c] = std::floor((palette[0][c] + palette[1][c]) / 2.0f);
+        }
+    }
+    palette[2][3] = 255.0f;
+    palette[3][3] = color0 > color1 ? 255.0f : 0.0f;
+
+    for (size_t i = 0; i < blockTexels; ++i)
+    {
+        const uint32_t index = reader.Read(2);
+        for (size_t c = 0; c < 4; ++c)
+            block.texels[c][i] = palette[index][c];
+    }
+}
+
+void DecodeBC4(const uint8_t* input, size_t channel, Block& block)
+{
+    BitReader reader {input};
+    const float red0 = (float)reader.Read(8);
+    const float red1 = (float)reader.Read(8);
+
+    float palette[8] = {red0, red1};
+    for (size_t k = 2; k < 8; ++k)
+    {
+        if (red0 > red1)
+            palette[k] = ((8 - k) * red0 + (k - 1) * red1) / 7.0f;
+        else
+            palette[k] = k < 6 ? ((6 - k) * red0 + (k - 1) * red1) / 5.0f : (k == 6 ? 0.0f : 255.0f);
+    }
+
+    for (size_t i = 0; i < blockTexels; ++i)
+        block.texels[channel][i] = palette[reader.Read(3)];
+}
+
+void DecodeBC7(const uint8_t* input, Block& block)
+{
+    BitReader reader {input};
+    size_t mode = 0;
+    while (mode < 8 && !reader.Read(1))
+        mode++;
+
+    if (mode == 6)
+    {
+        int endpoints[2][4];
+        for (size_t c = 0; c < 4; ++c)
+        {
+            endpoints[0][c] = (int)reader.Read(7) << 1;
+            endpoints[1][c] = (int)reader.Read(7) << 1;
+        }
+        const int p0 = (int)reader.Read(1), p1 = (int)reader.Read(1);
+        for (size_t c = 0; c < 4; ++c)
+        {
+            endpoints[0][c] |= p0;
+            endpoints[1][c] |= p1;
+        }
+
+        for (size_t i = 0; i < blockTexels; ++i)
+        {
+            const int weight = weights4[reader.Read(i == 0 ? 3 : 4)];
+            for (size_t c = 0; c < 4; ++c)
+                block.texels[c][i] = (float)Interpolate(endpoints[0][c], endpoints[1][c], weight);
+        }
+    }
+    else if (mode == 5)
+    {
+        const uint32_t rotation = reader.Read(2);
+        int endpoints[2][4];
+        for (size_t c = 0; c < 3; ++c)
+        {
+            for (size_t e = 0; e < 2; ++e)
+            {
+                const int value = (int)reader.Read(7);
+                endpoints[e][c] = value << 1 | value >> 6;
+            }
+        }
+        endpoints[0][3] = (int)reader.Read(8);
+        endpoints[1][3] = (int)reader.Read(8);
+
+        uint32_t colorIndices[blockTexels];
+        for (size_t i = 0; i < blockTexels; ++i)
+            colorIndices[i] = reader.Read(i == 0 ? 1 : 2);
+
+        for (size_t i = 0; i < blockTexels; ++i)
+        {
+            const uint32_t alphaIndex = reader.Read(i == 0 ? 1 : 2);
+            for (size_t c = 0; c < 3; ++c)
+                block.texels[c][i] = (float)Interpolate(endpoints[0][c], endpoints[1][c], weights2[colorIndices[i]]);
+            block.texels[3][i] = (float)Interpolate(endpoints[0][3], endpoints[1][3], weights2[alphaIndex]);
+
+            if (rotation)
+                std::swap(block.texels[3][i], block.texels[rotation - 1][i]);
+        }
+    }
+    else
+    {
+        std::memset(&block, 0, sizeof(block));
+    }
+}
+
+void DecodeBC6H(const uint8_t* input, Block& block)
+{
+    BitReader reader {input};
+    if (reader.Read(5) != 0x03)
+    {
+        std::memset(&block, 0, sizeof(block));
+        return;
+    }
+
+    int endpoints[2][3];
+    for (size_t e = 0; e < 2; ++e)
+    {
+        for (size_t c = 0; c < 3; ++c)
+            endpoints[e][c] = (int)UnquantizeBC6H(reader.Read(10));
+    }
+
+    for (size_t i = 0; i < blockTexels; ++i)
+    {
+        const int weight = weights4[reader.Read(i == 0 ? 3 : 4)];
+        for (size_t c = 0; c < 3; ++c)
+            block.texels[c][i] = FromBC6HSpace((uint32_t)Interpolate(endpoints[0][c], endpoints[1][c], weight));
+        block.texels[3][i] = 1.0f;
+    }
+}
+
+void DecodeBlock(const uint8_t* input, Format format, Block& block)
+{
+    switch (format)
+    {
+    case Format::BC1:
+        DecodeBC1(input, block);
+        break;
+    case Format::BC4:
+        DecodeBC4(input, 0, block);
+        break;
+    case Format::BC5:
+        DecodeBC4(input, 0, block);
+        DecodeBC4(input + 8, 1, block);
+        break;
+    case Format::BC6H:
+        DecodeBC6H(input, block);
+        break;
+    case Format::BC7:
+        DecodeBC7(input, block);
+        break;
+    }
+}
+
+size_t GetChannelsCount(Format format)
+{
+    switch (format)
+    {
+    case Format::BC4:
+        return 1;
+    case Format::BC5:
+        return 2;
+    case Format::BC7:
+        return 4;
+    default:
+        return 3;
+    }
+}
+
+size_t Align(size_t value, size_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+}
+
+DXGI_FORMAT GetCompressedFormat(Format format, bool srgb)
+{
+    switch (format)
+    {
+    case Format::BC1:
+        return srgb ? DXGI_FORMAT_BC1_UNORM_SRGB : DXGI_FORMAT_BC1_UNORM;
+    case Format::BC4:
+        return DXGI_FORMAT_BC4_UNORM;
+    case Format::BC5:
+        return DXGI_FORMAT_BC5_UNORM;
+    case Format::BC6H:
+        return DXGI_FORMAT_BC6H_UF16;
+    case Format::BC7:
+        return srgb ? DXGI_FORMAT_BC7_UNORM_SRGB : DXGI_FORMAT_BC7_UNORM;
+    }
+
+    return DXGI_FORMAT_UNKNOWN;
+}
+
+size_t GetBlockSize(Format format)
+{
+    return (format == Format::BC1 || format == Format::BC4) ? 8 : 16;
+}
+
+CompressedTexture Compress(DXGI_FORMAT sourceFormat,
+                           size_t width,
+                           size_t height,
+                           size_t mipLevels,
+                           const D3D12_SUBRESOURCE_DATA* subresources,
+                           size_t subresourcesCount,
+                           Format format,
+                           Preset preset)
+{
+    GetSourceTexelSize(sourceFormat);
+    if (!width || !height || !mipLevels)
+        throw std::runtime_error("Empty texture can't be compressed");
+
+    const bool srgb = sourceFormat == DXGI_FORMAT_R8G8B8A8_UNORM_SRGB || sourceFormat == DXGI_FORMAT_B8G8R8A8_UNORM_SRGB;
+    const size_t blockSize = GetBlockSize(format);
+
+    CompressedTexture texture;
+    texture.format = GetCompressedFormat(format, srgb);
+
+    struct BlocksRow
+    {
+        size_t subresource;
+        size_t row;
+    };
+
+    std::vector<size_t> offsets;
+    std::vector<BlocksRow> rows;
+    size_t totalSize = 0;
+    for (size_t i = 0; i < subresourcesCount; ++i)
+    {
+        const size_t mip = i % mipLevels;
+        const size_t blocksX = (std::max<size_t>(width >> mip, 1) + 3) / 4;
+        const size_t blocksY = (std::max<size_t>(height >> mip, 1) + 3) / 4;
+        const size_t rowPitch = Align(blocksX * blockSize, D3D12_TEXTURE_DATA_PITCH_ALIGNMENT);
+
+        totalSize = Align(totalSize, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+        offsets.push_back(totalSize);
+        texture.subresources.push_back({nullptr, (LONG_PTR)rowPitch, (LONG_PTR)(rowPitch * blocksY)});
+        totalSize += rowPitch * blocksY;
+
+        for (size_t row = 0; row < blocksY; ++row)
+            rows.push_back({i, row});
+    }
+
+    texture.data.resize(totalSize, 0x0);
+    for (size_t i = 0; i < texture.subresources.size(); ++i)
+        texture.subresources[i].pData = texture.data.data() + offsets[i];
+
+    Threading::ParallelFor(rows.size(), 4, [&](size_t begin, size_t end)
+    {
+        Block block;
+        for (size_t r = begin; r < end; ++r)
+        {
+            const size_t subresource = rows[r].subresource;
+            const size_t mipWidth = std::max<size_t>(width >> subresource % mipLevels, 1);
+            const size_t mipHeight = std::max<size_t>(height >> subresource % mipLevels, 1);
+            const D3D12_SUBRESOURCE_DATA& destination = texture.subresources[subresource];
+            uint8_t * output = (uint8_t*)destination.pData + rows[r].row * destination.RowPitch;
+
+            for (size_t blockX = 0; blockX < (mipWidth + 3) / 4; ++blockX)
+            {
+                LoadBlock(subresources[subresource], sourceFormat, mipWidth, mipHeight, blockX, rows[r].row, IsLDR(format), block);
+                EncodeBlock(block, format, preset, output + blockX * blockSize);
+            }
+        }
+    });
+
+    return texture;
+}
+
+double MeasurePSNR(DXGI_FORMAT sourceFormat,
+                   const D3D12_SUBRESOURCE_DATA& source,
+                   size_t width,
+                   size_t height,
+                   Format format,
+                   const D3D12_SUBRESOURCE_DATA& compressed)
+{
+    GetSourceTexelSize(sourceFormat);
+
+    const size_t channels = GetChannelsCount(format);
+    double squaredError = 0.0;
+    double peak = IsLDR(format) ? 255.0 : 0.0;
+
+    Block original, decoded;
+    for (size_t blockY = 0; blockY < (height + 3) / 4; ++blockY)
+    {
+        for (size_t blockX = 0; blockX < (width + 3) / 4; ++blockX)
+        {
+            LoadBlock(source, sourceFormat, width, height, blockX, blockY, IsLDR(format), original);
+            DecodeBlock(static_cast<const uint8_t*>(compressed.pData) + blockY * compressed.RowPitch + blockX * GetBlockSize(format), format, decoded);
+
+            for (size_t i = 0; i < blockTexels; ++i)
+            {
+                // padding texels are not a part of the image
+                if (blockX * 4 + i % 4 >= width || blockY * 4 + i / 4 >= height)
+                    continue;
+
+                for (size_t c = 0; c < channels; ++c)
+                {
+                    const double value = IsLDR(format) ? original.texels[c][i] : std::max(original.texels[c][i], 0.0f);
+                    const double difference = value - decoded.texels[c][i];
+                    squaredError += difference * difference;
+                    peak = std::max(peak, value);
+                }
+            }
+        }
+    }
+
+    const double meanError = squaredError / (width * height * channels);
+    if (meanError == 0.0)
+        return std::numeric_limits<double>::infinity();
+
+    return 10.0 * std::log10(peak * peak / meanError);
+}
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "stdafx.h"
+
+// CPU block compression of 2D textures and texture arrays.
+// BC1/BC4/BC5/BC7 take texels as they are (sRGB data gives sRGB BC1/BC7), BC6H stores unsigned half floats.
+// Only single subset modes are written: BC7 modes 5 and 6, BC6H mode 11. Partitioned modes (BC7 0-3 and 7,
+// BC6H 1-10) and signed BC6H aren't implemented, so blocks with several distinct colors lose more than
+// with full encoders in both presets.
+namespace BlockCompression
+{
+enum class Format
+{
+    BC1,    // RGB, 4 bits per texel
+    BC4,    // R, 4 bits per texel
+    BC5,    // RG, 8 bits per texel
+    BC6H,   // HDR RGB (UF16), 8 bits per texel
+    BC7     // RGBA, 8 bits per texel
+};
+
+enum class Preset
+{
+    Fast,       // endpoints from bounding box, BC7 uses mode 6 only
+    Refined     // endpoints along principal axis refined by least squares, BC7 tries modes 5 and 6
+};
+
+struct CompressedTexture
+{
+    DXGI_FORMAT                         format = DXGI_FORMAT_UNKNOWN;
+    std::vector<uint8_t>                data;
+    // the same order as the source subresources, rows of blocks are aligned like in copyable footprints
+    std::vector<D3D12_SUBRESOURCE_DATA> subresources;
+};
+
+DXGI_FORMAT GetCompressedFormat(Format format, bool srgb);
+size_t GetBlockSize(Format format);
+
+// Source formats: R8G8B8A8_UNORM(_SRGB), B8G8R8A8_UNORM(_SRGB), R16G16B16A16_FLOAT, R32G32B32A32_FLOAT, any of them
+// can be compressed to any format. Subresource i is mip (i % mipLevels) of width x height texture, partial
+// blocks are padded by edge texels. All blocks are compressed in parallel, texels are matched with SSE.
+CompressedTexture Compress(DXGI_FORMAT sourceFormat,
+                           size_t width,
+                           size_t height,
+                           size_t mipLevels,
+                           const D3D12_SUBRESOURCE_DATA* subresources,
+                           size_t subresourcesCount,
+                           Format format,
+                           Preset preset);
+
+// Peak signal to noise ratio (dB) of decompressed width x height subresource against its source over channels
+// kept by the format. The peak is 255 for LDR formats and the maximum source value for BC6H.
+double MeasurePSNR(DXGI_FORMAT sourceFormat,
+                   const D3D12_SUBRESOURCE_DATA& source,
+                   size_t width,
+                   size_t height,
+                   Format format,
+                   const D3D12_SUBRESOURCE_DATA& compressed);
+}
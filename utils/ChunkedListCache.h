@@ -0,0 +1,99 @@
+#pragma once
+
+#include "stdafx.h"
+
+#include "MeshFile.h"
+
+#include <vector>
+
+// Command lists recorded for chunks of items and kept while the hash of their items is the same.
+// Items are split into chunks which differ in size by one item at most, Payload is what the owner
+// keeps per list, like the time of its last recording.
+template<typename Payload>
+class ChunkedListCache
+{
+public:
+    struct Chunk : Payload
+    {
+        size_t      firstItem = 0;
+        size_t      itemsCount = 0;
+        uint64_t    hash = 0;       // items and state the list is recorded with
+        bool        recorded = false;
+        bool        dirty = false;  // recorded in current frame
+    };
+
+    // Splits itemsCount items into chunksCount chunks and returns chunks to record. hashItem(index, hash)
+    // adds what the list depends on for the item, stateHash is what all lists depend on. Without reuse
+    // hashes aren't computed and every chunk is dirty.
+    template<typename HashItem>
+    const std::vector<size_t>& Update(size_t chunksCount, size_t itemsCount, uint64_t stateHash, bool reuse, HashItem&& hashItem)
+    {
+        _chunks.resize(chunksCount);
+        _dirty.clear();
+
+        for (size_t chunkIndex = 0; chunkIndex < chunksCount; ++chunkIndex)
+        {
+            Chunk& chunk = _chunks[chunkIndex];
+            const size_t firstItem = chunkIndex * itemsCount / chunksCount;
+            const size_t chunkItems = (chunkIndex + 1) * itemsCount / chunksCount - firstItem;
+
+            uint64_t hash = 0;
+            if (reuse)
+            {
+                hash = MeshFile::Hash(&firstItem, sizeof(firstItem), stateHash);
+                hash = MeshFile::Hash(&chunkItems, sizeof(chunkItems), hash);
+                for (size_t i = firstItem; i < firstItem + chunkItems; ++i)
+                    hash = hashItem(i, hash);
+            }
+
+            chunk.dirty = !reuse || !chunk.recorded || chunk.hash != hash;
+            if (!chunk.dirty)
+                continue;
+
+            chunk.firstItem = firstItem;
+            chunk.itemsCount = chunkItems;
+            chunk.hash = hash;
+            chunk.recorded = false;
+            _dirty.push_back(chunkIndex);
+        }
+        return _dirty;
+    }
+
+    // the list of the chunk is closed, it's reused while the hash is the same
+    void MarkRecorded(size_t chunkIndex)
+    {
+        _chunks[chunkIndex].recorded = true;
+    }
+
+    // lists are lost, all chunks are recorded again
+    void Clear()
+    {
+        _chunks.clear();
+        _dirty.clear();
+    }
+
+    Chunk& operator[](size_t chunkIndex)
+    {
+        return _chunks[chunkIndex];
+    }
+
+    const Chunk& operator[](size_t chunkIndex) const
+    {
+        return _chunks[chunkIndex];
+    }
+
+    size_t Size() const
+    {
+        return _chunks.size();
+    }
+
+    // chunks of the last update to record, in order
+    const std::vector<size_t>& Dirty() const
+    {
+        return _dirty;
+    }
+
+private:
+    std::vector<Chunk>  _chunks {};
+    std::vector<size_t> _dirty {};
+};
@@ -10,20 +10,29 @@ ComputePipelineState::ComputePipelineState()
 ComputePipelineState::ComputePipelineState(const RootSignature &pRootSignature)
 {
     _description.pRootSignature = pRootSignature.GetInternal().Get();
+    _rootSignatureHash = pRootSignature.Hash();
 }
 
 void ComputePipelineState::SetRootSignature(const RootSignature &pRootSignature)
 {
     _description.pRootSignature = pRootSignature.GetInternal().Get();
+    _rootSignatureHash = pRootSignature.Hash();
 }
 
 void ComputePipelineState::SetShaderCode(ComPtr<ID3DBlob> pShaderCode)
 {
     _description.CS = {pShaderCode->GetBufferPointer(), pShaderCode->GetBufferSize()};
+    _shader = pShaderCode;
 }
 
 ComPtr<ID3D12PipelineState> ComputePipelineState::GetPSO()
 {
+    if (_pendingPso.valid())
+    {
+        _pso = _pendingPso.get();
+        _pendingPso = {};
+    }
+
     assert(_pso);
     return _pso;
 }
@@ -32,3 +41,9 @@ void ComputePipelineState::Finalize(ComPtr<ID3D12Device> pDevice)
 {
     ThrowIfFailed(pDevice->CreateComputePipelineState(&_description, IID_PPV_ARGS(&_pso)));
 }
+
+void ComputePipelineState::Finalize(PipelineStateManager& manager, bool background /*= false*/)
+{
+    _pso = nullptr;
+    _pendingPso = manager.Create(_description, _rootSignatureHash, {_shader}, background);
+}
@@ -3,6 +3,7 @@
 #include "stdafx.h"
 #include "Types.h"
 #include "RootSignature.h"
+#include "PipelineStateManager.h"
 
 class ComputePipelineState
 {
@@ -13,10 +14,15 @@ public:
     void SetRootSignature(const RootSignature &pRootSignature);
     void SetShaderCode(ComPtr<ID3DBlob> pShaderCode);
 
+    // waits for the state if it's not compiled yet
     ComPtr<ID3D12PipelineState> GetPSO();
     void Finalize(ComPtr<ID3D12Device> pDevice);
+    void Finalize(PipelineStateManager& manager, bool background = false);
 
 private:
     D3D12_COMPUTE_PIPELINE_STATE_DESC   _description = {};
+    ComPtr<ID3DBlob>                    _shader = nullptr;
+    uint64_t                            _rootSignatureHash = 0;
     ComPtr<ID3D12PipelineState>         _pso = nullptr;
+    PipelineStateFuture                 _pendingPso;
 };
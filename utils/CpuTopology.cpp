@@ -0,0 +1,214 @@
+#include "stdafx.h"
+
+#include "CpuTopology.h"
+
+#include <algorithm>
+#include <tuple>
+
+namespace Threading
+{
+namespace
+{
+bool Contains(const GROUP_AFFINITY& mask, const LogicalProcessor& processor)
+{
+    return mask.Group == processor.group && (mask.Mask & ((KAFFINITY)1 << processor.number)) != 0;
+}
+
+size_t CountDistinct(const std::vector<LogicalProcessor>& processors, uint32_t LogicalProcessor::* domain)
+{
+    std::set<uint32_t> domains;
+    for (const LogicalProcessor& processor : processors)
+        domains.insert(processor.*domain);
+    return domains.size();
+}
+}
+
+CpuTopology CpuTopology::Query()
+{
+    DWORD size = 0;
+    GetLogicalProcessorInformationEx(RelationAll, nullptr, &size);
+    std::vector<uint8_t> buffer(size);
+    if (!size || !GetLogicalProcessorInformationEx(RelationAll, reinterpret_cast<SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*>(buffer.data()), &size))
+    {
+        unsigned processorsCount = std::thread::hardware_concurrency();
+        if (processorsCount == 0) // unable to detect
+            processorsCount = 8;
+
+        std::vector<LogicalProcessor> processors(processorsCount);
+        for (uint32_t i = 0; i < processorsCount; ++i)
+            processors[i].core = i;
+        return CpuTopology {std::move(processors), false};
+    }
+
+    return Parse(buffer.data(), size);
+}
+
+CpuTopology CpuTopology::Parse(const uint8_t* buffer, size_t size)
+{
+    // cores enumerate logical processors, caches and NUMA nodes refer to them by masks
+    std::vector<LogicalProcessor> processors;
+    std::vector<std::pair<GROUP_AFFINITY, BYTE>> caches;
+    std::vector<std::pair<GROUP_AFFINITY, DWORD>> numaNodes;
+    uint32_t coresCount = 0;
+    for (size_t offset = 0; offset < size;)
+    {
+        const auto* entry = reinterpret_cast<const SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*>(buffer + offset);
+        if (size - offset < offsetof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX, Processor) || entry->Size == 0 || entry->Size > size - offset)
+            throw std::runtime_error("Broken logical processor information record");
+
+        switch (entry->Relationship)
+        {
+        case RelationProcessorCore:
+            for (WORD i = 0; i < entry->Processor.GroupCount; ++i)
+            {
+                const GROUP_AFFINITY& mask = entry->Processor.GroupMask[i];
+                for (uint8_t number = 0; number < sizeof(KAFFINITY) * 8; ++number)
+                {
+                    if (mask.Mask & ((KAFFINITY)1 << number))
+                        processors.push_back({mask.Group, number, coresCount, 0, 0});
+                }
+            }
+            ++coresCount;
+            break;
+        case RelationCache:
+            if (entry->Cache.Type != CacheInstruction)
+                caches.emplace_back(entry->Cache.GroupMask, entry->Cache.Level);
+            break;
+        case RelationNumaNode:
+            numaNodes.emplace_back(entry->NumaNode.GroupMask, entry->NumaNode.NodeNumber);
+            break;
+        default:
+            break;
+        }
+        offset += entry->Size;
+    }
+
+    BYTE lastLevel = 0;
+    for (const auto& [mask, level] : caches)
+        lastLevel = std::max(lastLevel, level);
+
+    uint32_t cacheIndex = 0;
+    for (const auto& [mask, level] : caches)
+    {
+        if (level != lastLevel)
+            continue;
+
+        for (LogicalProcessor& processor : processors)
+        {
+            if (Contains(mask, processor))
+                processor.cache = cacheIndex;
+        }
+        ++cacheIndex;
+    }
+
+    for (const auto& [mask, node] : numaNodes)
+    {
+        for (LogicalProcessor& processor : processors)
+        {
+            if (Contains(mask, processor))
+                processor.numaNode = node;
+        }
+    }
+
+    if (processors.empty())
+        throw std::runtime_error("Logical processor information has no cores");
+
+    return CpuTopology {std::move(processors)};
+}
+
+CpuTopology::CpuTopology(std::vector<LogicalProcessor> processors, bool known /*= true*/)
+    : _processors(std::move(processors))
+    , _known(known)
+{
+    assert(!_processors.empty());
+
+    std::stable_sort(_processors.begin(), _processors.end(), [](const LogicalProcessor& left, const LogicalProcessor& right)
+    {
+        return std::tie(left.numaNode, left.cache, left.core) < std::tie(right.numaNode, right.cache, right.core);
+    });
+
+    _coresCount = CountDistinct(_processors, &LogicalProcessor::core);
+    _cachesCount = CountDistinct(_processors, &LogicalProcessor::cache);
+    _numaNodesCount = CountDistinct(_processors, &LogicalProcessor::numaNode);
+}
+
+const std::vector<LogicalProcessor>& CpuTopology::Processors() const
+{
+    return _processors;
+}
+
+size_t CpuTopology::CoresCount() const
+{
+    return _coresCount;
+}
+
+size_t CpuTopology::CachesCount() const
+{
+    return _cachesCount;
+}
+
+size_t CpuTopology::NumaNodesCount() const
+{
+    return _numaNodesCount;
+}
+
+bool CpuTopology::IsKnown() const
+{
+    return _known;
+}
+
+std::vector<LogicalProcessor> CpuTopology::SelectWorkerProcessors(bool physicalCoresOnly, size_t reservedCores) const
+{
+    reservedCores = std::min(reservedCores, _coresCount - 1);
+
+    // the first processor of a core in domains order goes to the first pass, siblings of it to the second one
+    std::set<uint32_t> reserved;
+    std::set<uint32_t> taken;
+    std::vector<LogicalProcessor> firstSiblings;
+    std::vector<LogicalProcessor> otherSiblings;
+    for (const LogicalProcessor& processor : _processors)
+    {
+        if (reserved.size() < reservedCores && !taken.count(processor.core))
+            reserved.insert(processor.core);
+        if (reserved.count(processor.core))
+            continue;
+
+        if (taken.insert(processor.core).second)
+            firstSiblings.push_back(processor);
+        else if (!physicalCoresOnly)
+            otherSiblings.push_back(processor);
+    }
+
+    firstSiblings.insert(firstSiblings.end(), otherSiblings.begin(), otherSiblings.end());
+    return firstSiblings;
+}
+
+std::vector<LogicalProcessor> CpuTopology::AssignWorkerProcessors(size_t workersCount, bool physicalCoresOnly, size_t reservedCores) const
+{
+    const std::vector<LogicalProcessor> processors = SelectWorkerProcessors(physicalCoresOnly, reservedCores);
+
+    std::vector<LogicalProcessor> assigned;
+    assigned.reserve(workersCount);
+    for (size_t worker = 0; worker < workersCount; ++worker)
+        assigned.push_back(processors[worker % processors.size()]);
+    return assigned;
+}
+
+std::string CpuTopology::Describe() const
+{
+    std::ostringstream description;
+    description << _processors.size() << " logical processors, " << _coresCount << " cores, ";
+    description << _cachesCount << " last level caches, " << _numaNodesCount << " NUMA nodes";
+    if (!_known)
+        description << " (not reported by the OS)";
+    return description.str();
+}
+
+bool PinThread(std::thread& thread, const LogicalProcessor& processor)
+{
+    GROUP_AFFINITY affinity = {};
+    affinity.Group = processor.group;
+    affinity.Mask = (KAFFINITY)1 << processor.number;
+    return SetThreadGroupAffinity(thread.native_handle(), &affinity, nullptr) != FALSE;
+}
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "stdafx.h"
+
+namespace Threading
+{
+// Logical processor with domains it shares with other ones
+struct LogicalProcessor
+{
+    uint16_t    group = 0;      // processor group and number in it, the way SetThreadGroupAffinity takes them
+    uint8_t     number = 0;
+    uint32_t    core = 0;       // SMT siblings have the same core
+    uint32_t    cache = 0;      // last level cache
+    uint32_t    numaNode = 0;
+};
+
+// Processors of the system from GetLogicalProcessorInformationEx, worker threads are placed with it so that
+// a pool fills one NUMA node and last level cache before the next one and takes SMT siblings last.
+class CpuTopology
+{
+public:
+    // hardware_concurrency processors on own cores when the OS doesn't report the topology, they aren't pinned
+    static CpuTopology Query();
+    // size bytes of SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX records the way GetLogicalProcessorInformationEx
+    // returns them for RelationAll, so topologies of other systems can be built from their dumps
+    static CpuTopology Parse(const uint8_t* buffer, size_t size);
+
+    explicit CpuTopology(std::vector<LogicalProcessor> processors, bool known = true);
+
+    const std::vector<LogicalProcessor>& Processors() const;
+    size_t CoresCount() const;
+    size_t CachesCount() const;
+    size_t NumaNodesCount() const;
+    // processors are reported by the OS, so threads can be pinned
+    bool IsKnown() const;
+
+    // Processors for workers in order of filling: the first logical processor of every core, then their SMT
+    // siblings if physicalCoresOnly isn't set. reservedCores first cores are left for the main and I/O threads,
+    // at least one core is kept for workers.
+    std::vector<LogicalProcessor> SelectWorkerProcessors(bool physicalCoresOnly, size_t reservedCores) const;
+    // one processor per worker from SelectWorkerProcessors, the order is repeated for more workers than processors
+    std::vector<LogicalProcessor> AssignWorkerProcessors(size_t workersCount, bool physicalCoresOnly, size_t reservedCores) const;
+
+    std::string Describe() const;
+
+private:
+    std::vector<LogicalProcessor>   _processors;   // ordered by NUMA node, last level cache and core
+    size_t                          _coresCount = 0;
+    size_t                          _cachesCount = 0;
+    size_t                          _numaNodesCount = 0;
+    bool                            _known = false;
+};
+
+// binds the thread to one processor, returns false if the OS refuses
+bool PinThread(std::thread& thread, const LogicalProcessor& processor);
+}
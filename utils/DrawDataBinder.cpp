@@ -0,0 +1,181 @@
+#include "stdafx.h"
+
+#include "DrawDataBinder.h"
+
+
+#include <algorithm>
+
+namespace
+{
+constexpr UINT drawDataValues = sizeof(perDrawData) / sizeof(uint32_t);
+// shaders declare constant buffers in whole 16 bytes registers, only drawDataValues are set
+constexpr UINT drawDataRegisterValues = (drawDataValues + 3) / 4 * 4;
+static_assert(sizeof(perDrawData) == 84, "perDrawData is 21 values in shaders");
+}
+
+DrawDataBinder::DrawDataBinder(ComPtr<ID3D12Device> pDevice, DrawDataMode mode)
+    : _device(pDevice)
+    , _mode(mode)
+{
+    assert(pDevice);
+}
+
+DrawDataMode DrawDataBinder::Mode() const
+{
+    return _mode;
+}
+
+const char* DrawDataBinder::GetModeName(DrawDataMode mode)
+{
+    switch (mode)
+    {
+    case DrawDataMode::ConstantBuffer:
+        return "constant buffers";
+    case DrawDataMode::RootConstants:
+        return "root constants";
+    case DrawDataMode::StructuredBuffer:
+        return "structured buffer";
+    default:
+        return "unknown";
+    }
+}
+
+void DrawDataBinder::InitRootParameters(RootParameter& drawParameter, RootParameter* pBufferParameter) const
+{
+    switch (_mode)
+    {
+    case DrawDataMode::ConstantBuffer:
+        drawParameter.InitAsCBV(0);
+        break;
+    case DrawDataMode::RootConstants:
+        drawParameter.InitAsConstants(drawDataRegisterValues, 0);
+        break;
+    case DrawDataMode::StructuredBuffer:
+        assert(pBufferParameter);
+        drawParameter.InitAsConstants(1, 0);
+        pBufferParameter->InitAsSRV(1);
+        break;
+    }
+}
+
+bool DrawDataBinder::HasBufferParameter() const
+{
+    return _mode == DrawDataMode::StructuredBuffer;
+}
+
+size_t DrawDataBinder::GetRootArgumentsSize() const
+{
+    switch (_mode)
+    {
+    case DrawDataMode::ConstantBuffer:
+        return sizeof(D3D12_GPU_VIRTUAL_ADDRESS);
+    case DrawDataMode::RootConstants:
+        return sizeof(perDrawData);
+    default:
+        return sizeof(uint32_t);
+    }
+}
+
+uint64_t DrawDataBinder::Update(const std::vector<perDrawData>& drawData)
+{
+    if (_mode == DrawDataMode::RootConstants)
+    {
+        _drawData = drawData;
+        return 0;
+    }
+
+    Reserve(drawData.size());
+
+    if (_mode == DrawDataMode::StructuredBuffer)
+    {
+        memcpy(_mappedData, drawData.data(), drawData.size() * sizeof(perDrawData));
+        return drawData.size() * sizeof(perDrawData);
+    }
+
+    // upload heap is write-combined, so constant buffers are filled on stack and copied at once
+    for (size_t i = 0; i < drawData.size(); ++i)
+    {
+        perModelParamsConstantBuffer buffer;
+        FillConstantBuffer(drawData[i], buffer);
+        memcpy(_mappedData + i * GetSlotSize(), &buffer, sizeof(buffer));
+    }
+    return drawData.size() * sizeof(perModelParamsConstantBuffer);
+}
+
+D3D12_GPU_VIRTUAL_ADDRESS DrawDataBinder::GetBufferAddress() const
+{
+    return _uploadBuffer ? _uploadBuffer->GetGPUVirtualAddress() : 0;
+}
+
+void DrawDataBinder::FillConstantBuffer(const perDrawData& data, perModelParamsConstantBuffer& buffer)
+{
+    for (size_t row = 0; row < 4; ++row)
+    {
+        for (size_t column = 0; column < 3; ++column)
+            buffer.worldMatrix[row][column] = data.worldMatrix[column][row];
+        buffer.worldMatrix[row][3] = row == 3 ? 1.0f : 0.0f;
+    }
+
+    memcpy(buffer.positionScale, data.positionScale, sizeof(data.positionScale));
+    buffer.positionScale[3] = 0.0f;
+    memcpy(buffer.positionOffset, data.positionOffset, sizeof(data.positionOffset));
+    buffer.positionOffset[3] = 0.0f;
+    buffer.tessellationFactor[0] = data.tessellationEdges;
+    buffer.tessellationFactor[1] = data.tessellationInside;
+    buffer.material = data.material;
+    buffer.padding = 0.0f;
+}
+
+void DrawDataBinder::BindBuffer(ID3D12GraphicsCommandList* pCmdList, UINT bufferParameter) const
+{
+    if (_mode == DrawDataMode::StructuredBuffer)
+        pCmdList->SetGraphicsRootShaderResourceView(bufferParameter, _uploadBuffer->GetGPUVirtualAddress());
+}
+
+void DrawDataBinder::Bind(ID3D12GraphicsCommandList* pCmdList, UINT drawParameter, size_t drawIndex) const
+{
+    switch (_mode)
+    {
+    case DrawDataMode::ConstantBuffer:
+        pCmdList->SetGraphicsRootConstantBufferView(drawParameter, _uploadBuffer->GetGPUVirtualAddress() + drawIndex * GetSlotSize());
+        break;
+    case DrawDataMode::RootConstants:
+        pCmdList->SetGraphicsRoot32BitConstants(drawParameter, drawDataValues, &_drawData[drawIndex], 0);
+        break;
+    case DrawDataMode::StructuredBuffer:
+        pCmdList->SetGraphicsRoot32BitConstant(drawParameter, (UINT)drawIndex, 0);
+        break;
+    }
+}
+
+size_t DrawDataBinder::GetSlotSize() const
+{
+    if (_mode == DrawDataMode::ConstantBuffer)
+        return D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT;
+
+    return sizeof(perDrawData);
+}
+
+void DrawDataBinder::Reserve(size_t drawsCount)
+{
+    if (drawsCount <= _capacity && _uploadBuffer)
+        return;
+
+    // the previous frame is finished, so the old buffer can be released right away
+    _capacity = std::max<size_t>(drawsCount, _capacity * 2);
+    _uploadBuffer = nullptr;
+    _mappedData = nullptr;
+
+    D3D12_HEAP_PROPERTIES uploadHeapProp = {D3D12_HEAP_TYPE_UPLOAD};
+    CD3DX12_RESOURCE_DESC bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(std::max<size_t>(_capacity, 1) * GetSlotSize());
+    ThrowIfFailed(_device->CreateCommittedResource(&uploadHeapProp,
+                                                   D3D12_HEAP_FLAG_NONE,
+                                                   &bufferDesc,
+                                                   D3D12_RESOURCE_STATE_GENERIC_READ,
+                                                   nullptr,
+                                                   IID_PPV_ARGS(&_uploadBuffer)));
+    _uploadBuffer->SetName(L"DrawData");
+
+    D3D12_RANGE readRange = {0, 0};
+    ThrowIfFailed(_uploadBuffer->Map(0, &readRange, reinterpret_cast<void**>(&_mappedData)));
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "stdafx.h"
+
+#include "RootSignature.h"
+#include "Types.h"
+
+// Delivers per-draw data of geometry passes in one of DrawDataMode ways, shaders read it through the same
+// functions in every mode (DrawRootConstants and DrawDataBuffer features). Data of all draws is written once
+// per frame before command lists are recorded, the previous frame has to be finished by then.
+// - ConstantBuffer: perModelParamsConstantBuffer in a 256 bytes slot of one upload buffer for every draw, root CBV
+// - RootConstants: perDrawData in 21 root constants, nothing is uploaded
+// - StructuredBuffer: perDrawData array in one upload buffer (root SRV t1), draw index in a root constant
+class DrawDataBinder
+{
+public:
+    DrawDataBinder(ComPtr<ID3D12Device> pDevice, DrawDataMode mode);
+
+    DrawDataBinder(const DrawDataBinder&) = delete;
+    DrawDataBinder(DrawDataBinder&&) = delete;
+    DrawDataBinder& operator=(const DrawDataBinder&) = delete;
+    DrawDataBinder& operator=(DrawDataBinder&&) = delete;
+
+    DrawDataMode Mode() const;
+    static const char* GetModeName(DrawDataMode mode);
+
+    // per-draw parameter is b0, the buffer parameter is needed only when HasBufferParameter() is true
+    void InitRootParameters(RootParameter& drawParameter, RootParameter* pBufferParameter) const;
+    bool HasBufferParameter() const;
+    // bytes of root arguments set by Bind for every draw
+    size_t GetRootArgumentsSize() const;
+
+    // returns bytes written to upload heap, buffers grow when draws are added
+    uint64_t Update(const std::vector<perDrawData>& drawData);
+
+    // 0 in root constants mode, buffers change addresses when they grow
+    D3D12_GPU_VIRTUAL_ADDRESS GetBufferAddress() const;
+
+    // slot of ConstantBuffer mode, the 4x4 world matrix is restored from 3x4 rows
+    static void FillConstantBuffer(const perDrawData& data, perModelParamsConstantBuffer& buffer);
+
+    // once per command list after root signature is set
+    void BindBuffer(ID3D12GraphicsCommandList* pCmdList, UINT bufferParameter) const;
+    void Bind(ID3D12GraphicsCommandList* pCmdList, UINT drawParameter, size_t drawIndex) const;
+
+private:
+    size_t GetSlotSize() const;
+    void Reserve(size_t drawsCount);
+
+    ComPtr<ID3D12Device>        _device = nullptr;
+    DrawDataMode                _mode = DrawDataMode::ConstantBuffer;
+
+    std::vector<perDrawData>    _drawData {};           // root constants
+    ComPtr<ID3D12Resource>      _uploadBuffer = nullptr;
+    uint8_t*                    _mappedData = nullptr;
+    size_t                      _capacity = 0;          // draws
+};
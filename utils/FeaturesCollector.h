@@ -11,6 +11,14 @@ public:
         : _device(pDevice)
     {}
 
+    // tier 2 allows unbounded SRV tables over the whole heap which bindless textures use
+    D3D12_RESOURCE_BINDING_TIER GetResourceBindingTier() const
+    {
+        D3D12_FEATURE_DATA_D3D12_OPTIONS opts = {};
+        ThrowIfFailed(_device->CheckFeatureSupport(D3D12_FEATURE_D3D12_OPTIONS, &opts, sizeof(D3D12_FEATURE_DATA_D3D12_OPTIONS)));
+        return opts.ResourceBindingTier;
+    }
+
     void CollectFeatures(const std::string &fileName)
     {
         if (!_device)
@@ -10,6 +10,7 @@ GraphicsPipelineState::GraphicsPipelineState()
 GraphicsPipelineState::GraphicsPipelineState(const RootSignature &pRootSignature, const D3D12_INPUT_LAYOUT_DESC & inputLayoutDesc)
 {
     _description.pRootSignature = pRootSignature.GetInternal().Get();
+    _rootSignatureHash = pRootSignature.Hash();
     _description.BlendState = _defaultBlendDesc;
     _description.SampleMask = UINT_MAX;
     _description.RasterizerState = _defaultRasterizerDesc;
@@ -22,6 +23,7 @@ GraphicsPipelineState::GraphicsPipelineState(const RootSignature &pRootSignature
 void GraphicsPipelineState::SetRootSignature(const RootSignature &pRootSignature)
 {
     _description.pRootSignature = pRootSignature.GetInternal().Get();
+    _rootSignatureHash = pRootSignature.Hash();
 }
 
 void GraphicsPipelineState::SetInputLayout(const D3D12_INPUT_LAYOUT_DESC & inputLayoutDesc)
@@ -53,6 +55,9 @@ void GraphicsPipelineState::SetShaderCode(ComPtr<ID3DBlob> pShaderCode, ShaderTy
     default:
         throw std::runtime_error("Unknown shader type");
     }
+
+    // bytecode has to live while the state is compiled
+    _shaders.push_back(pShaderCode);
 }
 
 void GraphicsPipelineState::SetRasterizerState(const D3D12_RASTERIZER_DESC & rasterizerDesc)
@@ -82,13 +87,42 @@ void GraphicsPipelineState::SetPritimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY_TYPE
     _description.PrimitiveTopologyType = topology;
 }
 
+void GraphicsPipelineState::SetFallback(GraphicsPipelineState* pFallback)
+{
+    assert(pFallback != this);
+    _fallback = pFallback;
+}
+
 ComPtr<ID3D12PipelineState> GraphicsPipelineState::GetPSO()
 {
+    if (_pendingPso.valid() && (!_fallback || IsReady()))
+    {
+        _pso = _pendingPso.get();
+        _pendingPso = {};
+    }
+
+    if (!_pso && _fallback)
+        return _fallback->GetPSO();
+
     assert(_pso);
     return _pso;
 }
 
+bool GraphicsPipelineState::IsReady() const
+{
+    if (_pso)
+        return true;
+
+    return _pendingPso.valid() && _pendingPso.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
 void GraphicsPipelineState::Finalize(ComPtr<ID3D12Device> pDevice)
 {
     ThrowIfFailed(pDevice->CreateGraphicsPipelineState(&_description, IID_PPV_ARGS(&_pso)));
 }
+
+void GraphicsPipelineState::Finalize(PipelineStateManager& manager, bool background /*= false*/)
+{
+    _pso = nullptr;
+    _pendingPso = manager.Create(_description, _rootSignatureHash, _shaders, background);
+}
@@ -3,6 +3,7 @@
 #include "stdafx.h"
 #include "Types.h"
 #include "RootSignature.h"
+#include "PipelineStateManager.h"
 
 class GraphicsPipelineState
 {
@@ -29,12 +30,23 @@ public:
     void SetDepthStencilFormat(DXGI_FORMAT format);
     void SetPritimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY_TYPE topology);
 
+    // used by GetPSO while this state is compiled in background, has to use the same root signature
+    void SetFallback(GraphicsPipelineState* pFallback);
+
+    // waits for the state if it's not compiled yet and there is no fallback
     ComPtr<ID3D12PipelineState> GetPSO();
+    bool IsReady() const;
+
     void Finalize(ComPtr<ID3D12Device> pDevice);
+    void Finalize(PipelineStateManager& manager, bool background = false);
 
 private:
     D3D12_GRAPHICS_PIPELINE_STATE_DESC  _description = {};
+    std::vector<ComPtr<ID3DBlob>>       _shaders;
+    uint64_t                            _rootSignatureHash = 0;
     ComPtr<ID3D12PipelineState>         _pso = nullptr;
+    PipelineStateFuture                 _pendingPso;
+    GraphicsPipelineState*              _fallback = nullptr;
 
     const D3D12_DEPTH_STENCIL_DESC _defaultDepthStencilDesc = {
         TRUE,                       // DepthEnable
@@ -0,0 +1,134 @@
+#include "stdafx.h"
+
+#include "LuminanceHistogram.h"
+
+#include "ParallelFor.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+namespace LuminanceHistogram
+{
+namespace
+{
+using BinsArray = std::array<uint32_t, binsCount>;
+
+uint32_t GetBin(float luminance, float logLuminance)
+{
+    if (luminance < std::exp2(minLogLuminance))
+        return 0;
+
+    // saturate in the shader turns NaN into 0, std::clamp would keep it and the index would be undefined
+    float position = (logLuminance - minLogLuminance) / logLuminanceRange;
+    position = std::isnan(position) ? 0.0f : std::clamp(position, 0.0f, 1.0f);
+    return (uint32_t)(position * (binsCount - 2) + 1.0f);
+}
+
+float GetBinLogLuminance(uint32_t bin)
+{
+    if (bin == 0)
+        return minLogLuminance;
+
+    return minLogLuminance + ((bin - 1) + 0.5f) / (binsCount - 2) * logLuminanceRange;
+}
+
+// luminance of one texel of the downsampled image, rows and columns are clamped at the edges
+float GetLuminance(const float* texels, uint32_t width, uint32_t height, size_t rowPitch, uint32_t x, uint32_t y)
+{
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(texels);
+    const float* top = reinterpret_cast<const float*>(bytes + y * downsampling * rowPitch);
+    const float* bottom = reinterpret_cast<const float*>(bytes + std::min(y * downsampling + 1, height - 1) * rowPitch);
+    const uint32_t left = x * downsampling * 4;
+    const uint32_t right = std::min(x * downsampling + 1, width - 1) * 4;
+
+    const XMVECTOR topRGB = XMVectorAdd(XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(top + left)),
+                                        XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(top + right)));
+    const XMVECTOR bottomRGB = XMVectorAdd(XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(bottom + left)),
+                                           XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(bottom + right)));
+    XMFLOAT3 rgb;
+    XMStoreFloat3(&rgb, XMVectorScale(XMVectorAdd(topRGB, bottomRGB), 0.25f));
+    return 0.2126f * rgb.x + 0.7152f * rgb.y + 0.0722f * rgb.z;
+}
+
+// bins one row of the downsampled image, logarithms are taken for four texels at a time
+void BinRow(const float* texels, uint32_t width, uint32_t height, size_t rowPitch, uint32_t y, BinsArray& bins)
+{
+    const uint32_t downsampledWidth = (width + downsampling - 1) / downsampling;
+    for (uint32_t x = 0; x < downsampledWidth; x += 4)
+    {
+        XMFLOAT4A luminance {1.0f, 1.0f, 1.0f, 1.0f};
+        float* luminanceLanes = &luminance.x;
+        const uint32_t lanes = std::min(4u, downsampledWidth - x);
+        for (uint32_t lane = 0; lane < lanes; ++lane)
+            luminanceLanes[lane] = GetLuminance(texels, width, height, rowPitch, x + lane, y);
+
+        XMFLOAT4A logLuminance;
+        XMStoreFloat4A(&logLuminance, XMVectorLog2(XMLoadFloat4A(&luminance)));
+        const float* logLuminanceLanes = &logLuminance.x;
+        for (uint32_t lane = 0; lane < lanes; ++lane)
+            bins[GetBin(luminanceLanes[lane], logLuminanceLanes[lane])]++;
+    }
+}
+}
+
+uint32_t GetGroupsCountX(uint32_t width)
+{
+    return ((width + downsampling - 1) / downsampling + groupSize - 1) / groupSize;
+}
+
+uint32_t GetGroupsCountY(uint32_t height)
+{
+    return GetGroupsCountX(height);
+}
+
+Histogram Build(const float* texels, uint32_t width, uint32_t height, size_t rowPitch)
+{
+    Histogram histogram(binsCount, 0);
+    std::mutex histogramMutex;
+
+    const uint32_t downsampledHeight = (height + downsampling - 1) / downsampling;
+    Threading::ParallelFor(downsampledHeight, groupSize, [&](size_t begin, size_t end)
+    {
+        BinsArray bins {};
+        for (size_t y = begin; y < end; ++y)
+            BinRow(texels, width, height, rowPitch, (uint32_t)y, bins);
+
+        std::lock_guard<std::mutex> lock(histogramMutex);
+        for (uint32_t bin = 0; bin < binsCount; ++bin)
+            histogram[bin] += bins[bin];
+    });
+
+    return histogram;
+}
+
+LuminanceReduction::Luminance ComputeExposure(const Histogram& histogram)
+{
+    float texelsCount = 0.0f;
+    for (uint32_t count : histogram)
+        texelsCount += (float)count;
+
+    const float lowCount = texelsCount * lowPercentile;
+    const float highCount = texelsCount * highPercentile;
+
+    float accumulated = 0.0f;
+    float logLuminanceSum = 0.0f;
+    float weight = 0.0f;
+    float whiteLogLuminance = minLogLuminance;
+    for (uint32_t bin = 0; bin < binsCount; ++bin)
+    {
+        const float count = (float)histogram[bin];
+        const float inside = std::clamp(accumulated + count, lowCount, highCount) - std::clamp(accumulated, lowCount, highCount);
+        logLuminanceSum += inside * GetBinLogLuminance(bin);
+        weight += inside;
+        if (accumulated < highCount)
+            whiteLogLuminance = GetBinLogLuminance(bin);
+        accumulated += count;
+    }
+
+    LuminanceReduction::Luminance result;
+    result.average = std::exp2(logLuminanceSum / std::max(weight, 1.0f));
+    result.max = std::clamp(std::exp2(whiteLogLuminance), LuminanceReduction::minMaxLuminance, LuminanceReduction::maxMaxLuminance);
+    return result;
+}
+}
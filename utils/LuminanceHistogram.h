@@ -0,0 +1,36 @@
+#pragma once
+
+#include "stdafx.h"
+
+#include "LuminanceReduction.h"
+
+// CPU reference of the histogram exposure passes (HistogramPass.hlsl and ExposurePass.hlsl). It is used to
+// validate GPU results and can compute exposure of captured images without a device.
+namespace LuminanceHistogram
+{
+constexpr uint32_t binsCount = 128;
+constexpr uint32_t groupSize = 16;
+
+// the image is downsampled by averaging of 2x2 texels before binning
+constexpr uint32_t downsampling = 2;
+
+// log2 luminance range of bins 1..binsCount-1, bin 0 holds darker texels
+constexpr float minLogLuminance = -10.0f;
+constexpr float logLuminanceRange = 12.0f;
+
+// texels outside of the percentiles are excluded from the average, the high one is the white point
+constexpr float lowPercentile = 0.5f;
+constexpr float highPercentile = 0.95f;
+
+using Histogram = std::vector<uint32_t>;
+
+// groups of HistogramPass to dispatch for the image
+uint32_t GetGroupsCountX(uint32_t width);
+uint32_t GetGroupsCountY(uint32_t height);
+
+// texels are float4 RGBA rows with rowPitch bytes between them, rows are binned in parallel
+Histogram Build(const float* texels, uint32_t width, uint32_t height, size_t rowPitch);
+
+// average is exp2 of mean log luminance between percentiles, max is clamped like in LuminanceReduction
+LuminanceReduction::Luminance ComputeExposure(const Histogram& histogram);
+}
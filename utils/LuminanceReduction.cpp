@@ -0,0 +1,131 @@
+#include "stdafx.h"
+
+#include "LuminanceReduction.h"
+
+#include "ParallelFor.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace LuminanceReduction
+{
+namespace
+{
+constexpr uint32_t tileTexels = tileSize * tileSize;
+
+// Tree reduction of groupshared arrays: values[i] += values[i + stride] for halving strides. Lanes of
+// vectors are independent threads, so vector and scalar steps give the same results.
+template<size_t N>
+void ReduceGroup(float (&logLuminance)[N], float (&maxLuminance)[N])
+{
+    static_assert(N % 4 == 0, "Groups are reduced by 4 lanes");
+
+    size_t stride = N / 2;
+    for (; stride >= 4; stride >>= 1)
+    {
+        for (size_t i = 0; i < stride; i += 4)
+        {
+            XMStoreFloat4A(reinterpret_cast<XMFLOAT4A*>(logLuminance + i),
+                           XMVectorAdd(XMLoadFloat4A(reinterpret_cast<const XMFLOAT4A*>(logLuminance + i)),
+                                       XMLoadFloat4A(reinterpret_cast<const XMFLOAT4A*>(logLuminance + i + stride))));
+            XMStoreFloat4A(reinterpret_cast<XMFLOAT4A*>(maxLuminance + i),
+                           XMVectorMax(XMLoadFloat4A(reinterpret_cast<const XMFLOAT4A*>(maxLuminance + i)),
+                                       XMLoadFloat4A(reinterpret_cast<const XMFLOAT4A*>(maxLuminance + i + stride))));
+        }
+    }
+
+    for (; stride > 0; stride >>= 1)
+    {
+        for (size_t i = 0; i < stride; ++i)
+        {
+            logLuminance[i] += logLuminance[i + stride];
+            maxLuminance[i] = std::max(maxLuminance[i], maxLuminance[i + stride]);
+        }
+    }
+}
+
+Luminance ReduceTile(const float* texels, uint32_t width, uint32_t height, size_t rowPitch, uint32_t tileX, uint32_t tileY)
+{
+    alignas(16) float logLuminance[tileTexels] = {};
+    alignas(16) float maxLuminance[tileTexels] = {};
+
+    const uint32_t left = tileX * tileSize;
+    const uint32_t top = tileY * tileSize;
+    const uint32_t right = std::min(left + tileSize, width);
+    const uint32_t bottom = std::min(top + tileSize, height);
+    for (uint32_t y = top; y < bottom; ++y)
+    {
+        const float* row = reinterpret_cast<const float*>(reinterpret_cast<const uint8_t*>(texels) + y * rowPitch);
+        for (uint32_t x = left; x < right; ++x)
+        {
+            const float* texel = row + x * 4;
+            const float luminance = 0.2126f * texel[0] + 0.7152f * texel[1] + 0.0722f * texel[2];
+            const size_t index = (y - top) * tileSize + (x - left);
+            logLuminance[index] = std::log(0.001f + luminance);
+            maxLuminance[index] = luminance;
+        }
+    }
+
+    ReduceGroup(logLuminance, maxLuminance);
+    return {logLuminance[0], maxLuminance[0]};
+}
+}
+
+size_t GetTilesCount(uint32_t width, uint32_t height)
+{
+    return (size_t)((width + tileSize - 1) / tileSize) * ((height + tileSize - 1) / tileSize);
+}
+
+std::vector<Luminance> ReduceTiles(const float* texels, uint32_t width, uint32_t height, size_t rowPitch)
+{
+    const uint32_t tilesInRow = (width + tileSize - 1) / tileSize;
+    std::vector<Luminance> tiles(GetTilesCount(width, height));
+
+    Threading::ParallelFor(tiles.size(), tilesInRow, [&](size_t begin, size_t end)
+    {
+        for (size_t tile = begin; tile < end; ++tile)
+            tiles[tile] = ReduceTile(texels, width, height, rowPitch, (uint32_t)(tile % tilesInRow), (uint32_t)(tile / tilesInRow));
+    });
+
+    return tiles;
+}
+
+Luminance ReduceImage(const std::vector<Luminance>& tiles, uint32_t width, uint32_t height)
+{
+    alignas(16) float logLuminance[reduceGroupSize] = {};
+    alignas(16) float maxLuminance[reduceGroupSize] = {};
+
+    // thread i sums tiles i, i + group size, ... in order, four threads at a time
+    for (size_t thread = 0; thread < reduceGroupSize; thread += 4)
+    {
+        XMVECTOR threadLog = XMVectorZero();
+        XMVECTOR threadMax = XMVectorZero();
+        for (size_t first = thread; first < tiles.size(); first += reduceGroupSize)
+        {
+            XMFLOAT4A tileLog {};
+            XMFLOAT4A tileMax {};
+            float* tileLogLanes = &tileLog.x;
+            float* tileMaxLanes = &tileMax.x;
+            const size_t lanes = std::min<size_t>(4, tiles.size() - first);
+            for (size_t lane = 0; lane < lanes; ++lane)
+            {
+                tileLogLanes[lane] = tiles[first + lane].average;
+                tileMaxLanes[lane] = tiles[first + lane].max;
+            }
+
+            // missing lanes add zeros like threads that are out of the loop already
+            threadLog = XMVectorAdd(threadLog, XMLoadFloat4A(&tileLog));
+            threadMax = XMVectorMax(threadMax, XMLoadFloat4A(&tileMax));
+        }
+        XMStoreFloat4A(reinterpret_cast<XMFLOAT4A*>(logLuminance + thread), threadLog);
+        XMStoreFloat4A(reinterpret_cast<XMFLOAT4A*>(maxLuminance + thread), threadMax);
+    }
+
+    ReduceGroup(logLuminance, maxLuminance);
+
+    Luminance result;
+    result.average = std::exp(logLuminance[0] / (float)(width * height));
+    result.max = std::clamp(maxLuminance[0], minMaxLuminance, maxMaxLuminance);
+    return result;
+}
+}
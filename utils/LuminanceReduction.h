@@ -0,0 +1,31 @@
+#pragma once
+
+#include "stdafx.h"
+
+// CPU reference of the luminance compute passes (IntensityPass.hlsl and IntensityReducePass.hlsl).
+// Tiles and the order of additions are the same as in groupshared reductions on GPU, so sums of the same
+// per-texel values are equal bit to bit; four threads of a group are emulated by every vector operation.
+namespace LuminanceReduction
+{
+constexpr uint32_t tileSize = 16;
+constexpr uint32_t reduceGroupSize = 256;
+
+// clamp range of the maximum luminance
+constexpr float minMaxLuminance = 0.4f;
+constexpr float maxMaxLuminance = 1.2f;
+
+// element of GPU buffers: sum of log luminance for tiles and average luminance for the whole image
+struct Luminance
+{
+    float average = 0.0f;
+    float max = 0.0f;
+};
+
+size_t GetTilesCount(uint32_t width, uint32_t height);
+
+// texels are float4 RGBA rows with rowPitch bytes between them, tiles are reduced in parallel
+std::vector<Luminance> ReduceTiles(const float* texels, uint32_t width, uint32_t height, size_t rowPitch);
+
+// average is exp of mean log luminance, max is clamped
+Luminance ReduceImage(const std::vector<Luminance>& tiles, uint32_t width, uint32_t height);
+}
@@ -0,0 +1,103 @@
+#include "stdafx.h"
+
+#include "MeshFile.h"
+
+namespace MeshFile
+{
+namespace
+{
+constexpr uint32_t magic = 0x4853454d; // "MESH"
+constexpr uint32_t version = 1;
+
+struct Header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t vertexSize;
+    uint32_t verticesCount;
+    uint32_t indicesCount;
+    uint32_t lodsCount;
+    uint64_t sourceHash;
+};
+
+template<typename T>
+bool Read(std::ifstream& file, std::vector<T>& data, size_t count)
+{
+    data.resize(count);
+    file.read(reinterpret_cast<char*>(data.data()), count * sizeof(T));
+    return (bool)file;
+}
+}
+
+bool Load(const std::string& fileName, MeshData& data)
+{
+    std::ifstream file {fileName, std::ios::binary};
+    if (!file)
+        return false;
+
+    Header header = {};
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!file || header.magic != magic || header.version != version || header.vertexSize != sizeof(geometryVertex))
+        return false;
+
+    MeshData result;
+    result.sourceHash = header.sourceHash;
+    if (!Read(file, result.vertices, header.verticesCount) ||
+        !Read(file, result.indices, header.indicesCount) ||
+        !Read(file, result.lods, header.lodsCount))
+    {
+        return false;
+    }
+
+    for (const MeshLod& lod : result.lods)
+    {
+        if ((size_t)lod.firstIndex + lod.indicesCount > result.indices.size())
+            return false;
+    }
+
+    for (uint32_t index : result.indices)
+    {
+        if (index >= result.vertices.size())
+            return false;
+    }
+
+    data = std::move(result);
+    return true;
+}
+
+void Save(const std::string& fileName, const MeshData& data)
+{
+    std::ofstream file {fileName, std::ios::binary};
+    if (!file)
+        throw std::runtime_error("Failed to create mesh file " + fileName);
+
+    Header header = {};
+    header.magic = magic;
+    header.version = version;
+    header.vertexSize = sizeof(geometryVertex);
+    header.verticesCount = (uint32_t)data.vertices.size();
+    header.indicesCount = (uint32_t)data.indices.size();
+    header.lodsCount = (uint32_t)data.lods.size();
+    header.sourceHash = data.sourceHash;
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(data.vertices.data()), data.vertices.size() * sizeof(geometryVertex));
+    file.write(reinterpret_cast<const char*>(data.indices.data()), data.indices.size() * sizeof(uint32_t));
+    file.write(reinterpret_cast<const char*>(data.lods.data()), data.lods.size() * sizeof(MeshLod));
+
+    if (!file)
+        throw std::runtime_error("Failed to write mesh file " + fileName);
+}
+
+uint64_t Hash(const void* data, size_t size, uint64_t seed /*= 14695981039346656037ull*/)
+{
+    const uint8_t * bytes = reinterpret_cast<const uint8_t*>(data);
+    uint64_t hash = seed;
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "stdafx.h"
+
+#include "Types.h"
+
+// Binary mesh format: header, geometryVertex array, 32-bit indices of all LODs and LODs table.
+namespace MeshFile
+{
+struct MeshData
+{
+    std::vector<geometryVertex> vertices;
+    std::vector<uint32_t>       indices;
+    std::vector<MeshLod>        lods;
+    uint64_t                    sourceHash = 0;  // identifies the data mesh was generated from, 0 for imported meshes
+};
+
+// Returns false when the file is missing or written by another version of the format.
+bool Load(const std::string& fileName, MeshData& data);
+void Save(const std::string& fileName, const MeshData& data);
+
+// FNV-1a, used to check that cached data is still valid
+uint64_t Hash(const void* data, size_t size, uint64_t seed = 14695981039346656037ull);
+}
@@ -2,8 +2,28 @@
 
 #include "MeshManager.h"
 
+#include "MeshFile.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "Tessellator.h"
 #include "Types.h"
 
+#include <cmath>
+#include <filesystem>
+
+constexpr size_t maxLodsCount = 5;
+constexpr float maxLodError = 0.1f;
+
+// the procedural sphere is dense enough for a few LODs, unlike the cubes and the plane
+constexpr uint32_t sphereRings = 16;
+constexpr uint32_t sphereSegments = 32;
+
+// discrete CPU tessellation levels from the finest to the coarsest one, hull shader clamps factors to 15
+constexpr uint32_t tessellationLevels[] = {16, 8, 4, 2, 1};
+// errors of the levels are measured against the surface sampled twice as dense as the finest level
+constexpr uint32_t tessellationReferenceLevel = 32;
+const std::string meshCacheDirectory = "meshCache";
+
 static const std::vector<geometryVertex> vertices =
 {
     // back face +Z
@@ -85,11 +105,14 @@ MeshObject::MeshObject(const std::vector<uint8_t>& vertex_data,
                        size_t stride,
                        const std::vector<uint32_t>& index_data,
                        ComPtr<ID3D12Device> pDevice,
-                       D3D_PRIMITIVE_TOPOLOGY topology)
+                       D3D_PRIMITIVE_TOPOLOGY topology,
+                       const VertexPacking::PositionBounds& positionBounds /*= {}*/,
+                       size_t positionStride /*= 0*/)
     : _indicesCount(index_data.size())
     , _device(pDevice)
     , _topology(topology)
     , _verticesCount(vertex_data.size() / stride)
+    , _positionBounds(positionBounds)
 {
     D3D12_HEAP_PROPERTIES heapProp = {D3D12_HEAP_TYPE_UPLOAD};
 
@@ -104,21 +127,42 @@ MeshObject::MeshObject(const std::vector<uint8_t>& vertex_data,
 
     ThrowIfFailed(pDevice->CreateCommittedResource(&heapProp, D3D12_HEAP_FLAG_NONE, &vertexBufferDesc, D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&_vertexBuffer)));
 
-    void * bufPtr = nullptr;
-    ThrowIfFailed(_vertexBuffer->Map(0, nullptr, &bufPtr));
-    std::memcpy(bufPtr, vertex_data.data(), vertex_data.size());
-    _vertexBuffer->Unmap(0, nullptr);
+    uint8_t * bufPtr = nullptr;
+    ThrowIfFailed(_vertexBuffer->Map(0, nullptr, reinterpret_cast<void**>(&bufPtr)));
+    if (positionStride && positionStride < stride)
+    {
+        // positions go to the first half of the buffer, the rest of attributes follows them
+        VertexPacking::SplitPositionStream(vertex_data.data(), _verticesCount, stride, positionStride, bufPtr);
+        const size_t attributeStride = stride - positionStride;
+
+        _vertexBufferView.BufferLocation = _vertexBuffer->GetGPUVirtualAddress();
+        _vertexBufferView.SizeInBytes = (UINT)(_verticesCount * positionStride);
+        _vertexBufferView.StrideInBytes = (UINT)positionStride;
+
+        _attributeBufferView.BufferLocation = _vertexBufferView.BufferLocation + _vertexBufferView.SizeInBytes;
+        _attributeBufferView.SizeInBytes = (UINT)(_verticesCount * attributeStride);
+        _attributeBufferView.StrideInBytes = (UINT)attributeStride;
+    }
+    else
+    {
+        std::memcpy(bufPtr, vertex_data.data(), vertex_data.size());
 
-    // creating view describing how to use vertex buffer for GPU
-    _vertexBufferView.BufferLocation = _vertexBuffer->GetGPUVirtualAddress();
-    _vertexBufferView.SizeInBytes = (UINT)vertex_data.size();
-    _vertexBufferView.StrideInBytes = (UINT)stride;
+        // creating view describing how to use vertex buffer for GPU
+        _vertexBufferView.BufferLocation = _vertexBuffer->GetGPUVirtualAddress();
+        _vertexBufferView.SizeInBytes = (UINT)vertex_data.size();
+        _vertexBufferView.StrideInBytes = (UINT)stride;
+    }
+    _vertexBuffer->Unmap(0, nullptr);
 
     if (!index_data.empty())
     {
+        // 16-bit indices are enough for small meshes and take half of the bandwidth
+        const bool shortIndices = _verticesCount <= UINT16_MAX;
+        const size_t indexSize = shortIndices ? sizeof(uint16_t) : sizeof(uint32_t);
+
         D3D12_RESOURCE_DESC indexBufferDesc = {};
         indexBufferDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
-        indexBufferDesc.Width = index_data.size() * sizeof(uint32_t);
+        indexBufferDesc.Width = index_data.size() * indexSize;
         indexBufferDesc.Height = 1;
         indexBufferDesc.MipLevels = 1;
         indexBufferDesc.SampleDesc.Count = 1;
@@ -128,13 +172,22 @@ MeshObject::MeshObject(const std::vector<uint8_t>& vertex_data,
         ThrowIfFailed(pDevice->CreateCommittedResource(&heapProp, D3D12_HEAP_FLAG_NONE, &indexBufferDesc, D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&_indexBuffer)));
 
         ThrowIfFailed(_indexBuffer->Map(0, nullptr, reinterpret_cast<void**>(&bufPtr)));
-        std::memcpy(bufPtr, index_data.data(), index_data.size() * sizeof(uint32_t));
+        if (shortIndices)
+        {
+            uint16_t* shortIndicesPtr = reinterpret_cast<uint16_t*>(bufPtr);
+            for (size_t i = 0; i < index_data.size(); ++i)
+                shortIndicesPtr[i] = (uint16_t)index_data[i];
+        }
+        else
+            std::memcpy(bufPtr, index_data.data(), index_data.size() * sizeof(uint32_t));
         _indexBuffer->Unmap(0, nullptr);
 
         // creating view describing how to use vertex buffer for GPU
         _indexBufferView.BufferLocation = _indexBuffer->GetGPUVirtualAddress();
-        _indexBufferView.SizeInBytes = (UINT)(index_data.size() * sizeof(uint32_t));
-        _indexBufferView.Format = DXGI_FORMAT_R32_UINT;
+        _indexBufferView.SizeInBytes = (UINT)(index_data.size() * indexSize);
+        _indexBufferView.Format = shortIndices ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+
+        _lods.push_back({0, (uint32_t)_indicesCount, 0.0f});
     }
 }
 
@@ -148,6 +201,16 @@ const D3D12_VERTEX_BUFFER_VIEW& MeshObject::VertexBufferView() const
     return _vertexBufferView;
 }
 
+const D3D12_VERTEX_BUFFER_VIEW& MeshObject::AttributeBufferView() const
+{
+    return _attributeBufferView;
+}
+
+bool MeshObject::HasPositionStream() const
+{
+    return _attributeBufferView.SizeInBytes != 0;
+}
+
 const Microsoft::WRL::ComPtr<ID3D12Resource>& MeshObject::IndexBuffer() const
 {
     return _indexBuffer;
@@ -173,24 +236,75 @@ size_t MeshObject::IndicesCount() const
     return _indicesCount;
 }
 
+const VertexPacking::PositionBounds& MeshObject::PositionBounds() const
+{
+    return _positionBounds;
+}
+
+void MeshObject::SetMeshlets(MeshletBuilder::MeshletData&& meshlets)
+{
+    _meshlets = std::move(meshlets);
+}
+
+const MeshletBuilder::MeshletData& MeshObject::Meshlets() const
+{
+    return _meshlets;
+}
+
+void MeshObject::SetLods(std::vector<MeshLod>&& lods)
+{
+    assert(!lods.empty() && lods.back().firstIndex + lods.back().indicesCount <= _indicesCount);
+    _lods = std::move(lods);
+}
+
+const std::vector<MeshLod>& MeshObject::Lods() const
+{
+    return _lods;
+}
+
+void MeshObject::SetAverageEdgeLength(float length)
+{
+    _averageEdgeLength = length;
+}
+
+float MeshObject::AverageEdgeLength() const
+{
+    return _averageEdgeLength;
+}
+
 //////////////////////////////////////////////////////////////////////////
 
-MeshManager::MeshManager(bool tessellationEnabled, ComPtr<ID3D12Device> device)
+MeshManager::MeshManager(bool tessellationEnabled, bool cpuTessellation, bool packedVertices, ComPtr<ID3D12Device> device)
     : _tessellationEnabled(tessellationEnabled)
+    , _cpuTessellation(cpuTessellation)
+    , _packedVertices(packedVertices)
     , _device(device)
 {
 }
 
 std::shared_ptr<MeshObject> MeshManager::LoadMesh(const std::string& filename)
 {
-    throw std::runtime_error("Not implemented yet");
+    MeshFile::MeshData data;
+    if (!MeshFile::Load(filename, data))
+        throw std::runtime_error("Failed to load mesh " + filename);
+
+    if (data.lods.empty())
+        data.lods.push_back({0, (uint32_t)data.indices.size(), 0.0f});
+
+    // different files may contain the same geometry, so the key is built from the loaded data
+    const uint64_t key = ComputeMeshKey(data.vertices.data(), data.vertices.size() * sizeof(geometryVertex), sizeof(geometryVertex),
+                                        data.indices, GetGeometryTopology());
+    if (auto mesh = FindCachedMesh(key))
+        return mesh;
+
+    std::vector<uint8_t> vertexData {(uint8_t*)data.vertices.data(), (uint8_t*)(data.vertices.data() + data.vertices.size())};
+    auto mesh = CreateMeshObject(filename, vertexData, data.indices, std::move(data.lods));
+    AddCachedMesh(key, mesh);
+    return mesh;
 }
 
 std::shared_ptr<MeshObject> MeshManager::CreateCube()
 {
-    if (_cube)
-        return _cube;
-
     static const std::vector<uint32_t> indices =
     {
         //back
@@ -213,31 +327,11 @@ std::shared_ptr<MeshObject> MeshManager::CreateCube()
         22, 23, 21
     };
 
-    if (_tessellationEnabled)
-    {
-        _cube = std::make_shared<MeshObject>(std::vector<uint8_t>{(uint8_t*)vertices.data(), (uint8_t*)(vertices.data() + vertices.size())},
-                                                        sizeof(geometryVertex),
-                                                        indices,
-                                                        _device,
-                                                        D3D_PRIMITIVE_TOPOLOGY_3_CONTROL_POINT_PATCHLIST);
-    }
-    else
-    {
-        _cube = std::make_shared<MeshObject>(std::vector<uint8_t>{(uint8_t*)vertices.data(), (uint8_t*)(vertices.data() + vertices.size())},
-                                                        sizeof(geometryVertex),
-                                                        indices,
-                                                        _device,
-                                                        D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-    }
-
-    return _cube;
+    return CreateGeometryMesh("Cube", vertices, indices);
 }
 
 std::shared_ptr<MeshObject> MeshManager::CreateEmptyCube()
 {
-    if (_emptyCube)
-        return _emptyCube;
-
     static const std::vector<uint32_t> indices =
     {
         //back
@@ -262,36 +356,66 @@ std::shared_ptr<MeshObject> MeshManager::CreateEmptyCube()
         24 + 23, 24 + 22, 24 + 21
     };
 
-    if (_tessellationEnabled)
-    {
-        _emptyCube = std::make_shared<MeshObject>(std::vector<uint8_t>{(uint8_t*)vertices.data(), (uint8_t*)(vertices.data() + vertices.size())},
-                                                  sizeof(geometryVertex),
-                                                  indices,
-                                                  _device,
-                                                  D3D_PRIMITIVE_TOPOLOGY_3_CONTROL_POINT_PATCHLIST);
-    }
-    else
-    {
-        _emptyCube = std::make_shared<MeshObject>(std::vector<uint8_t>{(uint8_t*)vertices.data(), (uint8_t*)(vertices.data() + vertices.size())},
-                                                  sizeof(geometryVertex),
-                                                  indices,
-                                                  _device,
-                                                  D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-    }
-
-    return _emptyCube;
+    return CreateGeometryMesh("EmptyCube", vertices, indices);
 }
 
 std::shared_ptr<MeshObject> MeshManager::CreateSphere()
 {
-    throw std::runtime_error("Not implemented yet");
+    // the seam and the poles have a vertex for every segment, so texture coordinates don't wrap
+    static std::vector<geometryVertex> vertices;
+    static std::vector<uint32_t> indices;
+    if (vertices.empty())
+    {
+        constexpr float pi = 3.14159265f;
+        for (uint32_t ring = 0; ring <= sphereRings; ++ring)
+        {
+            for (uint32_t segment = 0; segment <= sphereSegments; ++segment)
+            {
+                // positions of the seam and the poles are exact, so the simplifier sees the surface closed
+                const float theta = pi * ring / sphereRings;
+                const float phi = 2.0f * pi * (segment % sphereSegments) / sphereSegments;
+                const bool pole = ring == 0 || ring == sphereRings;
+                const XMFLOAT3 normal = pole ? XMFLOAT3 {0.0f, ring == 0 ? 1.0f : -1.0f, 0.0f}
+                                             : XMFLOAT3 {std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi)};
+
+                // binormal and tangent follow u and v like on the cube faces
+                geometryVertex vertex = {};
+                vertex.position[0] = normal.x * 0.5f;
+                vertex.position[1] = normal.y * 0.5f;
+                vertex.position[2] = normal.z * 0.5f;
+                vertex.normal[0] = normal.x;
+                vertex.normal[1] = normal.y;
+                vertex.normal[2] = normal.z;
+                vertex.binormal[0] = -std::sin(phi);
+                vertex.binormal[2] = std::cos(phi);
+                vertex.tangent[0] = std::cos(theta) * std::cos(phi);
+                vertex.tangent[1] = -std::sin(theta);
+                vertex.tangent[2] = std::cos(theta) * std::sin(phi);
+                vertex.uv[0] = (float)segment / sphereSegments;
+                vertex.uv[1] = (float)ring / sphereRings;
+                vertices.push_back(vertex);
+            }
+        }
+
+        for (uint32_t ring = 0; ring < sphereRings; ++ring)
+        {
+            for (uint32_t segment = 0; segment < sphereSegments; ++segment)
+            {
+                const uint32_t a = ring * (sphereSegments + 1) + segment;
+                const uint32_t b = a + sphereSegments + 1;
+                if (ring != 0)
+                    indices.insert(indices.end(), {a, a + 1, b});
+                if (ring != sphereRings - 1)
+                    indices.insert(indices.end(), {a + 1, b + 1, b});
+            }
+        }
+    }
+
+    return CreateGeometryMesh("Sphere", vertices, indices);
 }
 
 std::shared_ptr<MeshObject> MeshManager::CreatePlane()
 {
-    if (_plane)
-        return _plane;
-
     static const std::vector<geometryVertex> vertices =
     {
         {{-0.5f, 0.0f,  0.5f}, {0.0f, 1.0f, 0.0f}, {1.0f, 0.0f, 0.0f}, {0.0f, 0.0f, -1.0f}, {0.0f, 0.0f}},
@@ -306,31 +430,11 @@ std::shared_ptr<MeshObject> MeshManager::CreatePlane()
         0, 2, 3
     };
 
-    if (_tessellationEnabled)
-    {
-        _plane = std::make_shared<MeshObject>(std::vector<uint8_t>{(uint8_t*)vertices.data(), (uint8_t*)(vertices.data() + vertices.size())},
-                                              sizeof(geometryVertex),
-                                              indices,
-                                              _device,
-                                              D3D_PRIMITIVE_TOPOLOGY_3_CONTROL_POINT_PATCHLIST);
-    }
-    else
-    {
-        _plane = std::make_shared<MeshObject>(std::vector<uint8_t>{(uint8_t*)vertices.data(), (uint8_t*)(vertices.data() + vertices.size())},
-                                              sizeof(geometryVertex),
-                                              indices,
-                                              _device,
-                                              D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-    }
-
-    return _plane;
+    return CreateGeometryMesh("Plane", vertices, indices);
 }
 
 std::shared_ptr<MeshObject> MeshManager::CreateScreenQuad()
 {
-    if (_screenQuad)
-        return _screenQuad;
-
     static std::vector<screenQuadVertex> sqVertices =
     {
         {{-1.0f,  1.0f}, {0.0f, 0.0f}},
@@ -341,11 +445,288 @@ std::shared_ptr<MeshObject> MeshManager::CreateScreenQuad()
         {{-1.0f, -1.0f}, {0.0f, 1.0f}},
     };
 
-    _screenQuad = std::make_shared<MeshObject>(std::vector<uint8_t>{(uint8_t*)sqVertices.data(), (uint8_t*)(sqVertices.data() + sqVertices.size())},
-                                               sizeof(screenQuadVertex),
-                                               std::vector<uint32_t>{},
-                                               _device,
-                                               D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    const uint64_t key = ComputeMeshKey(sqVertices.data(), sqVertices.size() * sizeof(screenQuadVertex), sizeof(screenQuadVertex),
+                                        {}, D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    if (auto mesh = FindCachedMesh(key))
+        return mesh;
+
+    auto mesh = std::make_shared<MeshObject>(std::vector<uint8_t>{(uint8_t*)sqVertices.data(), (uint8_t*)(sqVertices.data() + sqVertices.size())},
+                                             sizeof(screenQuadVertex),
+                                             std::vector<uint32_t>{},
+                                             _device,
+                                             D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+    AddCachedMesh(key, mesh);
+    return mesh;
+}
+
+std::shared_ptr<MeshObject> MeshManager::CreateGeometryMesh(const std::string& name,
+                                                            const std::vector<geometryVertex>& vertices,
+                                                            const std::vector<uint32_t>& indices)
+{
+    // all processing below is deterministic, so the source data identifies the result
+    const uint64_t key = ComputeMeshKey(vertices.data(), vertices.size() * sizeof(geometryVertex), sizeof(geometryVertex),
+                                        indices, GetGeometryTopology());
+    if (auto mesh = FindCachedMesh(key))
+        return mesh;
+
+    auto mesh = _cpuTessellation ? CreateTessellatedMesh(name, vertices, indices) : CreateSimplifiedMesh(name, vertices, indices);
+    AddCachedMesh(key, mesh);
+    return mesh;
+}
+
+std::shared_ptr<MeshObject> MeshManager::CreateSimplifiedMesh(const std::string& name,
+                                                              const std::vector<geometryVertex>& vertices,
+                                                              const std::vector<uint32_t>& indices)
+{
+    std::vector<uint8_t> vertexData {(uint8_t*)vertices.data(), (uint8_t*)(vertices.data() + vertices.size())};
+    std::vector<uint32_t> indexData = indices;
+
+    // patches are triangles too, so the same optimizations are applicable
+    _optimizationReports.push_back(MeshOptimizer::Optimize(vertexData, sizeof(geometryVertex), indexData));
+    _optimizationReports.back().meshName = name;
+
+    // every LOD is simplified from the previous one, all of them share vertices of LOD 0
+    auto lodsStart = std::chrono::high_resolution_clock::now();
+    std::vector<MeshLod> lods = {{0, (uint32_t)indexData.size(), 0.0f}};
+    std::vector<uint32_t> allIndices = indexData;
+    std::vector<uint32_t> lodIndices = indexData;
+    while (lods.size() < maxLodsCount)
+    {
+        float error = 0.0f;
+        std::vector<uint32_t> simplified = MeshSimplifier::Simplify(lodIndices, vertexData, sizeof(geometryVertex),
+                                                                    lodIndices.size() / 6 * 3, maxLodError, &error);
+
+        // seams, borders or error limit don't allow to simplify the mesh noticeably
+        if (simplified.size() * 4 > lodIndices.size() * 3)
+            break;
+
+        MeshOptimizer::OptimizeVertexCache(simplified, vertexData.size() / sizeof(geometryVertex));
+
+        lods.push_back({(uint32_t)allIndices.size(), (uint32_t)simplified.size(), lods.back().error + error});
+        allIndices.insert(allIndices.end(), simplified.begin(), simplified.end());
+        lodIndices = std::move(simplified);
+    }
+    std::chrono::duration<float, std::milli> lodsTime = std::chrono::high_resolution_clock::now() - lodsStart;
+    _lodReports.push_back({name, lods, lodsTime.count()});
+
+    return CreateMeshObject(name, vertexData, allIndices, std::move(lods));
+}
+
+std::shared_ptr<MeshObject> MeshManager::CreateTessellatedMesh(const std::string& name,
+                                                               const std::vector<geometryVertex>& vertices,
+                                                               const std::vector<uint32_t>& indices)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+
+    uint64_t sourceHash = MeshFile::Hash(vertices.data(), vertices.size() * sizeof(geometryVertex));
+    sourceHash = MeshFile::Hash(indices.data(), indices.size() * sizeof(uint32_t), sourceHash);
+    sourceHash = MeshFile::Hash(tessellationLevels, sizeof(tessellationLevels), sourceHash);
+
+    const std::string cacheFileName = meshCacheDirectory + "/" + name + ".mesh";
+
+    MeshFile::MeshData data;
+    bool cached = MeshFile::Load(cacheFileName, data) && data.sourceHash == sourceHash;
+    if (!cached)
+    {
+        data = {};
+        data.sourceHash = sourceHash;
+
+        std::vector<float> errors;
+        for (uint32_t level : tessellationLevels)
+            errors.push_back(Tessellator::MeasureError(vertices, indices, level, tessellationReferenceLevel));
+
+        // every level has its own vertices, they are stored one after another in the shared vertex buffer
+        std::vector<geometryVertex> levelVertices;
+        std::vector<uint32_t> levelIndices;
+        for (size_t i = 0; i < _countof(tessellationLevels); ++i)
+        {
+            Tessellator::Tessellate(vertices, indices, tessellationLevels[i], levelVertices, levelIndices);
+
+            std::vector<uint8_t> vertexData {(uint8_t*)levelVertices.data(), (uint8_t*)(levelVertices.data() + levelVertices.size())};
+            _optimizationReports.push_back(MeshOptimizer::Optimize(vertexData, sizeof(geometryVertex), levelIndices));
+            _optimizationReports.back().meshName = name + " (tessellation level " + std::to_string(tessellationLevels[i]) + ")";
+
+            const uint32_t baseVertex = (uint32_t)data.vertices.size();
+            for (uint32_t& index : levelIndices)
+                index += baseVertex;
+
+            const geometryVertex* optimizedVertices = reinterpret_cast<const geometryVertex*>(vertexData.data());
+            data.vertices.insert(data.vertices.end(), optimizedVertices, optimizedVertices + vertexData.size() / sizeof(geometryVertex));
+            data.lods.push_back({(uint32_t)data.indices.size(), (uint32_t)levelIndices.size(), errors[i]});
+            data.indices.insert(data.indices.end(), levelIndices.begin(), levelIndices.end());
+        }
+
+        // LOD errors are expected to be relative to the bounding sphere radius
+        VertexPacking::PositionBounds bounds = VertexPacking::ComputeBounds(data.vertices.data(), data.vertices.size());
+        const XMFLOAT3& extent = bounds.extent;
+        const float radius = std::max(std::sqrt(extent.x * extent.x + extent.y * extent.y + extent.z * extent.z), 1e-6f);
+        for (MeshLod& lod : data.lods)
+            lod.error /= radius;
+
+        std::filesystem::create_directories(meshCacheDirectory);
+        MeshFile::Save(cacheFileName, data);
+    }
+
+    std::chrono::duration<float, std::milli> buildTime = std::chrono::high_resolution_clock::now() - start;
+    _lodReports.push_back({name + (cached ? " (tessellation, cached)" : " (tessellation)"), data.lods, buildTime.count()});
+
+    std::vector<uint8_t> vertexData {(uint8_t*)data.vertices.data(), (uint8_t*)(data.vertices.data() + data.vertices.size())};
+    return CreateMeshObject(name, vertexData, data.indices, std::move(data.lods));
+}
+
+std::shared_ptr<MeshObject> MeshManager::CreateMeshObject(const std::string& name,
+                                                          const std::vector<uint8_t>& vertexData,
+                                                          const std::vector<uint32_t>& indices,
+                                                          std::vector<MeshLod>&& lods)
+{
+    // meshlets are built on the final index order, so every meshlet is a contiguous range of the index buffer
+    auto meshletsStart = std::chrono::high_resolution_clock::now();
+    std::vector<uint32_t> lodIndices {indices.begin() + lods[0].firstIndex, indices.begin() + lods[0].firstIndex + lods[0].indicesCount};
+    MeshletBuilder::MeshletData meshlets = MeshletBuilder::Build(lodIndices, vertexData, sizeof(geometryVertex));
+    std::chrono::duration<float, std::milli> meshletsTime = std::chrono::high_resolution_clock::now() - meshletsStart;
+    _meshletReports.push_back({name, MeshletBuilder::ComputeStatistics(meshlets), meshletsTime.count()});
+
+    // CPU tessellation turns the hardware one off, so pre-tessellated meshes are drawn as plain triangles
+    D3D_PRIMITIVE_TOPOLOGY topology = GetGeometryTopology();
+
+    const geometryVertex* sourceVertices = reinterpret_cast<const geometryVertex*>(vertexData.data());
+    const size_t verticesCount = vertexData.size() / sizeof(geometryVertex);
+    VertexPacking::PositionBounds bounds = VertexPacking::ComputeBounds(sourceVertices, verticesCount);
+
+    float edgesLength = 0.0f;
+    for (size_t i = 0; i < lodIndices.size(); i += 3)
+    {
+        for (size_t k = 0; k < 3; ++k)
+        {
+            const float * a = sourceVertices[lodIndices[i + k]].position;
+            const float * b = sourceVertices[lodIndices[i + (k + 1) % 3]].position;
+            edgesLength += std::sqrt((a[0] - b[0]) * (a[0] - b[0]) + (a[1] - b[1]) * (a[1] - b[1]) + (a[2] - b[2]) * (a[2] - b[2]));
+        }
+    }
+
+    std::shared_ptr<MeshObject> mesh;
+    if (_packedVertices)
+    {
+        std::vector<uint8_t> packedData(verticesCount * sizeof(packedGeometryVertex));
+        VertexPacking::PackVertices(sourceVertices, verticesCount, bounds, reinterpret_cast<packedGeometryVertex*>(packedData.data()));
+
+        mesh = std::make_shared<MeshObject>(packedData, sizeof(packedGeometryVertex), indices, _device, topology,
+                                            bounds, sizeof(packedGeometryVertex::position));
+    }
+    else
+    {
+        mesh = std::make_shared<MeshObject>(vertexData, sizeof(geometryVertex), indices, _device, topology,
+                                            bounds, sizeof(geometryVertex::position));
+    }
+
+    mesh->SetMeshlets(std::move(meshlets));
+    mesh->SetLods(std::move(lods));
+    if (!lodIndices.empty())
+        mesh->SetAverageEdgeLength(edgesLength / lodIndices.size());
+    return mesh;
+}
+
+D3D_PRIMITIVE_TOPOLOGY MeshManager::GetGeometryTopology() const
+{
+    return _tessellationEnabled ? D3D_PRIMITIVE_TOPOLOGY_3_CONTROL_POINT_PATCHLIST : D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+}
+
+uint64_t MeshManager::ComputeMeshKey(const void* vertexData,
+                                     size_t vertexDataSize,
+                                     size_t stride,
+                                     const std::vector<uint32_t>& indices,
+                                     D3D_PRIMITIVE_TOPOLOGY topology)
+{
+    const uint64_t sizes[] = {vertexDataSize, indices.size(), stride, (uint64_t)topology};
+    uint64_t key = MeshFile::Hash(sizes, sizeof(sizes));
+    key = MeshFile::Hash(vertexData, vertexDataSize, key);
+    return MeshFile::Hash(indices.data(), indices.size() * sizeof(uint32_t), key);
+}
+
+std::shared_ptr<MeshObject> MeshManager::FindCachedMesh(uint64_t key)
+{
+    _cacheStatistics.requests++;
+
+    auto iter = _meshCache.find(key);
+    if (iter == _meshCache.end())
+        return nullptr;
+
+    std::shared_ptr<MeshObject> mesh = iter->second.lock();
+    if (!mesh)
+        return nullptr;
+
+    _cacheStatistics.hits++;
+    _cacheStatistics.bytesSaved += mesh->VertexBufferView().SizeInBytes + mesh->AttributeBufferView().SizeInBytes + mesh->IndexBufferView().SizeInBytes;
+    return mesh;
+}
+
+void MeshManager::AddCachedMesh(uint64_t key, const std::shared_ptr<MeshObject>& mesh)
+{
+    // nobody can get expired entries anymore, so they are removed before the cache grows
+    for (auto iter = _meshCache.begin(); iter != _meshCache.end();)
+    {
+        if (iter->second.expired())
+        {
+            iter = _meshCache.erase(iter);
+            _cacheStatistics.evictions++;
+        }
+        else
+            ++iter;
+    }
+
+    _meshCache[key] = mesh;
+}
+
+const MeshCacheStatistics& MeshManager::CacheStatistics() const
+{
+    return _cacheStatistics;
+}
+
+void MeshManager::DumpOptimizationReports(const std::string& fileName) const
+{
+    std::ostringstream ss;
+    ss << "Mesh cache: " << _cacheStatistics.requests << " requests, " << _cacheStatistics.hits << " hits";
+    if (_cacheStatistics.requests)
+        ss << " (" << 100.0f * _cacheStatistics.hits / _cacheStatistics.requests << "%)";
+    ss << ", " << _cacheStatistics.bytesSaved / 1024 << " KB saved, " << _meshCache.size() << " entries, "
+       << _cacheStatistics.evictions << " evicted" << std::endl << std::endl;
+
+    for (const auto& report : _optimizationReports)
+    {
+        ss << report.meshName << ": " << report.trianglesCount << " triangles" << std::endl;
+        ss << "Vertices: " << report.verticesBefore << " -> " << report.verticesAfter << std::endl;
+        ss << "ACMR: " << report.before.acmr << " -> " << report.after.acmr << std::endl;
+        ss << "ATVR: " << report.before.atvr << " -> " << report.after.atvr << std::endl;
+        ss << std::endl;
+    }
+
+    for (const auto& report : _lodReports)
+    {
+        size_t simplifiedTriangles = 0;
+        ss << report.meshName << ": " << report.lods.size() << " LODs" << std::endl;
+        for (size_t i = 0; i < report.lods.size(); ++i)
+        {
+            ss << "LOD " << i << ": " << report.lods[i].indicesCount / 3 << " triangles, error " << report.lods[i].error << std::endl;
+            if (i + 1 < report.lods.size())
+                simplifiedTriangles += report.lods[i].indicesCount / 3;
+        }
+        ss << "Build time: " << report.buildTimeMs << " ms";
+        if (report.buildTimeMs > 0.0f)
+            ss << " (" << simplifiedTriangles / report.buildTimeMs * 1000.0f << " triangles/s)";
+        ss << std::endl << std::endl;
+    }
+
+    for (const auto& report : _meshletReports)
+    {
+        ss << report.meshName << ": " << report.statistics.meshletsCount << " meshlets" << std::endl;
+        ss << "Average vertices: " << report.statistics.averageVertices << std::endl;
+        ss << "Average triangles: " << report.statistics.averageTriangles << std::endl;
+        ss << "Build time: " << report.buildTimeMs << " ms" << std::endl;
+        ss << std::endl;
+    }
 
-    return _screenQuad;
+    std::ofstream file {fileName};
+    file << ss.str();
+    file.close();
 }
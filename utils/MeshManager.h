@@ -2,6 +2,11 @@
 
 #include "stdafx.h"
 
+#include "MeshletBuilder.h"
+#include "MeshOptimizer.h"
+#include "Types.h"
+#include "VertexPacking.h"
+
 class MeshObject
 {
 public:
@@ -9,18 +14,34 @@ public:
                size_t stride,
                const std::vector<uint32_t>& index_data,
                ComPtr<ID3D12Device> pDevice,
-               D3D_PRIMITIVE_TOPOLOGY topology);
+               D3D_PRIMITIVE_TOPOLOGY topology,
+               const VertexPacking::PositionBounds& positionBounds = {},
+               size_t positionStride = 0);
 
     MeshObject(MeshObject&& right) noexcept = default;
     MeshObject& operator=(MeshObject&& right) noexcept = default;
 
     const ComPtr<ID3D12Resource>& VertexBuffer() const;
     const D3D12_VERTEX_BUFFER_VIEW& VertexBufferView() const;
+    const D3D12_VERTEX_BUFFER_VIEW& AttributeBufferView() const;
+    bool HasPositionStream() const;
     const ComPtr<ID3D12Resource>& IndexBuffer() const;
     const D3D12_INDEX_BUFFER_VIEW& IndexBufferView() const;
     D3D_PRIMITIVE_TOPOLOGY TopologyType() const;
     size_t VerticesCount() const;
     size_t IndicesCount() const;
+    const VertexPacking::PositionBounds& PositionBounds() const;
+
+    void SetMeshlets(MeshletBuilder::MeshletData&& meshlets);
+    const MeshletBuilder::MeshletData& Meshlets() const;
+
+    // all LODs share the vertex buffer and are stored one by one in the index buffer, LOD 0 goes first
+    void SetLods(std::vector<MeshLod>&& lods);
+    const std::vector<MeshLod>& Lods() const;
+
+    // average edge length of LOD 0 triangles in object space, used to select tessellation factors
+    void SetAverageEdgeLength(float length);
+    float AverageEdgeLength() const;
 
 private:
     size_t                      _verticesCount = 0;
@@ -28,18 +49,34 @@ private:
 
     ComPtr<ID3D12Resource>      _vertexBuffer = nullptr;
     D3D12_VERTEX_BUFFER_VIEW    _vertexBufferView = {};
+    D3D12_VERTEX_BUFFER_VIEW    _attributeBufferView = {};
 
     ComPtr<ID3D12Resource>      _indexBuffer = nullptr;
     D3D12_INDEX_BUFFER_VIEW     _indexBufferView = {};
 
     D3D_PRIMITIVE_TOPOLOGY      _topology = D3D_PRIMITIVE_TOPOLOGY_UNDEFINED;
     ComPtr<ID3D12Device>        _device = nullptr;
+
+    VertexPacking::PositionBounds _positionBounds = {};
+    MeshletBuilder::MeshletData _meshlets = {};
+    std::vector<MeshLod>        _lods;
+    float                       _averageEdgeLength = 0.0f;
 };
 
+struct MeshCacheStatistics
+{
+    uint64_t requests = 0;
+    uint64_t hits = 0;
+    uint64_t bytesSaved = 0;    // vertex and index data which was not uploaded again thanks to hits
+    uint64_t evictions = 0;     // entries removed after all users of the mesh released it
+};
+
+// Meshes are cached by content, so identical geometry is uploaded only once and is shared
+// while somebody uses it. The cache doesn't own meshes, released ones are evicted.
 class MeshManager
 {
 public:
-    MeshManager(bool tessellationEnabled, ComPtr<ID3D12Device> device);
+    MeshManager(bool tessellationEnabled, bool cpuTessellation, bool packedVertices, ComPtr<ID3D12Device> device);
 
     std::shared_ptr<MeshObject> LoadMesh(const std::string& filename);
     std::shared_ptr<MeshObject> CreateCube();
@@ -48,14 +85,64 @@ public:
     std::shared_ptr<MeshObject> CreatePlane();
     std::shared_ptr<MeshObject> CreateScreenQuad();
 
+    void DumpOptimizationReports(const std::string& fileName) const;
+    const MeshCacheStatistics& CacheStatistics() const;
+
 private:
-    std::vector<std::shared_ptr<MeshObject>> _meshes;
+    std::shared_ptr<MeshObject> CreateGeometryMesh(const std::string& name,
+                                                   const std::vector<geometryVertex>& vertices,
+                                                   const std::vector<uint32_t>& indices);
+
+    // optimizes the mesh and builds LODs by simplification
+    std::shared_ptr<MeshObject> CreateSimplifiedMesh(const std::string& name,
+                                                     const std::vector<geometryVertex>& vertices,
+                                                     const std::vector<uint32_t>& indices);
+
+    // tessellates and displaces the mesh once at several levels, LOD 0 is the finest one
+    std::shared_ptr<MeshObject> CreateTessellatedMesh(const std::string& name,
+                                                      const std::vector<geometryVertex>& vertices,
+                                                      const std::vector<uint32_t>& indices);
+
+    // builds meshlets for LOD 0 and uploads the mesh in the current vertex format
+    std::shared_ptr<MeshObject> CreateMeshObject(const std::string& name,
+                                                 const std::vector<uint8_t>& vertexData,
+                                                 const std::vector<uint32_t>& indices,
+                                                 std::vector<MeshLod>&& lods);
+
+    D3D_PRIMITIVE_TOPOLOGY GetGeometryTopology() const;
+
+    static uint64_t ComputeMeshKey(const void* vertexData,
+                                   size_t vertexDataSize,
+                                   size_t stride,
+                                   const std::vector<uint32_t>& indices,
+                                   D3D_PRIMITIVE_TOPOLOGY topology);
+    std::shared_ptr<MeshObject> FindCachedMesh(uint64_t key);
+    void AddCachedMesh(uint64_t key, const std::shared_ptr<MeshObject>& mesh);
+
+    std::unordered_map<uint64_t, std::weak_ptr<MeshObject>> _meshCache;
+    MeshCacheStatistics         _cacheStatistics = {};
+
     ComPtr<ID3D12Device>        _device = nullptr;
     bool                        _tessellationEnabled = false;
+    bool                        _cpuTessellation = false;
+    bool                        _packedVertices = false;
+
+    struct LodReport
+    {
+        std::string                         meshName;
+        std::vector<MeshLod>                lods;
+        float                               buildTimeMs = 0.0f;
+    };
+
+    struct MeshletReport
+    {
+        std::string                         meshName;
+        MeshletBuilder::MeshletStatistics   statistics;
+        float                               buildTimeMs = 0.0f;
+    };
 
-    std::shared_ptr<MeshObject> _screenQuad = nullptr;
-    std::shared_ptr<MeshObject> _plane = nullptr;
-    std::shared_ptr<MeshObject> _cube = nullptr;
-    std::shared_ptr<MeshObject> _emptyCube = nullptr;
+    std::vector<MeshOptimizer::OptimizationReport> _optimizationReports;
+    std::vector<MeshletReport> _meshletReports;
+    std::vector<LodReport> _lodReports;
 
 };
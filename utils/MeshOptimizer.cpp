@@ -0,0 +1,404 @@
+#include "stdafx.h"
+
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace MeshOptimizer
+{
+namespace
+{
+uint64_t HashVertex(const uint8_t* vertex, size_t stride)
+{
+    // FNV-1a
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < stride; ++i)
+    {
+        hash ^= vertex[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+struct float3
+{
+    float x, y, z;
+};
+
+float3 GetPosition(const std::vector<uint8_t>& vertexData, size_t stride, uint32_t index)
+{
+    float3 position;
+    std::memcpy(&position, vertexData.data() + index * stride, sizeof(float3));
+    return position;
+}
+}
+
+VertexCacheStatistics AnalyzeVertexCache(const std::vector<uint32_t>& indices, size_t verticesCount, size_t cacheSize /*= DefaultCacheSize*/)
+{
+    VertexCacheStatistics statistics;
+    if (indices.size() < 3 || !verticesCount)
+        return statistics;
+
+    // FIFO cache emulation: vertex is in cache while it is not older than cacheSize misses
+    std::vector<uint32_t> cacheTimestamps(verticesCount, 0);
+    std::vector<bool> usedVertices(verticesCount, false);
+    uint32_t timestamp = (uint32_t)cacheSize + 1;
+    size_t misses = 0;
+    size_t usedCount = 0;
+
+    for (uint32_t index : indices)
+    {
+        assert(index < verticesCount);
+
+        if (timestamp - cacheTimestamps[index] > cacheSize)
+        {
+            cacheTimestamps[index] = timestamp++;
+            misses++;
+        }
+
+        if (!usedVertices[index])
+        {
+            usedVertices[index] = true;
+            usedCount++;
+        }
+    }
+
+    statistics.acmr = (float)misses / (float)(indices.size() / 3);
+    statistics.atvr = (float)misses / (float)usedCount;
+    return statistics;
+}
+
+size_t WeldVertices(std::vector<uint8_t>& vertexData, size_t stride, std::vector<uint32_t>& indices)
+{
+    const size_t verticesCount = vertexData.size() / stride;
+    if (!verticesCount)
+        return 0;
+
+    size_t tableSize = 1;
+    while (tableSize < verticesCount * 2)
+        tableSize <<= 1;
+
+    // open addressing table, stores new vertex index + 1
+    std::vector<uint32_t> table(tableSize, 0);
+    std::vector<uint32_t> remap(verticesCount);
+    uint32_t uniqueCount = 0;
+
+    for (size_t vertex = 0; vertex < verticesCount; ++vertex)
+    {
+        const uint8_t* vertexPtr = vertexData.data() + vertex * stride;
+        size_t slot = HashVertex(vertexPtr, stride) & (tableSize - 1);
+
+        while (true)
+        {
+            if (!table[slot])
+            {
+                // unique vertices are compacted in place, uniqueCount <= vertex so it is safe
+                std::memmove(vertexData.data() + uniqueCount * stride, vertexPtr, stride);
+                table[slot] = uniqueCount + 1;
+                remap[vertex] = uniqueCount++;
+                break;
+            }
+
+            const uint32_t candidate = table[slot] - 1;
+            if (!std::memcmp(vertexData.data() + candidate * stride, vertexPtr, stride))
+            {
+                remap[vertex] = candidate;
+                break;
+            }
+
+            slot = (slot + 1) & (tableSize - 1);
+        }
+    }
+
+    for (uint32_t& index : indices)
+        index = remap[index];
+
+    vertexData.resize(uniqueCount * stride);
+    return uniqueCount;
+}
+
+std::vector<size_t> OptimizeVertexCache(std::vector<uint32_t>& indices, size_t verticesCount, size_t cacheSize /*= DefaultCacheSize*/)
+{
+    std::vector<size_t> hardBoundaries;
+    if (indices.size() < 3 || !verticesCount)
+        return hardBoundaries;
+
+    const size_t trianglesCount = indices.size() / 3;
+
+    // vertex -> triangles adjacency
+    std::vector<uint32_t> liveTriangles(verticesCount, 0);
+    for (uint32_t index : indices)
+        liveTriangles[index]++;
+
+    std::vector<uint32_t> adjacencyOffsets(verticesCount + 1, 0);
+    for (size_t vertex = 0; vertex < verticesCount; ++vertex)
+        adjacencyOffsets[vertex + 1] = adjacencyOffsets[vertex] + liveTriangles[vertex];
+
+    std::vector<uint32_t> adjacency(indices.size());
+    {
+        std::vector<uint32_t> cursors(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+        for (size_t i = 0; i < indices.size(); ++i)
+            adjacency[cursors[indices[i]]++] = (uint32_t)(i / 3);
+    }
+
+    std::vector<uint32_t> cacheTimestamps(verticesCount, 0);
+    std::vector<bool> emittedTriangles(trianglesCount, false);
+    std::vector<uint32_t> deadEndStack;
+    std::vector<uint32_t> candidates;
+    std::vector<uint32_t> result;
+    deadEndStack.reserve(indices.size());
+    result.reserve(indices.size());
+
+    uint32_t timestamp = (uint32_t)cacheSize + 1;
+    size_t scanCursor = 0;
+    int64_t fanningVertex = indices[0];
+
+    while (fanningVertex >= 0)
+    {
+        candidates.clear();
+
+        // emit all not yet emitted triangles around the fanning vertex
+        for (uint32_t i = adjacencyOffsets[fanningVertex]; i < adjacencyOffsets[fanningVertex + 1]; ++i)
+        {
+            const uint32_t triangle = adjacency[i];
+            if (emittedTriangles[triangle])
+                continue;
+
+            for (size_t corner = 0; corner < 3; ++corner)
+            {
+                const uint32_t vertex = indices[triangle * 3 + corner];
+                result.push_back(vertex);
+                deadEndStack.push_back(vertex);
+                candidates.push_back(vertex);
+                liveTriangles[vertex]--;
+
+                if (timestamp - cacheTimestamps[vertex] > cacheSize)
+                    cacheTimestamps[vertex] = timestamp++;
+            }
+
+            emittedTriangles[triangle] = true;
+        }
+
+        // select the next fanning vertex: the oldest one which still stays in cache after fanning
+        int64_t nextVertex = -1;
+        int64_t bestPriority = -1;
+        for (uint32_t vertex : candidates)
+        {
+            if (!liveTriangles[vertex])
+                continue;
+
+            int64_t priority = 0;
+            if (timestamp - cacheTimestamps[vertex] + 2 * liveTriangles[vertex] <= cacheSize)
+                priority = timestamp - cacheTimestamps[vertex];
+
+            if (priority > bestPriority)
+            {
+                bestPriority = priority;
+                nextVertex = vertex;
+            }
+        }
+
+        if (nextVertex < 0)
+        {
+            if (result.size() == indices.size())
+                break;
+
+            // dead end, all the following triangles will start with a cold cache
+            hardBoundaries.push_back(result.size() / 3);
+
+            while (!deadEndStack.empty())
+            {
+                const uint32_t vertex = deadEndStack.back();
+                deadEndStack.pop_back();
+                if (liveTriangles[vertex])
+                {
+                    nextVertex = vertex;
+                    break;
+                }
+            }
+
+            while (nextVertex < 0 && scanCursor < verticesCount)
+            {
+                if (liveTriangles[scanCursor])
+                    nextVertex = scanCursor;
+                scanCursor++;
+            }
+        }
+
+        fanningVertex = nextVertex;
+    }
+
+    assert(result.size() == indices.size());
+    indices.swap(result);
+    return hardBoundaries;
+}
+
+void OptimizeOverdraw(std::vector<uint32_t>& indices,
+                      const std::vector<size_t>& hardBoundaries,
+                      const std::vector<uint8_t>& vertexData,
+                      size_t stride,
+                      size_t cacheSize /*= DefaultCacheSize*/,
+                      float threshold /*= 1.05f*/)
+{
+    const size_t trianglesCount = indices.size() / 3;
+    const size_t verticesCount = vertexData.size() / stride;
+    if (trianglesCount < 2 || !verticesCount)
+        return;
+
+    // clusterization: every hard boundary starts a new cluster and soft boundaries are inserted
+    // when the cluster is already cache efficient enough, so reordering costs almost nothing
+    const float clusterThreshold = AnalyzeVertexCache(indices, verticesCount, cacheSize).acmr * threshold;
+
+    std::vector<size_t> clusters;
+    std::vector<uint32_t> cacheTimestamps(verticesCount, 0);
+    uint32_t timestamp = (uint32_t)cacheSize + 1;
+    size_t nextHardBoundary = 0;
+    size_t clusterStart = 0;
+    size_t clusterMisses = 0;
+    bool startCluster = true;
+
+    for (size_t triangle = 0; triangle < trianglesCount; ++triangle)
+    {
+        if (nextHardBoundary < hardBoundaries.size() && hardBoundaries[nextHardBoundary] == triangle)
+        {
+            startCluster = true;
+            nextHardBoundary++;
+        }
+
+        if (startCluster)
+        {
+            clusters.push_back(triangle);
+            clusterStart = triangle;
+            clusterMisses = 0;
+            timestamp += (uint32_t)cacheSize + 1; // flush the cache
+            startCluster = false;
+        }
+
+        for (size_t corner = 0; corner < 3; ++corner)
+        {
+            const uint32_t vertex = indices[triangle * 3 + corner];
+            if (timestamp - cacheTimestamps[vertex] > cacheSize)
+            {
+                cacheTimestamps[vertex] = timestamp++;
+                clusterMisses++;
+            }
+        }
+
+        const size_t clusterSize = triangle - clusterStart + 1;
+        if ((float)clusterMisses <= clusterThreshold * clusterSize)
+            startCluster = true;
+    }
+
+    // sort clusters by their facing: clusters looking outwards the mesh center are drawn first
+    // as they are most likely to occlude the rest of the mesh
+    float3 meshCentroid = {0.0f, 0.0f, 0.0f};
+    for (uint32_t index : indices)
+    {
+        const float3 position = GetPosition(vertexData, stride, index);
+        meshCentroid.x += position.x;
+        meshCentroid.y += position.y;
+        meshCentroid.z += position.z;
+    }
+    meshCentroid.x /= indices.size();
+    meshCentroid.y /= indices.size();
+    meshCentroid.z /= indices.size();
+
+    std::vector<std::pair<float, size_t>> clusterKeys(clusters.size());
+    for (size_t cluster = 0; cluster < clusters.size(); ++cluster)
+    {
+        const size_t begin = clusters[cluster];
+        const size_t end = cluster + 1 < clusters.size() ? clusters[cluster + 1] : trianglesCount;
+
+        float3 centroid = {0.0f, 0.0f, 0.0f};
+        float3 normal = {0.0f, 0.0f, 0.0f};
+        float area = 0.0f;
+
+        for (size_t triangle = begin; triangle < end; ++triangle)
+        {
+            const float3 a = GetPosition(vertexData, stride, indices[triangle * 3 + 0]);
+            const float3 b = GetPosition(vertexData, stride, indices[triangle * 3 + 1]);
+            const float3 c = GetPosition(vertexData, stride, indices[triangle * 3 + 2]);
+
+            const float3 ab = {b.x - a.x, b.y - a.y, b.z - a.z};
+            const float3 ac = {c.x - a.x, c.y - a.y, c.z - a.z};
+            const float3 n = {ab.y * ac.z - ab.z * ac.y, ab.z * ac.x - ab.x * ac.z, ab.x * ac.y - ab.y * ac.x};
+            const float triangleArea = std::sqrt(n.x * n.x + n.y * n.y + n.z * n.z);
+
+            centroid.x += (a.x + b.x + c.x) / 3.0f * triangleArea;
+            centroid.y += (a.y + b.y + c.y) / 3.0f * triangleArea;
+            centroid.z += (a.z + b.z + c.z) / 3.0f * triangleArea;
+            normal.x += n.x;
+            normal.y += n.y;
+            normal.z += n.z;
+            area += triangleArea;
+        }
+
+        float key = 0.0f;
+        const float normalLength = std::sqrt(normal.x * normal.x + normal.y * normal.y + normal.z * normal.z);
+        if (area > 0.0f && normalLength > 0.0f)
+        {
+            key = ((centroid.x / area - meshCentroid.x) * normal.x +
+                   (centroid.y / area - meshCentroid.y) * normal.y +
+                   (centroid.z / area - meshCentroid.z) * normal.z) / normalLength;
+        }
+
+        clusterKeys[cluster] = {key, cluster};
+    }
+
+    std::stable_sort(clusterKeys.begin(), clusterKeys.end(), [](const auto& left, const auto& right) {
+        return left.first > right.first;
+    });
+
+    std::vector<uint32_t> result;
+    result.reserve(indices.size());
+    for (const auto& [key, cluster] : clusterKeys)
+    {
+        const size_t begin = clusters[cluster];
+        const size_t end = cluster + 1 < clusters.size() ? clusters[cluster + 1] : trianglesCount;
+        result.insert(result.end(), indices.begin() + begin * 3, indices.begin() + end * 3);
+    }
+
+    indices.swap(result);
+}
+
+size_t OptimizeVertexFetch(std::vector<uint8_t>& vertexData, size_t stride, std::vector<uint32_t>& indices)
+{
+    const size_t verticesCount = vertexData.size() / stride;
+    std::vector<uint32_t> remap(verticesCount, ~0u);
+    std::vector<uint8_t> result(vertexData.size());
+    uint32_t nextVertex = 0;
+
+    for (uint32_t& index : indices)
+    {
+        if (remap[index] == ~0u)
+        {
+            std::memcpy(result.data() + nextVertex * stride, vertexData.data() + index * stride, stride);
+            remap[index] = nextVertex++;
+        }
+
+        index = remap[index];
+    }
+
+    result.resize(nextVertex * stride);
+    vertexData.swap(result);
+    return nextVertex;
+}
+
+OptimizationReport Optimize(std::vector<uint8_t>& vertexData, size_t stride, std::vector<uint32_t>& indices)
+{
+    OptimizationReport report;
+    report.trianglesCount = indices.size() / 3;
+    report.verticesBefore = vertexData.size() / stride;
+    report.before = AnalyzeVertexCache(indices, report.verticesBefore);
+
+    size_t verticesCount = WeldVertices(vertexData, stride, indices);
+    const std::vector<size_t> hardBoundaries = OptimizeVertexCache(indices, verticesCount);
+    OptimizeOverdraw(indices, hardBoundaries, vertexData, stride);
+    verticesCount = OptimizeVertexFetch(vertexData, stride, indices);
+
+    report.verticesAfter = verticesCount;
+    report.after = AnalyzeVertexCache(indices, verticesCount);
+    return report;
+}
+}
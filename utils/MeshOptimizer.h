@@ -0,0 +1,51 @@
+#pragma once
+
+#include "stdafx.h"
+
+// Offline (import/cook time) index and vertex buffer optimizations.
+// All functions work with triangle lists and expect the vertex position
+// to be stored as float3 at the beginning of every vertex.
+namespace MeshOptimizer
+{
+constexpr size_t DefaultCacheSize = 16;
+
+struct VertexCacheStatistics
+{
+    float acmr = 0.0f;   // average cache miss ratio: transformed vertices per triangle
+    float atvr = 0.0f;   // average transformed vertex ratio: transformed vertices per used vertex
+};
+
+struct OptimizationReport
+{
+    std::string             meshName;
+    size_t                  trianglesCount = 0;
+    size_t                  verticesBefore = 0;
+    size_t                  verticesAfter = 0;
+    VertexCacheStatistics   before;
+    VertexCacheStatistics   after;
+};
+
+// Simulates FIFO post-transform cache of the given size.
+VertexCacheStatistics AnalyzeVertexCache(const std::vector<uint32_t>& indices, size_t verticesCount, size_t cacheSize = DefaultCacheSize);
+
+// Merges bitwise identical vertices, returns new vertices count.
+size_t WeldVertices(std::vector<uint8_t>& vertexData, size_t stride, std::vector<uint32_t>& indices);
+
+// Tipsify triangle reordering. Returns triangle indices where the next cluster starts because of the cache jump.
+std::vector<size_t> OptimizeVertexCache(std::vector<uint32_t>& indices, size_t verticesCount, size_t cacheSize = DefaultCacheSize);
+
+// Splits cache optimized triangles into clusters and sorts them to draw outer clusters first.
+// threshold defines how much ACMR of the cluster is allowed to be worse than ACMR of the whole mesh.
+void OptimizeOverdraw(std::vector<uint32_t>& indices,
+                      const std::vector<size_t>& hardBoundaries,
+                      const std::vector<uint8_t>& vertexData,
+                      size_t stride,
+                      size_t cacheSize = DefaultCacheSize,
+                      float threshold = 1.05f);
+
+// Reorders vertices in the order of first use, removes unused ones. Returns new vertices count.
+size_t OptimizeVertexFetch(std::vector<uint8_t>& vertexData, size_t stride, std::vector<uint32_t>& indices);
+
+// Runs all the passes above.
+OptimizationReport Optimize(std::vector<uint8_t>& vertexData, size_t stride, std::vector<uint32_t>& indices);
+}
@@ -0,0 +1,372 @@
+#include "stdafx.h"
+
+#include "MeshSimplifier.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace MeshSimplifier
+{
+namespace
+{
+struct float3
+{
+    float x, y, z;
+};
+
+float3 Subtract(const float3& a, const float3& b)
+{
+    return {a.x - b.x, a.y - b.y, a.z - b.z};
+}
+
+float3 Cross(const float3& a, const float3& b)
+{
+    return {a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x};
+}
+
+float Dot(const float3& a, const float3& b)
+{
+    return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+// symmetric 4x4 matrix of the plane distance quadric
+struct Quadric
+{
+    double a00 = 0.0, a01 = 0.0, a02 = 0.0, a11 = 0.0, a12 = 0.0, a22 = 0.0;
+    double b0 = 0.0, b1 = 0.0, b2 = 0.0;
+    double c = 0.0;
+    double weight = 0.0;
+
+    void AddPlane(const float3& normal, float distance, double weight)
+    {
+        a00 += weight * normal.x * normal.x;
+        a01 += weight * normal.x * normal.y;
+        a02 += weight * normal.x * normal.z;
+        a11 += weight * normal.y * normal.y;
+        a12 += weight * normal.y * normal.z;
+        a22 += weight * normal.z * normal.z;
+        b0 += weight * normal.x * distance;
+        b1 += weight * normal.y * distance;
+        b2 += weight * normal.z * distance;
+        c += weight * distance * distance;
+        this->weight += weight;
+    }
+
+    void Add(const Quadric& right)
+    {
+        a00 += right.a00; a01 += right.a01; a02 += right.a02;
+        a11 += right.a11; a12 += right.a12; a22 += right.a22;
+        b0 += right.b0; b1 += right.b1; b2 += right.b2;
+        c += right.c;
+        weight += right.weight;
+    }
+
+    // weighted average of squared distances from the point to all accumulated planes
+    double Error(const float3& p) const
+    {
+        double result = a00 * p.x * p.x + a11 * p.y * p.y + a22 * p.z * p.z
+                      + 2.0 * (a01 * p.x * p.y + a02 * p.x * p.z + a12 * p.y * p.z)
+                      + 2.0 * (b0 * p.x + b1 * p.y + b2 * p.z)
+                      + c;
+        return weight > 0.0 ? std::max(result, 0.0) / weight : 0.0;
+    }
+};
+
+struct Collapse
+{
+    uint32_t    from;
+    uint32_t    to;
+    double      error;
+};
+
+// Maps every vertex to the first vertex with the same position
+std::vector<uint32_t> BuildPositionRemap(const std::vector<float3>& positions)
+{
+    std::vector<uint32_t> order(positions.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](uint32_t l, uint32_t r)
+    {
+        const float3& a = positions[l];
+        const float3& b = positions[r];
+        if (a.x != b.x)
+            return a.x < b.x;
+        if (a.y != b.y)
+            return a.y < b.y;
+        if (a.z != b.z)
+            return a.z < b.z;
+        return l < r;
+    });
+
+    std::vector<uint32_t> remap(positions.size());
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        const float3& p = positions[order[i]];
+        bool samePosition = i > 0 && std::memcmp(&p, &positions[order[i - 1]], sizeof(float3)) == 0;
+        remap[order[i]] = samePosition ? remap[order[i - 1]] : order[i];
+    }
+    return remap;
+}
+}
+
+std::vector<uint32_t> Simplify(const std::vector<uint32_t>& indices,
+                               const std::vector<uint8_t>& vertexData,
+                               size_t stride,
+                               size_t targetIndicesCount,
+                               float targetError,
+                               float* resultError /*= nullptr*/)
+{
+    const size_t verticesCount = vertexData.size() / stride;
+
+    std::vector<float3> positions(verticesCount);
+    for (size_t i = 0; i < verticesCount; ++i)
+        std::memcpy(&positions[i], vertexData.data() + i * stride, sizeof(float3));
+
+    if (resultError)
+        *resultError = 0.0f;
+
+    if (indices.size() <= targetIndicesCount || !verticesCount)
+        return indices;
+
+    // errors are normalized by the radius, so they can be compared with projected size later
+    float3 minPosition = positions[0];
+    float3 maxPosition = positions[0];
+    for (const float3& p : positions)
+    {
+        minPosition = {std::min(minPosition.x, p.x), std::min(minPosition.y, p.y), std::min(minPosition.z, p.z)};
+        maxPosition = {std::max(maxPosition.x, p.x), std::max(maxPosition.y, p.y), std::max(maxPosition.z, p.z)};
+    }
+    float3 diagonal = Subtract(maxPosition, minPosition);
+    float radius = std::max(std::sqrt(Dot(diagonal, diagonal)) * 0.5f, 1e-6f);
+    double maxError = (double)targetError * targetError * radius * radius;
+
+    std::vector<uint32_t> remap = BuildPositionRemap(positions);
+
+    // vertices of the same position with different attributes are wedges of a seam, they are linked in a ring
+    // and collapse together, so the seam is never torn
+    std::vector<uint32_t> wedgeNext(verticesCount);
+    for (uint32_t i = 0; i < verticesCount; ++i)
+    {
+        if (remap[i] == i)
+        {
+            wedgeNext[i] = i;
+        }
+        else
+        {
+            wedgeNext[i] = wedgeNext[remap[i]];
+            wedgeNext[remap[i]] = i;
+        }
+    }
+
+    // border edges have no opposite half-edge, moving their vertices would open holes
+    std::vector<bool> locked(verticesCount, false);
+    {
+        std::vector<std::pair<uint32_t, uint32_t>> halfEdges;
+        halfEdges.reserve(indices.size());
+        for (size_t i = 0; i < indices.size(); i += 3)
+            for (size_t k = 0; k < 3; ++k)
+                halfEdges.push_back({remap[indices[i + k]], remap[indices[i + (k + 1) % 3]]});
+
+        std::sort(halfEdges.begin(), halfEdges.end());
+        for (const auto& edge : halfEdges)
+        {
+            if (!std::binary_search(halfEdges.begin(), halfEdges.end(), std::make_pair(edge.second, edge.first)))
+            {
+                locked[edge.first] = true;
+                locked[edge.second] = true;
+            }
+        }
+
+        for (size_t i = 0; i < verticesCount; ++i)
+            locked[i] = locked[i] || locked[remap[i]];
+    }
+
+    std::vector<Quadric> quadrics(verticesCount);
+    for (size_t i = 0; i < indices.size(); i += 3)
+    {
+        const float3& p0 = positions[indices[i + 0]];
+        const float3& p1 = positions[indices[i + 1]];
+        const float3& p2 = positions[indices[i + 2]];
+
+        float3 normal = Cross(Subtract(p1, p0), Subtract(p2, p0));
+        float length = std::sqrt(Dot(normal, normal));
+        if (length == 0.0f)
+            continue;
+
+        normal = {normal.x / length, normal.y / length, normal.z / length};
+        float distance = -Dot(normal, p0);
+
+        // area weighted, so big triangles are preserved better
+        for (size_t k = 0; k < 3; ++k)
+            quadrics[remap[indices[i + k]]].AddPlane(normal, distance, length * 0.5);
+    }
+
+    std::vector<uint32_t> result = indices;
+    std::vector<uint32_t> collapseTarget(verticesCount);
+    std::vector<bool> touched(verticesCount);
+    std::vector<uint32_t> adjacencyOffsets(verticesCount + 1);
+    std::vector<uint32_t> adjacency;
+    std::vector<Collapse> collapses;
+    std::vector<std::pair<uint32_t, uint32_t>> wedgeTargets;
+    double worstError = 0.0;
+
+    while (result.size() > targetIndicesCount)
+    {
+        // vertex -> triangles adjacency of the current mesh
+        std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+        for (uint32_t index : result)
+            adjacencyOffsets[index + 1]++;
+        for (size_t i = 0; i < verticesCount; ++i)
+            adjacencyOffsets[i + 1] += adjacencyOffsets[i];
+
+        adjacency.resize(result.size());
+        {
+            std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+            for (size_t i = 0; i < result.size(); ++i)
+                adjacency[fill[result[i]]++] = (uint32_t)(i / 3);
+        }
+
+        collapses.clear();
+        for (size_t i = 0; i < result.size(); i += 3)
+        {
+            for (size_t k = 0; k < 3; ++k)
+            {
+                uint32_t from = result[i + k];
+                uint32_t to = result[i + (k + 1) % 3];
+                if (locked[from] || remap[from] == remap[to])
+                    continue;
+
+                double error = quadrics[remap[from]].Error(positions[to]);
+                if (error <= maxError)
+                    collapses.push_back({from, to, error});
+            }
+        }
+
+        if (collapses.empty())
+            break;
+
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& l, const Collapse& r) { return l.error < r.error; });
+
+        std::iota(collapseTarget.begin(), collapseTarget.end(), 0);
+        std::fill(touched.begin(), touched.end(), false);
+
+        size_t trianglesCount = result.size() / 3;
+        const size_t targetTrianglesCount = targetIndicesCount / 3;
+        size_t collapsesCount = 0;
+
+        for (const Collapse& collapse : collapses)
+        {
+            if (trianglesCount <= targetTrianglesCount)
+                break;
+
+            // touched flags are kept by positions, all wedges of a vertex change together
+            const uint32_t fromPosition = remap[collapse.from];
+            const uint32_t toPosition = remap[collapse.to];
+            if (touched[fromPosition] || touched[toPosition])
+                continue;
+
+            // every wedge moves to the wedge of the target it shares triangles with; a wedge that shares none
+            // or several would take attributes of the other side of the seam
+            bool valid = true;
+            wedgeTargets.clear();
+            uint32_t wedge = collapse.from;
+            do
+            {
+                uint32_t target = ~0u;
+                for (uint32_t t = adjacencyOffsets[wedge]; t < adjacencyOffsets[wedge + 1] && valid; ++t)
+                {
+                    const uint32_t * triangle = &result[adjacency[t] * 3];
+                    for (size_t k = 0; k < 3; ++k)
+                    {
+                        if (remap[triangle[k]] != toPosition)
+                            continue;
+
+                        valid = valid && (target == ~0u || target == triangle[k]);
+                        target = triangle[k];
+                    }
+                }
+
+                // wedges without triangles aren't used by the current mesh anymore
+                valid = valid && (target != ~0u || adjacencyOffsets[wedge] == adjacencyOffsets[wedge + 1]);
+                if (target != ~0u)
+                    wedgeTargets.push_back({wedge, target});
+
+                wedge = wedgeNext[wedge];
+            } while (wedge != collapse.from && valid);
+
+            if (!valid)
+                continue;
+
+            // the collapse must not flip any of the remaining triangles around the vertex
+            bool flipped = false;
+            size_t removedTriangles = 0;
+            for (size_t w = 0; w < wedgeTargets.size() && !flipped; ++w)
+            {
+                const uint32_t from = wedgeTargets[w].first;
+                for (uint32_t t = adjacencyOffsets[from]; t < adjacencyOffsets[from + 1] && !flipped; ++t)
+                {
+                    const uint32_t * triangle = &result[adjacency[t] * 3];
+                    if (remap[triangle[0]] == toPosition || remap[triangle[1]] == toPosition || remap[triangle[2]] == toPosition)
+                    {
+                        removedTriangles++;
+                        continue;
+                    }
+
+                    float3 before[3], after[3];
+                    for (size_t k = 0; k < 3; ++k)
+                    {
+                        before[k] = positions[triangle[k]];
+                        after[k] = triangle[k] == from ? positions[collapse.to] : before[k];
+                    }
+
+                    float3 normalBefore = Cross(Subtract(before[1], before[0]), Subtract(before[2], before[0]));
+                    float3 normalAfter = Cross(Subtract(after[1], after[0]), Subtract(after[2], after[0]));
+                    flipped = Dot(normalBefore, normalAfter) <= 0.0f;
+                }
+            }
+
+            if (flipped)
+                continue;
+
+            // neighbours are touched too, otherwise two collapses in the same area may flip triangles together
+            for (const auto& wedgeTarget : wedgeTargets)
+            {
+                for (uint32_t t = adjacencyOffsets[wedgeTarget.first]; t < adjacencyOffsets[wedgeTarget.first + 1]; ++t)
+                {
+                    const uint32_t * triangle = &result[adjacency[t] * 3];
+                    touched[remap[triangle[0]]] = touched[remap[triangle[1]]] = touched[remap[triangle[2]]] = true;
+                }
+                collapseTarget[wedgeTarget.first] = wedgeTarget.second;
+            }
+
+            quadrics[toPosition].Add(quadrics[fromPosition]);
+            worstError = std::max(worstError, collapse.error);
+            trianglesCount -= removedTriangles;
+            collapsesCount++;
+        }
+
+        if (!collapsesCount)
+            break;
+
+        size_t writeOffset = 0;
+        for (size_t i = 0; i < result.size(); i += 3)
+        {
+            uint32_t a = collapseTarget[result[i + 0]];
+            uint32_t b = collapseTarget[result[i + 1]];
+            uint32_t c = collapseTarget[result[i + 2]];
+            if (a == b || b == c || a == c)
+                continue;
+
+            result[writeOffset++] = a;
+            result[writeOffset++] = b;
+            result[writeOffset++] = c;
+        }
+        result.resize(writeOffset);
+    }
+
+    if (resultError)
+        *resultError = (float)(std::sqrt(worstError) / radius);
+
+    return result;
+}
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "stdafx.h"
+
+// Quadric error metric based simplification of triangle lists.
+// Vertex position is expected to be stored as float3 at the beginning of every vertex.
+namespace MeshSimplifier
+{
+// Collapses edges in the order of quadric error until indices count drops to targetIndicesCount
+// or the error exceeds targetError. Errors are relative to the bounding sphere radius of the mesh, the error of
+// a collapse is the weighted mean distance from the new position to planes of the triangles merged into the vertex.
+// Vertices are never moved or created, so the result is valid for the same vertex buffer.
+// Vertices of the same position with different attributes (seams) are collapsed together, each of them to
+// the vertex it shares triangles with, so seams move without tearing. Vertices on mesh borders are locked.
+std::vector<uint32_t> Simplify(const std::vector<uint32_t>& indices,
+                               const std::vector<uint8_t>& vertexData,
+                               size_t stride,
+                               size_t targetIndicesCount,
+                               float targetError,
+                               float* resultError = nullptr);
+}
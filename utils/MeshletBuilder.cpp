@@ -0,0 +1,290 @@
+#include "stdafx.h"
+
+#include "MeshletBuilder.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace MeshletBuilder
+{
+namespace
+{
+struct float3
+{
+    float x, y, z;
+};
+
+float3 GetPosition(const std::vector<uint8_t>& vertexData, size_t stride, uint32_t index)
+{
+    float3 position;
+    std::memcpy(&position, vertexData.data() + index * stride, sizeof(float3));
+    return position;
+}
+
+float3 Subtract(const float3& a, const float3& b)
+{
+    return {a.x - b.x, a.y - b.y, a.z - b.z};
+}
+
+float Dot(const float3& a, const float3& b)
+{
+    return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+float3 Cross(const float3& a, const float3& b)
+{
+    return {a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x};
+}
+
+float Length(const float3& a)
+{
+    return std::sqrt(Dot(a, a));
+}
+
+void ComputeBoundingSphere(Meshlet& meshlet, const MeshletData& data, const std::vector<uint8_t>& vertexData, size_t stride)
+{
+    auto position = [&](uint32_t i) { return GetPosition(vertexData, stride, data.vertices[meshlet.vertexOffset + i]); };
+
+    // Ritter's sphere: start from the most distant pair of points and grow it to enclose the rest
+    float3 a = position(0);
+    float3 b = a;
+    float maxDistance = 0.0f;
+    for (uint32_t i = 0; i < meshlet.vertexCount; ++i)
+    {
+        float3 p = position(i);
+        float distance = Length(Subtract(p, a));
+        if (distance > maxDistance)
+        {
+            maxDistance = distance;
+            b = p;
+        }
+    }
+
+    float3 c = b;
+    maxDistance = 0.0f;
+    for (uint32_t i = 0; i < meshlet.vertexCount; ++i)
+    {
+        float3 p = position(i);
+        float distance = Length(Subtract(p, b));
+        if (distance > maxDistance)
+        {
+            maxDistance = distance;
+            c = p;
+        }
+    }
+
+    float3 center = {(b.x + c.x) * 0.5f, (b.y + c.y) * 0.5f, (b.z + c.z) * 0.5f};
+    float radius = maxDistance * 0.5f;
+    for (uint32_t i = 0; i < meshlet.vertexCount; ++i)
+    {
+        float3 p = position(i);
+        float distance = Length(Subtract(p, center));
+        if (distance > radius)
+        {
+            float newRadius = (radius + distance) * 0.5f;
+            float shift = (newRadius - radius) / distance;
+            center = {center.x + (p.x - center.x) * shift, center.y + (p.y - center.y) * shift, center.z + (p.z - center.z) * shift};
+            radius = newRadius;
+        }
+    }
+
+    meshlet.center = {center.x, center.y, center.z};
+    meshlet.radius = radius;
+}
+
+void ComputeNormalCone(Meshlet& meshlet, const MeshletData& data, const std::vector<uint8_t>& vertexData, size_t stride)
+{
+    // cones wider than this are almost never culled, don't waste time on them
+    constexpr float minConeDot = 0.1f;
+
+    std::vector<float3> normals;
+    normals.reserve(meshlet.triangleCount);
+
+    float3 axis = {0.0f, 0.0f, 0.0f};
+    for (uint32_t i = 0; i < meshlet.triangleCount; ++i)
+    {
+        const uint8_t * triangle = &data.triangles[(meshlet.triangleOffset + i) * 3];
+        float3 p0 = GetPosition(vertexData, stride, data.vertices[meshlet.vertexOffset + triangle[0]]);
+        float3 p1 = GetPosition(vertexData, stride, data.vertices[meshlet.vertexOffset + triangle[1]]);
+        float3 p2 = GetPosition(vertexData, stride, data.vertices[meshlet.vertexOffset + triangle[2]]);
+
+        // clockwise triangles are front facing, so this normal points outside
+        float3 normal = Cross(Subtract(p1, p0), Subtract(p2, p0));
+        float length = Length(normal);
+        if (length == 0.0f)
+            continue; // degenerated triangles are never rasterized
+
+        normal = {normal.x / length, normal.y / length, normal.z / length};
+        normals.push_back(normal);
+        axis = {axis.x + normal.x, axis.y + normal.y, axis.z + normal.z};
+    }
+
+    float axisLength = Length(axis);
+    if (normals.empty() || axisLength == 0.0f)
+        return;
+
+    axis = {axis.x / axisLength, axis.y / axisLength, axis.z / axisLength};
+
+    float minDot = 1.0f;
+    for (const float3& normal : normals)
+        minDot = std::min(minDot, Dot(normal, axis));
+
+    meshlet.coneAxis = {axis.x, axis.y, axis.z};
+    if (minDot > minConeDot)
+    {
+        // all normals are back facing when the view direction makes an angle less than 90 - coneAngle with the axis
+        meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+    }
+}
+}
+
+MeshletData Build(const std::vector<uint32_t>& indices,
+                  const std::vector<uint8_t>& vertexData,
+                  size_t stride,
+                  size_t maxVertices /*= DefaultMaxVertices*/,
+                  size_t maxTriangles /*= DefaultMaxTriangles*/)
+{
+    // local indices are stored as bytes
+    assert(maxVertices >= 3 && maxVertices <= 256);
+    assert(maxTriangles >= 1);
+
+    MeshletData data;
+    const size_t verticesCount = vertexData.size() / stride;
+    const size_t trianglesCount = indices.size() / 3;
+
+    data.triangles.reserve(trianglesCount * 3);
+    data.vertices.reserve(verticesCount);
+
+    // index of the vertex in the current meshlet or -1
+    std::vector<int32_t> localIndices(verticesCount, -1);
+    Meshlet current;
+
+    auto flush = [&]()
+    {
+        for (uint32_t i = 0; i < current.vertexCount; ++i)
+            localIndices[data.vertices[current.vertexOffset + i]] = -1;
+
+        ComputeBoundingSphere(current, data, vertexData, stride);
+        ComputeNormalCone(current, data, vertexData, stride);
+        data.meshlets.push_back(current);
+
+        current = {};
+        current.vertexOffset = (uint32_t)data.vertices.size();
+        current.triangleOffset = (uint32_t)(data.triangles.size() / 3);
+    };
+
+    for (size_t t = 0; t < trianglesCount; ++t)
+    {
+        const uint32_t * triangle = &indices[t * 3];
+        assert(triangle[0] < verticesCount && triangle[1] < verticesCount && triangle[2] < verticesCount);
+
+        size_t newVertices = (localIndices[triangle[0]] < 0 ? 1 : 0)
+                           + (localIndices[triangle[1]] < 0 && triangle[1] != triangle[0] ? 1 : 0)
+                           + (localIndices[triangle[2]] < 0 && triangle[2] != triangle[0] && triangle[2] != triangle[1] ? 1 : 0);
+
+        if (current.vertexCount + newVertices > maxVertices || current.triangleCount + 1 > maxTriangles)
+            flush();
+
+        for (size_t k = 0; k < 3; ++k)
+        {
+            int32_t& localIndex = localIndices[triangle[k]];
+            if (localIndex < 0)
+            {
+                localIndex = (int32_t)current.vertexCount++;
+                data.vertices.push_back(triangle[k]);
+            }
+
+            data.triangles.push_back((uint8_t)localIndex);
+        }
+
+        current.triangleCount++;
+    }
+
+    if (current.triangleCount)
+        flush();
+
+    return data;
+}
+
+MeshletStatistics ComputeStatistics(const MeshletData& data)
+{
+    MeshletStatistics statistics;
+    statistics.meshletsCount = data.meshlets.size();
+    if (data.meshlets.empty())
+        return statistics;
+
+    statistics.averageVertices = (float)data.vertices.size() / data.meshlets.size();
+    statistics.averageTriangles = (float)(data.triangles.size() / 3) / data.meshlets.size();
+    return statistics;
+}
+
+void ExtractFrustumPlanes(FXMMATRIX viewProjection, XMFLOAT4 planes[6])
+{
+    // clip = position * viewProjection, so columns of the matrix are needed
+    XMMATRIX columns = XMMatrixTranspose(viewProjection);
+
+    XMStoreFloat4(&planes[0], XMPlaneNormalize(XMVectorAdd(columns.r[3], columns.r[0])));        // left
+    XMStoreFloat4(&planes[1], XMPlaneNormalize(XMVectorSubtract(columns.r[3], columns.r[0])));   // right
+    XMStoreFloat4(&planes[2], XMPlaneNormalize(XMVectorAdd(columns.r[3], columns.r[1])));        // bottom
+    XMStoreFloat4(&planes[3], XMPlaneNormalize(XMVectorSubtract(columns.r[3], columns.r[1])));   // top
+    XMStoreFloat4(&planes[4], XMPlaneNormalize(columns.r[2]));                                   // near
+    XMStoreFloat4(&planes[5], XMPlaneNormalize(XMVectorSubtract(columns.r[3], columns.r[2])));   // far
+}
+
+size_t Cull(const MeshletData& data,
+            FXMMATRIX world,
+            const XMFLOAT4 frustumPlanes[6],
+            const XMFLOAT3& eyePosition,
+            bool coneCulling,
+            std::vector<std::pair<uint32_t, uint32_t>>& visibleRanges)
+{
+    float scaleX = XMVectorGetX(XMVector3Length(world.r[0]));
+    float scaleY = XMVectorGetX(XMVector3Length(world.r[1]));
+    float scaleZ = XMVectorGetX(XMVector3Length(world.r[2]));
+    float maxScale = std::max(scaleX, std::max(scaleY, scaleZ));
+    float minScale = std::min(scaleX, std::min(scaleY, scaleZ));
+
+    // non-uniform scale distorts normals, so the cone is not conservative anymore
+    coneCulling = coneCulling && (maxScale - minScale) <= maxScale * 1e-3f;
+
+    XMVECTOR planes[6];
+    for (size_t i = 0; i < 6; ++i)
+        planes[i] = XMLoadFloat4(&frustumPlanes[i]);
+
+    const XMVECTOR eye = XMLoadFloat3(&eyePosition);
+    const size_t firstRange = visibleRanges.size();
+    size_t visibleCount = 0;
+
+    for (const Meshlet& meshlet : data.meshlets)
+    {
+        const XMVECTOR center = XMVector3TransformCoord(XMLoadFloat3(&meshlet.center), world);
+        const float radius = meshlet.radius * maxScale;
+
+        bool visible = true;
+        for (size_t i = 0; i < 6 && visible; ++i)
+            visible = XMVectorGetX(XMPlaneDotCoord(planes[i], center)) >= -radius;
+
+        if (visible && coneCulling && meshlet.coneCutoff < 1.0f)
+        {
+            XMVECTOR axis = XMVector3Normalize(XMVector3TransformNormal(XMLoadFloat3(&meshlet.coneAxis), world));
+            XMVECTOR direction = XMVectorSubtract(center, eye);
+            float distance = XMVectorGetX(XMVector3Length(direction));
+            visible = XMVectorGetX(XMVector3Dot(direction, axis)) < meshlet.coneCutoff * distance + radius;
+        }
+
+        if (!visible)
+            continue;
+
+        visibleCount++;
+
+        const uint32_t firstIndex = meshlet.triangleOffset * 3;
+        const uint32_t indicesCount = meshlet.triangleCount * 3;
+        if (visibleRanges.size() > firstRange && visibleRanges.back().first + visibleRanges.back().second == firstIndex)
+            visibleRanges.back().second += indicesCount;
+        else
+            visibleRanges.emplace_back(firstIndex, indicesCount);
+    }
+
+    return visibleCount;
+}
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "stdafx.h"
+
+// Splits triangle lists into small clusters (meshlets) with culling data.
+// Meshlets are built in index buffer order, so every meshlet is also a contiguous
+// range of the source index buffer and can be drawn with a regular indexed draw call.
+// Vertex position is expected to be stored as float3 at the beginning of every vertex.
+namespace MeshletBuilder
+{
+constexpr size_t DefaultMaxVertices = 64;
+constexpr size_t DefaultMaxTriangles = 124;
+
+struct Meshlet
+{
+    uint32_t    vertexOffset = 0;       // offset in MeshletData::vertices
+    uint32_t    vertexCount = 0;
+    uint32_t    triangleOffset = 0;     // offset in MeshletData::triangles and first triangle in source index buffer
+    uint32_t    triangleCount = 0;
+
+    XMFLOAT3    center = {0.0f, 0.0f, 0.0f};
+    float       radius = 0.0f;
+
+    // all triangles are back facing when dot(center - eye, coneAxis) >= coneCutoff * length(center - eye) + radius
+    XMFLOAT3    coneAxis = {0.0f, 0.0f, 1.0f};
+    float       coneCutoff = 1.0f;      // 1.0 means that cone is degenerated and can't be used for culling
+};
+
+struct MeshletData
+{
+    std::vector<Meshlet>    meshlets;
+    std::vector<uint32_t>   vertices;   // source vertex indices used by meshlets
+    std::vector<uint8_t>    triangles;  // three meshlet-local vertex indices per triangle
+};
+
+struct MeshletStatistics
+{
+    size_t  meshletsCount = 0;
+    float   averageVertices = 0.0f;
+    float   averageTriangles = 0.0f;
+};
+
+MeshletData Build(const std::vector<uint32_t>& indices,
+                  const std::vector<uint8_t>& vertexData,
+                  size_t stride,
+                  size_t maxVertices = DefaultMaxVertices,
+                  size_t maxTriangles = DefaultMaxTriangles);
+
+MeshletStatistics ComputeStatistics(const MeshletData& data);
+
+// Frustum planes are extracted from view projection matrix, normals point inside of the frustum.
+void ExtractFrustumPlanes(FXMMATRIX viewProjection, XMFLOAT4 planes[6]);
+
+// Appends index ranges (first index, indices count) of visible meshlets to visibleRanges,
+// adjacent visible meshlets are merged into a single range. Returns count of visible meshlets.
+size_t Cull(const MeshletData& data,
+            FXMMATRIX world,
+            const XMFLOAT4 frustumPlanes[6],
+            const XMFLOAT3& eyePosition,
+            bool coneCulling,
+            std::vector<std::pair<uint32_t, uint32_t>>& visibleRanges);
+}
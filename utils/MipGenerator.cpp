@@ -0,0 +1,416 @@
+#include "stdafx.h"
+
+#include "MipGenerator.h"
+
+#include "ParallelFor.h"
+
+#include <DirectXPackedVector.h>
+
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX::PackedVector;
+
+namespace MipGenerator
+{
+namespace
+{
+constexpr float pi = 3.14159265f;
+
+// Kaiser window parameters, the same as most of texture tools use
+constexpr float kaiserWidth = 3.0f;
+constexpr float kaiserAlpha = 4.0f;
+
+float Sinc(float x)
+{
+    if (std::abs(x) < 1e-6f)
+        return 1.0f;
+
+    x *= pi;
+    return std::sin(x) / x;
+}
+
+// modified Bessel function of the first kind, order 0
+float BesselI0(float x)
+{
+    float sum = 1.0f;
+    float term = 1.0f;
+    for (int k = 1; k < 50 && term > sum * 1e-8f; ++k)
+    {
+        float t = x / (2.0f * k);
+        term *= t * t;
+        sum += term;
+    }
+    return sum;
+}
+
+float BoxWeight(float x)
+{
+    return (x >= -0.5f && x < 0.5f) ? 1.0f : 0.0f;
+}
+
+float KaiserWeight(float x)
+{
+    if (std::abs(x) >= kaiserWidth)
+        return 0.0f;
+
+    float t = x / kaiserWidth;
+    return Sinc(x) * BesselI0(kaiserAlpha * std::sqrt(1.0f - t * t)) / BesselI0(kaiserAlpha);
+}
+
+float LanczosWeight(float x)
+{
+    return std::abs(x) < 3.0f ? Sinc(x) * Sinc(x / 3.0f) : 0.0f;
+}
+
+struct Kernel
+{
+    float radius;
+    float (*weight)(float);
+};
+
+Kernel GetKernel(Filter filter)
+{
+    switch (filter)
+    {
+    case Filter::Box:
+        return {0.5f, BoxWeight};
+    case Filter::Kaiser:
+        return {kaiserWidth, KaiserWeight};
+    case Filter::Lanczos:
+        return {3.0f, LanczosWeight};
+    }
+
+    throw std::runtime_error("Unknown mip filter");
+}
+
+// Source texels and weights for every destination texel along one axis, edges are clamped
+struct Axis
+{
+    size_t              srcSize = 0;
+    size_t              dstSize = 0;
+    size_t              tapsCount = 0;
+    std::vector<size_t> indices;
+    std::vector<float>  weights;
+};
+
+Axis BuildAxis(size_t srcSize, size_t dstSize, const Kernel& kernel)
+{
+    Axis axis;
+    axis.srcSize = srcSize;
+    axis.dstSize = dstSize;
+
+    if (srcSize == dstSize)
+    {
+        axis.tapsCount = 1;
+        for (size_t i = 0; i < dstSize; ++i)
+        {
+            axis.indices.push_back(i);
+            axis.weights.push_back(1.0f);
+        }
+        return axis;
+    }
+
+    // kernel is stretched by the scale to filter out frequencies the destination can't keep
+    const float scale = (float)srcSize / dstSize;
+    const float support = kernel.radius * scale;
+    axis.tapsCount = (size_t)std::ceil(support * 2.0f) + 1;
+    axis.indices.resize(dstSize * axis.tapsCount);
+    axis.weights.resize(dstSize * axis.tapsCount);
+
+    for (size_t i = 0; i < dstSize; ++i)
+    {
+        const float center = (i + 0.5f) * scale;
+        const ptrdiff_t first = (ptrdiff_t)std::floor(center - support);
+
+        float sum = 0.0f;
+        for (size_t k = 0; k < axis.tapsCount; ++k)
+        {
+            ptrdiff_t j = first + (ptrdiff_t)k;
+            float weight = kernel.weight((j + 0.5f - center) / scale);
+            axis.indices[i * axis.tapsCount + k] = (size_t)std::clamp<ptrdiff_t>(j, 0, (ptrdiff_t)srcSize - 1);
+            axis.weights[i * axis.tapsCount + k] = weight;
+            sum += weight;
+        }
+
+        for (size_t k = 0; k < axis.tapsCount; ++k)
+            axis.weights[i * axis.tapsCount + k] = sum != 0.0f ? axis.weights[i * axis.tapsCount + k] / sum : 1.0f / axis.tapsCount;
+    }
+
+    return axis;
+}
+
+// Texel (outer, a, inner) is stored at (outer * axisSize + a) * innerCount + inner, so the same
+// function filters rows, columns and layers. Only destination texels [begin; end) of the axis are written.
+void ResampleAxis(const XMFLOAT4* src, XMFLOAT4* dst, const Axis& axis, size_t outerCount, size_t innerCount, size_t begin, size_t end)
+{
+    for (size_t outer = 0; outer < outerCount; ++outer)
+    {
+        const XMFLOAT4* srcLine = src + outer * axis.srcSize * innerCount;
+        XMFLOAT4* dstLine = dst + outer * axis.dstSize * innerCount;
+
+        for (size_t i = begin; i < end; ++i)
+        {
+            const size_t * indices = &axis.indices[i * axis.tapsCount];
+            const float * weights = &axis.weights[i * axis.tapsCount];
+
+            for (size_t inner = 0; inner < innerCount; ++inner)
+            {
+                XMVECTOR sum = XMVectorZero();
+                for (size_t k = 0; k < axis.tapsCount; ++k)
+                    sum = XMVectorMultiplyAdd(XMLoadFloat4(&srcLine[indices[k] * innerCount + inner]), XMVectorReplicate(weights[k]), sum);
+
+                XMStoreFloat4(&dstLine[i * innerCount + inner], sum);
+            }
+        }
+    }
+}
+
+// one layer, x and then y
+void Resample2D(const XMFLOAT4* src, XMFLOAT4* dst, const Axis& axisX, const Axis& axisY, std::vector<XMFLOAT4>& scratch)
+{
+    scratch.resize(axisX.dstSize * axisY.srcSize);
+    ResampleAxis(src, scratch.data(), axisX, axisY.srcSize, 1, 0, axisX.dstSize);
+    ResampleAxis(scratch.data(), dst, axisY, 1, axisX.dstSize, 0, axisY.dstSize);
+}
+
+size_t GetTexelSize(DXGI_FORMAT format)
+{
+    switch (format)
+    {
+    case DXGI_FORMAT_R8G8B8A8_UNORM:
+    case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+    case DXGI_FORMAT_B8G8R8A8_UNORM:
+    case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+        return 4;
+    case DXGI_FORMAT_R16G16B16A16_FLOAT:
+        return 8;
+    case DXGI_FORMAT_R32G32B32A32_FLOAT:
+        return 16;
+    default:
+        throw std::runtime_error("Unsupported format for mip generation");
+    }
+}
+
+bool IsSRGB(DXGI_FORMAT format)
+{
+    return format == DXGI_FORMAT_R8G8B8A8_UNORM_SRGB || format == DXGI_FORMAT_B8G8R8A8_UNORM_SRGB;
+}
+
+bool IsBGRA(DXGI_FORMAT format)
+{
+    return format == DXGI_FORMAT_B8G8R8A8_UNORM || format == DXGI_FORMAT_B8G8R8A8_UNORM_SRGB;
+}
+
+void DecodeRow(const uint8_t* row, size_t width, DXGI_FORMAT format, XMFLOAT4* texels)
+{
+    for (size_t x = 0; x < width; ++x)
+    {
+        XMVECTOR texel;
+        switch (format)
+        {
+        case DXGI_FORMAT_R16G16B16A16_FLOAT:
+            texel = XMLoadHalf4(reinterpret_cast<const XMHALF4*>(row) + x);
+            break;
+        case DXGI_FORMAT_R32G32B32A32_FLOAT:
+            texel = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(row) + x);
+            break;
+        default:
+            texel = XMLoadUByteN4(reinterpret_cast<const XMUBYTEN4*>(row) + x);
+            if (IsBGRA(format))
+                texel = XMVectorSwizzle<2, 1, 0, 3>(texel);
+            if (IsSRGB(format))
+                texel = XMColorSRGBToRGB(texel);
+            break;
+        }
+
+        XMStoreFloat4(&texels[x], texel);
+    }
+}
+
+void EncodeRow(const XMFLOAT4* texels, size_t width, DXGI_FORMAT format, uint8_t* row)
+{
+    const XMVECTOR byteScale = XMVectorReplicate(255.0f);
+    const XMVECTOR half = XMVectorReplicate(0.5f);
+
+    for (size_t x = 0; x < width; ++x)
+    {
+        XMVECTOR texel = XMLoadFloat4(&texels[x]);
+        switch (format)
+        {
+        case DXGI_FORMAT_R16G16B16A16_FLOAT:
+            XMStoreHalf4(reinterpret_cast<XMHALF4*>(row) + x, texel);
+            break;
+        case DXGI_FORMAT_R32G32B32A32_FLOAT:
+            XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(row) + x, texel);
+            break;
+        default:
+            // sharp filters overshoot, so values are clamped before encoding
+            texel = XMVectorSaturate(texel);
+            if (IsSRGB(format))
+                texel = XMColorRGBToSRGB(texel);
+            if (IsBGRA(format))
+                texel = XMVectorSwizzle<2, 1, 0, 3>(texel);
+            XMStoreUByte4(reinterpret_cast<XMUBYTE4*>(row) + x, XMVectorMultiplyAdd(texel, byteScale, half));
+            break;
+        }
+    }
+}
+
+size_t Align(size_t value, size_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+}
+
+size_t MipLevelsCount(const TextureDesc& desc)
+{
+    size_t maxSize = std::max(desc.width, desc.height);
+    if (desc.dimension == D3D12_RESOURCE_DIMENSION_TEXTURE3D)
+        maxSize = std::max(maxSize, desc.depthOrArraySize);
+
+    size_t levels = 1;
+    while (maxSize > 1)
+    {
+        maxSize >>= 1;
+        levels++;
+    }
+    return levels;
+}
+
+MipChain Generate(const TextureDesc& desc, const D3D12_SUBRESOURCE_DATA* topLevel, Filter filter, size_t mipLevels /*= 0*/)
+{
+    const bool volume = desc.dimension == D3D12_RESOURCE_DIMENSION_TEXTURE3D;
+    if (!volume && desc.dimension != D3D12_RESOURCE_DIMENSION_TEXTURE2D)
+        throw std::runtime_error("Only 2D and 3D textures are supported by mip generation");
+
+    if (desc.cube && (volume || desc.depthOrArraySize % 6 || desc.width != desc.height))
+        throw std::runtime_error("Cube texture has to be 2D array of square faces, multiple of 6");
+
+    if (!desc.width || !desc.height || !desc.depthOrArraySize)
+        throw std::runtime_error("Empty texture can't have mips");
+
+    const size_t texelSize = GetTexelSize(desc.format);
+    const size_t arraySize = volume ? 1 : desc.depthOrArraySize;
+    const size_t depth = volume ? desc.depthOrArraySize : 1;
+    const Kernel kernel = GetKernel(filter);
+
+    MipChain chain;
+    chain.mipLevels = mipLevels ? std::min(mipLevels, MipLevelsCount(desc)) : MipLevelsCount(desc);
+
+    auto mipSize = [](size_t size, size_t mip) { return std::max<size_t>(size >> mip, 1); };
+
+    // the same layout GetCopyableFootprints gives for the texture
+    std::vector<size_t> offsets;
+    size_t totalSize = 0;
+    for (size_t slice = 0; slice < arraySize; ++slice)
+    {
+        for (size_t mip = 0; mip < chain.mipLevels; ++mip)
+        {
+            const size_t rowPitch = Align(mipSize(desc.width, mip) * texelSize, D3D12_TEXTURE_DATA_PITCH_ALIGNMENT);
+            const size_t slicePitch = rowPitch * mipSize(desc.height, mip);
+
+            totalSize = Align(totalSize, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+            offsets.push_back(totalSize);
+            chain.subresources.push_back({nullptr, (LONG_PTR)rowPitch, (LONG_PTR)slicePitch});
+            totalSize += slicePitch * mipSize(depth, mip);
+        }
+    }
+
+    chain.data.resize(totalSize, 0x0);
+    for (size_t i = 0; i < chain.subresources.size(); ++i)
+        chain.subresources[i].pData = chain.data.data() + offsets[i];
+
+    auto copyTopLevel = [&](size_t slice, size_t layer, std::vector<XMFLOAT4>& texels)
+    {
+        const D3D12_SUBRESOURCE_DATA& source = topLevel[slice];
+        const D3D12_SUBRESOURCE_DATA& destination = chain.subresources[slice * chain.mipLevels];
+
+        for (size_t y = 0; y < desc.height; ++y)
+        {
+            const uint8_t * srcRow = static_cast<const uint8_t*>(source.pData) + layer * source.SlicePitch + y * source.RowPitch;
+            uint8_t * dstRow = (uint8_t*)destination.pData + layer * destination.SlicePitch + y * destination.RowPitch;
+
+            // the most detailed level is copied as is, decoding and encoding it again may change it
+            std::memcpy(dstRow, srcRow, desc.width * texelSize);
+            DecodeRow(srcRow, desc.width, desc.format, &texels[(layer * desc.height + y) * desc.width]);
+        }
+    };
+
+    auto encodeLayer = [&](size_t slice, size_t mip, size_t layer, const XMFLOAT4* texels)
+    {
+        const D3D12_SUBRESOURCE_DATA& destination = chain.subresources[slice * chain.mipLevels + mip];
+        const size_t width = mipSize(desc.width, mip);
+        for (size_t y = 0; y < mipSize(desc.height, mip); ++y)
+        {
+            uint8_t * dstRow = (uint8_t*)destination.pData + layer * destination.SlicePitch + y * destination.RowPitch;
+            EncodeRow(texels + y * width, width, desc.format, dstRow);
+        }
+    };
+
+    if (!volume)
+    {
+        // slices and cube faces are independent
+        Threading::ParallelFor(arraySize, 1, [&](size_t begin, size_t end)
+        {
+            std::vector<XMFLOAT4> current, next, scratch;
+            for (size_t slice = begin; slice < end; ++slice)
+            {
+                current.resize(desc.width * desc.height);
+                copyTopLevel(slice, 0, current);
+
+                for (size_t mip = 1; mip < chain.mipLevels; ++mip)
+                {
+                    Axis axisX = BuildAxis(mipSize(desc.width, mip - 1), mipSize(desc.width, mip), kernel);
+                    Axis axisY = BuildAxis(mipSize(desc.height, mip - 1), mipSize(desc.height, mip), kernel);
+
+                    next.resize(axisX.dstSize * axisY.dstSize);
+                    Resample2D(current.data(), next.data(), axisX, axisY, scratch);
+                    encodeLayer(slice, mip, 0, next.data());
+                    std::swap(current, next);
+                }
+            }
+        });
+    }
+    else
+    {
+        std::vector<XMFLOAT4> current(desc.width * desc.height * depth);
+        Threading::ParallelFor(depth, 1, [&](size_t begin, size_t end)
+        {
+            for (size_t layer = begin; layer < end; ++layer)
+                copyTopLevel(0, layer, current);
+        });
+
+        std::vector<XMFLOAT4> layers, next;
+        for (size_t mip = 1; mip < chain.mipLevels; ++mip)
+        {
+            Axis axisX = BuildAxis(mipSize(desc.width, mip - 1), mipSize(desc.width, mip), kernel);
+            Axis axisY = BuildAxis(mipSize(desc.height, mip - 1), mipSize(desc.height, mip), kernel);
+            Axis axisZ = BuildAxis(mipSize(depth, mip - 1), mipSize(depth, mip), kernel);
+            const size_t srcLayerSize = axisX.srcSize * axisY.srcSize;
+            const size_t dstLayerSize = axisX.dstSize * axisY.dstSize;
+
+            // every source layer is filtered in xy, then all layers are filtered along z
+            layers.resize(dstLayerSize * axisZ.srcSize);
+            Threading::ParallelFor(axisZ.srcSize, 1, [&](size_t begin, size_t end)
+            {
+                std::vector<XMFLOAT4> scratch;
+                for (size_t layer = begin; layer < end; ++layer)
+                    Resample2D(&current[layer * srcLayerSize], &layers[layer * dstLayerSize], axisX, axisY, scratch);
+            });
+
+            next.resize(dstLayerSize * axisZ.dstSize);
+            Threading::ParallelFor(axisZ.dstSize, 1, [&](size_t begin, size_t end)
+            {
+                ResampleAxis(layers.data(), next.data(), axisZ, 1, dstLayerSize, begin, end);
+                for (size_t layer = begin; layer < end; ++layer)
+                    encodeLayer(0, mip, layer, &next[layer * dstLayerSize]);
+            });
+
+            std::swap(current, next);
+        }
+    }
+
+    return chain;
+}
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "stdafx.h"
+
+// CPU mip chain generation for 2D, array, cube and 3D textures.
+// Texels are filtered in linear space as float4 vectors, sRGB formats are decoded before and encoded after filtering.
+namespace MipGenerator
+{
+enum class Filter
+{
+    Box,        // average of 2x2 (2x2x2) texels for even sizes, the cheapest one
+    Kaiser,     // Kaiser windowed sinc, sharp without visible ringing
+    Lanczos     // Lanczos3, the sharpest one, may ring on hard edges
+};
+
+struct TextureDesc
+{
+    D3D12_RESOURCE_DIMENSION    dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;   // TEXTURE2D for arrays and cubes too
+    DXGI_FORMAT                 format = DXGI_FORMAT_R8G8B8A8_UNORM;
+    size_t                      width = 1;
+    size_t                      height = 1;
+    size_t                      depthOrArraySize = 1;                             // multiple of 6 for cubes
+    bool                        cube = false;                                     // faces are filtered independently
+};
+
+struct MipChain
+{
+    std::vector<uint8_t>                    data;
+    // D3D12CalcSubresource order, rows are aligned to D3D12_TEXTURE_DATA_PITCH_ALIGNMENT and subresources are
+    // aligned to D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT, so data matches copyable footprints of the texture
+    std::vector<D3D12_SUBRESOURCE_DATA>     subresources;
+    size_t                                  mipLevels = 0;
+};
+
+// Full chain down to 1x1(x1).
+size_t MipLevelsCount(const TextureDesc& desc);
+
+// Supported formats: R8G8B8A8_UNORM(_SRGB), B8G8R8A8_UNORM(_SRGB), R16G16B16A16_FLOAT, R32G32B32A32_FLOAT.
+// topLevel contains the most detailed mip of every array slice (one subresource for 3D textures).
+// mipLevels == 0 means the full chain. Slices are processed in parallel.
+MipChain Generate(const TextureDesc& desc, const D3D12_SUBRESOURCE_DATA* topLevel, Filter filter, size_t mipLevels = 0);
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "stdafx.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+namespace Threading
+{
+// Fixed set of slots published in any order by any threads and consumed in slot order by one thread.
+// Every slot has own ready flag, so publishing doesn't lock and doesn't wait for previous slots, the consumer
+// takes the longest prefix of published slots. Reset() is called by the consumer while no producers run.
+template<typename T>
+class OrderedQueue
+{
+public:
+    void Reset(size_t size)
+    {
+        if (size != _size)
+        {
+            _items = std::make_unique<T[]>(size);
+            _ready = std::make_unique<std::atomic_bool[]>(size);
+            _size = size;
+        }
+
+        for (size_t i = 0; i < _size; ++i)
+            _ready[i].store(false, std::memory_order_relaxed);
+        _prefix = 0;
+    }
+
+    // every slot is published once between resets
+    void Publish(size_t index, T item)
+    {
+        assert(index < _size);
+        assert(!_ready[index].load(std::memory_order_relaxed));
+        _items[index] = std::move(item);
+        _ready[index].store(true, std::memory_order_release);
+    }
+
+    // consumer only: count of slots from the first one which are published
+    size_t GetPrefix()
+    {
+        while (_prefix < _size && _ready[_prefix].load(std::memory_order_acquire))
+            ++_prefix;
+        return _prefix;
+    }
+
+    // consumer only: spins until the prefix has at least count slots, returns the prefix
+    size_t WaitPrefix(size_t count)
+    {
+        count = std::min(count, _size);
+        while (GetPrefix() < count)
+            std::this_thread::yield();
+        return _prefix;
+    }
+
+    // consumer only, slots of the prefix
+    const T& operator[](size_t index) const
+    {
+        assert(index < _prefix);
+        return _items[index];
+    }
+
+    size_t Size() const
+    {
+        return _size;
+    }
+
+private:
+    std::unique_ptr<T[]>                _items = nullptr;
+    std::unique_ptr<std::atomic_bool[]> _ready = nullptr;
+    size_t                              _size = 0;
+    size_t                              _prefix = 0;    // published slots seen by the consumer
+};
+}
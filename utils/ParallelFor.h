@@ -0,0 +1,43 @@
+#pragma once
+
+#include "stdafx.h"
+
+#include <algorithm>
+#include <atomic>
+
+namespace Threading
+{
+// Splits [0; count) into chunks and runs func(begin, end) for them on all hardware threads.
+// The calling thread takes part in the work, the function returns when all chunks are processed.
+template<typename Func>
+void ParallelFor(size_t count, size_t chunkSize, const Func& func)
+{
+    if (!count)
+        return;
+
+    chunkSize = std::max<size_t>(chunkSize, 1);
+    const size_t chunksCount = (count + chunkSize - 1) / chunkSize;
+
+    size_t threadsCount = std::thread::hardware_concurrency();
+    if (threadsCount == 0) // unable to detect
+        threadsCount = 8;
+    threadsCount = std::min(threadsCount, chunksCount);
+
+    std::atomic_size_t nextChunk = 0;
+    auto worker = [&]()
+    {
+        for (size_t chunk = nextChunk++; chunk < chunksCount; chunk = nextChunk++)
+            func(chunk * chunkSize, std::min(count, (chunk + 1) * chunkSize));
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(threadsCount - 1);
+    for (size_t i = 1; i < threadsCount; ++i)
+        threads.emplace_back(worker);
+
+    worker();
+
+    for (auto & thread : threads)
+        thread.join();
+}
+}
@@ -0,0 +1,137 @@
+#include "stdafx.h"
+
+#include "PipelineStateHash.h"
+
+#include "MeshFile.h"
+
+namespace
+{
+template<typename T>
+uint64_t HashValue(const T& value, uint64_t seed)
+{
+    return MeshFile::Hash(&value, sizeof(value), seed);
+}
+
+uint64_t HashString(const char* value, uint64_t seed)
+{
+    const uint64_t size = value ? strlen(value) : 0;
+    return MeshFile::Hash(value, (size_t)size, HashValue(size, seed));
+}
+
+uint64_t HashBytecode(const D3D12_SHADER_BYTECODE& bytecode, uint64_t seed)
+{
+    const uint64_t size = bytecode.pShaderBytecode ? bytecode.BytecodeLength : 0;
+    return MeshFile::Hash(bytecode.pShaderBytecode, (size_t)size, HashValue(size, seed));
+}
+
+// blend and depth stencil descriptions have padding, so they are hashed field by field
+uint64_t HashBlendState(const D3D12_BLEND_DESC& desc, uint64_t seed)
+{
+    seed = HashValue(desc.AlphaToCoverageEnable, seed);
+    seed = HashValue(desc.IndependentBlendEnable, seed);
+
+    // other targets are ignored without independent blending
+    const size_t targetsCount = desc.IndependentBlendEnable ? std::size(desc.RenderTarget) : 1;
+    for (size_t i = 0; i < targetsCount; ++i)
+    {
+        const D3D12_RENDER_TARGET_BLEND_DESC& target = desc.RenderTarget[i];
+        seed = HashValue(target.BlendEnable, seed);
+        seed = HashValue(target.LogicOpEnable, seed);
+        seed = HashValue(target.SrcBlend, seed);
+        seed = HashValue(target.DestBlend, seed);
+        seed = HashValue(target.BlendOp, seed);
+        seed = HashValue(target.SrcBlendAlpha, seed);
+        seed = HashValue(target.DestBlendAlpha, seed);
+        seed = HashValue(target.BlendOpAlpha, seed);
+        seed = HashValue(target.LogicOp, seed);
+        seed = HashValue(target.RenderTargetWriteMask, seed);
+    }
+    return seed;
+}
+
+uint64_t HashDepthStencilState(const D3D12_DEPTH_STENCIL_DESC& desc, uint64_t seed)
+{
+    seed = HashValue(desc.DepthEnable, seed);
+    seed = HashValue(desc.DepthWriteMask, seed);
+    seed = HashValue(desc.DepthFunc, seed);
+    seed = HashValue(desc.StencilEnable, seed);
+    seed = HashValue(desc.StencilReadMask, seed);
+    seed = HashValue(desc.StencilWriteMask, seed);
+    seed = HashValue(desc.FrontFace, seed);
+    return HashValue(desc.BackFace, seed);
+}
+
+uint64_t HashInputLayout(const D3D12_INPUT_LAYOUT_DESC& desc, uint64_t seed)
+{
+    const uint32_t elementsCount = desc.pInputElementDescs ? desc.NumElements : 0;
+    seed = HashValue(elementsCount, seed);
+    for (uint32_t i = 0; i < elementsCount; ++i)
+    {
+        const D3D12_INPUT_ELEMENT_DESC& element = desc.pInputElementDescs[i];
+        seed = HashString(element.SemanticName, seed);
+        seed = HashValue(element.SemanticIndex, seed);
+        seed = HashValue(element.Format, seed);
+        seed = HashValue(element.InputSlot, seed);
+        seed = HashValue(element.AlignedByteOffset, seed);
+        seed = HashValue(element.InputSlotClass, seed);
+        seed = HashValue(element.InstanceDataStepRate, seed);
+    }
+    return seed;
+}
+
+uint64_t HashStreamOutput(const D3D12_STREAM_OUTPUT_DESC& desc, uint64_t seed)
+{
+    const uint32_t entriesCount = desc.pSODeclaration ? desc.NumEntries : 0;
+    seed = HashValue(entriesCount, seed);
+    for (uint32_t i = 0; i < entriesCount; ++i)
+    {
+        const D3D12_SO_DECLARATION_ENTRY& entry = desc.pSODeclaration[i];
+        seed = HashValue(entry.Stream, seed);
+        seed = HashString(entry.SemanticName, seed);
+        seed = HashValue(entry.SemanticIndex, seed);
+        seed = HashValue(entry.StartComponent, seed);
+        seed = HashValue(entry.ComponentCount, seed);
+        seed = HashValue(entry.OutputSlot, seed);
+    }
+
+    const uint32_t stridesCount = desc.pBufferStrides ? desc.NumStrides : 0;
+    seed = HashValue(stridesCount, seed);
+    seed = MeshFile::Hash(desc.pBufferStrides, stridesCount * sizeof(UINT), seed);
+    return HashValue(desc.RasterizedStream, seed);
+}
+}
+
+uint64_t HashPipelineState(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc, uint64_t rootSignatureHash)
+{
+    uint64_t hash = MeshFile::Hash(&rootSignatureHash, sizeof(rootSignatureHash));
+    hash = HashBytecode(desc.VS, hash);
+    hash = HashBytecode(desc.PS, hash);
+    hash = HashBytecode(desc.DS, hash);
+    hash = HashBytecode(desc.HS, hash);
+    hash = HashBytecode(desc.GS, hash);
+    hash = HashStreamOutput(desc.StreamOutput, hash);
+    hash = HashBlendState(desc.BlendState, hash);
+    hash = HashValue(desc.SampleMask, hash);
+    hash = HashValue(desc.RasterizerState, hash);
+    hash = HashDepthStencilState(desc.DepthStencilState, hash);
+    hash = HashInputLayout(desc.InputLayout, hash);
+    hash = HashValue(desc.IBStripCutValue, hash);
+    hash = HashValue(desc.PrimitiveTopologyType, hash);
+    hash = HashValue(desc.NumRenderTargets, hash);
+    hash = MeshFile::Hash(desc.RTVFormats, std::min<size_t>(desc.NumRenderTargets, std::size(desc.RTVFormats)) * sizeof(DXGI_FORMAT), hash);
+    hash = HashValue(desc.DSVFormat, hash);
+    hash = HashValue(desc.SampleDesc, hash);
+    hash = HashValue(desc.NodeMask, hash);
+    return HashValue(desc.Flags, hash);
+}
+
+uint64_t HashPipelineState(const D3D12_COMPUTE_PIPELINE_STATE_DESC& desc, uint64_t rootSignatureHash)
+{
+    // compute pipelines are stored in the same library, so they are never equal to graphics ones
+    const char type[] = "compute";
+    uint64_t hash = MeshFile::Hash(type, sizeof(type));
+    hash = HashValue(rootSignatureHash, hash);
+    hash = HashBytecode(desc.CS, hash);
+    hash = HashValue(desc.NodeMask, hash);
+    return HashValue(desc.Flags, hash);
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+#include "stdafx.h"
+
+// Hashes of pipeline descriptions, which are the same between runs: shaders are hashed by their bytecode,
+// root signatures by their serialized blobs (RootSignature::Hash), pointers and cached blobs are ignored.
+// Descriptions are only read, so keys are computed without a device.
+uint64_t HashPipelineState(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc, uint64_t rootSignatureHash);
+uint64_t HashPipelineState(const D3D12_COMPUTE_PIPELINE_STATE_DESC& desc, uint64_t rootSignatureHash);
@@ -0,0 +1,160 @@
+#include "stdafx.h"
+
+#include "PipelineStateManager.h"
+
+using namespace std::chrono;
+
+namespace
+{
+std::wstring GetPipelineName(uint64_t key)
+{
+    std::wostringstream name;
+    name << std::hex << key;
+    return name.str();
+}
+}
+
+PipelineStateManager::PipelineStateManager(ComPtr<ID3D12Device> pDevice, const std::string& libraryFileName)
+    : _device(pDevice)
+    , _libraryFileName(libraryFileName)
+{
+    ComPtr<ID3D12Device1> device1;
+    if (FAILED(_device.As(&device1)))
+        return;
+
+    std::ifstream file {libraryFileName, std::ios::binary | std::ios::ate};
+    if (file)
+    {
+        _libraryData.resize((size_t)file.tellg());
+        file.seekg(0);
+        file.read((char*)_libraryData.data(), _libraryData.size());
+        if (!file)
+            _libraryData.clear();
+    }
+
+    // a library from another driver or adapter is refused, it's rebuilt from scratch then
+    if (_libraryData.empty() || FAILED(device1->CreatePipelineLibrary(_libraryData.data(), _libraryData.size(), IID_PPV_ARGS(&_library))))
+    {
+        _libraryData.clear();
+        _library = nullptr;
+        if (FAILED(device1->CreatePipelineLibrary(nullptr, 0, IID_PPV_ARGS(&_library))))
+            _library = nullptr;
+    }
+}
+
+PipelineStateManager::~PipelineStateManager()
+{
+    // pipelines created by waiting threads after the last background one aren't saved yet
+    Save();
+}
+
+PipelineStateFuture PipelineStateManager::Create(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc,
+                                                 uint64_t rootSignatureHash,
+                                                 const std::vector<ComPtr<ID3DBlob>>& shaders,
+                                                 bool background /*= false*/)
+{
+    ComPtr<ID3D12RootSignature> rootSignature = desc.pRootSignature;
+    ComPtr<ID3D12Device> device = _device;
+
+    auto load = [desc, rootSignature, shaders](ID3D12PipelineLibrary* library, LPCWSTR name, ComPtr<ID3D12PipelineState>& pso)
+    {
+        return library->LoadGraphicsPipeline(name, &desc, IID_PPV_ARGS(&pso));
+    };
+    auto create = [desc, rootSignature, shaders, device](ComPtr<ID3D12PipelineState>& pso)
+    {
+        return device->CreateGraphicsPipelineState(&desc, IID_PPV_ARGS(&pso));
+    };
+
+    return Request(HashPipelineState(desc, rootSignatureHash), background, load, create);
+}
+
+PipelineStateFuture PipelineStateManager::Create(const D3D12_COMPUTE_PIPELINE_STATE_DESC& desc,
+                                                 uint64_t rootSignatureHash,
+                                                 const std::vector<ComPtr<ID3DBlob>>& shaders,
+                                                 bool background /*= false*/)
+{
+    ComPtr<ID3D12RootSignature> rootSignature = desc.pRootSignature;
+    ComPtr<ID3D12Device> device = _device;
+
+    auto load = [desc, rootSignature, shaders](ID3D12PipelineLibrary* library, LPCWSTR name, ComPtr<ID3D12PipelineState>& pso)
+    {
+        return library->LoadComputePipeline(name, &desc, IID_PPV_ARGS(&pso));
+    };
+    auto create = [desc, rootSignature, shaders, device](ComPtr<ID3D12PipelineState>& pso)
+    {
+        return device->CreateComputePipelineState(&desc, IID_PPV_ARGS(&pso));
+    };
+
+    return Request(HashPipelineState(desc, rootSignatureHash), background, load, create);
+}
+
+PipelineStateStatistics PipelineStateManager::Statistics()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    PipelineStateStatistics statistics = _statistics;
+    statistics.pending = _pipelines.PendingCount();
+    return statistics;
+}
+
+void PipelineStateManager::Save()
+{
+    _pipelines.WaitAll();
+    SaveLibrary();
+}
+
+PipelineStateFuture PipelineStateManager::Request(uint64_t key, bool background, LoadFunc load, CreateFunc create)
+{
+    bool deduplicated = false;
+    PipelineStateFuture pipeline = _pipelines.Request(key, background, [this, key, load, create]() { return LoadOrCreate(key, load, create); }, deduplicated);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _statistics.requests++;
+    if (deduplicated)
+        _statistics.deduplicated++;
+    return pipeline;
+}
+
+ComPtr<ID3D12PipelineState> PipelineStateManager::LoadOrCreate(uint64_t key, const LoadFunc& load, const CreateFunc& create)
+{
+    const std::wstring name = GetPipelineName(key);
+    ComPtr<ID3D12PipelineState> pso;
+
+    // loading and storing aren't synchronized by the library itself
+    if (_library)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (SUCCEEDED(load(_library.Get(), name.c_str(), pso)))
+        {
+            _statistics.loadedFromLibrary++;
+            return pso;
+        }
+    }
+
+    auto start = high_resolution_clock::now();
+    ThrowIfFailed(create(pso));
+    const double milliseconds = duration<double, std::milli>(high_resolution_clock::now() - start).count();
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _statistics.compiled++;
+    _statistics.compileMilliseconds += milliseconds;
+
+    if (_library && SUCCEEDED(_library->StorePipeline(name.c_str(), pso.Get())))
+        _libraryChanged = true;
+
+    return pso;
+}
+
+void PipelineStateManager::SaveLibrary()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (!_library || !_libraryChanged)
+        return;
+
+    std::vector<uint8_t> data(_library->GetSerializedSize());
+    if (FAILED(_library->Serialize(data.data(), data.size())))
+        return;
+
+    std::ofstream file {_libraryFileName, std::ios::binary};
+    file.write((const char*)data.data(), data.size());
+    _libraryChanged = !file;
+}
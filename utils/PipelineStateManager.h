@@ -0,0 +1,68 @@
+#pragma once
+
+#include "stdafx.h"
+
+#include "PipelineStateHash.h"
+#include "SharedFutureCache.h"
+
+struct PipelineStateStatistics
+{
+    size_t      requests = 0;
+    size_t      deduplicated = 0;           // got a pipeline requested before
+    size_t      loadedFromLibrary = 0;
+    size_t      compiled = 0;
+    size_t      pending = 0;                // background requests which aren't compiled yet
+    double      compileMilliseconds = 0.0;  // sum over all threads
+};
+
+using PipelineStateFuture = std::shared_future<ComPtr<ID3D12PipelineState>>;
+
+// Creates every pipeline once per process: requests with the same description hash share one future.
+// Pipelines are loaded from and stored to ID3D12PipelineLibrary, which is serialized to a file by the thread
+// finishing the last background request and in the destructor. Background requests are compiled on their own threads.
+class PipelineStateManager
+{
+public:
+    // the library is not used when the device doesn't support it or the file is written by another driver
+    PipelineStateManager(ComPtr<ID3D12Device> pDevice, const std::string& libraryFileName);
+    ~PipelineStateManager();
+
+    PipelineStateManager(const PipelineStateManager&) = delete;
+    PipelineStateManager& operator=(const PipelineStateManager&) = delete;
+
+    // shaders are kept alive until the pipeline is compiled, other pointers of the description have to
+    // outlive the manager
+    PipelineStateFuture Create(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc,
+                               uint64_t rootSignatureHash,
+                               const std::vector<ComPtr<ID3DBlob>>& shaders,
+                               bool background = false);
+    PipelineStateFuture Create(const D3D12_COMPUTE_PIPELINE_STATE_DESC& desc,
+                               uint64_t rootSignatureHash,
+                               const std::vector<ComPtr<ID3DBlob>>& shaders,
+                               bool background = false);
+
+    // doesn't wait for background requests, they are counted as pending
+    PipelineStateStatistics Statistics();
+
+    // waits for background requests and writes the library if new pipelines were stored
+    void Save();
+
+private:
+    using LoadFunc = std::function<HRESULT(ID3D12PipelineLibrary* library, LPCWSTR name, ComPtr<ID3D12PipelineState>& pso)>;
+    using CreateFunc = std::function<HRESULT(ComPtr<ID3D12PipelineState>& pso)>;
+
+    PipelineStateFuture Request(uint64_t key, bool background, LoadFunc load, CreateFunc create);
+    ComPtr<ID3D12PipelineState> LoadOrCreate(uint64_t key, const LoadFunc& load, const CreateFunc& create);
+    // writes pipelines stored so far, called by the last background request too, so it doesn't wait for them
+    void SaveLibrary();
+
+    ComPtr<ID3D12Device>                                    _device = nullptr;
+    ComPtr<ID3D12PipelineLibrary>                           _library = nullptr;
+    std::vector<uint8_t>                                    _libraryData;   // has to outlive the library
+    std::string                                             _libraryFileName;
+    bool                                                    _libraryChanged = false;
+
+    std::mutex                                              _mutex;
+    PipelineStateStatistics                                 _statistics;
+    SharedFutureCache<ComPtr<ID3D12PipelineState>>          _pipelines {[this]() { SaveLibrary(); }};
+};
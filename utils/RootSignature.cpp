@@ -2,6 +2,7 @@
 
 #include "RootSignature.h"
 
+
 void RootParameter::InitAsConstants(UINT valuesCount, UINT shaderRegister, D3D12_SHADER_VISIBILITY visibility /*= D3D12_SHADER_VISIBILITY_ALL*/)
 {
     _parameter.ParameterType = D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS;
@@ -45,7 +46,7 @@ void RootParameter::InitAsDescriptorsTable(UINT numRanges, D3D12_SHADER_VISIBILI
     _parameter.DescriptorTable.pDescriptorRanges = _ranges.get();
 }
 
-void RootParameter::InitTableRange(UINT rangeNumber, UINT baseRegister, UINT descriptorsCount, D3D12_DESCRIPTOR_RANGE_TYPE rangeType)
+void RootParameter::InitTableRange(UINT rangeNumber, UINT baseRegister, UINT descriptorsCount, D3D12_DESCRIPTOR_RANGE_TYPE rangeType, UINT registerSpace /*= 0*/)
 {
     if (!_ranges || _parameter.DescriptorTable.NumDescriptorRanges <= rangeNumber)
     {
@@ -57,7 +58,7 @@ void RootParameter::InitTableRange(UINT rangeNumber, UINT baseRegister, UINT des
     _ranges[rangeNumber].BaseShaderRegister = baseRegister;
     _ranges[rangeNumber].NumDescriptors = descriptorsCount;
     _ranges[rangeNumber].OffsetInDescriptorsFromTableStart = D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND;
-    _ranges[rangeNumber].RegisterSpace = 0;
+    _ranges[rangeNumber].RegisterSpace = registerSpace;
 }
 
 RootParameter::operator D3D12_ROOT_PARAMETER&()
@@ -130,20 +131,9 @@ const RootParameter& RootSignature::operator[] (size_t parameter) const
 
 void RootSignature::Finalize(ComPtr<ID3D12Device> pDevice, D3D12_ROOT_SIGNATURE_FLAGS flags /*= D3D12_ROOT_SIGNATURE_FLAG_NONE*/)
 {
-    // create more optimal way to do this
-    std::unique_ptr<D3D12_ROOT_PARAMETER[]> descParameters;
-    descParameters.reset(new D3D12_ROOT_PARAMETER[_description.NumParameters]);
-    for (UINT i = 0; i < _description.NumParameters; ++i)
-        descParameters[i] = _parameters[i];
-
-    std::unique_ptr<D3D12_STATIC_SAMPLER_DESC[]> descSamplers;
-    descSamplers.reset(new D3D12_STATIC_SAMPLER_DESC[_description.NumStaticSamplers]);
-    for (UINT i = 0; i < _description.NumStaticSamplers; ++i)
-        descSamplers[i] = _samplers[i];
-
-    _description.Flags = flags;
-    _description.pParameters = descParameters.get();
-    _description.pStaticSamplers = descSamplers.get();
+    std::vector<D3D12_ROOT_PARAMETER> descParameters;
+    std::vector<D3D12_STATIC_SAMPLER_DESC> descSamplers;
+    FillDescription(flags, descParameters, descSamplers);
 
     ComPtr<ID3DBlob> signatureBlob = nullptr;
     ComPtr<ID3DBlob> errorBlob = nullptr;
@@ -151,9 +141,37 @@ void RootSignature::Finalize(ComPtr<ID3D12Device> pDevice, D3D12_ROOT_SIGNATURE_
         MessageBoxA(NULL, (const char*)errorBlob->GetBufferPointer(), NULL, NULL);
 
     ThrowIfFailed(pDevice->CreateRootSignature(0, signatureBlob->GetBufferPointer(), signatureBlob->GetBufferSize(), IID_PPV_ARGS(&_signature)));
+    _hash = HashRootSignature(_description);
+}
+
+void RootSignature::Finalize(RootSignatureRegistry& registry, const std::string& name, D3D12_ROOT_SIGNATURE_FLAGS flags /*= D3D12_ROOT_SIGNATURE_FLAG_NONE*/)
+{
+    std::vector<D3D12_ROOT_PARAMETER> descParameters;
+    std::vector<D3D12_STATIC_SAMPLER_DESC> descSamplers;
+    FillDescription(flags, descParameters, descSamplers);
+
+    _signature = registry.Create(_description, name);
+    _hash = HashRootSignature(_description);
 }
 
 ComPtr<ID3D12RootSignature> RootSignature::GetInternal() const
 {
     return _signature;
 }
+
+uint64_t RootSignature::Hash() const
+{
+    return _hash;
+}
+
+void RootSignature::FillDescription(D3D12_ROOT_SIGNATURE_FLAGS flags,
+                                    std::vector<D3D12_ROOT_PARAMETER>& parameters,
+                                    std::vector<D3D12_STATIC_SAMPLER_DESC>& samplers)
+{
+    parameters.assign(_parameters.get(), _parameters.get() + _description.NumParameters);
+    samplers.assign(_samplers.get(), _samplers.get() + _description.NumStaticSamplers);
+
+    _description.Flags = flags;
+    _description.pParameters = parameters.data();
+    _description.pStaticSamplers = samplers.data();
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "stdafx.h"
+#include "RootSignatureRegistry.h"
 
 class RootParameter
 {
@@ -20,7 +21,8 @@ public:
 
     void InitAsDescriptorsTable(UINT numRanges, D3D12_SHADER_VISIBILITY visibility = D3D12_SHADER_VISIBILITY_ALL);
 
-    void InitTableRange(UINT rangeNumber, UINT baseRegister, UINT descriptorsCount, D3D12_DESCRIPTOR_RANGE_TYPE rangeType);
+    // UINT_MAX descriptors is an unbounded range
+    void InitTableRange(UINT rangeNumber, UINT baseRegister, UINT descriptorsCount, D3D12_DESCRIPTOR_RANGE_TYPE rangeType, UINT registerSpace = 0);
 
     operator D3D12_ROOT_PARAMETER&();
     operator const D3D12_ROOT_PARAMETER&() const;
@@ -68,10 +70,20 @@ public:
     void Init(UINT parametersCount, UINT staticSamplersCount);
     void InitStaticSampler(UINT staticSampler, const StaticSampler& samplerDesc);
     void Finalize(ComPtr<ID3D12Device> pDevice, D3D12_ROOT_SIGNATURE_FLAGS flags = D3D12_ROOT_SIGNATURE_FLAG_NONE);
+    void Finalize(RootSignatureRegistry& registry, const std::string& name, D3D12_ROOT_SIGNATURE_FLAGS flags = D3D12_ROOT_SIGNATURE_FLAG_NONE);
     ComPtr<ID3D12RootSignature> GetInternal() const;
 
+    // hash of the canonical description, the same between runs
+    uint64_t Hash() const;
+
 private:
+    // arrays have to live while the description is used
+    void FillDescription(D3D12_ROOT_SIGNATURE_FLAGS flags,
+                         std::vector<D3D12_ROOT_PARAMETER>& parameters,
+                         std::vector<D3D12_STATIC_SAMPLER_DESC>& samplers);
+
     ComPtr<ID3D12RootSignature> _signature = nullptr;
+    uint64_t _hash = 0;
     std::unique_ptr<RootParameter[]> _parameters = nullptr;
     std::unique_ptr<StaticSampler[]> _samplers = nullptr;
     D3D12_ROOT_SIGNATURE_DESC _description = {};
@@ -0,0 +1,209 @@
+#include "stdafx.h"
+
+#include "RootSignatureRegistry.h"
+
+#include "MeshFile.h"
+
+#include <filesystem>
+#include <iomanip>
+
+using namespace std::chrono;
+
+namespace
+{
+template<typename T>
+uint64_t HashValue(const T& value, uint64_t seed)
+{
+    return MeshFile::Hash(&value, sizeof(value), seed);
+}
+
+uint32_t GetParameterCost(const D3D12_ROOT_PARAMETER& parameter)
+{
+    switch (parameter.ParameterType)
+    {
+    case D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE:
+        return 1;
+    case D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS:
+        return parameter.Constants.Num32BitValues;
+    default:
+        // GPU virtual address
+        return 2;
+    }
+}
+
+const char* GetParameterName(const D3D12_ROOT_PARAMETER& parameter)
+{
+    switch (parameter.ParameterType)
+    {
+    case D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE:
+        return "table";
+    case D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS:
+        return "constants";
+    case D3D12_ROOT_PARAMETER_TYPE_CBV:
+        return "CBV";
+    case D3D12_ROOT_PARAMETER_TYPE_SRV:
+        return "SRV";
+    default:
+        return "UAV";
+    }
+}
+
+std::vector<char> LoadBlob(const std::string& fileName)
+{
+    std::ifstream file {fileName, std::ios::binary | std::ios::ate};
+    if (!file)
+        return {};
+
+    std::vector<char> blob((size_t)file.tellg());
+    file.seekg(0);
+    file.read(blob.data(), blob.size());
+
+    // serialized signatures are DXBC containers
+    if (!file || blob.size() < 4 || memcmp(blob.data(), "DXBC", 4) != 0)
+        return {};
+
+    return blob;
+}
+
+void SaveBlob(const std::string& fileName, ID3DBlob* blob)
+{
+    std::error_code error;
+    std::filesystem::create_directories(std::filesystem::path(fileName).parent_path(), error);
+
+    // the file appears only when it's complete
+    const std::string tempFileName = fileName + ".tmp";
+    {
+        std::ofstream file {tempFileName, std::ios::binary};
+        file.write(static_cast<const char*>(blob->GetBufferPointer()), blob->GetBufferSize());
+        if (!file)
+            return;
+    }
+
+    std::filesystem::rename(tempFileName, fileName, error);
+    if (error)
+        std::filesystem::remove(tempFileName, error);
+}
+}
+
+uint64_t HashRootSignature(const D3D12_ROOT_SIGNATURE_DESC& desc)
+{
+    uint64_t hash = MeshFile::Hash(&desc.Flags, sizeof(desc.Flags));
+    hash = HashValue(desc.NumParameters, hash);
+    for (UINT i = 0; i < desc.NumParameters; ++i)
+    {
+        const D3D12_ROOT_PARAMETER& parameter = desc.pParameters[i];
+        hash = HashValue(parameter.ParameterType, hash);
+        hash = HashValue(parameter.ShaderVisibility, hash);
+
+        switch (parameter.ParameterType)
+        {
+        case D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE:
+            hash = HashValue(parameter.DescriptorTable.NumDescriptorRanges, hash);
+            hash = MeshFile::Hash(parameter.DescriptorTable.pDescriptorRanges,
+                                  parameter.DescriptorTable.NumDescriptorRanges * sizeof(D3D12_DESCRIPTOR_RANGE),
+                                  hash);
+            break;
+        case D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS:
+            hash = HashValue(parameter.Constants, hash);
+            break;
+        default:
+            hash = HashValue(parameter.Descriptor, hash);
+            break;
+        }
+    }
+
+    hash = HashValue(desc.NumStaticSamplers, hash);
+    return MeshFile::Hash(desc.pStaticSamplers, desc.NumStaticSamplers * sizeof(D3D12_STATIC_SAMPLER_DESC), hash);
+}
+
+uint32_t GetRootSignatureCost(const D3D12_ROOT_SIGNATURE_DESC& desc)
+{
+    uint32_t cost = 0;
+    for (UINT i = 0; i < desc.NumParameters; ++i)
+        cost += GetParameterCost(desc.pParameters[i]);
+    return cost;
+}
+
+RootSignatureRegistry::RootSignatureRegistry(ComPtr<ID3D12Device> pDevice, const std::string& directory)
+    : _device(pDevice)
+    , _directory(directory)
+{
+}
+
+ComPtr<ID3D12RootSignature> RootSignatureRegistry::Create(const D3D12_ROOT_SIGNATURE_DESC& desc, const std::string& name)
+{
+    auto start = high_resolution_clock::now();
+    _statistics.requests++;
+
+    Entry entry {name, HashRootSignature(desc), GetRootSignatureCost(desc)};
+    for (UINT i = 0; i < desc.NumParameters; ++i)
+        entry.parameters += (i ? " + " : "") + std::to_string(GetParameterCost(desc.pParameters[i])) + " " + GetParameterName(desc.pParameters[i]);
+
+    auto iter = _signatures.find(entry.hash);
+    if (iter != _signatures.end())
+    {
+        for (const Entry& other : _entries)
+        {
+            if (other.hash == entry.hash)
+            {
+                entry.sharedWith = other.name;
+                break;
+            }
+        }
+
+        _statistics.deduplicated++;
+        _entries.push_back(entry);
+        _statistics.milliseconds += duration<double, std::milli>(high_resolution_clock::now() - start).count();
+        return iter->second;
+    }
+
+    std::ostringstream fileName;
+    fileName << _directory << "/" << std::hex << std::setw(16) << std::setfill('0') << entry.hash << ".rootsig";
+
+    // blobs from disk are validated by the device, broken ones are serialized again
+    ComPtr<ID3D12RootSignature> signature;
+    const std::vector<char> cachedBlob = LoadBlob(fileName.str());
+    if (!cachedBlob.empty() && SUCCEEDED(_device->CreateRootSignature(0, cachedBlob.data(), cachedBlob.size(), IID_PPV_ARGS(&signature))))
+    {
+        _statistics.loadedFromDisk++;
+    }
+    else
+    {
+        ComPtr<ID3DBlob> signatureBlob = nullptr;
+        ComPtr<ID3DBlob> errorBlob = nullptr;
+        if (FAILED(D3D12SerializeRootSignature(&desc, D3D_ROOT_SIGNATURE_VERSION_1, &signatureBlob, &errorBlob)))
+        {
+            MessageBoxA(NULL, (const char*)errorBlob->GetBufferPointer(), NULL, NULL);
+            throw std::runtime_error("Unable to serialize root signature " + name);
+        }
+
+        ThrowIfFailed(_device->CreateRootSignature(0, signatureBlob->GetBufferPointer(), signatureBlob->GetBufferSize(), IID_PPV_ARGS(&signature)));
+        SaveBlob(fileName.str(), signatureBlob.Get());
+        _statistics.serialized++;
+    }
+
+    _signatures[entry.hash] = signature;
+    _entries.push_back(entry);
+    _statistics.milliseconds += duration<double, std::milli>(high_resolution_clock::now() - start).count();
+    return signature;
+}
+
+void RootSignatureRegistry::DumpReport(std::ostream& stream) const
+{
+    for (const Entry& entry : _entries)
+    {
+        stream << "    " << entry.name << ": " << entry.cost << "/" << rootSignatureBudget << " DWORDs";
+        if (!entry.parameters.empty())
+            stream << " (" << entry.parameters << ")";
+        if (!entry.sharedWith.empty())
+            stream << ", same as " << entry.sharedWith;
+        if (entry.cost > rootSignatureBudget)
+            stream << ", OVER BUDGET";
+        stream << std::endl;
+    }
+}
+
+const RootSignatureStatistics& RootSignatureRegistry::Statistics() const
+{
+    return _statistics;
+}
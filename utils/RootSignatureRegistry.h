@@ -0,0 +1,53 @@
+#pragma once
+
+#include "stdafx.h"
+
+// Root arguments are limited by 64 DWORDs: tables cost 1, root descriptors 2, constants 1 per value
+constexpr uint32_t rootSignatureBudget = 64;
+
+// Hash of canonical description: parameters with their ranges and static samplers are hashed by value,
+// pointers and unused members of unions are ignored
+uint64_t HashRootSignature(const D3D12_ROOT_SIGNATURE_DESC& desc);
+
+// size of root arguments in DWORDs
+uint32_t GetRootSignatureCost(const D3D12_ROOT_SIGNATURE_DESC& desc);
+
+struct RootSignatureStatistics
+{
+    size_t      requests = 0;
+    size_t      deduplicated = 0;           // same description was requested before
+    size_t      loadedFromDisk = 0;
+    size_t      serialized = 0;
+    double      milliseconds = 0.0;
+};
+
+// Creates every root signature once: requests with equal descriptions get the same object. Serialized
+// blobs are cached as <directory>/<hash>.rootsig files, so serialization is skipped on next starts.
+class RootSignatureRegistry
+{
+public:
+    RootSignatureRegistry(ComPtr<ID3D12Device> pDevice, const std::string& directory);
+
+    ComPtr<ID3D12RootSignature> Create(const D3D12_ROOT_SIGNATURE_DESC& desc, const std::string& name);
+
+    // cost of every signature against the budget, shared signatures are marked
+    void DumpReport(std::ostream& stream) const;
+
+    const RootSignatureStatistics& Statistics() const;
+
+private:
+    struct Entry
+    {
+        std::string                 name;
+        uint64_t                    hash;
+        uint32_t                    cost;
+        std::string                 parameters;     // cost of every parameter
+        std::string                 sharedWith;
+    };
+
+    ComPtr<ID3D12Device>                                        _device = nullptr;
+    std::string                                                 _directory;
+    std::unordered_map<uint64_t, ComPtr<ID3D12RootSignature>>   _signatures;
+    std::vector<Entry>                                          _entries;
+    RootSignatureStatistics                                     _statistics;
+};
@@ -4,24 +4,14 @@
 
 #include "Types.h"
 
+#include <algorithm>
+
 SceneObject::SceneObject(std::shared_ptr<MeshObject> meshObject,
                          ComPtr<ID3D12Device> pDevice,
                          ComPtr<ID3D12PipelineState> pPSO)
     : _meshObject(meshObject)
     , _device(pDevice)
 {
-    D3D12_HEAP_PROPERTIES heapProp = {D3D12_HEAP_TYPE_UPLOAD};
-    D3D12_RESOURCE_DESC constantBufferDesc = {};
-    constantBufferDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
-    constantBufferDesc.Width = sizeof(perModelParamsConstantBuffer);
-    constantBufferDesc.Height = 1;
-    constantBufferDesc.MipLevels = 1;
-    constantBufferDesc.SampleDesc.Count = 1;
-    constantBufferDesc.DepthOrArraySize = 1;
-    constantBufferDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
-
-    pDevice->CreateCommittedResource(&heapProp, D3D12_HEAP_FLAG_NONE, &constantBufferDesc, D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&_constantBuffer));
-
     if (pPSO)
         CreateBundleList(pPSO);
 }
@@ -41,24 +31,28 @@ SceneObject::~SceneObject()
 {
 }
 
-void SceneObject::Draw(const ComPtr<ID3D12GraphicsCommandList> & pCmdList, bool bundleUsingOverride /*= false*/)
+void SceneObject::Draw(const ComPtr<ID3D12GraphicsCommandList> & pCmdList, bool bundleUsingOverride /*= false*/, bool positionsOnly /*= false*/, size_t lod /*= 0*/)
 {
     if (_transformDirty)
         CalculateWorldMatrix();
 
-    if (_useBundles && !bundleUsingOverride)
+    // bundle is recorded with the most detailed LOD
+    if (_useBundles && !bundleUsingOverride && !positionsOnly && lod == 0)
     {
         pCmdList->ExecuteBundle(_drawBundle.Get());
     }
     else
     {
         pCmdList->IASetPrimitiveTopology(_meshObject->TopologyType());
-        pCmdList->IASetVertexBuffers(0, 1, &_meshObject->VertexBufferView());
+        BindVertexBuffers(pCmdList, positionsOnly);
 
         if (_meshObject->IndexBuffer())
         {
+            const auto& lods = _meshObject->Lods();
+            const MeshLod& meshLod = lods[std::min(lod, lods.size() - 1)];
+
             pCmdList->IASetIndexBuffer(&_meshObject->IndexBufferView());
-            pCmdList->DrawIndexedInstanced((UINT)_meshObject->IndicesCount(), 1, 0, 0, 0);
+            pCmdList->DrawIndexedInstanced(meshLod.indicesCount, 1, meshLod.firstIndex, 0, 0);
         }
         else
         {
@@ -67,6 +61,45 @@ void SceneObject::Draw(const ComPtr<ID3D12GraphicsCommandList> & pCmdList, bool
     }
 }
 
+size_t SceneObject::DrawVisibleMeshlets(const ComPtr<ID3D12GraphicsCommandList> & pCmdList,
+                                        const XMFLOAT4 frustumPlanes[6],
+                                        const XMFLOAT3& eyePosition,
+                                        bool coneCulling,
+                                        std::vector<std::pair<uint32_t, uint32_t>>& visibleRanges)
+{
+    assert(_meshObject->IndexBuffer());
+
+    if (_transformDirty)
+        CalculateWorldMatrix();
+
+    visibleRanges.clear();
+    size_t visibleMeshlets = MeshletBuilder::Cull(_meshObject->Meshlets(), _worldMatrix, frustumPlanes, eyePosition, coneCulling, visibleRanges);
+    if (visibleRanges.empty())
+        return 0;
+
+    pCmdList->IASetPrimitiveTopology(_meshObject->TopologyType());
+    BindVertexBuffers(pCmdList, false);
+    pCmdList->IASetIndexBuffer(&_meshObject->IndexBufferView());
+
+    for (const auto& range : visibleRanges)
+        pCmdList->DrawIndexedInstanced(range.second, 1, range.first, 0, 0);
+
+    return visibleMeshlets;
+}
+
+void SceneObject::BindVertexBuffers(const ComPtr<ID3D12GraphicsCommandList> & pCmdList, bool positionsOnly)
+{
+    if (_meshObject->HasPositionStream() && !positionsOnly)
+    {
+        D3D12_VERTEX_BUFFER_VIEW views[] = {_meshObject->VertexBufferView(), _meshObject->AttributeBufferView()};
+        pCmdList->IASetVertexBuffers(0, _countof(views), views);
+    }
+    else
+    {
+        pCmdList->IASetVertexBuffers(0, 1, &_meshObject->VertexBufferView());
+    }
+}
+
 const XMMATRIX& SceneObject::GetWorldMatrix() const
 {
     return _worldMatrix;
@@ -105,9 +138,57 @@ void SceneObject::Rotation(float val)
     _transformDirty = true;
 }
 
-ComPtr<ID3D12Resource> SceneObject::GetConstantBuffer() const
+uint32_t SceneObject::Material() const
 {
-    return _constantBuffer;
+    return _material;
+}
+
+void SceneObject::Material(uint32_t val)
+{
+    _material = val;
+}
+
+void SceneObject::FillDrawData(perDrawData& data)
+{
+    if (_transformDirty)
+        CalculateWorldMatrix();
+
+    // columns of the world matrix, the last one is always (0, 0, 0, 1)
+    XMFLOAT4X4 transposed;
+    XMStoreFloat4x4(&transposed, XMMatrixTranspose(_worldMatrix));
+    memcpy(data.worldMatrix, &transposed, sizeof(data.worldMatrix));
+
+    const VertexPacking::PositionBounds& bounds = _meshObject->PositionBounds();
+    memcpy(data.positionScale, &bounds.extent, sizeof(XMFLOAT3));
+    memcpy(data.positionOffset, &bounds.center, sizeof(XMFLOAT3));
+    data.tessellationEdges = _tessellationFactor.x;
+    data.tessellationInside = _tessellationFactor.y;
+    data.material = _material;
+}
+
+XMFLOAT4 SceneObject::GetWorldBoundingSphere()
+{
+    if (_transformDirty)
+        CalculateWorldMatrix();
+
+    const VertexPacking::PositionBounds& bounds = _meshObject->PositionBounds();
+    XMVECTOR center = XMVector3TransformCoord(XMLoadFloat3(&bounds.center), _worldMatrix);
+    float maxScale = std::max(_scale.x, std::max(_scale.y, _scale.z));
+    float radius = XMVectorGetX(XMVector3Length(XMLoadFloat3(&bounds.extent))) * maxScale;
+
+    XMFLOAT4 sphere;
+    XMStoreFloat4(&sphere, XMVectorSetW(center, radius));
+    return sphere;
+}
+
+const std::shared_ptr<MeshObject>& SceneObject::GetMeshObject() const
+{
+    return _meshObject;
+}
+
+void SceneObject::SetTessellationFactor(float edges, float inside)
+{
+    _tessellationFactor = {edges, inside};
 }
 
 void SceneObject::CalculateWorldMatrix()
@@ -117,11 +198,5 @@ void SceneObject::CalculateWorldMatrix()
     XMMATRIX scaleMatrix = XMMatrixScaling(_scale.x, _scale.y, _scale.z);
 
     _worldMatrix = scaleMatrix * rotationMatrix * translationMatrix;
-
-    perModelParamsConstantBuffer * bufPtr = nullptr;
-    ThrowIfFailed(_constantBuffer->Map(0, nullptr, reinterpret_cast<void**>(&bufPtr)));
-    memcpy(bufPtr->worldMatrix, GetWorldMatrix().r, sizeof(XMMATRIX));
-    _constantBuffer->Unmap(0, nullptr);
-
     _transformDirty = false;
 }
@@ -3,6 +3,7 @@
 #include "stdafx.h"
 
 #include <utils/MeshManager.h>
+#include <utils/Types.h>
 
 __declspec(align(16)) class SceneObject
 {
@@ -13,7 +14,14 @@ public:
 
     virtual ~SceneObject();
 
-    void Draw(const ComPtr<ID3D12GraphicsCommandList> & pCmdList, bool bundleUsingOverride = false);
+    // positionsOnly binds only position stream of the mesh (if it has one), bundle is never used in this case
+    void Draw(const ComPtr<ID3D12GraphicsCommandList> & pCmdList, bool bundleUsingOverride = false, bool positionsOnly = false, size_t lod = 0);
+    // culls meshlets of the mesh and draws visible ones only, visibleRanges is a scratch buffer to avoid allocations
+    size_t DrawVisibleMeshlets(const ComPtr<ID3D12GraphicsCommandList> & pCmdList,
+                               const XMFLOAT4 frustumPlanes[6],
+                               const XMFLOAT3& eyePosition,
+                               bool coneCulling,
+                               std::vector<std::pair<uint32_t, uint32_t>>& visibleRanges);
 
     const XMMATRIX& GetWorldMatrix() const;
 
@@ -26,6 +34,10 @@ public:
     float Rotation() const;
     void Rotation(float val);
 
+    // index in the material table of the scene
+    uint32_t Material() const;
+    void Material(uint32_t val);
+
     void * operator new(size_t i)
     {
         return _aligned_malloc(i, 16);
@@ -36,24 +48,33 @@ public:
         _aligned_free(p);
     }
 
-    ComPtr<ID3D12Resource> GetConstantBuffer() const;
+    // world matrix, vertex unpacking parameters, tessellation factors and material, delivered to shaders by DrawDataBinder
+    void FillDrawData(perDrawData& data);
+    // xyz - center, w - radius
+    XMFLOAT4 GetWorldBoundingSphere();
+    const std::shared_ptr<MeshObject>& GetMeshObject() const;
+
+    // factors used by hull shaders
+    void SetTessellationFactor(float edges, float inside);
 
 private:
     void CreateBundleList(ComPtr<ID3D12PipelineState> pPSO);
     void CalculateWorldMatrix();
+    void BindVertexBuffers(const ComPtr<ID3D12GraphicsCommandList> & pCmdList, bool positionsOnly);
 
     std::shared_ptr<MeshObject>         _meshObject = nullptr;
 
     XMFLOAT3                            _position = {0.0f, 0.0f, 0.0f};
     XMFLOAT3                            _scale = {1.0f, 1.0f, 1.0f};
     float                               _rotation = 0.0f;
+    uint32_t                            _material = 0;
     XMMATRIX                            _worldMatrix = XMMatrixIdentity();
 
-    ComPtr<ID3D12Resource>              _constantBuffer = nullptr;
     ComPtr<ID3D12Device>                _device = nullptr;
     ComPtr<ID3D12CommandAllocator>      _bundleCmdAllocator = nullptr;
     ComPtr<ID3D12GraphicsCommandList>   _drawBundle = nullptr;
 
     bool                                _useBundles = false;
     bool                                _transformDirty = true;
+    XMFLOAT2                            _tessellationFactor = {0.0f, 0.0f};
 };
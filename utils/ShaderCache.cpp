@@ -0,0 +1,186 @@
+#include "stdafx.h"
+
+#include "ShaderCache.h"
+
+#include "MeshFile.h"
+#include "Shaders.h"
+
+#include <filesystem>
+#include <iomanip>
+
+using namespace std::chrono;
+
+namespace
+{
+std::string DefaultPreprocessor(const std::wstring& fileName, const D3D_SHADER_MACRO* macro)
+{
+    const std::filesystem::path path {fileName};
+    std::ifstream file {path, std::ios::binary};
+    if (!file)
+        throw std::runtime_error("Unable to open shader " + path.string());
+
+    const std::string source {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+
+    ComPtr<ID3DBlob> preprocessed;
+    ComPtr<ID3DBlob> error;
+    if (FAILED(D3DPreprocess(source.data(),
+                             source.size(),
+                             path.string().c_str(),
+                             macro,
+                             D3D_COMPILE_STANDARD_FILE_INCLUDE,
+                             &preprocessed,
+                             &error)))
+    {
+        throw std::runtime_error(error ? (const char*)error->GetBufferPointer() : "Unable to preprocess shader " + path.string());
+    }
+
+    std::string result {(const char*)preprocessed->GetBufferPointer(), preprocessed->GetBufferSize()};
+    while (!result.empty() && result.back() == '\0')
+        result.pop_back();
+    return result;
+}
+
+ComPtr<ID3DBlob> DefaultCompiler(const std::string& source,
+                                 const std::string& sourceName,
+                                 const std::string& entryPoint,
+                                 const std::string& profile,
+                                 uint32_t flags)
+{
+    // macros and includes are already expanded by preprocessor
+    ComPtr<ID3DBlob> bytecode;
+    ComPtr<ID3DBlob> error;
+    if (FAILED(D3DCompile(source.data(),
+                          source.size(),
+                          sourceName.c_str(),
+                          nullptr,
+                          nullptr,
+                          entryPoint.c_str(),
+                          profile.c_str(),
+                          flags,
+                          0,
+                          &bytecode,
+                          &error)))
+    {
+        MessageBoxA(NULL, error ? (const char*)error->GetBufferPointer() : "Unable to compile shader", NULL, NULL);
+        return nullptr;
+    }
+    return bytecode;
+}
+
+uint64_t HashString(const std::string& value, uint64_t seed)
+{
+    const uint64_t size = value.size();
+    return MeshFile::Hash(value.data(), value.size(), MeshFile::Hash(&size, sizeof(size), seed));
+}
+
+// DXBC container starts with magic, checksum, version and size of the whole container
+constexpr size_t dxbcHeaderSize = 32;
+constexpr size_t dxbcSizeOffset = 24;
+
+ComPtr<ID3DBlob> LoadBytecode(const std::string& fileName)
+{
+    std::ifstream file {fileName, std::ios::binary | std::ios::ate};
+    if (!file)
+        return nullptr;
+
+    const size_t size = (size_t)file.tellg();
+    ComPtr<ID3DBlob> bytecode;
+    if (size < dxbcHeaderSize || FAILED(D3DCreateBlob(size, &bytecode)))
+        return nullptr;
+
+    file.seekg(0);
+    file.read(static_cast<char*>(bytecode->GetBufferPointer()), size);
+    if (!file)
+        return nullptr;
+
+    // truncated or foreign files are compiled again
+    const uint8_t* data = static_cast<const uint8_t*>(bytecode->GetBufferPointer());
+    uint32_t containerSize = 0;
+    memcpy(&containerSize, data + dxbcSizeOffset, sizeof(containerSize));
+    if (memcmp(data, "DXBC", 4) != 0 || containerSize != size)
+        return nullptr;
+
+    return bytecode;
+}
+
+void SaveBytecode(const std::string& fileName, ID3DBlob* bytecode)
+{
+    // other processes may read the cache at the same time, so the file appears only when it's complete
+    const std::string tempFileName = fileName + ".tmp";
+    {
+        std::ofstream file {tempFileName, std::ios::binary};
+        file.write(static_cast<const char*>(bytecode->GetBufferPointer()), bytecode->GetBufferSize());
+        if (!file)
+            return;
+    }
+
+    std::error_code error;
+    std::filesystem::rename(tempFileName, fileName, error);
+    if (error)
+        std::filesystem::remove(tempFileName, error);
+}
+}
+
+ShaderCache::ShaderCache(const std::string& directory, Preprocessor preprocessor /*= nullptr*/, Compiler compiler /*= nullptr*/)
+    : _directory(directory)
+    , _preprocessor(preprocessor ? preprocessor : DefaultPreprocessor)
+    , _compiler(compiler ? compiler : DefaultCompiler)
+{
+}
+
+ComPtr<ID3DBlob> ShaderCache::CompileFromFile(const std::wstring& fileName, ShaderType type, const D3D_SHADER_MACRO* macro /*= nullptr*/)
+{
+    const uint32_t flags = ShadersUtils::GetCompileFlags();
+    const std::string entryPoint = ShadersUtils::GetEntryPoint(type);
+    const std::string profile = ShadersUtils::GetShaderVersion(type);
+
+    auto start = high_resolution_clock::now();
+    const std::string source = _preprocessor(fileName, macro);
+    const uint64_t key = ComputeKey(source, macro, entryPoint, profile, flags);
+    auto preprocessEnd = high_resolution_clock::now();
+    _statistics.preprocessMilliseconds += duration<double, std::milli>(preprocessEnd - start).count();
+
+    std::ostringstream cacheFileName;
+    cacheFileName << _directory << "/" << std::hex << std::setw(16) << std::setfill('0') << key << ".cso";
+
+    if (ComPtr<ID3DBlob> bytecode = LoadBytecode(cacheFileName.str()))
+    {
+        _statistics.hits++;
+        _statistics.loadMilliseconds += duration<double, std::milli>(high_resolution_clock::now() - preprocessEnd).count();
+        return bytecode;
+    }
+
+    ComPtr<ID3DBlob> bytecode = _compiler(source, std::filesystem::path(fileName).string(), entryPoint, profile, flags);
+    if (bytecode)
+    {
+        std::error_code error;
+        std::filesystem::create_directories(_directory, error);
+        SaveBytecode(cacheFileName.str(), bytecode.Get());
+    }
+
+    _statistics.misses++;
+    _statistics.compileMilliseconds += duration<double, std::milli>(high_resolution_clock::now() - preprocessEnd).count();
+    return bytecode;
+}
+
+uint64_t ShaderCache::ComputeKey(const std::string& preprocessedSource,
+                                 const D3D_SHADER_MACRO* macro,
+                                 const std::string& entryPoint,
+                                 const std::string& profile,
+                                 uint32_t flags)
+{
+    uint64_t key = HashString(preprocessedSource, MeshFile::Hash(&flags, sizeof(flags)));
+    key = HashString(entryPoint, key);
+    key = HashString(profile, key);
+    for (; macro && macro->Name; ++macro)
+    {
+        key = HashString(macro->Name, key);
+        key = HashString(macro->Definition ? macro->Definition : "", key);
+    }
+    return key;
+}
+
+const ShaderCacheStatistics& ShaderCache::Statistics() const
+{
+    return _statistics;
+}
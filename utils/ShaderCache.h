@@ -0,0 +1,50 @@
+#pragma once
+
+#include "stdafx.h"
+
+#include "Types.h"
+
+#include <functional>
+
+struct ShaderCacheStatistics
+{
+    size_t      hits = 0;
+    size_t      misses = 0;
+    double      preprocessMilliseconds = 0.0;
+    double      loadMilliseconds = 0.0;       // reading of cached bytecode
+    double      compileMilliseconds = 0.0;    // compilation and writing of missed shaders
+};
+
+// Persistent cache of shader bytecode: <directory>/<key>.cso files, where key is a hash of the preprocessed
+// source (so included files and macro values are already in it), macros, entry point, profile and compile
+// flags. Preprocessor and compiler are replaceable, defaults use D3DPreprocess and D3DCompile.
+class ShaderCache
+{
+public:
+    // returns preprocessed source of the file, throws on errors
+    using Preprocessor = std::function<std::string(const std::wstring& fileName, const D3D_SHADER_MACRO* macro)>;
+    // compiles preprocessed source, returns nullptr on errors
+    using Compiler = std::function<ComPtr<ID3DBlob>(const std::string& source,
+                                                    const std::string& sourceName,
+                                                    const std::string& entryPoint,
+                                                    const std::string& profile,
+                                                    uint32_t flags)>;
+
+    explicit ShaderCache(const std::string& directory, Preprocessor preprocessor = nullptr, Compiler compiler = nullptr);
+
+    ComPtr<ID3DBlob> CompileFromFile(const std::wstring& fileName, ShaderType type, const D3D_SHADER_MACRO* macro = nullptr);
+
+    static uint64_t ComputeKey(const std::string& preprocessedSource,
+                               const D3D_SHADER_MACRO* macro,
+                               const std::string& entryPoint,
+                               const std::string& profile,
+                               uint32_t flags);
+
+    const ShaderCacheStatistics& Statistics() const;
+
+private:
+    std::string             _directory;
+    Preprocessor            _preprocessor;
+    Compiler                _compiler;
+    ShaderCacheStatistics   _statistics;
+};
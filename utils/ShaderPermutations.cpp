@@ -0,0 +1,189 @@
+#include "stdafx.h"
+
+#include "ShaderPermutations.h"
+
+#include "Shaders.h"
+
+#include <iomanip>
+
+namespace ShaderPermutations
+{
+namespace
+{
+constexpr size_t stagesCount = (size_t)ShaderType::Compute + 1;
+
+const ShaderInfo shaders[] = {
+    {"MRTPass",             L"assets/shaders/MRTPass.hlsl",                 RootConstants | UseTextures | UseTessellation | PackedVertices | DrawRootConstants | DrawDataBuffer | BindlessTextures},
+    {"LightPass",           L"assets/shaders/LightPass.hlsl",               ShadowMapping | PCFFiltering},
+    {"LDRPass",             L"assets/shaders/LDRPass.hlsl",                 0},
+    {"IntensityPass",       L"assets/shaders/IntensityPass.hlsl",           0},
+    {"IntensityReducePass", L"assets/shaders/IntensityReducePass.hlsl",     0},
+    {"DepthPass",           L"assets/shaders/DepthPass.hlsl",               UseTessellation | PackedVertices | DrawRootConstants | DrawDataBuffer},
+    {"HistogramPass",       L"assets/shaders/HistogramPass.hlsl",           0},
+    {"ExposurePass",        L"assets/shaders/ExposurePass.hlsl",            0},
+};
+static_assert(_countof(shaders) == (size_t)ShaderId::Count, "Every shader has to be described");
+
+const char* featureNames[FeaturesCount] = {
+    "RootConstants",
+    "UseTextures",
+    "UseTessellation",
+    "PackedVertices",
+    "ShadowMapping",
+    "PCFFiltering",
+    "DrawRootConstants",
+    "DrawDataBuffer",
+    "BindlessTextures",
+};
+
+size_t GetIndex(ShaderId shader, ShaderType stage, uint32_t features)
+{
+    return ((size_t)shader << FeaturesCount | features) * stagesCount + (size_t)stage;
+}
+}
+
+const ShaderInfo& GetShaderInfo(ShaderId shader)
+{
+    return shaders[(size_t)shader];
+}
+
+bool IsValid(ShaderId shader, uint32_t features)
+{
+    if (features & ~GetShaderInfo(shader).features)
+        return false;
+
+    if ((features & DrawRootConstants) && (features & DrawDataBuffer))
+        return false;
+
+    if ((features & BindlessTextures) && !(features & UseTextures))
+        return false;
+
+    return !(features & PCFFiltering) || (features & ShadowMapping);
+}
+
+std::vector<ShaderType> GetStages(ShaderId shader, uint32_t features)
+{
+    switch (shader)
+    {
+    case ShaderId::MRTPass:
+        if (features & UseTessellation)
+            return {ShaderType::Vertex, ShaderType::Pixel, ShaderType::Hull, ShaderType::Domain};
+        return {ShaderType::Vertex, ShaderType::Pixel};
+    case ShaderId::DepthPass:
+        // depth only, no pixel shader
+        if (features & UseTessellation)
+            return {ShaderType::Vertex, ShaderType::Hull, ShaderType::Domain};
+        return {ShaderType::Vertex};
+    case ShaderId::IntensityPass:
+    case ShaderId::IntensityReducePass:
+    case ShaderId::HistogramPass:
+    case ShaderId::ExposurePass:
+        return {ShaderType::Compute};
+    default:
+        return {ShaderType::Vertex, ShaderType::Pixel};
+    }
+}
+
+std::vector<D3D_SHADER_MACRO> GetMacros(uint32_t features)
+{
+    std::vector<D3D_SHADER_MACRO> macro;
+    for (uint32_t i = 0; i < FeaturesCount; ++i)
+    {
+        if (features & (1u << i))
+            macro.push_back({featureNames[i], "1"});
+    }
+    macro.push_back({NULL, NULL});
+    return macro;
+}
+
+std::string GetEntryName(const Permutation& permutation)
+{
+    std::ostringstream name;
+    name << "shaders/" << GetShaderInfo(permutation.shader).name << "/" << ShadersUtils::GetShaderPrefix(permutation.stage) << "/";
+    name << std::hex << std::setw(3) << std::setfill('0') << permutation.features;
+    return name.str();
+}
+
+std::vector<Permutation> Enumerate()
+{
+    std::vector<Permutation> permutations;
+    for (size_t shader = 0; shader < (size_t)ShaderId::Count; ++shader)
+    {
+        for (uint32_t features = 0; features < (1u << FeaturesCount); ++features)
+        {
+            if (!IsValid((ShaderId)shader, features))
+                continue;
+
+            for (ShaderType stage : GetStages((ShaderId)shader, features))
+                permutations.push_back({(ShaderId)shader, stage, features});
+        }
+    }
+    return permutations;
+}
+
+uint32_t GetFeatures(ShaderId shader, const CommandLineOptions& options)
+{
+    uint32_t features = 0;
+    if (options.root_constants)
+        features |= RootConstants;
+    if (options.textures)
+        features |= UseTextures;
+    if (options.textures && options.bindless_textures)
+        features |= BindlessTextures;
+    if (options.tessellation)
+        features |= UseTessellation;
+    if (options.packed_vertices)
+        features |= PackedVertices;
+    if (options.shadow_pass)
+        features |= ShadowMapping;
+    if (options.draw_data == DrawDataMode::RootConstants)
+        features |= DrawRootConstants;
+    if (options.draw_data == DrawDataMode::StructuredBuffer)
+        features |= DrawDataBuffer;
+
+    // options the shader doesn't depend on
+    return features & GetShaderInfo(shader).features;
+}
+
+Table::Table(const AssetPack::Reader& pack)
+    : _pack(pack)
+    , _entries((size_t)ShaderId::Count * stagesCount << FeaturesCount, nullptr)
+{
+    std::unordered_map<std::string, const AssetPack::Entry*> shaderEntries;
+    for (const AssetPack::Entry& entry : pack.Entries())
+    {
+        if (entry.type == AssetPack::EntryType::Shader)
+            shaderEntries[entry.name] = &entry;
+    }
+
+    for (const Permutation& permutation : Enumerate())
+    {
+        auto iter = shaderEntries.find(GetEntryName(permutation));
+        if (iter == shaderEntries.end())
+            continue;
+
+        _entries[GetIndex(permutation.shader, permutation.stage, permutation.features)] = iter->second;
+        _size++;
+    }
+}
+
+ComPtr<ID3DBlob> Table::Find(ShaderId shader, ShaderType stage, uint32_t features) const
+{
+    if (features >> FeaturesCount)
+        return nullptr;
+
+    const AssetPack::Entry* entry = _entries[GetIndex(shader, stage, features)];
+    if (!entry)
+        return nullptr;
+
+    ComPtr<ID3DBlob> bytecode;
+    ThrowIfFailed(D3DCreateBlob((SIZE_T)entry->size, &bytecode));
+    memcpy(bytecode->GetBufferPointer(), _pack.Data(*entry), (size_t)entry->size);
+    return bytecode;
+}
+
+size_t Table::Size() const
+{
+    return _size;
+}
+}
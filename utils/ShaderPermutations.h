@@ -0,0 +1,93 @@
+#pragma once
+
+#include "stdafx.h"
+
+#include "AssetPack.h"
+#include "Types.h"
+
+// Registry of shader variants: every shader declares feature axes (macros) it's compiled with, all valid
+// combinations of them are compiled ahead of time by asset_cooker into the pack, so a variant is found
+// by an index without compilation at runtime.
+namespace ShaderPermutations
+{
+enum class ShaderId
+{
+    MRTPass,
+    LightPass,
+    LDRPass,
+    IntensityPass,
+    IntensityReducePass,
+    DepthPass,
+    HistogramPass,
+    ExposurePass,
+    Count
+};
+
+// Each feature is a macro defined to 1
+enum Feature : uint32_t
+{
+    RootConstants       = 1 << 0,
+    UseTextures         = 1 << 1,
+    UseTessellation     = 1 << 2,
+    PackedVertices      = 1 << 3,
+    ShadowMapping       = 1 << 4,
+    PCFFiltering        = 1 << 5,
+    DrawRootConstants   = 1 << 6,
+    DrawDataBuffer      = 1 << 7,
+    BindlessTextures    = 1 << 8,
+};
+
+constexpr uint32_t FeaturesCount = 9;
+
+struct ShaderInfo
+{
+    const char*     name;
+    const wchar_t*  fileName;
+    uint32_t        features;   // axes of the shader
+};
+
+struct Permutation
+{
+    ShaderId    shader;
+    ShaderType  stage;
+    uint32_t    features;
+};
+
+const ShaderInfo& GetShaderInfo(ShaderId shader);
+
+// features have to be the shader's axes, PCF filtering needs shadow mapping, per-draw data comes from one source,
+// bindless textures need textures
+bool IsValid(ShaderId shader, uint32_t features);
+
+// hull and domain stages are used with tessellation only
+std::vector<ShaderType> GetStages(ShaderId shader, uint32_t features);
+
+// null terminated list, names are static strings
+std::vector<D3D_SHADER_MACRO> GetMacros(uint32_t features);
+
+// name of the bytecode entry in the pack
+std::string GetEntryName(const Permutation& permutation);
+
+// all valid combinations of all shaders with their stages
+std::vector<Permutation> Enumerate();
+
+// features the sample compiles the shader with, options are taken after device checks (bindless textures)
+uint32_t GetFeatures(ShaderId shader, const CommandLineOptions& options);
+
+// Precompiled variants from the pack, the pack has to outlive the table
+class Table
+{
+public:
+    explicit Table(const AssetPack::Reader& pack);
+
+    // nullptr when the variant isn't in the pack
+    ComPtr<ID3DBlob> Find(ShaderId shader, ShaderType stage, uint32_t features) const;
+
+    size_t Size() const;
+
+private:
+    const AssetPack::Reader&                _pack;
+    std::vector<const AssetPack::Entry*>    _entries;
+    size_t                                  _size = 0;
+};
+}
@@ -6,7 +6,7 @@
 
 namespace ShadersUtils
 {
-inline void CompileShaderFromSource(const std::string &shaderCode, ShaderType type, ID3DBlob ** out_blob, const D3D_SHADER_MACRO* macro = nullptr)
+inline uint32_t GetCompileFlags()
 {
     uint32_t compileFlags = D3DCOMPILE_PACK_MATRIX_ROW_MAJOR;
 #ifdef _DEBUG
@@ -17,9 +17,11 @@ inline void CompileShaderFromSource(const std::string &shaderCode, ShaderType ty
 #else
     compileFlags |= D3DCOMPILE_OPTIMIZATION_LEVEL3;
 #endif
+    return compileFlags;
+}
 
-    std::string entryPoint = "_main";
-    std::string shaderVersion = "_5_0";
+inline const char* GetShaderPrefix(ShaderType type)
+{
     static const std::map<ShaderType, const char*> shaderTypesPrefixes = {
         {ShaderType::Vertex,    "vs"},
         {ShaderType::Pixel,     "ps"},
@@ -28,9 +30,25 @@ inline void CompileShaderFromSource(const std::string &shaderCode, ShaderType ty
         {ShaderType::Domain,    "ds"},
         {ShaderType::Compute,   "cs"},
     };
+    return shaderTypesPrefixes.at(type);
+}
+
+inline std::string GetEntryPoint(ShaderType type)
+{
+    return std::string(GetShaderPrefix(type)) + "_main";
+}
+
+// 5.1 for arrays of resources indexed in shaders (bindless textures)
+inline std::string GetShaderVersion(ShaderType type)
+{
+    return std::string(GetShaderPrefix(type)) + "_5_1";
+}
 
-    entryPoint = shaderTypesPrefixes.at(type) + entryPoint;
-    shaderVersion = shaderTypesPrefixes.at(type) + shaderVersion;
+inline void CompileShaderFromSource(const std::string &shaderCode, ShaderType type, ID3DBlob ** out_blob, const D3D_SHADER_MACRO* macro = nullptr)
+{
+    const uint32_t compileFlags = GetCompileFlags();
+    const std::string entryPoint = GetEntryPoint(type);
+    const std::string shaderVersion = GetShaderVersion(type);
 
     ComPtr<ID3DBlob> error = nullptr;
     if (FAILED(D3DCompile(shaderCode.c_str(),
@@ -49,32 +67,12 @@ inline void CompileShaderFromSource(const std::string &shaderCode, ShaderType ty
 
 inline void CompileShaderFromFile(const std::wstring &fileName, ShaderType type, ID3DBlob ** out_blob, const D3D_SHADER_MACRO* macro = nullptr)
 {
-    uint32_t compileFlags = D3DCOMPILE_PACK_MATRIX_ROW_MAJOR;
-#ifdef _DEBUG
-    compileFlags |= D3DCOMPILE_DEBUG;
-    compileFlags |= D3DCOMPILE_ENABLE_STRICTNESS;
-    compileFlags |= D3DCOMPILE_SKIP_OPTIMIZATION;
-    compileFlags |= D3DCOMPILE_WARNINGS_ARE_ERRORS;
-#else
-    compileFlags |= D3DCOMPILE_OPTIMIZATION_LEVEL3;
-#endif
-
-    std::string entryPoint = "_main";
-    std::string shaderVersion = "_5_0";
-    static const std::map<ShaderType, const char*> shaderTypesPrefixes = {
-        {ShaderType::Vertex,    "vs"},
-        {ShaderType::Pixel,     "ps"},
-        {ShaderType::Geometry,  "gs"},
-        {ShaderType::Hull,      "hs"},
-        {ShaderType::Domain,    "ds"},
-        {ShaderType::Compute,   "cs"},
-    };
-
-    entryPoint = shaderTypesPrefixes.at(type) + entryPoint;
-    shaderVersion = shaderTypesPrefixes.at(type) + shaderVersion;
+    const uint32_t compileFlags = GetCompileFlags();
+    const std::string entryPoint = GetEntryPoint(type);
+    const std::string shaderVersion = GetShaderVersion(type);
 
     ComPtr<ID3DBlob> error = nullptr;
-    if (FAILED(D3DCompileFromFile(fileName.c_str(), macro, nullptr, entryPoint.c_str(), shaderVersion.c_str(), compileFlags, 0, out_blob, &error)))
+    if (FAILED(D3DCompileFromFile(fileName.c_str(), macro, D3D_COMPILE_STANDARD_FILE_INCLUDE, entryPoint.c_str(), shaderVersion.c_str(), compileFlags, 0, out_blob, &error)))
     {
         if (error)
         {
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "stdafx.h"
+
+#include <atomic>
+#include <functional>
+#include <future>
+
+// Values created once per key: the first request of a key creates the value, next ones share its future.
+// Creation is given by the caller, so deduplication doesn't depend on what is created. Background values are
+// created on own threads, the thread which finishes the last pending one calls the idle callback.
+template<typename T>
+class SharedFutureCache
+{
+public:
+    using Future = std::shared_future<T>;
+    using CreateFunc = std::function<T()>;
+
+    explicit SharedFutureCache(std::function<void()> onIdle = nullptr)
+        : _onIdle(std::move(onIdle))
+    {
+    }
+
+    SharedFutureCache(const SharedFutureCache&) = delete;
+    SharedFutureCache& operator=(const SharedFutureCache&) = delete;
+
+    // values of deferred requests are created by the first thread waiting for them,
+    // deduplicated is set when the key was requested before and create isn't used
+    Future Request(uint64_t key, bool background, CreateFunc create, bool& deduplicated)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto iter = _futures.find(key);
+        deduplicated = iter != _futures.end();
+        if (deduplicated)
+            return iter->second;
+
+        Future future;
+        if (background)
+        {
+            ++_pending;
+            future = std::async(std::launch::async, [this, create]()
+            {
+                PendingGuard guard {*this};
+                return create();
+            }).share();
+        }
+        else
+        {
+            future = std::async(std::launch::deferred, create).share();
+        }
+
+        _futures[key] = future;
+        return future;
+    }
+
+    // background values which aren't created yet
+    size_t PendingCount() const
+    {
+        return _pending.load();
+    }
+
+    size_t Size() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _futures.size();
+    }
+
+    // creates deferred values as well
+    void WaitAll() const
+    {
+        std::vector<Future> futures;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            for (const auto& future : _futures)
+                futures.push_back(future.second);
+        }
+
+        for (const Future& future : futures)
+            future.wait();
+    }
+
+private:
+    // the value is set after the guard is destroyed, so waiters see the idle callback finished
+    struct PendingGuard
+    {
+        ~PendingGuard()
+        {
+            if (--cache._pending == 0 && cache._onIdle)
+                cache._onIdle();
+        }
+
+        SharedFutureCache& cache;
+    };
+
+    std::function<void()>                   _onIdle;
+    mutable std::mutex                      _mutex;
+    std::unordered_map<uint64_t, Future>    _futures;
+    std::atomic_size_t                      _pending = 0;
+};
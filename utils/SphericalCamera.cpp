@@ -74,6 +74,62 @@ DirectX::XMFLOAT4 SphericalCamera::GetEyePosition() const
     return Math::GetPointOnSphere(_centerPosition, _radius, _rotation, _inclination);
 }
 
+float SphericalCamera::GetProjectedRadius(const XMFLOAT3 & center, float radius) const
+{
+    // orthographic view size is set in world units, so one unit is one "pixel"
+    if (_type == ProjectionType::Orthographic)
+        return radius;
+
+    XMFLOAT4 eyePosition = GetEyePosition();
+    XMVECTOR distanceVector = XMVectorSubtract(XMLoadFloat3(&center), XMLoadFloat4(&eyePosition));
+    float distance = XMVectorGetX(XMVector3Length(distanceVector));
+
+    // the camera is inside of the sphere
+    if (distance <= radius)
+        return _screenHeight;
+
+    return radius / (distance * std::tan(_fov * 0.5f)) * _screenHeight * 0.5f;
+}
+
+void SphericalCamera::GetProjectedRadii(const XMFLOAT4 * spheres, size_t count, float * radii) const
+{
+    if (_type == ProjectionType::Orthographic)
+    {
+        for (size_t i = 0; i < count; ++i)
+            radii[i] = spheres[i].w;
+        return;
+    }
+
+    const XMFLOAT4 eyePosition = GetEyePosition();
+    const XMVECTOR eyeX = XMVectorReplicate(eyePosition.x);
+    const XMVECTOR eyeY = XMVectorReplicate(eyePosition.y);
+    const XMVECTOR eyeZ = XMVectorReplicate(eyePosition.z);
+    const XMVECTOR scale = XMVectorReplicate(_screenHeight * 0.5f / std::tan(_fov * 0.5f));
+    const XMVECTOR screenHeight = XMVectorReplicate(_screenHeight);
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        // transposed spheres give x, y, z and radius of four spheres in separate registers
+        XMMATRIX batch = XMMatrixTranspose(XMMATRIX(XMLoadFloat4(&spheres[i + 0]),
+                                                    XMLoadFloat4(&spheres[i + 1]),
+                                                    XMLoadFloat4(&spheres[i + 2]),
+                                                    XMLoadFloat4(&spheres[i + 3])));
+
+        XMVECTOR dx = XMVectorSubtract(batch.r[0], eyeX);
+        XMVECTOR dy = XMVectorSubtract(batch.r[1], eyeY);
+        XMVECTOR dz = XMVectorSubtract(batch.r[2], eyeZ);
+        XMVECTOR distance = XMVectorSqrt(XMVectorMultiplyAdd(dx, dx, XMVectorMultiplyAdd(dy, dy, XMVectorMultiply(dz, dz))));
+
+        XMVECTOR projected = XMVectorDivide(XMVectorMultiply(batch.r[3], scale), distance);
+        XMVECTOR result = XMVectorSelect(projected, screenHeight, XMVectorLessOrEqual(distance, batch.r[3]));
+        XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(&radii[i]), result);
+    }
+
+    for (; i < count; ++i)
+        radii[i] = GetProjectedRadius({spheres[i].x, spheres[i].y, spheres[i].z}, spheres[i].w);
+}
+
 void SphericalCamera::UpdateMatrices()
 {
     XMFLOAT4 camPos = Math::GetPointOnSphere(_centerPosition, _radius, _rotation, _inclination);
@@ -27,6 +27,11 @@ public:
     XMMATRIX GetViewProjMatrix() const;
     XMFLOAT4 GetEyePosition() const;
 
+    // Radius of the sphere projection in pixels
+    float GetProjectedRadius(const XMFLOAT3 & center, float radius) const;
+    // The same for many spheres (xyz - center, w - radius) at once, four of them per iteration
+    void GetProjectedRadii(const XMFLOAT4 * spheres, size_t count, float * radii) const;
+
 private:
     void UpdateMatrices();
 
@@ -0,0 +1,332 @@
+#include "stdafx.h"
+
+#include "SubresourceStaging.h"
+
+#include "ParallelFor.h"
+
+#include <emmintrin.h>
+
+#include <algorithm>
+
+namespace
+{
+// rows of one job, big enough to hide threads overhead
+constexpr size_t copyJobBytes = 256 * 1024;
+
+struct FormatBlock
+{
+    UINT width;     // in texels
+    UINT height;
+    UINT bytes;
+};
+
+FormatBlock GetFormatBlock(DXGI_FORMAT format)
+{
+    switch (format)
+    {
+    case DXGI_FORMAT_R32G32B32A32_TYPELESS:
+    case DXGI_FORMAT_R32G32B32A32_FLOAT:
+    case DXGI_FORMAT_R32G32B32A32_UINT:
+    case DXGI_FORMAT_R32G32B32A32_SINT:
+        return {1, 1, 16};
+
+    case DXGI_FORMAT_R32G32B32_TYPELESS:
+    case DXGI_FORMAT_R32G32B32_FLOAT:
+    case DXGI_FORMAT_R32G32B32_UINT:
+    case DXGI_FORMAT_R32G32B32_SINT:
+        return {1, 1, 12};
+
+    case DXGI_FORMAT_R16G16B16A16_TYPELESS:
+    case DXGI_FORMAT_R16G16B16A16_FLOAT:
+    case DXGI_FORMAT_R16G16B16A16_UNORM:
+    case DXGI_FORMAT_R16G16B16A16_UINT:
+    case DXGI_FORMAT_R16G16B16A16_SNORM:
+    case DXGI_FORMAT_R16G16B16A16_SINT:
+    case DXGI_FORMAT_R32G32_TYPELESS:
+    case DXGI_FORMAT_R32G32_FLOAT:
+    case DXGI_FORMAT_R32G32_UINT:
+    case DXGI_FORMAT_R32G32_SINT:
+        return {1, 1, 8};
+
+    case DXGI_FORMAT_R10G10B10A2_TYPELESS:
+    case DXGI_FORMAT_R10G10B10A2_UNORM:
+    case DXGI_FORMAT_R10G10B10A2_UINT:
+    case DXGI_FORMAT_R11G11B10_FLOAT:
+    case DXGI_FORMAT_R8G8B8A8_TYPELESS:
+    case DXGI_FORMAT_R8G8B8A8_UNORM:
+    case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+    case DXGI_FORMAT_R8G8B8A8_UINT:
+    case DXGI_FORMAT_R8G8B8A8_SNORM:
+    case DXGI_FORMAT_R8G8B8A8_SINT:
+    case DXGI_FORMAT_R16G16_TYPELESS:
+    case DXGI_FORMAT_R16G16_FLOAT:
+    case DXGI_FORMAT_R16G16_UNORM:
+    case DXGI_FORMAT_R16G16_UINT:
+    case DXGI_FORMAT_R16G16_SNORM:
+    case DXGI_FORMAT_R16G16_SINT:
+    case DXGI_FORMAT_R32_TYPELESS:
+    case DXGI_FORMAT_D32_FLOAT:
+    case DXGI_FORMAT_R32_FLOAT:
+    case DXGI_FORMAT_R32_UINT:
+    case DXGI_FORMAT_R32_SINT:
+    case DXGI_FORMAT_R9G9B9E5_SHAREDEXP:
+    case DXGI_FORMAT_B8G8R8A8_UNORM:
+    case DXGI_FORMAT_B8G8R8X8_UNORM:
+    case DXGI_FORMAT_R10G10B10_XR_BIAS_A2_UNORM:
+    case DXGI_FORMAT_B8G8R8A8_TYPELESS:
+    case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+    case DXGI_FORMAT_B8G8R8X8_TYPELESS:
+    case DXGI_FORMAT_B8G8R8X8_UNORM_SRGB:
+        return {1, 1, 4};
+
+    case DXGI_FORMAT_R8G8_TYPELESS:
+    case DXGI_FORMAT_R8G8_UNORM:
+    case DXGI_FORMAT_R8G8_UINT:
+    case DXGI_FORMAT_R8G8_SNORM:
+    case DXGI_FORMAT_R8G8_SINT:
+    case DXGI_FORMAT_R16_TYPELESS:
+    case DXGI_FORMAT_R16_FLOAT:
+    case DXGI_FORMAT_D16_UNORM:
+    case DXGI_FORMAT_R16_UNORM:
+    case DXGI_FORMAT_R16_UINT:
+    case DXGI_FORMAT_R16_SNORM:
+    case DXGI_FORMAT_R16_SINT:
+    case DXGI_FORMAT_B5G6R5_UNORM:
+    case DXGI_FORMAT_B5G5R5A1_UNORM:
+    case DXGI_FORMAT_B4G4R4A4_UNORM:
+        return {1, 1, 2};
+
+    case DXGI_FORMAT_R8_TYPELESS:
+    case DXGI_FORMAT_R8_UNORM:
+    case DXGI_FORMAT_R8_UINT:
+    case DXGI_FORMAT_R8_SNORM:
+    case DXGI_FORMAT_R8_SINT:
+    case DXGI_FORMAT_A8_UNORM:
+        return {1, 1, 1};
+
+    case DXGI_FORMAT_BC1_TYPELESS:
+    case DXGI_FORMAT_BC1_UNORM:
+    case DXGI_FORMAT_BC1_UNORM_SRGB:
+    case DXGI_FORMAT_BC4_TYPELESS:
+    case DXGI_FORMAT_BC4_UNORM:
+    case DXGI_FORMAT_BC4_SNORM:
+        return {4, 4, 8};
+
+    case DXGI_FORMAT_BC2_TYPELESS:
+    case DXGI_FORMAT_BC2_UNORM:
+    case DXGI_FORMAT_BC2_UNORM_SRGB:
+    case DXGI_FORMAT_BC3_TYPELESS:
+    case DXGI_FORMAT_BC3_UNORM:
+    case DXGI_FORMAT_BC3_UNORM_SRGB:
+    case DXGI_FORMAT_BC5_TYPELESS:
+    case DXGI_FORMAT_BC5_UNORM:
+    case DXGI_FORMAT_BC5_SNORM:
+    case DXGI_FORMAT_BC6H_TYPELESS:
+    case DXGI_FORMAT_BC6H_UF16:
+    case DXGI_FORMAT_BC6H_SF16:
+    case DXGI_FORMAT_BC7_TYPELESS:
+    case DXGI_FORMAT_BC7_UNORM:
+    case DXGI_FORMAT_BC7_UNORM_SRGB:
+        return {4, 4, 16};
+
+    default:
+        throw std::runtime_error("Copyable footprints of the format are not supported");
+    }
+}
+
+UINT64 Align(UINT64 value, UINT64 alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// Upload heaps are write-combined, streaming stores don't read destination lines and don't pollute caches
+void StreamCopy(uint8_t* pDestination, const uint8_t* pSource, size_t size)
+{
+    size_t offset = 0;
+    if (((uintptr_t)pDestination & 15) == 0)
+    {
+        for (; offset + 64 <= size; offset += 64)
+        {
+            __m128i v0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSource + offset));
+            __m128i v1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSource + offset + 16));
+            __m128i v2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSource + offset + 32));
+            __m128i v3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSource + offset + 48));
+            _mm_stream_si128(reinterpret_cast<__m128i*>(pDestination + offset), v0);
+            _mm_stream_si128(reinterpret_cast<__m128i*>(pDestination + offset + 16), v1);
+            _mm_stream_si128(reinterpret_cast<__m128i*>(pDestination + offset + 32), v2);
+            _mm_stream_si128(reinterpret_cast<__m128i*>(pDestination + offset + 48), v3);
+        }
+
+        for (; offset + 16 <= size; offset += 16)
+            _mm_stream_si128(reinterpret_cast<__m128i*>(pDestination + offset), _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSource + offset)));
+    }
+
+    if (offset < size)
+        std::memcpy(pDestination + offset, pSource + offset, size - offset);
+}
+}
+
+CopyableFootprints ComputeCopyableFootprints(const D3D12_RESOURCE_DESC& desc, UINT firstSubresource, UINT numSubresources, UINT64 baseOffset)
+{
+    CopyableFootprints footprints;
+    footprints.layouts.resize(numSubresources);
+    footprints.numRows.resize(numSubresources);
+    footprints.rowSizesInBytes.resize(numSubresources);
+
+    if (desc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER)
+    {
+        if (firstSubresource != 0 || numSubresources != 1)
+            throw std::runtime_error("Buffers have the only subresource");
+
+        footprints.layouts[0] = {baseOffset, {DXGI_FORMAT_UNKNOWN, (UINT)desc.Width, 1, 1, (UINT)Align(desc.Width, D3D12_TEXTURE_DATA_PITCH_ALIGNMENT)}};
+        footprints.numRows[0] = 1;
+        footprints.rowSizesInBytes[0] = desc.Width;
+        footprints.totalBytes = desc.Width;
+        return footprints;
+    }
+
+    const FormatBlock block = GetFormatBlock(desc.Format);
+    const UINT mipLevels = desc.MipLevels ? desc.MipLevels : 1;
+    const bool volume = desc.Dimension == D3D12_RESOURCE_DIMENSION_TEXTURE3D;
+
+    UINT64 offset = baseOffset;
+    UINT64 end = baseOffset;
+    for (UINT i = 0; i < numSubresources; ++i)
+    {
+        const UINT mip = (firstSubresource + i) % mipLevels;
+        const UINT width = std::max<UINT>((UINT)(desc.Width >> mip), 1);
+        const UINT height = std::max<UINT>(desc.Height >> mip, 1);
+        const UINT depth = volume ? std::max<UINT>(desc.DepthOrArraySize >> mip, 1) : 1;
+
+        const UINT blocksX = (width + block.width - 1) / block.width;
+        const UINT blocksY = (height + block.height - 1) / block.height;
+        const UINT64 rowSize = (UINT64)blocksX * block.bytes;
+        const UINT rowPitch = (UINT)Align(rowSize, D3D12_TEXTURE_DATA_PITCH_ALIGNMENT);
+
+        offset = Align(offset, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+
+        // footprints of block compressed formats cover whole blocks
+        D3D12_PLACED_SUBRESOURCE_FOOTPRINT& layout = footprints.layouts[i];
+        layout.Offset = offset;
+        layout.Footprint = {desc.Format, blocksX * block.width, blocksY * block.height, depth, rowPitch};
+        footprints.numRows[i] = blocksY;
+        footprints.rowSizesInBytes[i] = rowSize;
+
+        // the last row isn't padded
+        end = offset + (UINT64)rowPitch * ((UINT64)blocksY * depth - 1) + rowSize;
+        offset += (UINT64)rowPitch * blocksY * depth;
+    }
+
+    footprints.totalBytes = end - baseOffset;
+    return footprints;
+}
+
+const CopyableFootprints& SubresourceStaging::GetFootprints(const D3D12_RESOURCE_DESC& desc, UINT firstSubresource, UINT numSubresources, UINT64 baseOffset /*= 0*/)
+{
+    const FootprintsKey key = {
+        (UINT64)desc.Dimension, desc.Alignment, desc.Width, desc.Height, desc.DepthOrArraySize, desc.MipLevels,
+        (UINT64)desc.Format, desc.SampleDesc.Count, desc.SampleDesc.Quality, (UINT64)desc.Layout, (UINT64)desc.Flags,
+        firstSubresource, numSubresources, baseOffset
+    };
+
+    auto it = _footprints.find(key);
+    if (it == _footprints.end())
+    {
+        it = _footprints.emplace(key, ComputeCopyableFootprints(desc, firstSubresource, numSubresources, baseOffset)).first;
+        _statistics.footprintsComputed++;
+    }
+    return it->second;
+}
+
+UINT64 SubresourceStaging::GetRequiredIntermediateSize(ID3D12Resource* pDestination, UINT firstSubresource, UINT numSubresources)
+{
+    return GetFootprints(pDestination->GetDesc(), firstSubresource, numSubresources).totalBytes;
+}
+
+UINT64 SubresourceStaging::UpdateSubresources(ID3D12GraphicsCommandList* pCmdList,
+                                              ID3D12Resource* pDestination,
+                                              ID3D12Resource* pIntermediate,
+                                              UINT64 intermediateOffset,
+                                              UINT firstSubresource,
+                                              UINT numSubresources,
+                                              const D3D12_SUBRESOURCE_DATA* pSrcData)
+{
+    const D3D12_RESOURCE_DESC destinationDesc = pDestination->GetDesc();
+    const CopyableFootprints& footprints = GetFootprints(destinationDesc, firstSubresource, numSubresources, intermediateOffset);
+
+    const D3D12_RESOURCE_DESC intermediateDesc = pIntermediate->GetDesc();
+    if (intermediateDesc.Dimension != D3D12_RESOURCE_DIMENSION_BUFFER || intermediateDesc.Width < footprints.totalBytes + intermediateOffset)
+        throw std::runtime_error("Intermediate buffer is too small for subresources");
+
+    _statistics.updates++;
+
+    uint8_t * pData = nullptr;
+    ThrowIfFailed(pIntermediate->Map(0, nullptr, reinterpret_cast<void**>(&pData)));
+    CopySubresources(footprints, pData, pSrcData);
+    pIntermediate->Unmap(0, nullptr);
+
+    if (destinationDesc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER)
+    {
+        pCmdList->CopyBufferRegion(pDestination, 0, pIntermediate, footprints.layouts[0].Offset, footprints.layouts[0].Footprint.Width);
+        return footprints.totalBytes;
+    }
+
+    for (UINT i = 0; i < numSubresources; ++i)
+    {
+        CD3DX12_TEXTURE_COPY_LOCATION destination(pDestination, firstSubresource + i);
+        CD3DX12_TEXTURE_COPY_LOCATION source(pIntermediate, footprints.layouts[i]);
+        pCmdList->CopyTextureRegion(&destination, 0, 0, 0, &source, nullptr);
+    }
+
+    return footprints.totalBytes;
+}
+
+void SubresourceStaging::CopySubresources(const CopyableFootprints& footprints, uint8_t* pDestination, const D3D12_SUBRESOURCE_DATA* pSrcData)
+{
+    auto copyStart = std::chrono::high_resolution_clock::now();
+
+    _jobs.clear();
+    for (size_t i = 0; i < footprints.layouts.size(); ++i)
+    {
+        const UINT numRows = footprints.numRows[i];
+        const UINT rowsPerJob = (UINT)std::clamp<UINT64>(copyJobBytes / std::max<UINT64>(footprints.rowSizesInBytes[i], 1), 1, numRows);
+
+        for (UINT slice = 0; slice < footprints.layouts[i].Footprint.Depth; ++slice)
+        {
+            for (UINT row = 0; row < numRows; row += rowsPerJob)
+                _jobs.push_back({i, slice, row, std::min(rowsPerJob, numRows - row)});
+        }
+
+        _statistics.bytesCopied += footprints.rowSizesInBytes[i] * numRows * footprints.layouts[i].Footprint.Depth;
+    }
+
+    Threading::ParallelFor(_jobs.size(), 1, [&](size_t begin, size_t end)
+    {
+        for (size_t j = begin; j < end; ++j)
+        {
+            const CopyJob& job = _jobs[j];
+            const D3D12_PLACED_SUBRESOURCE_FOOTPRINT& layout = footprints.layouts[job.subresource];
+            const D3D12_SUBRESOURCE_DATA& source = pSrcData[job.subresource];
+            const size_t rowSize = (size_t)footprints.rowSizesInBytes[job.subresource];
+            const UINT64 slicePitch = (UINT64)layout.Footprint.RowPitch * footprints.numRows[job.subresource];
+
+            for (UINT row = job.firstRow; row < job.firstRow + job.rowsCount; ++row)
+            {
+                StreamCopy(pDestination + layout.Offset + slicePitch * job.slice + (UINT64)layout.Footprint.RowPitch * row,
+                           static_cast<const uint8_t*>(source.pData) + source.SlicePitch * job.slice + source.RowPitch * row,
+                           rowSize);
+            }
+        }
+
+        // streaming stores are weakly ordered, they have to be visible before the buffer is unmapped
+        _mm_sfence();
+    });
+
+    std::chrono::duration<double, std::milli> copyTime = std::chrono::high_resolution_clock::now() - copyStart;
+    _statistics.copyMilliseconds += copyTime.count();
+}
+
+const StagingStatistics& SubresourceStaging::Statistics() const
+{
+    return _statistics;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "stdafx.h"
+
+#include <array>
+
+struct CopyableFootprints
+{
+    std::vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT> layouts;
+    std::vector<UINT>                               numRows;
+    std::vector<UINT64>                             rowSizesInBytes;
+    UINT64                                          totalBytes = 0;
+};
+
+struct StagingStatistics
+{
+    size_t      updates = 0;
+    size_t      footprintsComputed = 0;     // the rest of updates used cached footprints
+    uint64_t    bytesCopied = 0;
+    double      copyMilliseconds = 0.0;
+};
+
+// CPU implementation of ID3D12Device::GetCopyableFootprints for buffers and textures of non planar formats,
+// throws for formats it doesn't know. Doesn't need a device, so layouts can be computed anywhere.
+CopyableFootprints ComputeCopyableFootprints(const D3D12_RESOURCE_DESC& desc, UINT firstSubresource, UINT numSubresources, UINT64 baseOffset);
+
+// Replacement of d3dx12 UpdateSubresources: footprints are computed once per resource description and
+// reused, rows are copied to the upload buffer by several threads with non-temporal stores, since upload
+// heaps are write-combined. Copy jobs list is kept between calls. Not thread safe.
+class SubresourceStaging
+{
+public:
+    const CopyableFootprints& GetFootprints(const D3D12_RESOURCE_DESC& desc, UINT firstSubresource, UINT numSubresources, UINT64 baseOffset = 0);
+    UINT64 GetRequiredIntermediateSize(ID3D12Resource* pDestination, UINT firstSubresource, UINT numSubresources);
+
+    // Maps intermediate buffer, fills it and records copies to the command list, returns copied size
+    UINT64 UpdateSubresources(ID3D12GraphicsCommandList* pCmdList,
+                              ID3D12Resource* pDestination,
+                              ID3D12Resource* pIntermediate,
+                              UINT64 intermediateOffset,
+                              UINT firstSubresource,
+                              UINT numSubresources,
+                              const D3D12_SUBRESOURCE_DATA* pSrcData);
+
+    // CPU part of the update: pDestination is the beginning of the mapped intermediate buffer
+    void CopySubresources(const CopyableFootprints& footprints, uint8_t* pDestination, const D3D12_SUBRESOURCE_DATA* pSrcData);
+
+    const StagingStatistics& Statistics() const;
+
+private:
+    using FootprintsKey = std::array<UINT64, 14>;
+
+    struct CopyJob
+    {
+        size_t  subresource;
+        UINT    slice;
+        UINT    firstRow;
+        UINT    rowsCount;
+    };
+
+    std::map<FootprintsKey, CopyableFootprints>     _footprints;
+    std::vector<CopyJob>                            _jobs;
+    StagingStatistics                               _statistics;
+};
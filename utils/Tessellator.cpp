@@ -0,0 +1,224 @@
+#include "stdafx.h"
+
+#include "Tessellator.h"
+
+#include "ParallelFor.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace Tessellator
+{
+namespace
+{
+// triangles are processed in batches to keep threads busy without much synchronization
+constexpr size_t trianglesPerChunk = 16;
+
+struct float3
+{
+    float x, y, z;
+};
+
+float3 operator+(const float3& a, const float3& b)
+{
+    return {a.x + b.x, a.y + b.y, a.z + b.z};
+}
+
+float3 operator-(const float3& a, const float3& b)
+{
+    return {a.x - b.x, a.y - b.y, a.z - b.z};
+}
+
+float3 operator*(const float3& a, float s)
+{
+    return {a.x * s, a.y * s, a.z * s};
+}
+
+float3 Normalize(const float3& a)
+{
+    float length = std::sqrt(a.x * a.x + a.y * a.y + a.z * a.z);
+    return length > 0.0f ? a * (1.0f / length) : a;
+}
+
+float3 Cross(const float3& a, const float3& b)
+{
+    return {a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x};
+}
+
+float3 Load(const float* v)
+{
+    return {v[0], v[1], v[2]};
+}
+
+void Store(const float3& a, float* v)
+{
+    v[0] = a.x;
+    v[1] = a.y;
+    v[2] = a.z;
+}
+
+// vertices of every triangle are stored row by row, row j contains factor + 1 - j vertices
+uint32_t GridIndex(uint32_t i, uint32_t j, uint32_t factor)
+{
+    return j * (factor + 1) - j * (j - 1) / 2 + i;
+}
+
+uint32_t GridVerticesCount(uint32_t factor)
+{
+    return (factor + 1) * (factor + 2) / 2;
+}
+
+// Mirrors ds_main: barycentric interpolation, tangent frame from finite differences, displacement
+geometryVertex Displace(const geometryVertex& v0, const geometryVertex& v1, const geometryVertex& v2, float b1, float b2)
+{
+    const float b0 = 1.0f - b1 - b2;
+
+    float3 position = Load(v0.position) * b0 + Load(v1.position) * b1 + Load(v2.position) * b2;
+    float u = v0.uv[0] * b0 + v1.uv[0] * b1 + v2.uv[0] * b2;
+    float v = v0.uv[1] * b0 + v1.uv[1] * b1 + v2.uv[1] * b2;
+
+    const float3 normal0 = Load(v0.normal);
+    const float3 binormal0 = Load(v0.binormal);
+    const float3 tangent0 = Load(v0.tangent);
+
+    float3 prePosition = position - binormal0 * 0.01f + normal0 * SurfaceHeight(u - 0.01f, v);
+    float3 postPosition = position + binormal0 * 0.01f + normal0 * SurfaceHeight(u + 0.01f, v);
+    float3 binormal = Normalize(postPosition - prePosition);
+
+    prePosition = position - tangent0 * 0.01f + normal0 * SurfaceHeight(u, v - 0.01f);
+    postPosition = position + tangent0 * 0.01f + normal0 * SurfaceHeight(u, v + 0.01f);
+    float3 tangent = Normalize(postPosition - prePosition);
+
+    float3 normal = Normalize(Cross(binormal, tangent));
+
+    geometryVertex result;
+    Store(position + normal0 * SurfaceHeight(u, v), result.position);
+    Store(normal, result.normal);
+    Store(binormal, result.binormal);
+    Store(tangent, result.tangent);
+    result.uv[0] = u;
+    result.uv[1] = v;
+    return result;
+}
+}
+
+float SurfaceHeight(float u, float v)
+{
+    return (std::pow((std::sin((u + 0.8f) * 6.28f) + 1.0f) / 2.0f, 4.0f) *
+            std::pow((std::cos((v + 0.8f) * 6.28f) + 1.0f) / 2.0f, 4.0f)) * 0.2f;
+}
+
+void Tessellate(const std::vector<geometryVertex>& vertices,
+                const std::vector<uint32_t>& indices,
+                uint32_t factor,
+                std::vector<geometryVertex>& outVertices,
+                std::vector<uint32_t>& outIndices)
+{
+    assert(factor >= 1);
+
+    const size_t trianglesCount = indices.size() / 3;
+    const uint32_t gridVertices = GridVerticesCount(factor);
+    const uint32_t gridIndices = factor * factor * 3;
+
+    // every source triangle owns fixed ranges of the output, so the result doesn't depend on threads count
+    outVertices.resize(trianglesCount * gridVertices);
+    outIndices.resize(trianglesCount * gridIndices);
+
+    Threading::ParallelFor(trianglesCount, trianglesPerChunk, [&](size_t begin, size_t end)
+    {
+        for (size_t t = begin; t < end; ++t)
+        {
+            const geometryVertex& v0 = vertices[indices[t * 3 + 0]];
+            const geometryVertex& v1 = vertices[indices[t * 3 + 1]];
+            const geometryVertex& v2 = vertices[indices[t * 3 + 2]];
+
+            const uint32_t baseVertex = (uint32_t)(t * gridVertices);
+            for (uint32_t j = 0; j <= factor; ++j)
+            {
+                for (uint32_t i = 0; i + j <= factor; ++i)
+                    outVertices[baseVertex + GridIndex(i, j, factor)] = Displace(v0, v1, v2, (float)i / factor, (float)j / factor);
+            }
+
+            // (i, j) -> (i + 1, j) -> (i, j + 1) keeps the winding of v0 -> v1 -> v2
+            uint32_t * triangle = &outIndices[t * gridIndices];
+            for (uint32_t j = 0; j < factor; ++j)
+            {
+                for (uint32_t i = 0; i + j < factor; ++i)
+                {
+                    *triangle++ = baseVertex + GridIndex(i, j, factor);
+                    *triangle++ = baseVertex + GridIndex(i + 1, j, factor);
+                    *triangle++ = baseVertex + GridIndex(i, j + 1, factor);
+
+                    if (i + j + 1 < factor)
+                    {
+                        *triangle++ = baseVertex + GridIndex(i + 1, j, factor);
+                        *triangle++ = baseVertex + GridIndex(i + 1, j + 1, factor);
+                        *triangle++ = baseVertex + GridIndex(i, j + 1, factor);
+                    }
+                }
+            }
+        }
+    });
+}
+
+float MeasureError(const std::vector<geometryVertex>& vertices,
+                   const std::vector<uint32_t>& indices,
+                   uint32_t factor,
+                   uint32_t referenceFactor)
+{
+    const size_t trianglesCount = indices.size() / 3;
+    std::vector<float> errors(trianglesCount, 0.0f);
+
+    Threading::ParallelFor(trianglesCount, trianglesPerChunk, [&](size_t begin, size_t end)
+    {
+        for (size_t t = begin; t < end; ++t)
+        {
+            const geometryVertex& v0 = vertices[indices[t * 3 + 0]];
+            const geometryVertex& v1 = vertices[indices[t * 3 + 1]];
+            const geometryVertex& v2 = vertices[indices[t * 3 + 2]];
+
+            auto position = [&](float b1, float b2) { return Load(Displace(v0, v1, v2, b1, b2).position); };
+
+            float maxError = 0.0f;
+            for (uint32_t j = 0; j <= referenceFactor; ++j)
+            {
+                for (uint32_t i = 0; i + j <= referenceFactor; ++i)
+                {
+                    float b1 = (float)i / referenceFactor;
+                    float b2 = (float)j / referenceFactor;
+
+                    // find the coarse triangle containing the sample and interpolate its vertices
+                    float x = b1 * factor;
+                    float y = b2 * factor;
+                    float cellX = std::min(std::floor(x), (float)factor - 1.0f);
+                    float cellY = std::min(std::floor(y), (float)factor - 1.0f - cellX);
+                    cellY = std::max(cellY, 0.0f);
+                    float fx = x - cellX;
+                    float fy = y - cellY;
+
+                    float3 approximation;
+                    if (fx + fy <= 1.0f)
+                    {
+                        approximation = position(cellX / factor, cellY / factor) * (1.0f - fx - fy)
+                                      + position((cellX + 1.0f) / factor, cellY / factor) * fx
+                                      + position(cellX / factor, (cellY + 1.0f) / factor) * fy;
+                    }
+                    else
+                    {
+                        approximation = position((cellX + 1.0f) / factor, (cellY + 1.0f) / factor) * (fx + fy - 1.0f)
+                                      + position(cellX / factor, (cellY + 1.0f) / factor) * (1.0f - fx)
+                                      + position((cellX + 1.0f) / factor, cellY / factor) * (1.0f - fy);
+                    }
+
+                    float3 difference = position(b1, b2) - approximation;
+                    maxError = std::max(maxError, std::sqrt(difference.x * difference.x + difference.y * difference.y + difference.z * difference.z));
+                }
+            }
+
+            errors[t] = maxError;
+        }
+    });
+
+    return errors.empty() ? 0.0f : *std::max_element(errors.begin(), errors.end());
+}
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "stdafx.h"
+
+#include "Types.h"
+
+// CPU version of the hull/domain shaders displacement, used to pre-tessellate meshes once.
+namespace Tessellator
+{
+// Copy of surfaceHeight() from MRTPass.hlsl and DepthPass.hlsl, they have to be changed together.
+float SurfaceHeight(float u, float v);
+
+// Splits every triangle into factor^2 triangles (integer partitioning) and displaces vertices
+// along the normal of the first triangle vertex like ds_main does. Runs in parallel.
+void Tessellate(const std::vector<geometryVertex>& vertices,
+                const std::vector<uint32_t>& indices,
+                uint32_t factor,
+                std::vector<geometryVertex>& outVertices,
+                std::vector<uint32_t>& outIndices);
+
+// Max distance between the displaced surface sampled at referenceFactor and its linear approximation at factor.
+float MeasureError(const std::vector<geometryVertex>& vertices,
+                   const std::vector<uint32_t>& indices,
+                   uint32_t factor,
+                   uint32_t referenceFactor);
+}
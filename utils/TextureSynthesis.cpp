@@ -0,0 +1,162 @@
+#include "stdafx.h"
+
+#include "TextureSynthesis.h"
+
+#include "ParallelFor.h"
+
+#include <immintrin.h>
+
+namespace TextureSynthesis
+{
+namespace
+{
+constexpr size_t bytesPerTexel = 4;
+constexpr size_t rowSizeLimit = 256 / bytesPerTexel;
+
+constexpr uint32_t whiteColor = 0xFF'FF'FF'FF;
+constexpr uint32_t orangeColor = 0xFF'C4'92'00;
+
+struct Image
+{
+    size_t offset;  // in texels
+    size_t width;
+    size_t height;
+    size_t slice;
+};
+
+// color = same ^ ((same ^ other) & mask), so no branches are needed
+void FillRow(uint32_t* row, const uint32_t* columnMasks, size_t width, uint32_t rowMask, uint32_t same, uint32_t other)
+{
+    const uint32_t difference = same ^ other;
+    size_t col = 0;
+
+#if defined(__AVX2__)
+    const __m256i rowMask8 = _mm256_set1_epi32((int)rowMask);
+    const __m256i same8 = _mm256_set1_epi32((int)same);
+    const __m256i difference8 = _mm256_set1_epi32((int)difference);
+    for (; col + 16 <= width; col += 16)
+    {
+        __m256i mask0 = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(columnMasks + col)), rowMask8);
+        __m256i mask1 = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(columnMasks + col + 8)), rowMask8);
+        _mm256_storeu_si256((__m256i*)(row + col), _mm256_xor_si256(same8, _mm256_and_si256(difference8, mask0)));
+        _mm256_storeu_si256((__m256i*)(row + col + 8), _mm256_xor_si256(same8, _mm256_and_si256(difference8, mask1)));
+    }
+#else
+    // SSE2 is always available on x64
+    const __m128i rowMask4 = _mm_set1_epi32((int)rowMask);
+    const __m128i same4 = _mm_set1_epi32((int)same);
+    const __m128i difference4 = _mm_set1_epi32((int)difference);
+    for (; col + 16 <= width; col += 16)
+    {
+        for (size_t i = 0; i < 16; i += 4)
+        {
+            __m128i mask = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(columnMasks + col + i)), rowMask4);
+            _mm_storeu_si128((__m128i*)(row + col + i), _mm_xor_si128(same4, _mm_and_si128(difference4, mask)));
+        }
+    }
+#endif
+
+    for (; col < width; ++col)
+        row[col] = same ^ (difference & (columnMasks[col] ^ rowMask));
+}
+
+void FillImage(uint32_t* texels, const Image& image)
+{
+    // blocks count along both axes depends on the width only
+    const size_t delimX = (image.width >= 8) ? 8 : image.width;
+    const size_t delimY = (image.width >= 8) ? 8 : image.height;
+
+    // the only divisions left are per column and per row, not per texel
+    std::vector<uint32_t> columnMasks(image.width);
+    for (size_t col = 0; col < image.width; ++col)
+        columnMasks[col] = (col * delimX / image.width) % 2 ? ~0u : 0u;
+
+    // texels with the same parity of block coordinates get the first color
+    const uint32_t same = image.slice & 1 ? whiteColor : orangeColor;
+    const uint32_t other = image.slice & 1 ? orangeColor : whiteColor;
+
+    for (size_t row = 0; row < image.height; ++row)
+    {
+        const uint32_t rowMask = (row * delimY / image.height) % 2 ? ~0u : 0u;
+        FillRow(texels + image.width * row, columnMasks.data(), image.width, rowMask, same, other);
+    }
+}
+}
+
+size_t GenerateCheckerboard(std::vector<uint8_t>& pixels,
+                            std::vector<D3D12_SUBRESOURCE_DATA>& mips,
+                            size_t width,
+                            size_t height,
+                            size_t depth,
+                            bool volume /*= false*/)
+{
+    pixels.clear();
+    mips.clear();
+
+    if (!width || !height || !depth)
+        return 0;
+
+    const size_t arraySize = volume ? 1 : depth;
+    const size_t maxDepth = volume ? depth : 1;
+
+    // layout is computed first, so the buffer is allocated once and images can be filled independently
+    std::vector<Image> images;
+    std::vector<Image> mipImages;   // the first image of every mip
+    size_t offset = 0;
+    size_t generatedMips = 0;
+
+    for (size_t level = 0; level < arraySize; ++level)
+    {
+        size_t mipWidth = width;
+        size_t mipHeight = height;
+        size_t mipDepth = maxDepth;
+        generatedMips = 0;
+
+        while (true)
+        {
+            mipImages.push_back({offset, mipWidth, mipHeight, 0});
+            for (size_t slice = 0; slice < mipDepth; ++slice)
+            {
+                images.push_back({offset, mipWidth, mipHeight, slice});
+                offset += mipWidth * mipHeight;
+            }
+            ++generatedMips;
+
+            if (level == arraySize - 1 && mipWidth == 1 && mipHeight == 1 && mipDepth == 1)
+                break;
+
+            size_t rowPadding = 0;
+            if (mipWidth % rowSizeLimit)
+            {
+                rowPadding = rowSizeLimit - mipWidth % rowSizeLimit;
+                offset += rowPadding * mipHeight * mipDepth; // row padding for alignment
+            }
+
+            if (((mipWidth + rowPadding) * mipHeight * mipDepth) & (2 * rowSizeLimit - 1))
+                offset += rowSizeLimit;                     // mip padding for alignment
+
+            if (mipWidth == 1 && mipHeight == 1 && mipDepth == 1)
+                break;
+
+            mipWidth = mipWidth > 1 ? mipWidth >> 1 : 1;
+            mipHeight = mipHeight > 1 ? mipHeight >> 1 : 1;
+            mipDepth = mipDepth > 1 ? mipDepth >> 1 : 1;
+        }
+    }
+
+    // paddings stay zeroed
+    pixels.resize(offset * bytesPerTexel, 0x0);
+    uint32_t* texels = reinterpret_cast<uint32_t*>(pixels.data());
+
+    for (const Image& mip : mipImages)
+        mips.push_back({texels + mip.offset, (LONG_PTR)(mip.width * bytesPerTexel), (LONG_PTR)(mip.width * mip.height * bytesPerTexel)});
+
+    Threading::ParallelFor(images.size(), 1, [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+            FillImage(texels + images[i].offset, images[i]);
+    });
+
+    return generatedMips;
+}
+}
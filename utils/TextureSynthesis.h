@@ -0,0 +1,18 @@
+#pragma once
+
+#include "stdafx.h"
+
+// CPU generation of procedural textures.
+namespace TextureSynthesis
+{
+// Fills 8x8 blocks checkerboard for every slice (or depth layer of volume) and mip level, colors
+// of odd slices are swapped. Images are stored one by one with tightly packed rows, every mip is
+// followed by padding which keeps the data aligned for upload. Returns mips count of one slice.
+// Images are generated in parallel, rows are filled with SIMD.
+size_t GenerateCheckerboard(std::vector<uint8_t>& pixels,
+                            std::vector<D3D12_SUBRESOURCE_DATA>& mips,
+                            size_t width,
+                            size_t height,
+                            size_t depth,
+                            bool volume = false);
+}
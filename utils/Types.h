@@ -2,12 +2,33 @@
 
 enum optTypes
 {
+    disable_bindless_textures,
     disable_bundles,
     disable_concurrency,
+    disable_lods,
     disable_textures,
     disable_root_constants,
     disable_shadow_pass,
+    disable_worker_spinning,
+    enable_cluster_culling,
+    enable_core_reservation,
+    enable_cpu_tessellation,
+    enable_draw_data_benchmark,
+    enable_draw_data_buffer,
+    enable_draw_root_constants,
+    enable_filtered_mips,
+    enable_gbuffer_cache,
+    enable_histogram_exposure,
+    enable_luminance_validation,
+    enable_pack_benchmark,
+    enable_physical_core_workers,
+    enable_shadow_lod_bias,
+    enable_staging_benchmark,
+    enable_streaming_submission,
     enable_tessellation,
+    enable_texture_compression,
+    enable_thread_pinning,
+    enable_vertex_packing,
     legacy_swapchain,
 };
 
@@ -30,6 +51,22 @@ struct geometryVertex
     float uv[2];
 };
 
+// 20 bytes: SNORM position relative to mesh bounds, SNORM quaternion tangent frame
+// (sign of w keeps the binormal handedness) and half precision texture coordinates
+struct packedGeometryVertex
+{
+    int16_t position[4];
+    int16_t tangentFrame[4];
+    uint16_t uv[2];
+};
+
+struct MeshLod
+{
+    uint32_t firstIndex = 0;
+    uint32_t indicesCount = 0;
+    float error = 0.0f;         // geometric error relative to the mesh bounding sphere radius
+};
+
 struct screenQuadVertex
 {
     float position[2];
@@ -56,6 +93,30 @@ struct sceneParamsConstantBuffer
 struct perModelParamsConstantBuffer
 {
     float worldMatrix[4][4];
+    float positionScale[4];
+    float positionOffset[4];
+    float tessellationFactor[2];    // x - edges, y - inside
+    uint32_t material;
+    float padding;
+};
+
+// 84 bytes of per-draw data for root constants and structured buffer: rows of the 3x4 affine world matrix
+// (transposed 4x4 without the last column), vertex unpacking parameters with tessellation factors in w
+// and index in the material table
+struct perDrawData
+{
+    float worldMatrix[3][4];
+    float positionScale[3];
+    float tessellationEdges;
+    float positionOffset[3];
+    float tessellationInside;
+    uint32_t material;
+};
+
+// entry of the material table, textures are indices in the textures heap
+struct materialData
+{
+    uint32_t diffuseTexture;
 };
 
 struct perFrameParamsConstantBuffer
@@ -64,13 +125,63 @@ struct perFrameParamsConstantBuffer
     float cameraPosition[4];
 };
 
+// how geometry passes get data of every draw
+enum class DrawDataMode
+{
+    ConstantBuffer,     // perModelParamsConstantBuffer of the object, root CBV
+    RootConstants,      // perDrawData in root constants
+    StructuredBuffer    // perDrawData of all objects in one buffer, draw ID in a root constant
+};
+
 struct CommandLineOptions
 {
     bool threads = true;
+    uint32_t worker_spin_count = 4096;  // YieldProcessor iterations before render threads park
+    bool physical_core_workers = false;
+    bool thread_pinning = false;
+    uint32_t reserved_cores = 0;        // left for the main and I/O threads
     bool bundles = true;
     bool root_constants = true;
     bool shadow_pass = true;
     bool textures = true;
+    bool bindless_textures = true;  // used only when the device has resource binding tier 2
     bool tessellation = false;
+    bool cpu_tessellation = false;
+    bool packed_vertices = false;
+    bool cluster_culling = false;
+    DrawDataMode draw_data = DrawDataMode::ConstantBuffer;
+    bool draw_data_benchmark = false;
+    bool filtered_mips = false;
+    bool gbuffer_cache = false;
+    bool streaming_submission = false;
+    bool histogram_exposure = false;
+    bool texture_compression = false;
+    bool staging_benchmark = false;
+    bool pack_benchmark = false;
+    bool luminance_validation = false;
+    bool lods = true;
+    uint32_t shadow_lod_bias = 0;
     bool legacy_swapchain = false;
 };
+
+struct FrameStatistics
+{
+    uint64_t geometryBytes = 0;         // vertex and index data fetched by all geometry passes
+    uint64_t shadowGeometryBytes = 0;   // part of geometryBytes fetched by shadow pass
+    uint64_t triangles = 0;             // triangles submitted by all geometry passes
+    uint64_t shadowTriangles = 0;       // part of triangles submitted by shadow pass
+    uint64_t meshletsTotal = 0;         // meshlets tested by CPU cluster culling in G-buffer pass
+    uint64_t meshletsVisible = 0;
+    float averageTessellationFactor = 0.0f;  // over all objects, 0 when tessellation is disabled
+    float luminanceMicroseconds = 0.0f;      // GPU time of luminance passes from timestamp queries
+    uint64_t drawDataBytes = 0;         // per-draw data written to upload heap for geometry passes
+    uint64_t gbufferLists = 0;          // G-buffer lists with --enable_gbuffer_cache
+    uint64_t gbufferListsReused = 0;    // submitted again without recording
+    float gbufferRecordingMilliseconds = 0.0f;  // CPU time of recorded lists
+    float gbufferSavedMilliseconds = 0.0f;      // last recording time of reused lists
+    float gbufferCacheHitRate = 0.0f;           // reused lists since start
+    uint64_t gbufferSubmissions = 0;    // ExecuteCommandLists calls of G-buffer with --enable_streaming_submission
+    float gbufferFirstSubmitMilliseconds = 0.0f;    // since recording start
+    float gbufferLastSubmitMilliseconds = 0.0f;
+    uint64_t fallbackFrames = 0;        // frames since start with the light pass drawn by its fallback pipeline state
+};
@@ -0,0 +1,117 @@
+#include "stdafx.h"
+
+#include "VertexPacking.h"
+
+#include <DirectXPackedVector.h>
+#include <cmath>
+
+using namespace DirectX::PackedVector;
+
+namespace VertexPacking
+{
+PositionBounds ComputeBounds(const geometryVertex* vertices, size_t count)
+{
+    if (!count)
+        return {};
+
+    XMVECTOR minPosition = XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(vertices[0].position));
+    XMVECTOR maxPosition = minPosition;
+    for (size_t i = 1; i < count; ++i)
+    {
+        XMVECTOR position = XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(vertices[i].position));
+        minPosition = XMVectorMin(minPosition, position);
+        maxPosition = XMVectorMax(maxPosition, position);
+    }
+
+    // flat meshes have zero extent along one of the axes
+    const XMVECTOR minExtent = XMVectorReplicate(1e-6f);
+
+    PositionBounds bounds;
+    XMStoreFloat3(&bounds.center, XMVectorScale(XMVectorAdd(minPosition, maxPosition), 0.5f));
+    XMStoreFloat3(&bounds.extent, XMVectorMax(XMVectorScale(XMVectorSubtract(maxPosition, minPosition), 0.5f), minExtent));
+    return bounds;
+}
+
+void PackVertices(const geometryVertex* vertices, size_t count, const PositionBounds& bounds, packedGeometryVertex* packed)
+{
+    // quaternion w must not be quantized to zero, otherwise its sign (handedness) is lost
+    constexpr float minQuaternionW = 2.0f / 32767.0f;
+
+    const XMVECTOR center = XMLoadFloat3(&bounds.center);
+    const XMVECTOR invExtent = XMVectorReciprocal(XMLoadFloat3(&bounds.extent));
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        const geometryVertex& vertex = vertices[i];
+        packedGeometryVertex& result = packed[i];
+
+        XMVECTOR position = XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(vertex.position));
+        position = XMVectorMultiply(XMVectorSubtract(position, center), invExtent);
+        position = XMVectorSetW(position, 1.0f);
+        XMStoreShortN4(reinterpret_cast<XMSHORTN4*>(result.position), position);
+
+        // orthonormalize the frame, rows are (binormal, tangent, normal) with normal = cross(binormal, tangent)
+        XMVECTOR normal = XMVector3Normalize(XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(vertex.normal)));
+        XMVECTOR tangent = XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(vertex.tangent));
+        tangent = XMVector3Normalize(XMVectorSubtract(tangent, XMVectorMultiply(normal, XMVector3Dot(normal, tangent))));
+        XMVECTOR binormal = XMVector3Cross(tangent, normal);
+
+        const XMVECTOR sourceBinormal = XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(vertex.binormal));
+        const bool mirrored = XMVectorGetX(XMVector3Dot(sourceBinormal, binormal)) < 0.0f;
+
+        XMMATRIX frame(binormal, tangent, normal, g_XMIdentityR3);
+        XMVECTOR quaternion = XMQuaternionNormalize(XMQuaternionRotationMatrix(frame));
+        if (XMVectorGetW(quaternion) < 0.0f)
+            quaternion = XMVectorNegate(quaternion);
+
+        if (XMVectorGetW(quaternion) < minQuaternionW)
+            quaternion = XMQuaternionNormalize(XMVectorSetW(quaternion, minQuaternionW));
+
+        if (mirrored)
+            quaternion = XMVectorSetW(quaternion, -XMVectorGetW(quaternion));
+
+        XMStoreShortN4(reinterpret_cast<XMSHORTN4*>(result.tangentFrame), quaternion);
+        XMStoreHalf2(reinterpret_cast<XMHALF2*>(result.uv), XMLoadFloat2(reinterpret_cast<const XMFLOAT2*>(vertex.uv)));
+    }
+}
+
+void UnpackVertices(const packedGeometryVertex* packed, size_t count, const PositionBounds& bounds, geometryVertex* vertices)
+{
+    const XMVECTOR center = XMLoadFloat3(&bounds.center);
+    const XMVECTOR extent = XMLoadFloat3(&bounds.extent);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        const packedGeometryVertex& vertex = packed[i];
+        geometryVertex& result = vertices[i];
+
+        XMVECTOR position = XMLoadShortN4(reinterpret_cast<const XMSHORTN4*>(vertex.position));
+        position = XMVectorMultiplyAdd(position, extent, center);
+        XMStoreFloat3(reinterpret_cast<XMFLOAT3*>(result.position), position);
+
+        XMVECTOR quaternion = XMLoadShortN4(reinterpret_cast<const XMSHORTN4*>(vertex.tangentFrame));
+        const bool mirrored = XMVectorGetW(quaternion) < 0.0f;
+        quaternion = XMQuaternionNormalize(XMVectorSetW(quaternion, std::fabs(XMVectorGetW(quaternion))));
+
+        const XMMATRIX frame = XMMatrixRotationQuaternion(quaternion);
+        const XMVECTOR binormal = mirrored ? XMVectorNegate(frame.r[0]) : frame.r[0];
+        XMStoreFloat3(reinterpret_cast<XMFLOAT3*>(result.binormal), binormal);
+        XMStoreFloat3(reinterpret_cast<XMFLOAT3*>(result.tangent), frame.r[1]);
+        XMStoreFloat3(reinterpret_cast<XMFLOAT3*>(result.normal), frame.r[2]);
+
+        XMStoreFloat2(reinterpret_cast<XMFLOAT2*>(result.uv), XMLoadHalf2(reinterpret_cast<const XMHALF2*>(vertex.uv)));
+    }
+}
+
+void SplitPositionStream(const uint8_t* vertices, size_t count, size_t stride, size_t positionStride, uint8_t* streams)
+{
+    const size_t attributeStride = stride - positionStride;
+    uint8_t* attributes = streams + count * positionStride;
+    for (size_t i = 0; i < count; ++i)
+    {
+        const uint8_t* vertex = vertices + i * stride;
+        std::memcpy(streams + i * positionStride, vertex, positionStride);
+        std::memcpy(attributes + i * attributeStride, vertex + positionStride, attributeStride);
+    }
+}
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "stdafx.h"
+
+#include "Types.h"
+
+namespace VertexPacking
+{
+// Packed positions are stored in [-1; 1] range, original one is restored as packed * extent + center
+struct PositionBounds
+{
+    XMFLOAT3 center = {0.0f, 0.0f, 0.0f};
+    XMFLOAT3 extent = {1.0f, 1.0f, 1.0f};
+};
+
+PositionBounds ComputeBounds(const geometryVertex* vertices, size_t count);
+
+void PackVertices(const geometryVertex* vertices, size_t count, const PositionBounds& bounds, packedGeometryVertex* packed);
+void UnpackVertices(const packedGeometryVertex* packed, size_t count, const PositionBounds& bounds, geometryVertex* vertices);
+
+// Writes positions of all vertices first and the rest of attributes after them, so passes that need only
+// positions don't fetch the whole vertex. Positions are the first positionStride bytes of a vertex.
+void SplitPositionStream(const uint8_t* vertices, size_t count, size_t stride, size_t positionStride, uint8_t* streams);
+}
@@ -0,0 +1,73 @@
+#include "stdafx.h"
+
+#include "WaitableCounter.h"
+
+namespace Threading
+{
+WaitableCounter::WaitableCounter(uint32_t value /*= 0*/)
+    : _value(value)
+{
+}
+
+uint32_t WaitableCounter::Load() const
+{
+    return _value.load(std::memory_order_acquire);
+}
+
+void WaitableCounter::Store(uint32_t value)
+{
+    _value.store(value);
+    WakeAll();
+}
+
+uint32_t WaitableCounter::Increment()
+{
+    const uint32_t value = ++_value;
+    WakeAll();
+    return value;
+}
+
+uint32_t WaitableCounter::Decrement()
+{
+    const uint32_t value = --_value;
+    if (value == 0)
+        WakeAll();
+    return value;
+}
+
+uint32_t WaitableCounter::WaitWhileEqual(uint32_t expected, uint32_t spinCount) const
+{
+    for (uint32_t i = 0; i < spinCount; ++i)
+    {
+        const uint32_t value = _value.load(std::memory_order_acquire);
+        if (value != expected)
+            return value;
+        YieldProcessor();
+    }
+
+    // the counter is changed before the parked count is read by WakeAll, so either the change is seen here
+    // or the waker sees this thread and wakes it; WaitOnAddress returns at once if the value is changed already
+    ++_parked;
+    uint32_t value = _value.load();
+    while (value == expected)
+    {
+        WaitOnAddress(const_cast<std::atomic_uint32_t*>(&_value), &expected, sizeof(expected), INFINITE);
+        value = _value.load();
+    }
+    --_parked;
+    return value;
+}
+
+void WaitableCounter::WaitZero(uint32_t spinCount) const
+{
+    // decrements don't wake waiters before zero, a waiter parked with a stale value sleeps until then
+    for (uint32_t value = Load(); value != 0; value = WaitWhileEqual(value, spinCount))
+        ;
+}
+
+void WaitableCounter::WakeAll()
+{
+    if (_parked.load() != 0)
+        WakeByAddressAll(&_value);
+}
+}
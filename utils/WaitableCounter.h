@@ -0,0 +1,38 @@
+#pragma once
+
+#include "stdafx.h"
+
+#include <atomic>
+
+namespace Threading
+{
+// 32-bit counter threads wait to change, a frame start signal and an end barrier of worker pools are built on it.
+// Waiters spin for spinCount iterations first, since workers of a frame loop are usually signaled within
+// microseconds, and park in WaitOnAddress after that. Changes call the kernel only when somebody is parked.
+class WaitableCounter
+{
+public:
+    explicit WaitableCounter(uint32_t value = 0);
+
+    WaitableCounter(const WaitableCounter&) = delete;
+    WaitableCounter& operator=(const WaitableCounter&) = delete;
+
+    uint32_t Load() const;
+
+    // store and increment wake all parked waiters
+    void Store(uint32_t value);
+    uint32_t Increment();
+    // wakes waiters only when the counter reaches zero
+    uint32_t Decrement();
+
+    // returns the value which differs from expected
+    uint32_t WaitWhileEqual(uint32_t expected, uint32_t spinCount) const;
+    void WaitZero(uint32_t spinCount) const;
+
+private:
+    void WakeAll();
+
+    std::atomic_uint32_t            _value = 0;
+    mutable std::atomic_uint32_t    _parked = 0;    // waiters in WaitOnAddress
+};
+}